@@ -2,8 +2,17 @@
 
 #include <iostream>
 #include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "ImGuiConsoleManager.h"
+#include "LogRingBuffer.h"
 
 #define RED     "\x1B[31m"
 #define GREEN   "\x1B[32m"
@@ -33,8 +42,40 @@ enum class LEVEL { INFO, WARNING, ERRORS, PRINT, SUCCESS };
  */
 enum class API { DX11, OPENGL, MAIN, INPUT, PHYSICS, RENDERER, SHADER, MODEL, UI };
 
+/**
+ * @brief Behaviour of Console::Log when the log ring buffer is full.
+ */
+enum class OVERFLOW_POLICY { DROP, BLOCK, COUNT_AND_REPORT };
+
+/**
+ * @brief Compact log record written by producers into the log ring buffer.
+ */
+struct LogRecord
+{
+	/**
+	 * @brief Payload bytes per record; longer messages continue in the following records.
+	 */
+	static constexpr size_t PAYLOAD_SIZE = 232;
+
+	uint64_t timestamp = 0;
+	API api = API::MAIN;
+	LEVEL level = LEVEL::PRINT;
+	uint16_t length = 0;
+
+	/**
+	 * @brief True when the message goes on in the next record.
+	 */
+	bool continues = false;
+
+	char payload[PAYLOAD_SIZE];
+};
+
 /**
  * @brief Console class for logging messages with different APIs and log levels.
+ *
+ * Log() only copies the message into a lock-free ring buffer. A background sink thread
+ * drains the buffer in batches, formats the lines and writes them to stdout/stderr and
+ * to the ImGui console.
  */
 class Console
 {
@@ -45,7 +86,49 @@ public:
 	  * @param API The API source of the log (default: MAIN).
 	  * @param errorLvl The log level (default: PRINT).
 	  */
-	void Log(std::string message, API API = API::MAIN, LEVEL errorLvl = LEVEL::PRINT);
+	void Log(std::string_view message, API API = API::MAIN, LEVEL errorLvl = LEVEL::PRINT);
+
+	/**
+	 * @brief Blocks until every message logged before the call has been written by the sink.
+	 */
+	void Flush();
+
+	/**
+	 * @brief Sets what Log() does when the ring buffer is full.
+	 * @param policy DROP discards silently, BLOCK waits for the sink, COUNT_AND_REPORT discards and
+	 * reports the number of lost messages on the next drain.
+	 */
+	void SetOverflowPolicy(OVERFLOW_POLICY policy)
+	{
+		overflowPolicy.store(policy, std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Total number of messages discarded because the ring buffer was full.
+	 */
+	uint64_t GetDroppedCount() const
+	{
+		return droppedTotal.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Total number of messages cut to MAX_MESSAGE_LENGTH and marked with a trailing ellipsis.
+	 */
+	uint64_t GetTruncatedCount() const
+	{
+		return truncatedTotal.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Records a message may spill over; longer messages are truncated.
+	 */
+	static constexpr size_t MAX_RECORDS_PER_MESSAGE = 8;
+
+	/**
+	 * @brief Longest message logged in full, in bytes.
+	 */
+	static constexpr size_t MAX_MESSAGE_LENGTH = LogRecord::PAYLOAD_SIZE * MAX_RECORDS_PER_MESSAGE;
+
 	/**
 	 * @brief Retrieves the singleton instance of Console.
 	 * @return Reference to the Console instance.
@@ -62,30 +145,68 @@ public:
 	 */
 	Console& operator=(const Console&) = delete;
 
+	Console(const Console&) = delete;
+
 	/**
    * @brief Here is a simple method to sample of the logs.
    */
 	void Sample();
 
 private:
+	/**
+	 * @brief Number of records held by the ring buffer.
+	 */
+	static constexpr size_t RING_CAPACITY = 4096;
+
+	/**
+	 * @brief Maximum number of records written per sink batch before flushing the streams.
+	 */
+	static constexpr size_t SINK_BATCH_SIZE = 256;
+
+	/**
+	 * @brief Starts the sink thread.
+	 */
+	Console();
+
+	/**
+	 * @brief Drains the remaining records and joins the sink thread.
+	 */
+	~Console();
+
+	/**
+	 * @brief Sink thread entry point.
+	 */
+	void SinkLoop();
+
+	/**
+	 * @brief Writes one batch of records to the output streams and the ImGui console.
+	 * @return The number of records consumed.
+	 */
+	size_t DrainBatch();
+
+	/**
+	 * @brief Wakes the sink thread if it is waiting for records.
+	 */
+	void WakeSink();
+
 	/**
 	 * @brief Retrieves a formatted API string with color.
 	 * @param API The API enum value.
 	 * @return A formatted string representing the API.
 	 */
-	static std::string getAPIString(API API)
+	static std::string_view getAPIString(API API)
 	{
 		switch (API)
 		{
-		case API::DX11: return "[" + setColor(GREEN, "DX11") + "]";
-		case API::OPENGL: return "[" + setColor(BLUE, "OPENGL") + "]";
-		case API::MAIN: return "[" + setColor(PASTEL_CYAN, "MAIN") + "]";
-		case API::INPUT: return "[" + setColor(CYAN, "INPUT") + "]";
-		case API::PHYSICS: return "[" + setColor(MAGENTA, "PHYSICS") + "]";
-		case API::RENDERER: return "[" + setColor(RED, "RENDERER") + "]";
-		case API::MODEL: return "[" + setColor(PASTEL_MAGENTA, "MODEL") + "]";
-		case API::SHADER: return "[" + setColor(PASTEL_RED, "SHADER") + "]";
-		case API::UI: return "[" + setColor(PASTEL_GREEN, "UI") + "]";
+		case API::DX11: return "[" GREEN "DX11" RESET "]";
+		case API::OPENGL: return "[" BLUE "OPENGL" RESET "]";
+		case API::MAIN: return "[" PASTEL_CYAN "MAIN" RESET "]";
+		case API::INPUT: return "[" CYAN "INPUT" RESET "]";
+		case API::PHYSICS: return "[" MAGENTA "PHYSICS" RESET "]";
+		case API::RENDERER: return "[" RED "RENDERER" RESET "]";
+		case API::MODEL: return "[" PASTEL_MAGENTA "MODEL" RESET "]";
+		case API::SHADER: return "[" PASTEL_RED "SHADER" RESET "]";
+		case API::UI: return "[" PASTEL_GREEN "UI" RESET "]";
 		default: return "[UNKNOWN]";
 		}
 	}
@@ -95,42 +216,90 @@ private:
 	 * @param level The log level enum value.
 	 * @return A formatted string representing the log level.
 	 */
-	static std::string getLevelString(LEVEL level)
+	static std::string_view getLevelString(LEVEL level)
 	{
 		switch (level)
 		{
-		case LEVEL::INFO: return "[" + setColor(BLUE, "INFO") + "] ";
-		case LEVEL::WARNING: return "[" + setColor(YELLOW, "WARNING") + "] ";
-		case LEVEL::ERRORS: return "[" + setColor(RED, "ERROR") + "] ";
-		case LEVEL::PRINT: return "[" + setColor(WHITE, "PRINT") + "] ";
-		case LEVEL::SUCCESS: return "[" + setColor(GREEN, "SUCCESS") + "] ";
+		case LEVEL::INFO: return "[" BLUE "INFO" RESET "] ";
+		case LEVEL::WARNING: return "[" YELLOW "WARNING" RESET "] ";
+		case LEVEL::ERRORS: return "[" RED "ERROR" RESET "] ";
+		case LEVEL::PRINT: return "[" WHITE "PRINT" RESET "] ";
+		case LEVEL::SUCCESS: return "[" GREEN "SUCCESS" RESET "] ";
 		default: return "[UNKNOWN]";
 		}
 	}
 
 	/**
-	* @brief Sets color formatting for text.
-	* @param color The color code.
-	* @param text The text to colorize.
-	* @return The formatted string.
-	*/
-	static std::string setColor(std::string_view color, std::string_view text)
+	 * @brief Retrieves the color used for the message body of a log level.
+	 * @param level The log level enum value.
+	 * @return The color code.
+	 */
+	static std::string_view getMessageColor(LEVEL level)
 	{
-		return std::string(color) + std::string(text) + RESET;
+		switch (level)
+		{
+		case LEVEL::SUCCESS: return GREEN;
+		case LEVEL::INFO: return CYAN;
+		case LEVEL::WARNING: return YELLOW;
+		case LEVEL::ERRORS: return RED;
+		case LEVEL::PRINT:
+		default: return WHITE;
+		}
 	}
 
 	/**
-	 * @brief Formats a log message with API, level, and color.
-	 * @param api The API source.
-	 * @param level The log level.
-	 * @param text The log message.
-	 * @param color The color code.
-	 * @return The formatted log message.
+	 * @brief Appends a fully formatted log line (API, level, colored message) to a string.
+	 * @param out The string to append to.
+	 * @param record The record holding the timestamp, API and level.
+	 * @param message The message, which may span several records.
 	 */
-	static std::string setLog(API api, LEVEL level, std::string_view text, const char* color)
-	{
-		return getAPIString(api) + getLevelString(level) + setColor(color, text);
-	};
+	void appendLog(std::string& out, const LogRecord& record, std::string_view message) const;
+
+	LogRingBuffer<LogRecord> ring{ RING_CAPACITY };
+
+	std::atomic<OVERFLOW_POLICY> overflowPolicy{ OVERFLOW_POLICY::COUNT_AND_REPORT };
+
+	/**
+	 * @brief Messages dropped since the last report (COUNT_AND_REPORT policy).
+	 */
+	std::atomic<uint64_t> droppedPending{ 0 };
+
+	std::atomic<uint64_t> droppedTotal{ 0 };
+
+	std::atomic<uint64_t> truncatedTotal{ 0 };
+
+	/**
+	 * @brief Number of records written by the sink, used by Flush().
+	 */
+	std::atomic<size_t> processed{ 0 };
+
+	std::atomic<bool> running{ true };
+
+	std::atomic<bool> sinkWaiting{ false };
+
+	std::mutex sinkMutex;
+
+	std::condition_variable sinkWake;
+
+	std::condition_variable sinkDone;
+
+	std::chrono::steady_clock::time_point startTime;
+
+	/**
+	 * @brief Reusable formatting buffers owned by the sink thread.
+	 */
+	std::string outBuffer;
+
+	std::string errBuffer;
+
+	std::string lineBuffer;
+
+	/**
+	 * @brief Payloads of a message whose last record has not been drained yet.
+	 */
+	std::string pendingMessage;
+
+	std::thread sinkThread;
 };
 
 /**
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "PhysicsManager.h"
+
+/**
+ * @brief Options of a headless run, filled from the command line.
+ */
+struct HeadlessSettings
+{
+	/**
+	 * @brief Number of frames to simulate.
+	 */
+	int frames = 600;
+
+	/**
+	 * @brief Wall-clock duration of one frame in seconds, fed to the physics and audio updates.
+	 */
+	double frameTime = 1.0 / 60.0;
+
+	/**
+	 * @brief Number of dynamic boxes dropped on the ground plane.
+	 */
+	int bodies = 1000;
+
+	/**
+	 * @brief Number of looping tones mixed by the audio engine.
+	 */
+	int sounds = 8;
+
+	/**
+	 * @brief Number of task scheduler threads, 0 to use every hardware thread.
+	 */
+	int threads = 0;
+
+	/**
+	 * @brief Task scheduler used by the physics world.
+	 */
+	TASK_SCHEDULER scheduler = TASK_SCHEDULER::DEFAULT;
+
+	/**
+	 * @brief Backs the physics allocator pools with huge pages.
+	 */
+	bool hugePages = false;
+
+	/**
+	 * @brief Broadphase used by the physics world.
+	 */
+	BROADPHASE broadphase = BROADPHASE::DBVT;
+
+	/**
+	 * @brief Finds the physics overlapping pairs on the task scheduler.
+	 */
+	bool parallelBroadphase = true;
+
+	/**
+	 * @brief Adds the physics overlapping pairs to a concurrent pair cache from the broadphase tasks.
+	 */
+	bool concurrentPairCache = false;
+
+	/**
+	 * @brief Records the physics pair events and reports how many there were.
+	 */
+	bool pairEvents = false;
+
+	/**
+	 * @brief Runs the physics narrowphase with the batched kernels.
+	 */
+	bool batchedNarrowphase = false;
+
+	/**
+	 * @brief Skips the convex pair queries that the coherence cache can answer.
+	 */
+	bool convexCoherence = false;
+
+	/**
+	 * @brief Telemetry file. A ".json" extension selects JSON, anything else CSV. Empty to skip.
+	 */
+	std::string outputPath = "headless_telemetry.csv";
+
+	/**
+	 * @brief Chrome trace file written at the end of the run. Empty to leave the profiler off.
+	 */
+	std::string tracePath;
+
+	/**
+	 * @brief Number of final frames exported to the trace file.
+	 */
+	int traceFrames = 10;
+};
+
+/**
+ * @brief Time spent in each part of one frame, in milliseconds.
+ */
+struct FrameTiming
+{
+	double total = 0.0;
+	double physics = 0.0;
+	double audio = 0.0;
+};
+
+/**
+ * @brief Distribution of one timing series, in milliseconds.
+ */
+struct TimingSummary
+{
+	double min = 0.0;
+	double avg = 0.0;
+	double p50 = 0.0;
+	double p99 = 0.0;
+	double max = 0.0;
+};
+
+/**
+ * @brief HeadlessRunner class running the engine loop without a window.
+ *
+ * Steps the physics world and the audio mixer for a fixed number of frames on the calling thread
+ * and records per-frame timings, so simulation performance can be measured on machines with no
+ * display or sound card.
+ */
+class HeadlessRunner
+{
+public:
+	/**
+	 * @brief Parses the command line into settings.
+	 * @param argc Argument count.
+	 * @param argv Argument values (--frames, --dt, --bodies, --sounds, --threads, --scheduler, --out, --trace, --trace-frames).
+	 * @param settings Receives the parsed options.
+	 * @return False if an argument is unknown or malformed.
+	 */
+	static bool ParseArguments(int argc, char** argv, HeadlessSettings& settings);
+
+	/**
+	 * @brief Runs the simulation and writes the telemetry file.
+	 * @param settings The run options.
+	 * @return The process exit code.
+	 */
+	int Run(const HeadlessSettings& settings);
+
+	/**
+	 * @brief Computes min/avg/p50/p99/max over a timing series.
+	 * @param samples The samples; reordered by the call.
+	 * @return The summary, all zero if there are no samples.
+	 */
+	static TimingSummary Summarize(std::vector<double>& samples);
+
+private:
+	/**
+	 * @brief Writes the per-frame timings and their summaries to settings.outputPath.
+	 * @return False if the file could not be written.
+	 */
+	bool WriteTelemetry(const HeadlessSettings& settings) const;
+
+	std::vector<FrameTiming> timings;
+
+	TimingSummary totalSummary;
+
+	TimingSummary physicsSummary;
+
+	TimingSummary audioSummary;
+};
@@ -1,44 +1,114 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
-#include <vector>
-#include <regex>
-#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
 
-#include"..\..\Libraries\imgui\imgui.h"
+#include"../../Libraries/imgui/imgui.h"
 
 /**
  * @brief ANSI Color Code to ImGui Color Mapping
  *
- * This unordered map is used to map ANSI color codes to ImGui color representations.
+ * Maps the SGR parameters of an ANSI color sequence to an ImGui color. The basic colors (30-37)
+ * and the pastel palette used by Console have fixed values; any other 256-color index falls back
+ * to the standard xterm palette.
+ *
+ * @param code The SGR code (30-37, 39, 0 for reset, or 38 followed by 5;index).
+ * @param index The 256-color index when code is 38, ignored otherwise.
+ * @param color Receives the color when the sequence is recognized.
+ *
+ * @return True if the sequence changes the text color.
  */
-const std::unordered_map<std::string, ImVec4> ANSI_COLOR_MAP = {
-	{"\x1B[31m", ImVec4(1.0f, 0.0f, 0.0f, 1.0f)}, // RED
-	{"\x1B[32m", ImVec4(0.0f, 1.0f, 0.0f, 1.0f)}, // GREEN
-	{"\x1B[33m", ImVec4(1.0f, 1.0f, 0.0f, 1.0f)}, // YELLOW
-	{"\x1B[34m", ImVec4(0.0f, 0.0f, 1.0f, 1.0f)}, // BLUE
-	{"\x1B[35m", ImVec4(1.0f, 0.0f, 1.0f, 1.0f)}, // MAGENTA
-	{"\x1B[36m", ImVec4(0.0f, 1.0f, 1.0f, 1.0f)}, // CYAN
-	{"\x1B[37m", ImVec4(1.0f, 1.0f, 1.0f, 1.0f)}, // WHITE
-
-	{"\x1B[38;5;210m", ImVec4(1.0f, 0.6f, 0.7f, 1.0f)}, // PASTEL RED (Soft Pink)
-	{"\x1B[38;5;150m", ImVec4(0.6f, 1.0f, 0.6f, 1.0f)}, // PASTEL GREEN (Mint)
-	{"\x1B[38;5;229m", ImVec4(1.0f, 1.0f, 0.8f, 1.0f)}, // PASTEL YELLOW (Light Cream)
-	{"\x1B[38;5;147m", ImVec4(0.6f, 0.8f, 1.0f, 1.0f)}, // PASTEL BLUE (Sky Blue)
-	{"\x1B[38;5;183m", ImVec4(0.8f, 0.6f, 1.0f, 1.0f)}, // PASTEL MAGENTA (Lavender)
-	{"\x1B[38;5;159m", ImVec4(0.6f, 1.0f, 0.9f, 1.0f)}, // PASTEL CYAN (Aqua)
-	{"\x1B[38;5;141m", ImVec4(0.7f, 0.5f, 0.9f, 1.0f)}, // PASTEL PURPLE
-	{"\033[0m", ImVec4(1.0f, 1.0f, 1.0f, 1.0f)} // RESET (Default white)
-};
+inline bool AnsiColorToImGui(int code, int index, ImU32& color)
+{
+	switch (code)
+	{
+	case 0:
+	case 39: color = IM_COL32(255, 255, 255, 255); return true; // RESET (Default white)
+	case 31: color = IM_COL32(255, 0, 0, 255); return true;     // RED
+	case 32: color = IM_COL32(0, 255, 0, 255); return true;     // GREEN
+	case 33: color = IM_COL32(255, 255, 0, 255); return true;   // YELLOW
+	case 34: color = IM_COL32(0, 0, 255, 255); return true;     // BLUE
+	case 35: color = IM_COL32(255, 0, 255, 255); return true;   // MAGENTA
+	case 36: color = IM_COL32(0, 255, 255, 255); return true;   // CYAN
+	case 30:
+	case 37: color = IM_COL32(255, 255, 255, 255); return true; // WHITE
+	case 38: break;
+	default: return false;
+	}
+
+	switch (index)
+	{
+	case 210: color = IM_COL32(255, 153, 178, 255); return true; // PASTEL RED (Soft Pink)
+	case 150: color = IM_COL32(153, 255, 153, 255); return true; // PASTEL GREEN (Mint)
+	case 229: color = IM_COL32(255, 255, 204, 255); return true; // PASTEL YELLOW (Light Cream)
+	case 147: color = IM_COL32(153, 204, 255, 255); return true; // PASTEL BLUE (Sky Blue)
+	case 183: color = IM_COL32(204, 153, 255, 255); return true; // PASTEL MAGENTA (Lavender)
+	case 159: color = IM_COL32(153, 255, 229, 255); return true; // PASTEL CYAN (Aqua)
+	case 141: color = IM_COL32(178, 127, 229, 255); return true; // PASTEL PURPLE
+	default: break;
+	}
+
+	if (index < 0 || index > 255)
+	{
+		return false;
+	}
+
+	if (index < 16)
+	{
+		const int level = index >= 8 ? 255 : 170;
+		color = IM_COL32((index & 1) ? level : 0, (index & 2) ? level : 0, (index & 4) ? level : 0, 255);
+	}
+	else if (index < 232)
+	{
+		static const int cube[6] = { 0, 95, 135, 175, 215, 255 };
+		const int cell = index - 16;
+		color = IM_COL32(cube[cell / 36], cube[(cell / 6) % 6], cube[cell % 6], 255);
+	}
+	else
+	{
+		const int gray = 8 + (index - 232) * 10;
+		color = IM_COL32(gray, gray, gray, 255);
+	}
+	return true;
+}
 
 /**
  * @brief ImGuiConsoleManager class for managing and rendering console logs in an ImGui interface.
  *
- * This class handles logging messages with ANSI color codes, stores them, and displays them with the appropriate ImGui color formatting.
+ * Lines are parsed once, when logged, into colored spans. The stripped text lives in a single
+ * circular text arena and the spans and lines in rings, so the oldest lines are evicted in O(1).
+ * The storage starts empty and doubles as the history grows, up to the MAX_* limits; past that
+ * logging no longer allocates. Draw only submits the visible lines through ImGuiListClipper, so
+ * its cost does not depend on the history size.
  */
 class ImGuiConsoleManager
 {
 public:
+	/**
+	 * @brief Maximum number of lines kept in the history.
+	 */
+	static constexpr size_t MAX_LINES = 100000;
+
+	/**
+	 * @brief Maximum size in bytes of the text arena shared by all lines.
+	 */
+	static constexpr size_t TEXT_ARENA_SIZE = 8 * 1024 * 1024;
+
+	/**
+	 * @brief Maximum number of colored spans kept across all lines.
+	 */
+	static constexpr size_t MAX_SPANS = 4 * MAX_LINES;
+
+	/**
+	 * @brief Lines longer than this (after stripping color codes) are truncated.
+	 */
+	static constexpr size_t MAX_LINE_LENGTH = 1024;
+
 	/**
 	 * @brief Retrieves the singleton instance of ImGuiConsoleManager.
 	 *
@@ -57,15 +127,29 @@ public:
 	 *
 	 * This function parses the ANSI color codes in the input message and stores the segments for rendering.
 	 */
-	void Log(const std::string& message)
+	void Log(std::string_view message)
 	{
-		std::vector<std::pair<std::string, ImVec4>> parsedSegments = ParseAnsiColors(message);
+		std::lock_guard<std::mutex> lock(logsMutex);
 
-		if (logs.size() >= 100)
+		const size_t reserved = message.size() < MAX_LINE_LENGTH ? message.size() : MAX_LINE_LENGTH;
+		GrowIfFull(reserved);
+
+		if (lineCount == lineCapacity)
 		{
-			logs.erase(logs.begin()); // Limit log size to 100
+			PopOldestLine();
 		}
-		logs.push_back(parsedSegments);
+
+		const uint64_t textStart = ReserveText(reserved);
+
+		LogLine line;
+		line.textStart = textStart;
+		line.firstSpan = spanHead;
+
+		ParseAnsiColors(message, textArena.get() + (textStart % textCapacity), reserved, line);
+
+		textHead = textStart + line.textLength;
+		lines[(lineFirst + lineCount) % lineCapacity] = line;
+		++lineCount;
 		scrollToBottom = true;
 	}
 
@@ -74,7 +158,11 @@ public:
 	 */
 	void Clear()
 	{
-		logs.clear();
+		std::lock_guard<std::mutex> lock(logsMutex);
+		lineFirst = 0;
+		lineCount = 0;
+		textHead = 0;
+		spanHead = 0;
 	}
 
 	/**
@@ -87,14 +175,27 @@ public:
 		ImGui::Begin(title);
 		ImGui::BeginChild("ScrollingRegion", ImVec2(ImGui::GetWindowWidth(), ImGui::GetWindowHeight()), true);
 
-		for (const auto& logLine : logs)
+		std::unique_lock<std::mutex> lock(logsMutex);
+
+		ImGuiListClipper clipper;
+		clipper.Begin((int)lineCount);
+		while (clipper.Step())
 		{
-			for (const auto& segment : logLine)
+			for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
 			{
-				ImGui::TextColored(segment.second, "%s", segment.first.c_str());
-				ImGui::SameLine();
+				const LogLine& line = lines[(lineFirst + row) % lineCapacity];
+				const char* text = textArena.get() + (line.textStart % textCapacity);
+
+				for (uint16_t i = 0; i < line.spanCount; ++i)
+				{
+					const LogSpan& span = spans[(line.firstSpan + i) % spanCapacity];
+					ImGui::PushStyleColor(ImGuiCol_Text, span.color);
+					ImGui::TextUnformatted(text + span.offset, text + span.offset + span.length);
+					ImGui::PopStyleColor();
+					ImGui::SameLine(0.0f, 0.0f);
+				}
+				ImGui::NewLine(); // Move to the next log line
 			}
-			ImGui::NewLine(); // Move to the next log line
 		}
 
 		if (scrollToBottom)
@@ -102,6 +203,7 @@ public:
 			ImGui::SetScrollHereY(1.0f);
 			scrollToBottom = false;
 		}
+		lock.unlock();
 
 		ImGui::EndChild();
 		ImGui::End();
@@ -135,10 +237,44 @@ public:
 	ImGuiConsoleManager& operator=(const ImGuiConsoleManager&) = delete;
 
 private:
+	/**
+	 * @brief A run of text drawn with a single color, relative to the start of its line.
+	 */
+	struct LogSpan
+	{
+		uint16_t offset;
+		uint16_t length;
+		ImU32 color;
+	};
+
+	/**
+	 * @brief A log line. Text and span positions are monotonic and wrap modulo the arena/ring size.
+	 */
+	struct LogLine
+	{
+		uint64_t textStart = 0;
+		uint64_t firstSpan = 0;
+		uint16_t textLength = 0;
+		uint16_t spanCount = 0;
+	};
+
+	/**
+	 * @brief Capacities allocated by the first Log call.
+	 */
+	static constexpr size_t INITIAL_LINES = 256;
+
+	static constexpr size_t INITIAL_TEXT_ARENA_SIZE = 64 * 1024;
+
+	/**
+	 * @brief A single line may need one span per character, so the span ring never starts smaller.
+	 */
+	static constexpr size_t INITIAL_SPANS = 2 * MAX_LINE_LENGTH;
+
 	/**
 	 * @brief Private constructor to prevent direct instantiation of ImGuiConsoleManager.
 	 */
-	ImGuiConsoleManager() : scrollToBottom(false) {}
+	ImGuiConsoleManager()
+		: scrollToBottom(false) {}
 
 	/**
 	 * @brief Destructor for ImGuiConsoleManager.
@@ -146,9 +282,44 @@ private:
 	~ImGuiConsoleManager() {}
 
 	/**
-	 * @brief A vector holding the log entries, with each log containing multiple segments (text and color).
+	 * @brief Ring of log lines, oldest at lineFirst.
+	 */
+	std::unique_ptr<LogLine[]> lines;
+
+	/**
+	 * @brief Ring of colored spans referenced by the lines.
+	 */
+	std::unique_ptr<LogSpan[]> spans;
+
+	/**
+	 * @brief Circular arena holding the stripped text of every line contiguously.
+	 */
+	std::unique_ptr<char[]> textArena;
+
+	/**
+	 * @brief Current sizes of the line ring, the span ring and the text arena.
+	 */
+	size_t lineCapacity = 0;
+
+	size_t spanCapacity = 0;
+
+	size_t textCapacity = 0;
+
+	size_t lineFirst = 0;
+
+	size_t lineCount = 0;
+
+	/**
+	 * @brief Monotonic write positions in the text arena and the span ring.
 	 */
-	std::vector<std::vector<std::pair<std::string, ImVec4>>> logs;
+	uint64_t textHead = 0;
+
+	uint64_t spanHead = 0;
+
+	/**
+	 * @brief Guards the history, which is filled by the Console sink thread and read by Draw on the UI thread.
+	 */
+	std::mutex logsMutex;
 
 	/**
 	 * @brief A buffer for user input text.
@@ -161,45 +332,189 @@ private:
 	bool scrollToBottom;
 
 	/**
-	 * @brief Parses ANSI color codes from the given text and returns a vector of pairs (text, color).
+	 * @brief Evicts the oldest line from the history.
+	 */
+	void PopOldestLine()
+	{
+		lineFirst = (lineFirst + 1) % lineCapacity;
+		--lineCount;
+	}
+
+	/**
+	 * @brief Doubles the storage that the next line would otherwise evict from, while it is below its maximum.
 	 *
-	 * @param text The input text containing ANSI color codes.
+	 * @param textSize The number of text bytes the next line reserves.
+	 */
+	void GrowIfFull(size_t textSize)
+	{
+		const uint64_t oldestText = lineCount > 0 ? lines[lineFirst].textStart : textHead;
+		const uint64_t oldestSpan = lineCount > 0 ? lines[lineFirst].firstSpan : spanHead;
+
+		// The text reservation may skip up to its own size at the end of the arena, and the line may
+		// need a span per character.
+		const bool linesFull = lineCount == lineCapacity && lineCapacity < MAX_LINES;
+		const bool textFull = textHead - oldestText + 2 * textSize > textCapacity && textCapacity < TEXT_ARENA_SIZE;
+		const bool spansFull = spanHead - oldestSpan + textSize + 1 > spanCapacity && spanCapacity < MAX_SPANS;
+
+		if (textArena && !linesFull && !textFull && !spansFull)
+		{
+			return;
+		}
+
+		const size_t newLineCapacity = !textArena ? INITIAL_LINES : linesFull ? std::min(2 * lineCapacity, MAX_LINES) : lineCapacity;
+		const size_t newSpanCapacity = !textArena ? INITIAL_SPANS : spansFull ? std::min(2 * spanCapacity, MAX_SPANS) : spanCapacity;
+		const size_t newTextCapacity = !textArena ? INITIAL_TEXT_ARENA_SIZE : textFull ? std::min(2 * textCapacity, TEXT_ARENA_SIZE) : textCapacity;
+
+		std::unique_ptr<LogLine[]> newLines(new LogLine[newLineCapacity]);
+		std::unique_ptr<LogSpan[]> newSpans(new LogSpan[newSpanCapacity]);
+		std::unique_ptr<char[]> newText(new char[newTextCapacity]);
+
+		// Copy the history oldest first, packed from the start of the new storage.
+		uint64_t textPosition = 0;
+		uint64_t spanPosition = 0;
+		for (size_t row = 0; row < lineCount; ++row)
+		{
+			LogLine line = lines[(lineFirst + row) % lineCapacity];
+			memcpy(newText.get() + textPosition, textArena.get() + (line.textStart % textCapacity), line.textLength);
+			for (uint16_t i = 0; i < line.spanCount; ++i)
+			{
+				newSpans[spanPosition + i] = spans[(line.firstSpan + i) % spanCapacity];
+			}
+			line.textStart = textPosition;
+			line.firstSpan = spanPosition;
+			textPosition += line.textLength;
+			spanPosition += line.spanCount;
+			newLines[row] = line;
+		}
+
+		lines = std::move(newLines);
+		spans = std::move(newSpans);
+		textArena = std::move(newText);
+		lineCapacity = newLineCapacity;
+		spanCapacity = newSpanCapacity;
+		textCapacity = newTextCapacity;
+		lineFirst = 0;
+		textHead = textPosition;
+		spanHead = spanPosition;
+	}
+
+	/**
+	 * @brief Reserves a contiguous region of the text arena, evicting the lines it overwrites.
 	 *
-	 * @return A vector of pairs where each pair consists of the text and its corresponding color.
+	 * @param size The number of bytes to reserve.
+	 *
+	 * @return The monotonic position of the region. A region never straddles the end of the arena.
 	 */
-	std::vector<std::pair<std::string, ImVec4>> ParseAnsiColors(const std::string& text)
+	uint64_t ReserveText(size_t size)
 	{
-		std::vector<std::pair<std::string, ImVec4>> result;
-		std::regex ansiPattern(R"((\x1B\[[0-9;]*m))"); // Match ANSI color codes
-		std::sregex_token_iterator iter(text.begin(), text.end(), ansiPattern, {-1, 0});
-		std::sregex_token_iterator end;
+		uint64_t start = textHead;
+		const uint64_t wrapped = start % textCapacity;
+		if (wrapped + size > textCapacity)
+		{
+			start += textCapacity - wrapped;
+		}
 
-		ImVec4 currentColor = ANSI_COLOR_MAP.at("\033[0m"); // Default to white
-		std::string currentText;
+		while (lineCount > 0 && lines[lineFirst].textStart + textCapacity < start + size)
+		{
+			PopOldestLine();
+		}
 
-		for (; iter != end; ++iter)
+		return start;
+	}
+
+	/**
+	 * @brief Appends a span to the current line, evicting the lines whose spans it overwrites.
+	 */
+	void PushSpan(LogLine& line, uint16_t offset, uint16_t length, ImU32 color)
+	{
+		if (length == 0)
+		{
+			return;
+		}
+
+		// Merge with the previous span when the color did not actually change.
+		if (line.spanCount > 0)
+		{
+			LogSpan& last = spans[(line.firstSpan + line.spanCount - 1) % spanCapacity];
+			if (last.color == color && last.offset + last.length == offset)
+			{
+				last.length += length;
+				return;
+			}
+		}
+
+		while (lineCount > 0 && lines[lineFirst].firstSpan + spanCapacity <= spanHead)
+		{
+			PopOldestLine();
+		}
+
+		spans[spanHead % spanCapacity] = { offset, length, color };
+		++spanHead;
+		++line.spanCount;
+	}
+
+	/**
+	 * @brief Parses ANSI color codes from the given text into colored spans.
+	 *
+	 * A hand-written scanner for ESC [ params m sequences: the text between sequences is copied
+	 * once into the arena and each color change starts a new span.
+	 *
+	 * @param text The input text containing ANSI color codes.
+	 * @param out The reserved arena region receiving the stripped text.
+	 * @param capacity The size of the reserved region.
+	 * @param line The line receiving the spans and the stripped length.
+	 */
+	void ParseAnsiColors(std::string_view text, char* out, size_t capacity, LogLine& line)
+	{
+		ImU32 currentColor = IM_COL32(255, 255, 255, 255); // Default to white
+		size_t written = 0;
+		size_t spanStart = 0;
+		size_t i = 0;
+
+		while (i < text.size() && written < capacity)
 		{
-			std::string part = iter->str();
-			if (ANSI_COLOR_MAP.find(part) != ANSI_COLOR_MAP.end())
+			if (text[i] != '\x1B' || i + 1 >= text.size() || text[i + 1] != '[')
 			{
-				if (!currentText.empty())
+				out[written++] = text[i++];
+				continue;
+			}
+
+			// Parse up to three ';' separated numeric parameters followed by 'm'.
+			int params[3] = { 0, 0, 0 };
+			int paramCount = 0;
+			size_t j = i + 2;
+			while (j < text.size() && ((text[j] >= '0' && text[j] <= '9') || text[j] == ';'))
+			{
+				if (text[j] == ';')
+				{
+					++paramCount;
+				}
+				else if (paramCount < 3)
 				{
-					result.emplace_back(currentText, currentColor);
-					currentText.clear();
+					params[paramCount] = params[paramCount] * 10 + (text[j] - '0');
 				}
-				currentColor = ANSI_COLOR_MAP.at(part);
+				++j;
 			}
-			else
+
+			if (j >= text.size() || text[j] != 'm')
 			{
-				currentText += part;
+				// Not a color sequence, keep it as text.
+				out[written++] = text[i++];
+				continue;
 			}
-		}
 
-		if (!currentText.empty())
-		{
-			result.emplace_back(currentText, currentColor);
+			ImU32 color;
+			const int index = params[0] == 38 && params[1] == 5 ? params[2] : -1;
+			if (AnsiColorToImGui(params[0], index, color) && color != currentColor)
+			{
+				PushSpan(line, (uint16_t)spanStart, (uint16_t)(written - spanStart), currentColor);
+				spanStart = written;
+				currentColor = color;
+			}
+			i = j + 1;
 		}
 
-		return result;
+		PushSpan(line, (uint16_t)spanStart, (uint16_t)(written - spanStart), currentColor);
+		line.textLength = (uint16_t)written;
 	}
 };
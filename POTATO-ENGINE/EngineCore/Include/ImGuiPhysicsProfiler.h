@@ -0,0 +1,509 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include"../../Libraries/imgui/imgui.h"
+
+#include "PhysicsManager.h"
+
+/**
+ * @brief ImGuiPhysicsProfiler class showing the physics profile published with each snapshot.
+ *
+ * Feed it every frame with the snapshot returned by Physics.AcquireSnapshot() while
+ * Physics.SetProfilingEnabled(true) is on. It keeps a rolling history per scope (keyed by thread,
+ * parent scope and name) and per counter, and draws the scope hierarchy, a flame graph per
+ * scheduler thread and the world counters. All storage is fixed-size and owned by the panel, so it
+ * can stay open indefinitely without allocating.
+ */
+class ImGuiPhysicsProfiler
+{
+public:
+	/**
+	 * @brief Number of updates kept in every history.
+	 */
+	static constexpr int HISTORY_LENGTH = 240;
+
+	/**
+	 * @brief Number of distinct scopes tracked, a power of two. Scopes beyond it are shown but have no history.
+	 */
+	static constexpr int MAX_TRACKED_SCOPES = 1024;
+
+	/**
+	 * @brief Retrieves the singleton instance of ImGuiPhysicsProfiler.
+	 *
+	 * @return The singleton instance of the ImGuiPhysicsProfiler.
+	 */
+	static ImGuiPhysicsProfiler& GetInstance()
+	{
+		static ImGuiPhysicsProfiler instance;
+		return instance;
+	}
+
+	/**
+	 * @brief Records the profile of a snapshot, once per simulation update.
+	 *
+	 * @param snapshot The latest snapshot. Snapshots already seen or without a profile are ignored.
+	 */
+	void Update(const PhysicsSnapshot& snapshot)
+	{
+		if (paused || !snapshot.profile.valid || snapshot.stepCount == lastStepCount)
+		{
+			return;
+		}
+		lastStepCount = snapshot.stepCount;
+
+		const PhysicsProfile& source = snapshot.profile;
+		profile.scopeCount = source.scopeCount;
+		profile.threadCount = source.threadCount;
+		profile.steps = source.steps;
+		profile.alignedAllocs = source.alignedAllocs;
+		profile.alignedFrees = source.alignedFrees;
+		profile.heapAllocs = source.heapAllocs;
+		profile.manifoldPoolHitRate = source.manifoldPoolHitRate;
+		profile.algorithmPoolHitRate = source.algorithmPoolHitRate;
+		profile.manifoldPoolCapacity = source.manifoldPoolCapacity;
+		profile.algorithmPoolCapacity = source.algorithmPoolCapacity;
+		profile.poolFallbacks = source.poolFallbacks;
+		profile.convexQueries = source.convexQueries;
+		profile.convexCoherenceHitRate = source.convexCoherenceHitRate;
+		profile.triangleQueries = source.triangleQueries;
+		profile.triangleCacheHitRate = source.triangleCacheHitRate;
+		profile.overlappingPairs = source.overlappingPairs;
+		profile.manifolds = source.manifolds;
+		profile.islands = source.islands;
+		profile.bodies = source.bodies;
+		profile.valid = true;
+		memcpy(profile.scopes, source.scopes, sizeof(PhysicsProfileScope) * source.scopeCount);
+		memory = snapshot.memory;
+
+		historyHead = (historyHead + 1) % HISTORY_LENGTH;
+		historyCount = historyCount < HISTORY_LENGTH ? historyCount + 1 : HISTORY_LENGTH;
+
+		updateHistory[historyHead] = (float)snapshot.updateMilliseconds;
+		allocHistory[historyHead] = (float)source.alignedAllocs;
+		pairHistory[historyHead] = (float)source.overlappingPairs;
+		manifoldHistory[historyHead] = (float)source.manifolds;
+		islandHistory[historyHead] = (float)source.islands;
+
+		// Tracked scopes that did not run in this update get a zero sample.
+		for (TrackedScope& tracked : trackedScopes)
+		{
+			if (tracked.name != nullptr)
+			{
+				tracked.history[historyHead] = 0.0f;
+			}
+		}
+
+		for (int i = 0; i < profile.scopeCount; ++i)
+		{
+			const PhysicsProfileScope& scope = profile.scopes[i];
+			firstChild[i] = -1;
+			childCount[i] = 0;
+
+			// Children are contiguous and come after their parent, so the parent is already placed.
+			if (scope.parent >= 0)
+			{
+				if (childCount[scope.parent]++ == 0)
+				{
+					firstChild[scope.parent] = i;
+				}
+				offsets[i] = nextChildOffset[scope.parent];
+				nextChildOffset[scope.parent] += scope.milliseconds;
+			}
+			else
+			{
+				offsets[i] = threadOffset[scope.thread];
+				threadOffset[scope.thread] += scope.milliseconds;
+			}
+			nextChildOffset[i] = offsets[i];
+
+			const int parentSlot = scope.parent >= 0 ? scopeSlots[scope.parent] : -1;
+			scopeSlots[i] = FindTrackedScope(scope.name, parentSlot, scope.thread);
+			if (scopeSlots[i] >= 0)
+			{
+				trackedScopes[scopeSlots[i]].history[historyHead] = scope.milliseconds;
+			}
+		}
+
+		for (int thread = 0; thread < profile.threadCount && thread < MAX_THREADS; ++thread)
+		{
+			threadOffset[thread] = 0.0f;
+		}
+	}
+
+	/**
+	 * @brief Draws the profiler window.
+	 *
+	 * @param title The title of the ImGui window.
+	 */
+	void Draw(const char* title)
+	{
+		ImGui::Begin(title);
+
+		ImGui::Checkbox("Pause", &paused);
+		if (!profile.valid)
+		{
+			ImGui::TextUnformatted("No profile yet. Enable it with Physics.SetProfilingEnabled(true).");
+			ImGui::End();
+			return;
+		}
+
+		DrawCounters();
+
+		if (ImGui::CollapsingHeader("Scopes", ImGuiTreeNodeFlags_DefaultOpen))
+		{
+			DrawScopeTable();
+		}
+
+		if (ImGui::CollapsingHeader("Flame graph", ImGuiTreeNodeFlags_DefaultOpen))
+		{
+			DrawFlameGraphs();
+		}
+
+		ImGui::End();
+	}
+
+	/**
+	 * @brief Deleted copy constructor to prevent copying of the singleton instance.
+	 */
+	ImGuiPhysicsProfiler(const ImGuiPhysicsProfiler&) = delete;
+
+	/**
+	 * @brief Deleted assignment operator to prevent assigning of the singleton instance.
+	 *
+	 * @return Reference to the ImGuiPhysicsProfiler instance.
+	 */
+	ImGuiPhysicsProfiler& operator=(const ImGuiPhysicsProfiler&) = delete;
+
+private:
+	static constexpr int MAX_THREADS = (int)BT_QUICKPROF_MAX_THREAD_COUNT;
+
+	static constexpr float FLAME_ROW_HEIGHT = 18.0f;
+
+	/**
+	 * @brief History of one scope, identified by its name, its parent's slot and its thread.
+	 */
+	struct TrackedScope
+	{
+		const char* name = nullptr;
+		int parentSlot = -1;
+		int thread = 0;
+		float history[HISTORY_LENGTH] = {};
+	};
+
+	ImGuiPhysicsProfiler() {}
+
+	/**
+	 * @brief Finds or claims the history slot of a scope with open addressing.
+	 *
+	 * @return The slot, or -1 if the table is full.
+	 */
+	int FindTrackedScope(const char* name, int parentSlot, int thread)
+	{
+		uint64_t hash = (uint64_t)(uintptr_t)name * 0x9E3779B97F4A7C15ull;
+		hash ^= (uint64_t)(parentSlot + 1) * 0xBF58476D1CE4E5B9ull + (uint64_t)thread;
+		hash ^= hash >> 29;
+
+		for (int probe = 0; probe < MAX_TRACKED_SCOPES; ++probe)
+		{
+			const int slot = (int)((hash + probe) & (MAX_TRACKED_SCOPES - 1));
+			TrackedScope& tracked = trackedScopes[slot];
+			if (tracked.name == nullptr)
+			{
+				tracked.name = name;
+				tracked.parentSlot = parentSlot;
+				tracked.thread = thread;
+				return slot;
+			}
+			if (tracked.name == name && tracked.parentSlot == parentSlot && tracked.thread == thread)
+			{
+				return slot;
+			}
+		}
+		return -1;
+	}
+
+	static void ThreadLabel(int thread, char* label, size_t size)
+	{
+		if (thread == 0)
+		{
+			snprintf(label, size, "Simulation thread");
+		}
+		else
+		{
+			snprintf(label, size, "Worker %d", thread);
+		}
+	}
+
+	/**
+	 * @brief Average and maximum of a history ring over the recorded updates.
+	 */
+	void Summarize(const float* history, float& average, float& maximum) const
+	{
+		float sum = 0.0f;
+		maximum = 0.0f;
+		for (int i = 0; i < historyCount; ++i)
+		{
+			const float value = history[(historyHead + HISTORY_LENGTH - i) % HISTORY_LENGTH];
+			sum += value;
+			maximum = value > maximum ? value : maximum;
+		}
+		average = historyCount > 0 ? sum / historyCount : 0.0f;
+	}
+
+	/**
+	 * @brief Plots a history ring oldest to newest.
+	 */
+	void PlotHistory(const char* label, const float* history, const char* overlay, ImVec2 size) const
+	{
+		// Until the ring wraps the samples sit in [1, historyCount]; afterwards the oldest follows the head.
+		if (historyCount < HISTORY_LENGTH)
+		{
+			ImGui::PlotLines(label, history + 1, historyCount, 0, overlay, 0.0f, FLT_MAX, size);
+		}
+		else
+		{
+			ImGui::PlotLines(label, history, HISTORY_LENGTH, (historyHead + 1) % HISTORY_LENGTH, overlay, 0.0f, FLT_MAX, size);
+		}
+	}
+
+	void DrawCounters()
+	{
+		float average;
+		float maximum;
+		Summarize(updateHistory, average, maximum);
+
+		char overlay[64];
+		snprintf(overlay, sizeof(overlay), "update avg %.3f ms  max %.3f ms", average, maximum);
+		PlotHistory("##update", updateHistory, overlay, ImVec2(-1.0f, 60.0f));
+
+		ImGui::Text("Steps %d  Threads %d  Bodies %d", profile.steps, profile.threadCount, profile.bodies);
+		ImGui::Text("Aligned allocs %llu  frees %llu  heap %llu (this update)", (unsigned long long)profile.alignedAllocs, (unsigned long long)profile.alignedFrees, (unsigned long long)profile.heapAllocs);
+		ImGui::Text("Memory %.2f MiB (peak %.2f)  reserved %.2f MiB%s  frame arena %.1f KiB (peak %.1f)",
+			memory.bytesInUse / 1048576.0, memory.peakBytesInUse / 1048576.0, memory.bytesReserved / 1048576.0, memory.hugePages ? " in huge pages" : "",
+			memory.frameArenaBytes / 1024.0, memory.peakFrameArenaBytes / 1024.0);
+		ImGui::Text("Manifold pool %d (%.1f%% local)  algorithm pool %d (%.1f%% local)  fallbacks %llu",
+			profile.manifoldPoolCapacity, profile.manifoldPoolHitRate * 100.0f, profile.algorithmPoolCapacity, profile.algorithmPoolHitRate * 100.0f,
+			(unsigned long long)profile.poolFallbacks);
+		if (profile.convexQueries > 0)
+		{
+			ImGui::Text("Convex queries %llu (%.1f%% from the coherence cache)", (unsigned long long)profile.convexQueries, profile.convexCoherenceHitRate * 100.0f);
+		}
+		if (profile.triangleQueries > 0)
+		{
+			ImGui::Text("Mesh queries %llu (%.1f%% from the triangle cache)", (unsigned long long)profile.triangleQueries, profile.triangleCacheHitRate * 100.0f);
+		}
+		ImGui::Text("Overlapping pairs %d  Manifolds %d  Islands %d", profile.overlappingPairs, profile.manifolds, profile.islands);
+
+		const float width = (ImGui::GetContentRegionAvail().x - 3.0f * ImGui::GetStyle().ItemSpacing.x) / 4.0f;
+		PlotHistory("##allocs", allocHistory, "allocs", ImVec2(width, 40.0f));
+		ImGui::SameLine();
+		PlotHistory("##pairs", pairHistory, "pairs", ImVec2(width, 40.0f));
+		ImGui::SameLine();
+		PlotHistory("##manifolds", manifoldHistory, "manifolds", ImVec2(width, 40.0f));
+		ImGui::SameLine();
+		PlotHistory("##islands", islandHistory, "islands", ImVec2(width, 40.0f));
+	}
+
+	void DrawScopeTable()
+	{
+		const ImGuiTableFlags flags = ImGuiTableFlags_BordersV | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable | ImGuiTableFlags_SizingStretchProp;
+		if (!ImGui::BeginTable("Scopes", 5, flags))
+		{
+			return;
+		}
+
+		ImGui::TableSetupColumn("Scope", ImGuiTableColumnFlags_WidthStretch, 3.0f);
+		ImGui::TableSetupColumn("ms", ImGuiTableColumnFlags_WidthStretch, 0.7f);
+		ImGui::TableSetupColumn("avg / max", ImGuiTableColumnFlags_WidthStretch, 1.2f);
+		ImGui::TableSetupColumn("Calls", ImGuiTableColumnFlags_WidthStretch, 0.6f);
+		ImGui::TableSetupColumn("History", ImGuiTableColumnFlags_WidthStretch, 2.0f);
+		ImGui::TableHeadersRow();
+
+		for (int thread = 0; thread < profile.threadCount; ++thread)
+		{
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::PushID(thread);
+			char label[32];
+			ThreadLabel(thread, label, sizeof(label));
+			const bool open = ImGui::TreeNodeEx(label, ImGuiTreeNodeFlags_SpanFullWidth | (thread == 0 ? ImGuiTreeNodeFlags_DefaultOpen : 0));
+			if (open)
+			{
+				for (int i = 0; i < profile.scopeCount; ++i)
+				{
+					if (profile.scopes[i].thread == thread && profile.scopes[i].parent < 0)
+					{
+						DrawScopeRow(i);
+					}
+				}
+				ImGui::TreePop();
+			}
+			ImGui::PopID();
+		}
+
+		ImGui::EndTable();
+	}
+
+	void DrawScopeRow(int index)
+	{
+		const PhysicsProfileScope& scope = profile.scopes[index];
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::PushID(index);
+		const ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_SpanFullWidth | ImGuiTreeNodeFlags_DefaultOpen | (childCount[index] == 0 ? ImGuiTreeNodeFlags_Leaf : 0);
+		const bool open = ImGui::TreeNodeEx(scope.name, flags);
+
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", scope.milliseconds);
+
+		const int slot = scopeSlots[index];
+		ImGui::TableNextColumn();
+		if (slot >= 0)
+		{
+			float average;
+			float maximum;
+			Summarize(trackedScopes[slot].history, average, maximum);
+			ImGui::Text("%.3f / %.3f", average, maximum);
+		}
+
+		ImGui::TableNextColumn();
+		ImGui::Text("%d", scope.calls);
+
+		ImGui::TableNextColumn();
+		if (slot >= 0)
+		{
+			PlotHistory("##history", trackedScopes[slot].history, nullptr, ImVec2(-1.0f, ImGui::GetTextLineHeight()));
+		}
+
+		if (open)
+		{
+			for (int child = 0; child < childCount[index]; ++child)
+			{
+				DrawScopeRow(firstChild[index] + child);
+			}
+			ImGui::TreePop();
+		}
+		ImGui::PopID();
+	}
+
+	void DrawFlameGraphs()
+	{
+		// One time axis for all threads: the longest thread sets the scale.
+		float total = 0.0f;
+		for (int i = 0; i < profile.scopeCount; ++i)
+		{
+			const PhysicsProfileScope& scope = profile.scopes[i];
+			if (scope.parent < 0)
+			{
+				const float end = offsets[i] + scope.milliseconds;
+				total = end > total ? end : total;
+			}
+		}
+		if (total <= 0.0f)
+		{
+			return;
+		}
+
+		ImDrawList* drawList = ImGui::GetWindowDrawList();
+		const float width = ImGui::GetContentRegionAvail().x;
+		const float scale = width / total;
+
+		for (int thread = 0; thread < profile.threadCount; ++thread)
+		{
+			int maxDepth = -1;
+			for (int i = 0; i < profile.scopeCount; ++i)
+			{
+				if (profile.scopes[i].thread == thread && profile.scopes[i].depth > maxDepth)
+				{
+					maxDepth = profile.scopes[i].depth;
+				}
+			}
+			if (maxDepth < 0)
+			{
+				continue;
+			}
+
+			char label[32];
+			ThreadLabel(thread, label, sizeof(label));
+			ImGui::TextUnformatted(label);
+			const ImVec2 origin = ImGui::GetCursorScreenPos();
+			const float height = (maxDepth + 1) * FLAME_ROW_HEIGHT;
+			ImGui::PushID(thread);
+			ImGui::InvisibleButton("##flame", ImVec2(width, height));
+			const bool hovered = ImGui::IsItemHovered();
+			ImGui::PopID();
+			const ImVec2 mouse = ImGui::GetIO().MousePos;
+
+			for (int i = 0; i < profile.scopeCount; ++i)
+			{
+				const PhysicsProfileScope& scope = profile.scopes[i];
+				if (scope.thread != thread)
+				{
+					continue;
+				}
+
+				const ImVec2 min(origin.x + offsets[i] * scale, origin.y + scope.depth * FLAME_ROW_HEIGHT);
+				const ImVec2 max(min.x + scope.milliseconds * scale, min.y + FLAME_ROW_HEIGHT - 1.0f);
+				if (max.x - min.x < 1.0f)
+				{
+					continue;
+				}
+
+				const float hue = (float)(((uintptr_t)scope.name >> 4) % 64) / 64.0f;
+				drawList->AddRectFilled(min, max, ImColor::HSV(hue, 0.45f, 0.8f));
+				drawList->PushClipRect(min, max, true);
+				drawList->AddText(ImVec2(min.x + 3.0f, min.y + 1.0f), IM_COL32(20, 20, 20, 255), scope.name);
+				drawList->PopClipRect();
+
+				if (hovered && mouse.x >= min.x && mouse.x < max.x && mouse.y >= min.y && mouse.y < max.y)
+				{
+					ImGui::SetTooltip("%s\n%.3f ms, %d calls", scope.name, scope.milliseconds, scope.calls);
+				}
+			}
+		}
+	}
+
+	PhysicsProfile profile;
+
+	PhysicsMemoryStats memory;
+
+	/**
+	 * @brief Per scope of the current profile: history slot, children range and flame graph start in ms.
+	 */
+	int scopeSlots[PhysicsProfile::MAX_SCOPES] = {};
+
+	int firstChild[PhysicsProfile::MAX_SCOPES] = {};
+
+	int childCount[PhysicsProfile::MAX_SCOPES] = {};
+
+	float offsets[PhysicsProfile::MAX_SCOPES] = {};
+
+	float nextChildOffset[PhysicsProfile::MAX_SCOPES] = {};
+
+	float threadOffset[MAX_THREADS] = {};
+
+	TrackedScope trackedScopes[MAX_TRACKED_SCOPES];
+
+	float updateHistory[HISTORY_LENGTH] = {};
+
+	float allocHistory[HISTORY_LENGTH] = {};
+
+	float pairHistory[HISTORY_LENGTH] = {};
+
+	float manifoldHistory[HISTORY_LENGTH] = {};
+
+	float islandHistory[HISTORY_LENGTH] = {};
+
+	int historyHead = 0;
+
+	int historyCount = 0;
+
+	uint64_t lastStepCount = 0;
+
+	bool paused = false;
+};
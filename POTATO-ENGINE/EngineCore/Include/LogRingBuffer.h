@@ -0,0 +1,208 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * @brief Bounded multi-producer, single-consumer lock-free ring buffer.
+ *
+ * Every slot carries a sequence number: producers claim a position with a CAS on the
+ * enqueue cursor, fill the slot in place and publish it by bumping the slot sequence.
+ * The single consumer reads published slots in order and hands them back to producers
+ * by advancing the sequence by one lap. No locks are taken and no memory is allocated
+ * after construction.
+ *
+ * @tparam T Slot payload type. Must be default constructible.
+ */
+template <typename T>
+class LogRingBuffer
+{
+public:
+	/**
+	 * @brief Creates a ring buffer.
+	 * @param capacity Number of slots, rounded up to the next power of two.
+	 */
+	explicit LogRingBuffer(size_t capacity)
+	{
+		size_t size = 2;
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+
+		mask = size - 1;
+		cells.reset(new Cell[size]);
+		for (size_t i = 0; i < size; ++i)
+		{
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	LogRingBuffer(const LogRingBuffer&) = delete;
+	LogRingBuffer& operator=(const LogRingBuffer&) = delete;
+
+	/**
+	 * @brief Claims a free slot and fills it in place. Safe to call from any thread.
+	 * @param fill Callable invoked as fill(T&) on the claimed slot.
+	 * @return False if the buffer is full; fill is not invoked in that case.
+	 */
+	template <typename Fill>
+	bool TryPush(Fill&& fill)
+	{
+		size_t pos = enqueuePos.load(std::memory_order_relaxed);
+		Cell* cell;
+
+		for (;;)
+		{
+			cell = &cells[pos & mask];
+			const size_t seq = cell->sequence.load(std::memory_order_acquire);
+			const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+			if (diff == 0)
+			{
+				if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		fill(cell->value);
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * @brief Claims count consecutive slots at once and fills them in place. Safe to call from any thread.
+	 *
+	 * The consumer sees the slots back to back, without slots of other producers in between.
+	 *
+	 * @param count Number of slots to claim.
+	 * @param fill Callable invoked as fill(T&, size_t index) on each claimed slot, in order.
+	 * @return False if fewer than count slots are free; fill is not invoked in that case.
+	 */
+	template <typename Fill>
+	bool TryPushRange(size_t count, Fill&& fill)
+	{
+		if (count == 0 || count > mask + 1)
+		{
+			return count == 0;
+		}
+
+		size_t pos = enqueuePos.load(std::memory_order_relaxed);
+
+		for (;;)
+		{
+			const size_t seq = cells[pos & mask].sequence.load(std::memory_order_acquire);
+			const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+			if (diff == 0)
+			{
+				// The consumer releases slots in order, so the range is free once its last slot is.
+				const size_t last = pos + count - 1;
+				if (cells[last & mask].sequence.load(std::memory_order_acquire) != last)
+				{
+					return false;
+				}
+				if (enqueuePos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			Cell* cell = &cells[(pos + i) & mask];
+			fill(cell->value, i);
+			cell->sequence.store(pos + i + 1, std::memory_order_release);
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Visits up to maxCount published slots in FIFO order and releases them.
+	 *
+	 * Must only be called from the consumer thread.
+	 *
+	 * @param visit Callable invoked as visit(const T&) on each slot.
+	 * @param maxCount Upper bound on the number of slots consumed.
+	 * @return The number of slots consumed.
+	 */
+	template <typename Visit>
+	size_t Drain(Visit&& visit, size_t maxCount)
+	{
+		size_t count = 0;
+
+		while (count < maxCount)
+		{
+			Cell* cell = &cells[dequeuePos & mask];
+			if (cell->sequence.load(std::memory_order_acquire) != dequeuePos + 1)
+			{
+				break;
+			}
+
+			visit(static_cast<const T&>(cell->value));
+			cell->sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+			++dequeuePos;
+			++count;
+		}
+
+		return count;
+	}
+
+	/**
+	 * @brief Total number of slots ever claimed by producers.
+	 */
+	size_t Claimed() const
+	{
+		return enqueuePos.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * @brief Number of slots in the buffer.
+	 */
+	size_t Capacity() const
+	{
+		return mask + 1;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence{ 0 };
+		T value;
+	};
+
+	std::unique_ptr<Cell[]> cells;
+
+	size_t mask = 0;
+
+	/**
+	 * @brief Producer cursor, kept on its own cache line to avoid false sharing with the consumer.
+	 */
+	alignas(64) std::atomic<size_t> enqueuePos{ 0 };
+
+	/**
+	 * @brief Consumer cursor, only touched by the consumer thread.
+	 */
+	alignas(64) size_t dequeuePos = 0;
+};
@@ -0,0 +1,365 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Live counters of the PhysicsAllocator. Totals count from the installation.
+ */
+struct PhysicsMemoryStats
+{
+	/**
+	 * @brief Bytes handed out and not freed yet, counted in block sizes.
+	 */
+	uint64_t bytesInUse = 0;
+
+	/**
+	 * @brief Highest bytesInUse sampled at the end of a frame or by GetStats().
+	 */
+	uint64_t peakBytesInUse = 0;
+
+	/**
+	 * @brief Bytes mapped from the OS for the size-class pools and the frame arenas.
+	 */
+	uint64_t bytesReserved = 0;
+
+	uint64_t totalAllocations = 0;
+
+	uint64_t totalFrees = 0;
+
+	/**
+	 * @brief Requests that reached the OS or the C heap: new regions and blocks too large for a size class.
+	 */
+	uint64_t totalHeapAllocations = 0;
+
+	/**
+	 * @brief Frame arena bytes used by every thread during the last frame, and the most used in one frame.
+	 */
+	uint64_t frameArenaBytes = 0;
+
+	uint64_t peakFrameArenaBytes = 0;
+
+	/**
+	 * @brief True when the last region mapped got huge pages.
+	 */
+	bool hugePages = false;
+};
+
+/**
+ * @brief PhysicsAllocator class serving Bullet's aligned allocations from per-thread pools.
+ *
+ * Install() routes btAlignedAlloc through btAlignedAllocSetCustom. Blocks up to MAX_SMALL_SIZE are
+ * rounded to one of CLASS_COUNT size classes and come from the calling thread's free list, so the
+ * scratch arrays the Mt dispatcher and solver grow on worker threads never take a lock. A thread
+ * refills an empty list from a shared depot, or carves a fresh slab out of a 2 MiB region mapped
+ * from the OS, and hands surplus blocks back to the depot in batches. A block freed on another
+ * thread simply joins that thread's list. Larger blocks go to the C heap.
+ *
+ * Memory is never given back: once the pools cover the working set, stepping no longer reaches the
+ * heap. Regions can be backed by huge pages to cut TLB misses over the solver pools.
+ *
+ * Each thread also owns a frame arena, a bump allocator for scratch memory that only lives until
+ * the end of the current simulation step, when PhysicsManager resets every arena. It is a separate
+ * entry point because nothing tells btAlignedAlloc which requests are transient. While its world
+ * exists, PhysicsManager hands it to Bullet through btFrameAllocSetCustom, which serves the Mt
+ * solver's batching scratch and the batched narrowphase's pair array from it.
+ */
+class PhysicsAllocator
+{
+public:
+	/**
+	 * @brief Retrieves the singleton instance of PhysicsAllocator.
+	 * @return Reference to the PhysicsAllocator instance.
+	 */
+	static PhysicsAllocator& GetInstance();
+
+	PhysicsAllocator& operator= (const PhysicsAllocator&) = delete;
+
+	PhysicsAllocator(const PhysicsAllocator&) = delete;
+
+	/**
+	 * @brief Makes btAlignedAlloc and btAlignedFree use the allocator, for the rest of the process.
+	 *
+	 * Must run before Bullet allocates anything, since blocks from the default allocator cannot be
+	 * freed here. PhysicsManager installs it when it is constructed.
+	 */
+	void Install();
+
+	/**
+	 * @brief Backs the regions mapped from now on with huge pages, or stops doing so.
+	 * @param enabled Whether to request huge pages.
+	 * @return False if huge pages were requested but the OS refused them. Regions then use normal pages.
+	 */
+	bool SetHugePages(bool enabled);
+
+	/**
+	 * @brief Allocates scratch memory that stays valid until the next ResetFrame().
+	 * @param size Size in bytes.
+	 * @param alignment Power of two alignment.
+	 * @return The memory, or null if the OS is out of memory.
+	 */
+	void* FrameAllocate(size_t size, size_t alignment = 16);
+
+	/**
+	 * @brief Rewinds the frame arena of every thread and samples the statistics.
+	 *
+	 * No other thread may use its frame arena during the call, which holds between two
+	 * simulation steps since the task scheduler workers are idle then.
+	 */
+	void ResetFrame();
+
+	PhysicsMemoryStats GetStats();
+
+	/**
+	 * @brief btAllocFunc and btFreeFunc entry points.
+	 */
+	static void* Allocate(size_t size);
+
+	static void Free(void* memory);
+
+	/**
+	 * @brief btFrameAllocFunc entry point, FrameAllocate for the calling thread.
+	 */
+	static void* AllocateFrame(size_t size, int alignment);
+
+private:
+	/**
+	 * @brief Largest block served from a size class.
+	 */
+	static constexpr size_t MAX_SMALL_SIZE = 8192;
+
+	/**
+	 * @brief Eight 16-byte steps up to 128 bytes, then four classes per power of two up to MAX_SMALL_SIZE.
+	 */
+	static constexpr int CLASS_COUNT = 32;
+
+	static constexpr size_t REGION_SIZE = size_t(2) << 20;
+
+	static constexpr size_t SLAB_SIZE = size_t(64) << 10;
+
+	static constexpr int SLABS_PER_REGION = (int)(REGION_SIZE / SLAB_SIZE);
+
+	/**
+	 * @brief Bytes at the start of each region holding its RegionHeader.
+	 */
+	static constexpr size_t REGION_HEADER_SIZE = 64;
+
+	/**
+	 * @brief Free blocks moved between a thread and the depot at once.
+	 */
+	static constexpr int BATCH_SIZE = 32;
+
+	/**
+	 * @brief Capacity of the region lookup table, a power of two. Bounds the pools to 8 GiB.
+	 */
+	static constexpr int REGION_TABLE_SIZE = 4096;
+
+	/**
+	 * @brief A free block, linked through its first bytes. The head of a depot batch also links the next batch.
+	 */
+	struct FreeBlock
+	{
+		FreeBlock* next;
+
+		FreeBlock* nextBatch;
+	};
+
+	/**
+	 * @brief Size class of every slab of a region, written before the slab is carved.
+	 */
+	struct RegionHeader
+	{
+		uint8_t slabClass[SLABS_PER_REGION];
+	};
+
+	struct ArenaChunk
+	{
+		ArenaChunk* next;
+
+		size_t size;
+	};
+
+	/**
+	 * @brief Pools and frame arena of one thread.
+	 *
+	 * Only the owner touches the lists and the arena. The counters are atomics so GetStats() can sum
+	 * them from another thread.
+	 */
+	struct ThreadCache
+	{
+		FreeBlock* freeLists[CLASS_COUNT] = {};
+
+		int freeCounts[CLASS_COUNT] = {};
+
+		/**
+		 * @brief Uncarved part of the slab the thread is cutting blocks from, per class.
+		 */
+		char* slabCursor[CLASS_COUNT] = {};
+
+		char* slabEnd[CLASS_COUNT] = {};
+
+		ArenaChunk* arenaChunks = nullptr;
+
+		char* arenaCursor = nullptr;
+
+		char* arenaEnd = nullptr;
+
+		/**
+		 * @brief Arena bytes used in the full chunks of the current frame.
+		 */
+		size_t arenaUsedInFullChunks = 0;
+
+		std::atomic<uint64_t> allocations{ 0 };
+
+		std::atomic<uint64_t> frees{ 0 };
+
+		std::atomic<uint64_t> bytesAllocated{ 0 };
+
+		std::atomic<uint64_t> bytesFreed{ 0 };
+	};
+
+	/**
+	 * @brief Free blocks of one class given back by threads, as a list of batches.
+	 */
+	struct Depot
+	{
+		std::mutex mutex;
+
+		FreeBlock* batches = nullptr;
+	};
+
+	/**
+	 * @brief Releases the calling thread's cache when the thread exits.
+	 */
+	struct ThreadCacheOwner
+	{
+		~ThreadCacheOwner();
+	};
+
+	PhysicsAllocator();
+
+	~PhysicsAllocator() = default;
+
+	static int GetSizeClass(size_t size);
+
+	static size_t GetClassSize(int sizeClass);
+
+	/**
+	 * @brief Returns the calling thread's cache, creating it on first use.
+	 * @return Null once the thread is exiting.
+	 */
+	ThreadCache* GetThreadCache();
+
+	void* AllocateSmall(ThreadCache* cache, int sizeClass);
+
+	void FreeSmall(ThreadCache* cache, void* memory, int sizeClass);
+
+	void* AllocateLarge(size_t size);
+
+	/**
+	 * @brief Finds the region holding a block.
+	 * @return Null if the block does not come from the pools.
+	 */
+	RegionHeader* FindRegion(const void* memory) const;
+
+	/**
+	 * @brief Maps a region and makes it the one slabs are cut from. Needs regionMutex.
+	 * @return False if the OS is out of memory or the region table is full.
+	 */
+	bool MapNextRegion();
+
+	/**
+	 * @brief Gives a thread a new slab of a size class to carve.
+	 * @return False if no region could be mapped.
+	 */
+	bool RefillSlab(ThreadCache* cache, int sizeClass);
+
+	/**
+	 * @brief Moves the first count blocks of a thread list into the depot as one batch.
+	 */
+	void PushBatch(ThreadCache* cache, int sizeClass, int count);
+
+	/**
+	 * @brief Maps a REGION_SIZE-aligned block of whole regions from the OS.
+	 */
+	void* MapRegions(size_t size);
+
+	void UnmapRegions(void* memory, size_t size);
+
+	void* ArenaAllocateSlow(ThreadCache* cache, size_t size, size_t alignment);
+
+	void ReleaseArena(ThreadCache* cache);
+
+	/**
+	 * @brief Sums the bytes in use over every cache. Needs cacheMutex.
+	 */
+	uint64_t SumBytesInUse() const;
+
+	/**
+	 * @brief Flushes a cache into the depot and folds its counters into the retired totals.
+	 */
+	void RetireThreadCache(ThreadCache* cache);
+
+	bool installed = false;
+
+	std::atomic<bool> hugePagesRequested{ false };
+
+	std::atomic<bool> hugePagesActive{ false };
+
+	/**
+	 * @brief Region bases, open addressing on the base address. Entries are only ever added.
+	 */
+	std::atomic<uintptr_t> regionTable[REGION_TABLE_SIZE] = {};
+
+	/**
+	 * @brief Guards the region being cut into slabs and the region table inserts.
+	 */
+	std::mutex regionMutex;
+
+	char* currentRegion = nullptr;
+
+	int nextSlab = SLABS_PER_REGION;
+
+	int regionCount = 0;
+
+	Depot depots[CLASS_COUNT];
+
+	/**
+	 * @brief Guards the cache list and the retired counters.
+	 */
+	std::mutex cacheMutex;
+
+	std::vector<ThreadCache*> caches;
+
+	uint64_t retiredAllocations = 0;
+
+	uint64_t retiredFrees = 0;
+
+	uint64_t retiredBytesAllocated = 0;
+
+	uint64_t retiredBytesFreed = 0;
+
+	std::atomic<uint64_t> bytesReserved{ 0 };
+
+	std::atomic<uint64_t> heapAllocations{ 0 };
+
+	/**
+	 * @brief Large blocks are not in any cache, so their bytes are counted here.
+	 */
+	std::atomic<uint64_t> largeBytesInUse{ 0 };
+
+	std::atomic<uint64_t> largeAllocations{ 0 };
+
+	std::atomic<uint64_t> largeFrees{ 0 };
+
+	uint64_t peakBytesInUse = 0;
+
+	uint64_t frameArenaBytes = 0;
+
+	uint64_t peakFrameArenaBytes = 0;
+};
+
+static PhysicsAllocator& PhysicsMemory = PhysicsAllocator::GetInstance();
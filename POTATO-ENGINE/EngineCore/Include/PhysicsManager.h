@@ -1,5 +1,609 @@
 #pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/BroadphaseCollision/btConcurrentOverlappingPairCache.h"
+#include "BulletCollision/BroadphaseCollision/btDbvtBroadphaseMt.h"
+#include "BulletCollision/BroadphaseCollision/btGridBroadphaseMt.h"
+#include "BulletCollision/BroadphaseCollision/btSapBroadphaseMt.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletCollision/CollisionDispatch/btConvexConcaveCollisionAlgorithm.h"
+#include "BulletCollision/CollisionDispatch/btConvexConvexAlgorithm.h"
+#include "BulletCollision/CollisionDispatch/btPairEventBuffer.h"
+#include "BulletDynamics/ConstraintSolver/btJacobiConstraintSolverMt.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "BulletDynamics/Dynamics/btSimulationIslandManagerMt.h"
+#include "LinearMath/btQuickprof.h"
+#include "LinearMath/btThreads.h"
+#include "PhysicsAllocator.h"
+
+/**
+ * @brief Handle of a rigid body owned by the PhysicsManager. Also its index in a PhysicsSnapshot.
+ */
+typedef int PhysicsBodyHandle;
+
+/**
+ * @brief Invalid body handle.
+ */
+const PhysicsBodyHandle INVALID_BODY_HANDLE = -1;
+
+/**
+ * @brief Bullet task scheduler driving the parallel parts of a step.
+ */
+enum class TASK_SCHEDULER { DEFAULT, WORK_STEALING, SEQUENTIAL, OPENMP, TBB, PPL };
+
+/**
+ * @brief Broadphase finding the overlapping pairs: the dynamic AABB tree (btDbvtBroadphaseMt), the
+ * multithreaded sweep and prune that sorts every proxy again at each step (btSapBroadphaseMt), or the
+ * multithreaded hashed grid for swarms of small bodies such as particles and debris (btGridBroadphaseMt).
+ */
+enum class BROADPHASE { DBVT, SAP, GRID };
+
+/**
+ * @brief Simulation parameters used when the world is created.
+ */
+struct PhysicsSettings
+{
+	/**
+	 * @brief Duration of one simulation step in seconds.
+	 */
+	btScalar fixedTimeStep = btScalar(1.0 / 60.0);
+
+	/**
+	 * @brief Maximum number of steps per update. Time beyond that is dropped so a slow frame cannot snowball.
+	 */
+	int maxSubSteps = 4;
+
+	/**
+	 * @brief Number of task scheduler threads, 0 to use every hardware thread.
+	 */
+	int numThreads = 0;
+
+	/**
+	 * @brief Task scheduler to install. Falls back to the sequential one if Bullet was built without it.
+	 */
+	TASK_SCHEDULER taskScheduler = TASK_SCHEDULER::DEFAULT;
+
+	/**
+	 * @brief Backs the PhysicsAllocator pools with huge pages when the OS allows it.
+	 */
+	bool hugePages = false;
+
+	/**
+	 * @brief Broadphase used by the world.
+	 */
+	BROADPHASE broadphase = BROADPHASE::DBVT;
+
+	/**
+	 * @brief Finds the overlapping pairs with tree-vs-tree tasks on the task scheduler instead of
+	 * colliding each moved body on the stepping thread. Only used by BROADPHASE::DBVT.
+	 */
+	bool parallelBroadphase = true;
+
+	/**
+	 * @brief Lets the broadphase tasks add their pairs to the pair cache in parallel, through a lock-free
+	 * btConcurrentOverlappingPairCache that sorts the new pairs so the step stays deterministic. Only used
+	 * by BROADPHASE::SAP and BROADPHASE::GRID.
+	 */
+	bool concurrentPairCache = false;
+
+	/**
+	 * @brief Records when body pairs start and stop overlapping and touching, read with
+	 * PhysicsManager::DrainPairEvents, so gameplay reacts to the changes without going through every contact.
+	 */
+	bool pairEvents = false;
+
+	/**
+	 * @brief Runs the narrowphase grouped by shape types, with batched kernels for sphere, box, capsule and
+	 * plane pairs, instead of one collision algorithm call per pair in pair order.
+	 */
+	bool batchedNarrowphase = false;
+
+	/**
+	 * @brief Skips the convex pair queries of bodies that cannot have come within contact distance since
+	 * the last query. The contacts are the same as without it unless convexCoherenceContactMotion is set.
+	 */
+	bool convexCoherence = false;
+
+	/**
+	 * @brief With convexCoherence, only refreshes the contacts of touching pairs that moved less than this
+	 * distance instead of querying them again. 0 keeps the contacts exact; 0.001 (a millimetre) saves most
+	 * queries of resting stacks at the cost of slightly stale contact normals.
+	 */
+	btScalar convexCoherenceContactMotion = 0;
+
+	/**
+	 * @brief Contact points kept per body pair against a triangle mesh or heightfield, 0 for the usual 4.
+	 * Boxes resting on a mesh keep their contacts more stable with 8; capped by the MANIFOLD_CACHE_SIZE
+	 * Bullet was built with.
+	 */
+	int meshContactCapacity = 0;
+
+	/**
+	 * @brief Keeps the mesh and heightfield triangles around each body against them and reuses them while
+	 * the body stays within 20 cm of where they were gathered, instead of walking the mesh every step.
+	 * The contacts are the same. After editing a mesh in place, clean the pairs of its body from the
+	 * overlapping pair cache so they gather the new triangles.
+	 */
+	bool triangleQueryCache = false;
+
+	/**
+	 * @brief Keeps the solver batches of the constraints that persist from one step to the next, for each
+	 * large island, and only batches new or conflicting constraints again. Saves most of the batching time
+	 * of resting piles and stacks; the batches, and so the results, differ from a fresh batching.
+	 */
+	bool incrementalBatching = false;
+
+	/**
+	 * @brief Solves the contacts of large islands with the block Jacobi solver, one parallel pass per
+	 * iteration, instead of batches of the sequential impulse solver. Suits crowds of loosely coupled
+	 * bodies; stacks need more solver iterations.
+	 */
+	bool jacobiSolver = false;
+
+	btVector3 gravity = btVector3(0, btScalar(-9.81), 0);
+};
+
+/**
+ * @brief Transforms of one body at the last two simulation steps.
+ */
+struct PhysicsBodyState
+{
+	btTransform previous;
+	btTransform current;
+	bool valid = false;
+};
+
+/**
+ * @brief Change in the state of two bodies, recorded when PhysicsSettings::pairEvents is set.
+ */
+struct PhysicsPairEvent
+{
+	/**
+	 * @brief One of btPairEvent::Type: the bounding boxes start or stop overlapping, or the bodies start or stop touching.
+	 */
+	int type = 0;
+
+	/**
+	 * @brief The two bodies. Events of a destroyed body keep its handle, which may since have been reused.
+	 */
+	PhysicsBodyHandle body0 = INVALID_BODY_HANDLE;
+
+	PhysicsBodyHandle body1 = INVALID_BODY_HANDLE;
+};
+
+/**
+ * @brief Time spent in one BT_PROFILE scope during an update, flattened from the btQuickprof tree.
+ */
+struct PhysicsProfileScope
+{
+	/**
+	 * @brief Scope name, a static string owned by Bullet.
+	 */
+	const char* name = nullptr;
+
+	/**
+	 * @brief Index of the enclosing scope in PhysicsProfile::scopes, -1 for a top-level scope.
+	 */
+	int parent = -1;
+
+	int depth = 0;
+
+	/**
+	 * @brief Bullet thread index that ran the scope.
+	 */
+	int thread = 0;
+
+	float milliseconds = 0.0f;
+
+	int calls = 0;
+};
+
+/**
+ * @brief Profile of one update: the scope hierarchy of every scheduler thread and the world counters.
+ *
+ * Fixed-size so publishing and reading it never allocate. A scope always comes after its parent,
+ * and the children of a scope are contiguous.
+ */
+struct PhysicsProfile
+{
+	static constexpr int MAX_SCOPES = 512;
+
+	PhysicsProfileScope scopes[MAX_SCOPES];
+
+	int scopeCount = 0;
+
+	int threadCount = 0;
+
+	/**
+	 * @brief Number of fixed steps the scopes cover.
+	 */
+	int steps = 0;
+
+	/**
+	 * @brief Bullet aligned allocations and frees made during the update.
+	 */
+	uint64_t alignedAllocs = 0;
+
+	uint64_t alignedFrees = 0;
+
+	/**
+	 * @brief Allocations of the update that the PhysicsAllocator pools could not serve.
+	 */
+	uint64_t heapAllocs = 0;
+
+	/**
+	 * @brief Share of the dispatcher's manifold and collision algorithm allocations served from the
+	 * calling thread's free list without touching the shared pool, since the world was created.
+	 */
+	float manifoldPoolHitRate = 1.0f;
+
+	float algorithmPoolHitRate = 1.0f;
+
+	/**
+	 * @brief Elements the dispatcher pools have grown to.
+	 */
+	int manifoldPoolCapacity = 0;
+
+	int algorithmPoolCapacity = 0;
+
+	/**
+	 * @brief Dispatcher pool requests too large for an element, sent to btAlignedAlloc instead.
+	 */
+	uint64_t poolFallbacks = 0;
+
+	/**
+	 * @brief Convex pair queries of the update and the share of them answered by the coherence cache,
+	 * see PhysicsSettings::convexCoherence.
+	 */
+	uint64_t convexQueries = 0;
+
+	float convexCoherenceHitRate = 0.0f;
+
+	/**
+	 * @brief Mesh queries of the update and the share of them answered by the triangle query cache,
+	 * see PhysicsSettings::triangleQueryCache.
+	 */
+	uint64_t triangleQueries = 0;
+
+	float triangleCacheHitRate = 0.0f;
+
+	int overlappingPairs = 0;
+
+	int manifolds = 0;
+
+	int islands = 0;
+
+	int bodies = 0;
+
+	/**
+	 * @brief False when profiling is off; the rest of the profile is then meaningless.
+	 */
+	bool valid = false;
+};
+
+/**
+ * @brief Immutable view of the simulation published after each update.
+ */
+struct PhysicsSnapshot
+{
+	/**
+	 * @brief Body states indexed by PhysicsBodyHandle.
+	 */
+	std::vector<PhysicsBodyState> bodies;
+
+	/**
+	 * @brief Total number of simulation steps taken when the snapshot was published.
+	 */
+	uint64_t stepCount = 0;
+
+	/**
+	 * @brief Wall-clock time of the publication, used to compute the interpolation factor.
+	 */
+	std::chrono::steady_clock::time_point publishTime;
+
+	/**
+	 * @brief Time spent in the last update, in milliseconds.
+	 */
+	double updateMilliseconds = 0.0;
+
+	/**
+	 * @brief Scope timings and counters of the update, filled while profiling is enabled.
+	 */
+	PhysicsProfile profile;
+
+	/**
+	 * @brief PhysicsAllocator counters when the snapshot was published.
+	 */
+	PhysicsMemoryStats memory;
+
+	/**
+	 * @brief Blends a body between its previous and current transforms.
+	 * @param handle The body handle.
+	 * @param alpha Blend factor in [0, 1], see PhysicsManager::GetInterpolationAlpha.
+	 * @param transform Receives the interpolated transform.
+	 * @return False if the handle does not refer to a body in this snapshot.
+	 */
+	bool GetInterpolatedTransform(PhysicsBodyHandle handle, btScalar alpha, btTransform& transform) const;
+};
+
+/**
+ * @brief PhysicsManager class running a multithreaded Bullet world at a fixed timestep.
+ *
+ * The world (btDiscreteDynamicsWorldMt with btCollisionDispatcherMt and btConstraintSolverPoolMt
+ * on the task scheduler picked in PhysicsSettings) is created, stepped and destroyed on a single simulation thread:
+ * either the dedicated thread started by Start(), or the caller of Update(). Bullet numbers the
+ * first thread that touches its scheduler as the main thread, so that must be the stepping thread.
+ *
+ * Other threads never touch the world. Body creation and destruction are queued and applied at the
+ * start of the next update, and the body transforms are published through a triple-buffered
+ * snapshot: the simulation thread and the single reader swap buffers with one atomic exchange and
+ * never wait on each other.
+ *
+ * Bullet allocates through the PhysicsAllocator, installed as soon as the manager exists, and the
+ * allocator's frame arenas are reset after every step.
+ */
 class PhysicsManager
 {
+public:
+	static PhysicsManager& GetInstance();
+
+	PhysicsManager& operator= (const PhysicsManager&) = delete;
+
+	PhysicsManager(const PhysicsManager&) = delete;
+
+	/**
+	 * @brief Sets the simulation parameters. Must be called before the world is created.
+	 * @param settings The simulation parameters.
+	 * @return False if the world already exists.
+	 */
+	bool Init(const PhysicsSettings& settings = PhysicsSettings());
+
+	/**
+	 * @brief Starts the dedicated simulation thread, which steps the world in real time.
+	 */
+	void Start();
+
+	/**
+	 * @brief Stops the simulation thread and destroys the world and every body.
+	 */
+	void Stop();
+
+	/**
+	 * @brief Advances the simulation on the calling thread, for callers that own the loop.
+	 *
+	 * Must not be mixed with Start(), and must always be called from the same thread.
+	 *
+	 * @param elapsedSeconds Wall-clock time since the previous update.
+	 * @return The number of fixed steps taken.
+	 */
+	int Update(double elapsedSeconds);
+
+	/**
+	 * @brief Stops the simulation and releases every Bullet object.
+	 */
+	void Shutdown();
+
+	bool IsRunning() const { return running.load(std::memory_order_acquire); }
+
+	/**
+	 * @brief Queues the creation of a rigid body. Safe to call from any thread.
+	 * @param shape The collision shape. Owned by the caller and must outlive the body.
+	 * @param mass The mass, 0 for a static body.
+	 * @param transform The initial world transform.
+	 * @return The handle of the body, valid in snapshots published after the next update.
+	 *
+	 * The engine stores the handle in the body's user index, so that field is not available to the game.
+	 */
+	PhysicsBodyHandle CreateRigidBody(btCollisionShape* shape, btScalar mass, const btTransform& transform);
+
+	/**
+	 * @brief Queues the destruction of a rigid body. Safe to call from any thread.
+	 * @param handle The body handle.
+	 */
+	void DestroyRigidBody(PhysicsBodyHandle handle);
+
+	/**
+	 * @brief Returns the latest published snapshot.
+	 *
+	 * Only one thread may read snapshots. The returned reference stays valid until the next call.
+	 */
+	const PhysicsSnapshot& AcquireSnapshot();
+
+	/**
+	 * @brief Takes the pair events recorded since the previous call, in the order they happened.
+	 *
+	 * Events queue up until they are drained, so none are lost when the reader skips snapshots.
+	 * With PhysicsSettings::pairEvents set, call this regularly or the queue keeps growing.
+	 * Safe to call from any thread.
+	 *
+	 * @param events Receives the events, replacing its contents. Its storage is recycled for the next events.
+	 */
+	void DrainPairEvents(std::vector<PhysicsPairEvent>& events);
+
+	/**
+	 * @brief Computes how far the simulation has progressed past a snapshot, in fixed steps.
+	 * @param snapshot A snapshot returned by AcquireSnapshot.
+	 * @return A blend factor in [0, 1] for PhysicsSnapshot::GetInterpolatedTransform.
+	 */
+	btScalar GetInterpolationAlpha(const PhysicsSnapshot& snapshot) const;
+
+	/**
+	 * @brief Turns the btQuickprof scope tree on or off. Takes effect at the start of the next update.
+	 *
+	 * While enabled, BT_PROFILE scopes also feed CProfileManager, and every published snapshot carries
+	 * a PhysicsProfile of its update. Safe to call from any thread.
+	 */
+	void SetProfilingEnabled(bool enabled) { profilingRequested.store(enabled, std::memory_order_relaxed); }
+
+	/**
+	 * @brief The world, or null if it does not exist. Only usable from the simulation thread.
+	 *
+	 * The user index of the bodies belongs to the engine, see CreateRigidBody.
+	 */
+	btDiscreteDynamicsWorld* GetWorld() const { return world; }
+
+	~PhysicsManager();
+
+private:
+	PhysicsManager();
+
+	/**
+	 * @brief Simulation thread entry point.
+	 */
+	void SimulationLoop();
+
+	/**
+	 * @brief Installs the task scheduler and creates the world on the calling thread.
+	 * @return False without creating anything when the calling thread is not Bullet thread 0.
+	 */
+	bool CreateWorld();
+
+	/**
+	 * @brief Deletes every body, the world and the task scheduler.
+	 */
+	void DestroyWorld();
+
+	/**
+	 * @brief Applies the queued body creations and destructions.
+	 */
+	void ApplyPendingCommands();
+
+	/**
+	 * @brief Fills the back snapshot and swaps it with the middle one.
+	 */
+	void PublishSnapshot(double updateMilliseconds, int steps);
+
+	/**
+	 * @brief Installs or removes the btQuickprof hooks.
+	 * @param requested The last value passed to SetProfilingEnabled, or false when the world goes away.
+	 */
+	void UpdateProfilingState(bool requested);
+
+	/**
+	 * @brief Copies the btQuickprof trees and the world counters into a profile and clears the trees.
+	 * @param memory Allocator counters at the end of the update, turned into per-update deltas.
+	 */
+	void CollectProfile(PhysicsProfile& profile, const PhysicsMemoryStats& memory, int steps);
+
+	/**
+	 * @brief Appends the called children of the iterator's current parent, then recurses into them.
+	 */
+	static void FlattenProfileScopes(CProfileIterator* iterator, PhysicsProfile& profile, int parent, int depth, int thread);
+
+	static void QuickprofEnterZone(const char* name);
+
+	static void QuickprofLeaveZone();
+
+	PhysicsSettings settings;
+
+	/**
+	 * @brief Scheduler created for this world, null when a shared one (sequential, OpenMP, TBB, PPL) is used.
+	 */
+	btITaskScheduler* taskScheduler = nullptr;
+
+	btDefaultCollisionConfiguration* collisionConfiguration = nullptr;
+
+	btCollisionDispatcherMt* dispatcher = nullptr;
+
+	btOverlappingPairCache* pairCache = nullptr;
+
+	btBroadphaseInterface* broadphase = nullptr;
+
+	btConstraintSolverPoolMt* solverPool = nullptr;
+
+	btSequentialImpulseConstraintSolverMt* solverMt = nullptr;
+
+	btDiscreteDynamicsWorldMt* world = nullptr;
+
+	/**
+	 * @brief Collects the pair events between snapshots, null unless PhysicsSettings::pairEvents is set.
+	 */
+	btPairEventBuffer* pairEventBuffer = nullptr;
+
+	/**
+	 * @brief Guards pendingPairEvents, shared by the simulation thread and the reader.
+	 */
+	std::mutex pairEventMutex;
+
+	/**
+	 * @brief Pair events published but not yet drained.
+	 */
+	std::vector<PhysicsPairEvent> pendingPairEvents;
+
+	/**
+	 * @brief Bodies indexed by handle. Owned by the simulation thread.
+	 */
+	std::vector<btRigidBody*> bodies;
+
+	/**
+	 * @brief Transforms before the last step of the current update, used as the snapshot previous state.
+	 */
+	std::vector<btTransform> previousTransforms;
+
+	double accumulator = 0.0;
+
+	uint64_t stepCount = 0;
+
+	/**
+	 * @brief Guards the command queues and the handle allocator.
+	 */
+	std::mutex commandMutex;
+
+	std::vector<std::pair<PhysicsBodyHandle, btRigidBody*>> pendingCreates;
+
+	std::vector<PhysicsBodyHandle> pendingDestroys;
+
+	std::vector<PhysicsBodyHandle> freeHandles;
+
+	PhysicsBodyHandle nextHandle = 0;
+
+	/**
+	 * @brief Triple buffer: back is written by the simulation thread, front is read by the reader,
+	 * and middle holds the latest published snapshot. SNAPSHOT_DIRTY marks an unread middle.
+	 */
+	static constexpr int SNAPSHOT_DIRTY = 4;
+
+	PhysicsSnapshot snapshots[3];
+
+	int backSnapshot = 0;
+
+	int frontSnapshot = 1;
+
+	std::atomic<int> middleSnapshot{ 2 };
+
+	std::atomic<bool> running{ false };
+
+	std::thread simulationThread;
+
+	std::atomic<bool> profilingRequested{ false };
+
+	/**
+	 * @brief Whether the btQuickprof hooks are installed. Owned by the simulation thread.
+	 */
+	bool profilingActive = false;
+
+	/**
+	 * @brief One iterator per Bullet thread, created when profiling starts so collecting never allocates.
+	 */
+	CProfileIterator* profileIterators[BT_QUICKPROF_MAX_THREAD_COUNT] = {};
+
+	uint64_t lastAlignedAllocs = 0;
+
+	uint64_t lastAlignedFrees = 0;
+
+	uint64_t lastHeapAllocs = 0;
+
+	static btEnterProfileZoneFunc* previousEnterZone;
+
+	static btLeaveProfileZoneFunc* previousLeaveZone;
 };
 
+static PhysicsManager& Physics = PhysicsManager::GetInstance();
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "ConsoleManager.h"
+#include "LinearMath/btQuickprof.h"
+
+/**
+ * @brief One begin or end mark in a thread's event buffer.
+ *
+ * The fields are atomics because a capture reads buffers while their threads keep writing;
+ * every access is relaxed and ordered by the buffer's write index.
+ */
+struct ProfileEvent
+{
+	std::atomic<uint64_t> ticks{ 0 };
+
+	/**
+	 * @brief Zone name for a begin mark, null for an end mark.
+	 */
+	std::atomic<const char*> name{ nullptr };
+
+	std::atomic<uint8_t> api{ 0 };
+};
+
+/**
+ * @brief ProfilerManager class recording timestamped zones per thread for timeline captures.
+ *
+ * Every thread that opens a zone gets its own ring of events, written only by that thread, so
+ * recording is a timestamp read and three relaxed stores. Timestamps come from the CPU time stamp
+ * counter where available and are converted to microseconds at capture time against a
+ * steady_clock reference, which assumes an invariant TSC.
+ *
+ * Enable() also routes Bullet's BT_PROFILE zones into the recorder through the btQuickprof
+ * enter/leave hooks, so the simulation, the task scheduler workers and the engine zones all end up
+ * on one timeline. A capture writes the last frames as Chrome trace JSON (chrome://tracing,
+ * ui.perfetto.dev) with one process per Console API category and one track per thread.
+ */
+class ProfilerManager
+{
+public:
+	/**
+	 * @brief Retrieves the singleton instance of ProfilerManager.
+	 * @return Reference to the ProfilerManager instance.
+	 */
+	static ProfilerManager& GetInstance();
+
+	ProfilerManager& operator= (const ProfilerManager&) = delete;
+
+	ProfilerManager(const ProfilerManager&) = delete;
+
+	/**
+	 * @brief Starts recording and installs the Bullet profile zone hooks.
+	 */
+	void Enable();
+
+	/**
+	 * @brief Stops recording and restores the previous Bullet profile zone hooks.
+	 *
+	 * The hooks chain to the ones installed before them, so other hook users must be turned off in
+	 * the reverse order they were turned on.
+	 */
+	void Disable();
+
+	bool IsEnabled() const
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Opens a zone on the calling thread.
+	 * @param name Zone name. Must be a string literal or otherwise outlive the profiler.
+	 * @param api Category whose track receives the zone.
+	 */
+	void BeginZone(const char* name, API api);
+
+	/**
+	 * @brief Closes the innermost zone of the calling thread.
+	 */
+	void EndZone();
+
+	/**
+	 * @brief Marks the start of a frame. Captures are cut on these marks.
+	 */
+	void MarkFrame();
+
+	/**
+	 * @brief Names the calling thread's track in captures.
+	 * @param name The thread name, truncated to THREAD_NAME_SIZE - 1 characters.
+	 */
+	void SetThreadName(const char* name);
+
+	/**
+	 * @brief Writes the zones of the last frames as Chrome trace JSON.
+	 * @param path Output file.
+	 * @param frameCount Number of frames to export, counted back from the last MarkFrame().
+	 * @return False if the file could not be written.
+	 */
+	bool CaptureChromeTrace(const std::string& path, int frameCount);
+
+private:
+	/**
+	 * @brief Maximum number of threads with an event buffer. Later threads are not recorded.
+	 */
+	static constexpr int MAX_THREADS = 64;
+
+	/**
+	 * @brief Events kept per thread, a power of two. The oldest are overwritten.
+	 */
+	static constexpr uint64_t EVENTS_PER_THREAD = 1 << 16;
+
+	/**
+	 * @brief Number of frame marks kept, which bounds the frames a capture can export.
+	 */
+	static constexpr uint64_t MAX_FRAMES = 1024;
+
+	static constexpr size_t THREAD_NAME_SIZE = 32;
+
+	/**
+	 * @brief Event ring of one thread.
+	 */
+	struct ThreadBuffer
+	{
+		std::atomic<uint64_t> writeIndex{ 0 };
+
+		ProfileEvent events[EVENTS_PER_THREAD];
+
+		char name[THREAD_NAME_SIZE] = {};
+	};
+
+	ProfilerManager();
+
+	~ProfilerManager();
+
+	/**
+	 * @brief Reads the time stamp counter, or a nanosecond clock on CPUs without one.
+	 */
+	static uint64_t ReadTicks();
+
+	/**
+	 * @brief Returns the calling thread's buffer, creating it on first use.
+	 * @return Null if MAX_THREADS buffers already exist.
+	 */
+	ThreadBuffer* GetThreadBuffer();
+
+	void Record(const char* name, API api);
+
+	static void BulletEnterZone(const char* name);
+
+	static void BulletLeaveZone();
+
+	std::atomic<bool> enabled{ false };
+
+	std::atomic<ThreadBuffer*> threads[MAX_THREADS] = {};
+
+	std::atomic<int> threadCount{ 0 };
+
+	std::atomic<uint64_t> frameTicks[MAX_FRAMES] = {};
+
+	std::atomic<uint64_t> frameCount{ 0 };
+
+	/**
+	 * @brief Tick and clock values sampled together at startup, the origin of exported timestamps.
+	 */
+	uint64_t referenceTicks = 0;
+
+	std::chrono::steady_clock::time_point referenceTime;
+
+	btEnterProfileZoneFunc* previousEnterZone = nullptr;
+
+	btLeaveProfileZoneFunc* previousLeaveZone = nullptr;
+};
+
+/**
+ * @brief Opens a zone for the lifetime of the object when the profiler is enabled.
+ */
+class ProfileScope
+{
+public:
+	ProfileScope(const char* name, API api);
+
+	~ProfileScope();
+
+private:
+	bool active;
+};
+
+#define PROFILE_SCOPE(name, api) ProfileScope profileScope(name, api)
+
+static ProfilerManager& Profiler = ProfilerManager::GetInstance();
@@ -1,49 +1,252 @@
-#include "../include/ConsoleManager.h"
+#include "../Include/ConsoleManager.h"
 
-void Console::Log(std::string message, API API, LEVEL errorLvl)
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+Console::Console()
+	: startTime(std::chrono::steady_clock::now())
+{
+	// Construct the ImGui console first so it outlives the sink thread at shutdown.
+	ImGuiConsoleManager::GetInstance();
+
+	outBuffer.reserve(SINK_BATCH_SIZE * 128);
+	errBuffer.reserve(SINK_BATCH_SIZE * 128);
+	lineBuffer.reserve(MAX_MESSAGE_LENGTH + 128);
+	pendingMessage.reserve(MAX_MESSAGE_LENGTH);
+
+	sinkThread = std::thread(&Console::SinkLoop, this);
+}
+
+Console::~Console()
+{
+	running.store(false, std::memory_order_release);
+	WakeSink();
+
+	if (sinkThread.joinable())
+	{
+		sinkThread.join();
+	}
+}
+
+void Console::Log(std::string_view message, API API, LEVEL errorLvl)
 {
-	switch (errorLvl)
+	const uint64_t timestamp = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - startTime).count();
+
+	// A message that does not fit the records is cut on a UTF-8 character boundary and marked.
+	static constexpr std::string_view TRUNCATION_MARK = "\xE2\x80\xA6";
+	std::string_view mark;
+	if (message.size() > MAX_MESSAGE_LENGTH)
 	{
-	case LEVEL::SUCCESS:
+		size_t length = MAX_MESSAGE_LENGTH - TRUNCATION_MARK.size();
+		while (length > 0 && ((unsigned char)message[length] & 0xC0) == 0x80)
 		{
-			std::string successMessage = setLog(API, LEVEL::SUCCESS, message, GREEN);
-			std::cout << successMessage << std::endl;
-			ImGuiConsoleManager::GetInstance().Log(successMessage);
-			break;
+			--length;
 		}
-	case LEVEL::INFO:
+		message = message.substr(0, length);
+		mark = TRUNCATION_MARK;
+	}
+
+	const size_t totalLength = message.size() + mark.size();
+	const size_t recordCount = std::max<size_t>(1, (totalLength + LogRecord::PAYLOAD_SIZE - 1) / LogRecord::PAYLOAD_SIZE);
+
+	auto fill = [&](LogRecord& record, size_t index)
+	{
+		const size_t begin = index * LogRecord::PAYLOAD_SIZE;
+		const size_t length = std::min(totalLength - begin, LogRecord::PAYLOAD_SIZE);
+		record.timestamp = timestamp;
+		record.api = API;
+		record.level = errorLvl;
+		record.length = (uint16_t)length;
+		record.continues = index + 1 < recordCount;
+
+		const size_t fromMessage = begin < message.size() ? std::min(length, message.size() - begin) : 0;
+		memcpy(record.payload, message.data() + begin, fromMessage);
+		if (fromMessage < length)
 		{
-			std::string infoMessage = setLog(API, LEVEL::INFO, message, CYAN);
-			std::cout << infoMessage << std::endl;
-			ImGuiConsoleManager::GetInstance().Log(infoMessage);
+			const size_t markBegin = begin + fromMessage - message.size();
+			memcpy(record.payload + fromMessage, mark.data() + markBegin, length - fromMessage);
+		}
+	};
+
+	if (!mark.empty())
+	{
+		truncatedTotal.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (ring.TryPushRange(recordCount, fill))
+	{
+		WakeSink();
+		return;
+	}
+
+	switch (overflowPolicy.load(std::memory_order_relaxed))
+	{
+	case OVERFLOW_POLICY::BLOCK:
+		{
+			do
+			{
+				WakeSink();
+				std::this_thread::yield();
+			} while (!ring.TryPushRange(recordCount, fill));
+			WakeSink();
 			break;
 		}
-	case LEVEL::WARNING:
+	case OVERFLOW_POLICY::COUNT_AND_REPORT:
 		{
-			std::string warnMessage = setLog(API, LEVEL::WARNING, message, YELLOW);
-			std::cout << warnMessage << std::endl;
-			ImGuiConsoleManager::GetInstance().Log(warnMessage);
-
+			droppedPending.fetch_add(1, std::memory_order_relaxed);
+			droppedTotal.fetch_add(1, std::memory_order_relaxed);
 			break;
 		}
-	case LEVEL::PRINT:
+	case OVERFLOW_POLICY::DROP:
+	default:
 		{
-			std::string printMessage = setLog(API, LEVEL::PRINT, message, WHITE);
-			std::cout << printMessage << std::endl;
-			ImGuiConsoleManager::GetInstance().Log(printMessage);
+			droppedTotal.fetch_add(1, std::memory_order_relaxed);
 			break;
 		}
-	case LEVEL::ERRORS:
+	}
+}
+
+void Console::Flush()
+{
+	const size_t target = ring.Claimed();
+
+	std::unique_lock<std::mutex> lock(sinkMutex);
+	sinkWake.notify_one();
+
+	// The sink only signals when it goes idle, so poll as well in case producers keep it busy.
+	while (processed.load(std::memory_order_acquire) < target && running.load(std::memory_order_acquire))
+	{
+		sinkDone.wait_for(lock, std::chrono::milliseconds(1));
+	}
+}
+
+void Console::WakeSink()
+{
+	if (sinkWaiting.load(std::memory_order_acquire))
+	{
+		std::lock_guard<std::mutex> lock(sinkMutex);
+		sinkWake.notify_one();
+	}
+}
+
+void Console::SinkLoop()
+{
+	for (;;)
+	{
+		if (DrainBatch() > 0)
+		{
+			continue;
+		}
+
+		if (!running.load(std::memory_order_acquire))
 		{
-			std::string errorMessage = setLog(API, LEVEL::ERRORS, message, RED);
-			std::cerr << errorMessage << std::endl;
-			ImGuiConsoleManager::GetInstance().Log(errorMessage);
+			// Records claimed before shutdown may still be in flight; drain until the cursors meet.
+			if (processed.load(std::memory_order_relaxed) >= ring.Claimed())
+			{
+				break;
+			}
+			std::this_thread::yield();
+			continue;
+		}
 
-			break;
+		std::unique_lock<std::mutex> lock(sinkMutex);
+		sinkDone.notify_all();
+		sinkWaiting.store(true, std::memory_order_release);
+		sinkWake.wait_for(lock, std::chrono::milliseconds(10));
+		sinkWaiting.store(false, std::memory_order_relaxed);
+	}
+
+	std::lock_guard<std::mutex> lock(sinkMutex);
+	sinkDone.notify_all();
+}
+
+size_t Console::DrainBatch()
+{
+	outBuffer.clear();
+	errBuffer.clear();
+
+	// Once shutdown has started nothing will draw the ImGui console again, so the remaining
+	// records only go to the output streams.
+	const bool forwardToImGui = running.load(std::memory_order_acquire);
+
+	const uint64_t dropped = droppedPending.exchange(0, std::memory_order_relaxed);
+	if (dropped > 0)
+	{
+		LogRecord report;
+		report.api = API::MAIN;
+		report.level = LEVEL::WARNING;
+		report.timestamp = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - startTime).count();
+		const int length = snprintf(report.payload, LogRecord::PAYLOAD_SIZE, "%llu log messages dropped (ring buffer full)", (unsigned long long)dropped);
+		report.length = (uint16_t)std::min((size_t)std::max(length, 0), LogRecord::PAYLOAD_SIZE - 1);
+
+		lineBuffer.clear();
+		appendLog(lineBuffer, report, std::string_view(report.payload, report.length));
+		outBuffer.append(lineBuffer).push_back('\n');
+		if (forwardToImGui)
+		{
+			ImGuiConsoleManager::GetInstance().Log(lineBuffer);
 		}
-	default:
-		break;
 	}
+
+	const size_t count = ring.Drain([&](const LogRecord& record)
+	{
+		std::string_view message(record.payload, record.length);
+		if (record.continues || !pendingMessage.empty())
+		{
+			pendingMessage.append(message);
+			if (record.continues)
+			{
+				return;
+			}
+			message = pendingMessage;
+		}
+
+		lineBuffer.clear();
+		appendLog(lineBuffer, record, message);
+		pendingMessage.clear();
+
+		std::string& stream = record.level == LEVEL::ERRORS ? errBuffer : outBuffer;
+		stream.append(lineBuffer).push_back('\n');
+
+		if (forwardToImGui)
+		{
+			ImGuiConsoleManager::GetInstance().Log(lineBuffer);
+		}
+	}, SINK_BATCH_SIZE);
+
+	if (!outBuffer.empty())
+	{
+		fwrite(outBuffer.data(), 1, outBuffer.size(), stdout);
+		fflush(stdout);
+	}
+	if (!errBuffer.empty())
+	{
+		fwrite(errBuffer.data(), 1, errBuffer.size(), stderr);
+		fflush(stderr);
+	}
+
+	if (count > 0)
+	{
+		processed.fetch_add(count, std::memory_order_release);
+	}
+
+	return count;
+}
+
+void Console::appendLog(std::string& out, const LogRecord& record, std::string_view message) const
+{
+	char stamp[32];
+	const int timeLength = snprintf(stamp, sizeof(stamp), "[%.3f]", (double)record.timestamp * 1e-9);
+
+	out.append(stamp, (size_t)std::max(timeLength, 0));
+	out.append(getAPIString(record.api));
+	out.append(getLevelString(record.level));
+	out.append(getMessageColor(record.level));
+	out.append(message);
+	out.append(RESET);
 }
 
 void Console::Sample()
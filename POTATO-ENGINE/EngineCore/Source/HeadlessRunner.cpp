@@ -0,0 +1,455 @@
+#include "HeadlessRunner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+// The headless runner owns the audio engine, so it also compiles the miniaudio implementation.
+#define MINIAUDIO_IMPLEMENTATION
+#include "miniaudio.h"
+
+#include "ConsoleManager.h"
+#include "ProfilerManager.h"
+
+namespace
+{
+	const ma_uint32 AUDIO_CHANNELS = 2;
+	const ma_uint32 AUDIO_SAMPLE_RATE = 48000;
+
+	double ElapsedMilliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	bool ParseInt(const char* text, int& value)
+	{
+		char* end = nullptr;
+		const long parsed = strtol(text, &end, 10);
+		if (end == text || *end != '\0' || parsed < 0)
+		{
+			return false;
+		}
+		value = (int)parsed;
+		return true;
+	}
+
+	bool ParseScheduler(const char* text, TASK_SCHEDULER& scheduler)
+	{
+		const struct { const char* name; TASK_SCHEDULER value; } names[] = {
+			{ "default", TASK_SCHEDULER::DEFAULT },
+			{ "workstealing", TASK_SCHEDULER::WORK_STEALING },
+			{ "sequential", TASK_SCHEDULER::SEQUENTIAL },
+			{ "openmp", TASK_SCHEDULER::OPENMP },
+			{ "tbb", TASK_SCHEDULER::TBB },
+			{ "ppl", TASK_SCHEDULER::PPL },
+		};
+		for (const auto& entry : names)
+		{
+			if (strcmp(text, entry.name) == 0)
+			{
+				scheduler = entry.value;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool ParseBroadphase(const char* text, BROADPHASE& broadphase)
+	{
+		const struct { const char* name; BROADPHASE value; } names[] = {
+			{ "dbvt", BROADPHASE::DBVT },
+			{ "sap", BROADPHASE::SAP },
+			{ "grid", BROADPHASE::GRID },
+		};
+		for (const auto& entry : names)
+		{
+			if (strcmp(text, entry.name) == 0)
+			{
+				broadphase = entry.value;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool EndsWith(const std::string& text, const char* suffix)
+	{
+		const size_t length = strlen(suffix);
+		return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+	}
+}
+
+bool HeadlessRunner::ParseArguments(int argc, char** argv, HeadlessSettings& settings)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* option = argv[i];
+		if (strcmp(option, "--help") == 0 || strcmp(option, "-h") == 0)
+		{
+			// The caller prints the usage.
+			return false;
+		}
+
+		// Every option takes a value. A missing one is reported once the option is known to exist.
+		const bool hasValue = i + 1 < argc;
+		const char* value = hasValue ? argv[i + 1] : "";
+
+		bool valid = true;
+		if (strcmp(option, "--frames") == 0)
+		{
+			valid = ParseInt(value, settings.frames);
+		}
+		else if (strcmp(option, "--bodies") == 0)
+		{
+			valid = ParseInt(value, settings.bodies);
+		}
+		else if (strcmp(option, "--sounds") == 0)
+		{
+			valid = ParseInt(value, settings.sounds);
+		}
+		else if (strcmp(option, "--threads") == 0)
+		{
+			valid = ParseInt(value, settings.threads);
+		}
+		else if (strcmp(option, "--scheduler") == 0)
+		{
+			valid = ParseScheduler(value, settings.scheduler);
+		}
+		else if (strcmp(option, "--huge-pages") == 0)
+		{
+			int hugePages = 0;
+			valid = ParseInt(value, hugePages) && hugePages <= 1;
+			settings.hugePages = hugePages == 1;
+		}
+		else if (strcmp(option, "--broadphase") == 0)
+		{
+			valid = ParseBroadphase(value, settings.broadphase);
+		}
+		else if (strcmp(option, "--parallel-broadphase") == 0)
+		{
+			int parallelBroadphase = 0;
+			valid = ParseInt(value, parallelBroadphase) && parallelBroadphase <= 1;
+			settings.parallelBroadphase = parallelBroadphase == 1;
+		}
+		else if (strcmp(option, "--concurrent-pairs") == 0)
+		{
+			int concurrentPairs = 0;
+			valid = ParseInt(value, concurrentPairs) && concurrentPairs <= 1;
+			settings.concurrentPairCache = concurrentPairs == 1;
+		}
+		else if (strcmp(option, "--pair-events") == 0)
+		{
+			int pairEvents = 0;
+			valid = ParseInt(value, pairEvents) && pairEvents <= 1;
+			settings.pairEvents = pairEvents == 1;
+		}
+		else if (strcmp(option, "--batched-narrowphase") == 0)
+		{
+			int batchedNarrowphase = 0;
+			valid = ParseInt(value, batchedNarrowphase) && batchedNarrowphase <= 1;
+			settings.batchedNarrowphase = batchedNarrowphase == 1;
+		}
+		else if (strcmp(option, "--convex-coherence") == 0)
+		{
+			int convexCoherence = 0;
+			valid = ParseInt(value, convexCoherence) && convexCoherence <= 1;
+			settings.convexCoherence = convexCoherence == 1;
+		}
+		else if (strcmp(option, "--dt") == 0)
+		{
+			settings.frameTime = atof(value);
+			valid = settings.frameTime > 0.0;
+		}
+		else if (strcmp(option, "--out") == 0)
+		{
+			settings.outputPath = value;
+		}
+		else if (strcmp(option, "--trace") == 0)
+		{
+			settings.tracePath = value;
+		}
+		else if (strcmp(option, "--trace-frames") == 0)
+		{
+			valid = ParseInt(value, settings.traceFrames) && settings.traceFrames > 0;
+		}
+		else
+		{
+			console.Log(std::string("Unknown option ") + option, API::MAIN, LEVEL::ERRORS);
+			return false;
+		}
+
+		if (!hasValue)
+		{
+			console.Log(std::string("Missing value for ") + option, API::MAIN, LEVEL::ERRORS);
+			return false;
+		}
+
+		if (!valid)
+		{
+			console.Log(std::string("Invalid value for ") + option + ": " + value, API::MAIN, LEVEL::ERRORS);
+			return false;
+		}
+		++i;
+	}
+	return true;
+}
+
+int HeadlessRunner::Run(const HeadlessSettings& settings)
+{
+	// Audio: no playback device, the loop pulls each frame's worth of samples from the mixer itself.
+	ma_engine_config engineConfig = ma_engine_config_init();
+	engineConfig.noDevice = MA_TRUE;
+	engineConfig.channels = AUDIO_CHANNELS;
+	engineConfig.sampleRate = AUDIO_SAMPLE_RATE;
+
+	std::unique_ptr<ma_engine> audioEngine(new ma_engine);
+	if (ma_engine_init(&engineConfig, audioEngine.get()) != MA_SUCCESS)
+	{
+		console.Log("Failed to initialize the audio engine", API::MAIN, LEVEL::ERRORS);
+		return 1;
+	}
+
+	std::vector<ma_waveform> waveforms(settings.sounds);
+	std::vector<ma_sound> sounds(settings.sounds);
+	for (int i = 0; i < settings.sounds; ++i)
+	{
+		ma_waveform_config waveformConfig = ma_waveform_config_init(ma_format_f32, AUDIO_CHANNELS, AUDIO_SAMPLE_RATE, ma_waveform_type_sine, 0.1, 220.0 + 55.0 * i);
+		ma_waveform_init(&waveformConfig, &waveforms[i]);
+		ma_sound_init_from_data_source(audioEngine.get(), &waveforms[i], 0, nullptr, &sounds[i]);
+		ma_sound_set_looping(&sounds[i], MA_TRUE);
+		ma_sound_start(&sounds[i]);
+	}
+
+	if (!settings.tracePath.empty())
+	{
+		Profiler.SetThreadName("Main");
+		Profiler.Enable();
+	}
+
+	// Physics: a ground box and a grid of falling boxes, stepped synchronously on this thread.
+	PhysicsSettings physicsSettings;
+	physicsSettings.numThreads = settings.threads;
+	physicsSettings.taskScheduler = settings.scheduler;
+	physicsSettings.hugePages = settings.hugePages;
+	physicsSettings.broadphase = settings.broadphase;
+	physicsSettings.parallelBroadphase = settings.parallelBroadphase;
+	physicsSettings.concurrentPairCache = settings.concurrentPairCache;
+	physicsSettings.pairEvents = settings.pairEvents;
+	physicsSettings.batchedNarrowphase = settings.batchedNarrowphase;
+	physicsSettings.convexCoherence = settings.convexCoherence;
+	Physics.Init(physicsSettings);
+
+	btBoxShape groundShape(btVector3(500, 1, 500));
+	btBoxShape boxShape(btVector3(btScalar(0.5), btScalar(0.5), btScalar(0.5)));
+
+	btTransform transform;
+	transform.setIdentity();
+	Physics.CreateRigidBody(&groundShape, 0, transform);
+
+	const int side = std::max(1, (int)std::ceil(std::sqrt((double)settings.bodies / 4.0)));
+	for (int i = 0; i < settings.bodies; ++i)
+	{
+		const int layer = i / (side * side);
+		const int cell = i % (side * side);
+		transform.setOrigin(btVector3(btScalar((cell % side - side / 2) * 1.1), btScalar(2 + layer * 1.1), btScalar((cell / side - side / 2) * 1.1)));
+		Physics.CreateRigidBody(&boxShape, 1, transform);
+	}
+
+	// A zero-length update creates the world and inserts the bodies outside the timed frames.
+	Physics.Update(0.0);
+
+	console.Log("Headless run: " + std::to_string(settings.frames) + " frames, " + std::to_string(settings.bodies) + " bodies, " + std::to_string(settings.sounds) + " sounds", API::MAIN, LEVEL::INFO);
+
+	const ma_uint64 audioFramesPerFrame = (ma_uint64)(settings.frameTime * AUDIO_SAMPLE_RATE);
+	std::vector<float> audioBuffer((size_t)audioFramesPerFrame * AUDIO_CHANNELS);
+
+	timings.clear();
+	timings.reserve(settings.frames);
+
+	const PhysicsMemoryStats memoryBefore = PhysicsMemory.GetStats();
+	uint64_t contactBegins = 0;
+	uint64_t contactEnds = 0;
+	uint64_t pairEvents = 0;
+	std::vector<PhysicsPairEvent> frameEvents;
+
+	for (int frame = 0; frame < settings.frames; ++frame)
+	{
+		Profiler.MarkFrame();
+		PROFILE_SCOPE("Frame", API::MAIN);
+
+		const std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+
+		Physics.Update(settings.frameTime);
+		Physics.AcquireSnapshot();
+		Physics.DrainPairEvents(frameEvents);
+		for (const PhysicsPairEvent& event : frameEvents)
+		{
+			contactBegins += event.type == btPairEvent::CONTACT_BEGIN;
+			contactEnds += event.type == btPairEvent::CONTACT_END;
+		}
+		pairEvents += frameEvents.size();
+		const std::chrono::steady_clock::time_point physicsEnd = std::chrono::steady_clock::now();
+
+		{
+			PROFILE_SCOPE("Audio mix", API::MAIN);
+			ma_engine_read_pcm_frames(audioEngine.get(), audioBuffer.data(), audioFramesPerFrame, nullptr);
+		}
+		const std::chrono::steady_clock::time_point audioEnd = std::chrono::steady_clock::now();
+
+		FrameTiming timing;
+		timing.physics = ElapsedMilliseconds(frameStart, physicsEnd);
+		timing.audio = ElapsedMilliseconds(physicsEnd, audioEnd);
+		timing.total = ElapsedMilliseconds(frameStart, audioEnd);
+		timings.push_back(timing);
+	}
+
+	const PhysicsMemoryStats memoryAfter = PhysicsMemory.GetStats();
+
+	if (!settings.tracePath.empty())
+	{
+		Profiler.Disable();
+		if (Profiler.CaptureChromeTrace(settings.tracePath, settings.traceFrames))
+		{
+			console.Log("Wrote the last " + std::to_string(settings.traceFrames) + " frames to " + settings.tracePath, API::MAIN, LEVEL::INFO);
+		}
+		else
+		{
+			console.Log("Failed to write " + settings.tracePath, API::MAIN, LEVEL::ERRORS);
+		}
+	}
+
+	Physics.Shutdown();
+	for (ma_sound& sound : sounds)
+	{
+		ma_sound_uninit(&sound);
+	}
+	for (ma_waveform& waveform : waveforms)
+	{
+		ma_waveform_uninit(&waveform);
+	}
+	ma_engine_uninit(audioEngine.get());
+
+	std::vector<double> samples(timings.size());
+	std::transform(timings.begin(), timings.end(), samples.begin(), [](const FrameTiming& timing) { return timing.total; });
+	totalSummary = Summarize(samples);
+	std::transform(timings.begin(), timings.end(), samples.begin(), [](const FrameTiming& timing) { return timing.physics; });
+	physicsSummary = Summarize(samples);
+	std::transform(timings.begin(), timings.end(), samples.begin(), [](const FrameTiming& timing) { return timing.audio; });
+	audioSummary = Summarize(samples);
+
+	char summary[256];
+	snprintf(summary, sizeof(summary), "Frame ms: min %.3f avg %.3f p50 %.3f p99 %.3f max %.3f",
+		totalSummary.min, totalSummary.avg, totalSummary.p50, totalSummary.p99, totalSummary.max);
+	console.Log(summary, API::MAIN, LEVEL::SUCCESS);
+
+	snprintf(summary, sizeof(summary), "Physics memory: %.2f MiB peak, %.2f MiB reserved, %.2f KiB frame arena peak, %llu aligned allocations and %llu heap allocations over the frames",
+		memoryAfter.peakBytesInUse / 1048576.0, memoryAfter.bytesReserved / 1048576.0, memoryAfter.peakFrameArenaBytes / 1024.0,
+		(unsigned long long)(memoryAfter.totalAllocations - memoryBefore.totalAllocations),
+		(unsigned long long)(memoryAfter.totalHeapAllocations - memoryBefore.totalHeapAllocations));
+	console.Log(summary, API::MAIN, LEVEL::INFO);
+
+	if (settings.pairEvents)
+	{
+		snprintf(summary, sizeof(summary), "Pair events: %llu over the frames, %llu contact begins and %llu contact ends",
+			(unsigned long long)pairEvents, (unsigned long long)contactBegins, (unsigned long long)contactEnds);
+		console.Log(summary, API::MAIN, LEVEL::INFO);
+	}
+
+	if (!settings.outputPath.empty() && !WriteTelemetry(settings))
+	{
+		console.Log("Failed to write " + settings.outputPath, API::MAIN, LEVEL::ERRORS);
+		return 1;
+	}
+
+	return 0;
+}
+
+TimingSummary HeadlessRunner::Summarize(std::vector<double>& samples)
+{
+	TimingSummary summary;
+	if (samples.empty())
+	{
+		return summary;
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	// Nearest-rank percentiles.
+	auto percentile = [&](double p)
+	{
+		const size_t rank = (size_t)std::ceil(p * samples.size());
+		return samples[std::min(samples.size() - 1, rank > 0 ? rank - 1 : 0)];
+	};
+
+	double sum = 0.0;
+	for (double sample : samples)
+	{
+		sum += sample;
+	}
+
+	summary.min = samples.front();
+	summary.max = samples.back();
+	summary.avg = sum / samples.size();
+	summary.p50 = percentile(0.50);
+	summary.p99 = percentile(0.99);
+	return summary;
+}
+
+bool HeadlessRunner::WriteTelemetry(const HeadlessSettings& settings) const
+{
+	FILE* file = fopen(settings.outputPath.c_str(), "w");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	const TimingSummary* summaries[3] = { &totalSummary, &physicsSummary, &audioSummary };
+	const char* names[3] = { "total_ms", "physics_ms", "audio_ms" };
+
+	if (EndsWith(settings.outputPath, ".json"))
+	{
+		fprintf(file, "{\n  \"frames\": %d,\n  \"frame_time_s\": %.6f,\n  \"bodies\": %d,\n  \"sounds\": %d,\n  \"summary\": {\n",
+			settings.frames, settings.frameTime, settings.bodies, settings.sounds);
+		for (int i = 0; i < 3; ++i)
+		{
+			fprintf(file, "    \"%s\": { \"min\": %.4f, \"avg\": %.4f, \"p50\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+				names[i], summaries[i]->min, summaries[i]->avg, summaries[i]->p50, summaries[i]->p99, summaries[i]->max, i < 2 ? "," : "");
+		}
+		fprintf(file, "  },\n  \"samples\": [\n");
+		for (size_t frame = 0; frame < timings.size(); ++frame)
+		{
+			const FrameTiming& timing = timings[frame];
+			fprintf(file, "    { \"frame\": %zu, \"total_ms\": %.4f, \"physics_ms\": %.4f, \"audio_ms\": %.4f }%s\n",
+				frame, timing.total, timing.physics, timing.audio, frame + 1 < timings.size() ? "," : "");
+		}
+		fprintf(file, "  ]\n}\n");
+	}
+	else
+	{
+		// Summary rows first (frame column holds the statistic name), then one row per frame.
+		fprintf(file, "frame,total_ms,physics_ms,audio_ms\n");
+		const char* statistics[5] = { "min", "avg", "p50", "p99", "max" };
+		for (int s = 0; s < 5; ++s)
+		{
+			fprintf(file, "%s", statistics[s]);
+			for (int i = 0; i < 3; ++i)
+			{
+				const double values[5] = { summaries[i]->min, summaries[i]->avg, summaries[i]->p50, summaries[i]->p99, summaries[i]->max };
+				fprintf(file, ",%.4f", values[s]);
+			}
+			fprintf(file, "\n");
+		}
+		for (size_t frame = 0; frame < timings.size(); ++frame)
+		{
+			const FrameTiming& timing = timings[frame];
+			fprintf(file, "%zu,%.4f,%.4f,%.4f\n", frame, timing.total, timing.physics, timing.audio);
+		}
+	}
+
+	const bool written = ferror(file) == 0;
+	return fclose(file) == 0 && written;
+}
@@ -0,0 +1,650 @@
+#include "PhysicsAllocator.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+
+#include "LinearMath/btAlignedAllocator.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+	thread_local void* threadCache = nullptr;
+
+	/**
+	 * @brief Set once the thread's cache is retired, so frees during thread teardown bypass it.
+	 */
+	thread_local bool threadExiting = false;
+
+	/**
+	 * @brief Bytes in front of a large block holding its size. Keeps the block 16-byte aligned.
+	 */
+	const size_t LARGE_HEADER_SIZE = 16;
+
+	/**
+	 * @brief Adds to a counter only its owner thread writes, without a locked instruction.
+	 */
+	void AddOwned(std::atomic<uint64_t>& counter, uint64_t value)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	size_t RoundUp(size_t value, size_t multiple)
+	{
+		return (value + multiple - 1) / multiple * multiple;
+	}
+}
+
+PhysicsAllocator& PhysicsAllocator::GetInstance()
+{
+	// Never destroyed: Bullet objects owned by other statics may still be freed during exit.
+	static PhysicsAllocator* instance = new PhysicsAllocator;
+	return *instance;
+}
+
+PhysicsAllocator::PhysicsAllocator()
+{
+}
+
+PhysicsAllocator::ThreadCacheOwner::~ThreadCacheOwner()
+{
+	ThreadCache* cache = static_cast<ThreadCache*>(threadCache);
+	threadCache = nullptr;
+	threadExiting = true;
+
+	if (cache != nullptr)
+	{
+		GetInstance().RetireThreadCache(cache);
+	}
+}
+
+void PhysicsAllocator::Install()
+{
+	if (installed)
+	{
+		return;
+	}
+
+	installed = true;
+	btAlignedAllocSetCustom(&PhysicsAllocator::Allocate, &PhysicsAllocator::Free);
+}
+
+bool PhysicsAllocator::SetHugePages(bool enabled)
+{
+	hugePagesRequested.store(enabled, std::memory_order_relaxed);
+	if (!enabled)
+	{
+		return true;
+	}
+
+	// Map the next region right away to learn whether the OS grants huge pages.
+	std::lock_guard<std::mutex> lock(regionMutex);
+	MapNextRegion();
+	return hugePagesActive.load(std::memory_order_relaxed);
+}
+
+int PhysicsAllocator::GetSizeClass(size_t size)
+{
+	if (size <= 128)
+	{
+		return size == 0 ? 0 : (int)((size - 1) / 16);
+	}
+
+	// 2^power < size <= 2^(power + 1), split in four steps of 2^(power - 2).
+	const int power = (int)std::bit_width(size - 1) - 1;
+	const size_t step = size_t(1) << (power - 2);
+	const size_t quarter = (size - (size_t(1) << power) + step - 1) / step;
+	return 8 + (power - 7) * 4 + (int)quarter - 1;
+}
+
+size_t PhysicsAllocator::GetClassSize(int sizeClass)
+{
+	if (sizeClass < 8)
+	{
+		return size_t(16) * (sizeClass + 1);
+	}
+
+	const int power = 7 + (sizeClass - 8) / 4;
+	const size_t quarter = (size_t)((sizeClass - 8) % 4 + 1);
+	return (size_t(1) << power) + quarter * (size_t(1) << (power - 2));
+}
+
+PhysicsAllocator::ThreadCache* PhysicsAllocator::GetThreadCache()
+{
+	if (threadCache != nullptr)
+	{
+		return static_cast<ThreadCache*>(threadCache);
+	}
+
+	if (threadExiting)
+	{
+		return nullptr;
+	}
+
+	// Reaching this declaration registers the owner's destructor for the thread's exit.
+	static thread_local ThreadCacheOwner owner;
+	(void)owner;
+
+	ThreadCache* cache = new ThreadCache;
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		caches.push_back(cache);
+	}
+	threadCache = cache;
+	return cache;
+}
+
+void* PhysicsAllocator::Allocate(size_t size)
+{
+	PhysicsAllocator& allocator = GetInstance();
+
+	if (size <= MAX_SMALL_SIZE)
+	{
+		ThreadCache* cache = allocator.GetThreadCache();
+		if (cache != nullptr)
+		{
+			void* memory = allocator.AllocateSmall(cache, GetSizeClass(size));
+			if (memory != nullptr)
+			{
+				return memory;
+			}
+		}
+	}
+
+	// Also the fallback when the pools cannot grow: large blocks are told apart by their address.
+	return allocator.AllocateLarge(size);
+}
+
+void PhysicsAllocator::Free(void* memory)
+{
+	if (memory == nullptr)
+	{
+		return;
+	}
+
+	PhysicsAllocator& allocator = GetInstance();
+
+	RegionHeader* region = allocator.FindRegion(memory);
+	if (region != nullptr)
+	{
+		const int slab = (int)(((char*)memory - (char*)region) / SLAB_SIZE);
+		allocator.FreeSmall(allocator.GetThreadCache(), memory, region->slabClass[slab]);
+		return;
+	}
+
+	char* block = (char*)memory - LARGE_HEADER_SIZE;
+	allocator.largeBytesInUse.fetch_sub(*(uint64_t*)block, std::memory_order_relaxed);
+	allocator.largeFrees.fetch_add(1, std::memory_order_relaxed);
+	free(block);
+}
+
+void* PhysicsAllocator::AllocateFrame(size_t size, int alignment)
+{
+	return GetInstance().FrameAllocate(size, (size_t)alignment);
+}
+
+void* PhysicsAllocator::AllocateSmall(ThreadCache* cache, int sizeClass)
+{
+	FreeBlock* block = cache->freeLists[sizeClass];
+	const size_t classSize = GetClassSize(sizeClass);
+
+	if (block == nullptr)
+	{
+		Depot& depot = depots[sizeClass];
+		{
+			std::lock_guard<std::mutex> lock(depot.mutex);
+			block = depot.batches;
+			if (block != nullptr)
+			{
+				depot.batches = block->nextBatch;
+			}
+		}
+
+		if (block == nullptr)
+		{
+			// Depot empty: cut a batch out of the slab, refilling the slab when it runs out.
+			int carved = 0;
+			FreeBlock* tail = nullptr;
+			while (carved < BATCH_SIZE)
+			{
+				if ((size_t)(cache->slabEnd[sizeClass] - cache->slabCursor[sizeClass]) < classSize)
+				{
+					if (carved > 0 || !RefillSlab(cache, sizeClass))
+					{
+						break;
+					}
+				}
+
+				FreeBlock* carvedBlock = (FreeBlock*)cache->slabCursor[sizeClass];
+				cache->slabCursor[sizeClass] += classSize;
+				carvedBlock->next = nullptr;
+				if (tail == nullptr)
+				{
+					block = carvedBlock;
+				}
+				else
+				{
+					tail->next = carvedBlock;
+				}
+				tail = carvedBlock;
+				++carved;
+			}
+
+			if (block == nullptr)
+			{
+				return nullptr;
+			}
+			cache->freeCounts[sizeClass] = carved;
+		}
+		else
+		{
+			int count = 0;
+			for (FreeBlock* counted = block; counted != nullptr; counted = counted->next)
+			{
+				++count;
+			}
+			cache->freeCounts[sizeClass] = count;
+		}
+	}
+
+	cache->freeLists[sizeClass] = block->next;
+	--cache->freeCounts[sizeClass];
+
+	AddOwned(cache->allocations, 1);
+	AddOwned(cache->bytesAllocated, classSize);
+	return block;
+}
+
+void PhysicsAllocator::FreeSmall(ThreadCache* cache, void* memory, int sizeClass)
+{
+	FreeBlock* block = (FreeBlock*)memory;
+
+	if (cache == nullptr)
+	{
+		// The thread is exiting: hand the block straight to the depot as a batch of one.
+		block->next = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(depots[sizeClass].mutex);
+			block->nextBatch = depots[sizeClass].batches;
+			depots[sizeClass].batches = block;
+		}
+
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		++retiredFrees;
+		retiredBytesFreed += GetClassSize(sizeClass);
+		return;
+	}
+
+	block->next = cache->freeLists[sizeClass];
+	cache->freeLists[sizeClass] = block;
+	if (++cache->freeCounts[sizeClass] >= 2 * BATCH_SIZE)
+	{
+		PushBatch(cache, sizeClass, BATCH_SIZE);
+	}
+
+	AddOwned(cache->frees, 1);
+	AddOwned(cache->bytesFreed, GetClassSize(sizeClass));
+}
+
+void* PhysicsAllocator::AllocateLarge(size_t size)
+{
+	char* block = (char*)malloc(size + LARGE_HEADER_SIZE);
+	if (block == nullptr)
+	{
+		return nullptr;
+	}
+
+	*(uint64_t*)block = size;
+	largeBytesInUse.fetch_add(size, std::memory_order_relaxed);
+	largeAllocations.fetch_add(1, std::memory_order_relaxed);
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	return block + LARGE_HEADER_SIZE;
+}
+
+PhysicsAllocator::RegionHeader* PhysicsAllocator::FindRegion(const void* memory) const
+{
+	const uintptr_t base = (uintptr_t)memory & ~(uintptr_t)(REGION_SIZE - 1);
+	const uint64_t hash = ((uint64_t)base >> 21) * 0x9E3779B97F4A7C15ull;
+
+	for (int probe = 0; probe < REGION_TABLE_SIZE; ++probe)
+	{
+		const uintptr_t entry = regionTable[(hash + probe) & (REGION_TABLE_SIZE - 1)].load(std::memory_order_acquire);
+		if (entry == base)
+		{
+			return (RegionHeader*)base;
+		}
+		if (entry == 0)
+		{
+			return nullptr;
+		}
+	}
+	return nullptr;
+}
+
+bool PhysicsAllocator::MapNextRegion()
+{
+	// Keep the table at most three quarters full so lookups of foreign blocks stay short.
+	if (regionCount >= REGION_TABLE_SIZE / 4 * 3)
+	{
+		return false;
+	}
+
+	char* region = (char*)MapRegions(REGION_SIZE);
+	if (region == nullptr)
+	{
+		return false;
+	}
+
+	RegionHeader* header = (RegionHeader*)region;
+	std::fill(header->slabClass, header->slabClass + SLABS_PER_REGION, (uint8_t)0);
+
+	const uint64_t hash = ((uint64_t)(uintptr_t)region >> 21) * 0x9E3779B97F4A7C15ull;
+	for (int probe = 0; ; ++probe)
+	{
+		std::atomic<uintptr_t>& entry = regionTable[(hash + probe) & (REGION_TABLE_SIZE - 1)];
+		if (entry.load(std::memory_order_relaxed) == 0)
+		{
+			entry.store((uintptr_t)region, std::memory_order_release);
+			break;
+		}
+	}
+
+	currentRegion = region;
+	nextSlab = 0;
+	++regionCount;
+	return true;
+}
+
+bool PhysicsAllocator::RefillSlab(ThreadCache* cache, int sizeClass)
+{
+	std::lock_guard<std::mutex> lock(regionMutex);
+
+	if (nextSlab == SLABS_PER_REGION && !MapNextRegion())
+	{
+		return false;
+	}
+
+	const int slab = nextSlab++;
+	((RegionHeader*)currentRegion)->slabClass[slab] = (uint8_t)sizeClass;
+
+	char* slabStart = currentRegion + slab * SLAB_SIZE;
+	cache->slabCursor[sizeClass] = slab == 0 ? slabStart + REGION_HEADER_SIZE : slabStart;
+	cache->slabEnd[sizeClass] = slabStart + SLAB_SIZE;
+	return true;
+}
+
+void PhysicsAllocator::PushBatch(ThreadCache* cache, int sizeClass, int count)
+{
+	FreeBlock* head = cache->freeLists[sizeClass];
+	FreeBlock* tail = head;
+	for (int i = 1; i < count; ++i)
+	{
+		tail = tail->next;
+	}
+
+	cache->freeLists[sizeClass] = tail->next;
+	cache->freeCounts[sizeClass] -= count;
+	tail->next = nullptr;
+
+	std::lock_guard<std::mutex> lock(depots[sizeClass].mutex);
+	head->nextBatch = depots[sizeClass].batches;
+	depots[sizeClass].batches = head;
+}
+
+void* PhysicsAllocator::MapRegions(size_t size)
+{
+	const bool hugePages = hugePagesRequested.load(std::memory_order_relaxed);
+	void* memory = nullptr;
+
+#if defined(_WIN32)
+	if (hugePages)
+	{
+		// Needs SeLockMemoryPrivilege. Large pages are at least as aligned as a region.
+		const SIZE_T largePage = GetLargePageMinimum();
+		if (largePage != 0 && REGION_SIZE % largePage == 0)
+		{
+			memory = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		}
+	}
+	hugePagesActive.store(memory != nullptr, std::memory_order_relaxed);
+
+	// VirtualAlloc only aligns to 64 KiB: find an aligned address in a larger reservation, then map it
+	// on its own. Another thread can take the address in between, hence the retries.
+	for (int attempt = 0; memory == nullptr && attempt < 8; ++attempt)
+	{
+		char* reserved = (char*)VirtualAlloc(nullptr, size + REGION_SIZE, MEM_RESERVE, PAGE_NOACCESS);
+		if (reserved == nullptr)
+		{
+			return nullptr;
+		}
+		VirtualFree(reserved, 0, MEM_RELEASE);
+
+		char* aligned = (char*)RoundUp((size_t)reserved, REGION_SIZE);
+		memory = VirtualAlloc(aligned, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	}
+#else
+#if defined(MAP_HUGETLB)
+	if (hugePages)
+	{
+		// Only succeeds with huge pages reserved by the administrator. Mappings are aligned to their page size.
+		memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		memory = memory == MAP_FAILED ? nullptr : memory;
+	}
+#endif
+	hugePagesActive.store(memory != nullptr, std::memory_order_relaxed);
+
+	if (memory == nullptr)
+	{
+		// Over-map by one region and trim both ends to get an aligned block.
+		char* reserved = (char*)mmap(nullptr, size + REGION_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (reserved == MAP_FAILED)
+		{
+			return nullptr;
+		}
+
+		char* aligned = (char*)RoundUp((size_t)reserved, REGION_SIZE);
+		if (aligned != reserved)
+		{
+			munmap(reserved, aligned - reserved);
+		}
+		munmap(aligned + size, reserved + REGION_SIZE - aligned);
+		memory = aligned;
+
+#if defined(MADV_HUGEPAGE)
+		// Fall back to transparent huge pages, which the kernel may or may not provide.
+		if (hugePages)
+		{
+			hugePagesActive.store(madvise(memory, size, MADV_HUGEPAGE) == 0, std::memory_order_relaxed);
+		}
+#endif
+	}
+#endif
+
+	if (memory != nullptr)
+	{
+		bytesReserved.fetch_add(size, std::memory_order_relaxed);
+		heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	}
+	return memory;
+}
+
+void PhysicsAllocator::UnmapRegions(void* memory, size_t size)
+{
+#if defined(_WIN32)
+	VirtualFree(memory, 0, MEM_RELEASE);
+#else
+	munmap(memory, size);
+#endif
+	bytesReserved.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void* PhysicsAllocator::FrameAllocate(size_t size, size_t alignment)
+{
+	ThreadCache* cache = GetThreadCache();
+	if (cache == nullptr)
+	{
+		return nullptr;
+	}
+
+	if (cache->arenaCursor != nullptr)
+	{
+		char* memory = (char*)RoundUp((size_t)cache->arenaCursor, alignment);
+		if (memory + size <= cache->arenaEnd)
+		{
+			cache->arenaCursor = memory + size;
+			return memory;
+		}
+	}
+
+	return ArenaAllocateSlow(cache, size, alignment);
+}
+
+void* PhysicsAllocator::ArenaAllocateSlow(ThreadCache* cache, size_t size, size_t alignment)
+{
+	const size_t chunkSize = RoundUp(std::max(REGION_SIZE, sizeof(ArenaChunk) + size + alignment), REGION_SIZE);
+	ArenaChunk* chunk = (ArenaChunk*)MapRegions(chunkSize);
+	if (chunk == nullptr)
+	{
+		return nullptr;
+	}
+
+	if (cache->arenaChunks != nullptr)
+	{
+		cache->arenaUsedInFullChunks += cache->arenaCursor - (char*)(cache->arenaChunks + 1);
+	}
+
+	chunk->next = cache->arenaChunks;
+	chunk->size = chunkSize;
+	cache->arenaChunks = chunk;
+
+	char* memory = (char*)RoundUp((size_t)(chunk + 1), alignment);
+	cache->arenaCursor = memory + size;
+	cache->arenaEnd = (char*)chunk + chunkSize;
+	return memory;
+}
+
+void PhysicsAllocator::ReleaseArena(ThreadCache* cache)
+{
+	while (cache->arenaChunks != nullptr)
+	{
+		ArenaChunk* chunk = cache->arenaChunks;
+		cache->arenaChunks = chunk->next;
+		UnmapRegions(chunk, chunk->size);
+	}
+
+	cache->arenaCursor = nullptr;
+	cache->arenaEnd = nullptr;
+	cache->arenaUsedInFullChunks = 0;
+}
+
+void PhysicsAllocator::ResetFrame()
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+
+	uint64_t arenaBytes = 0;
+	for (ThreadCache* cache : caches)
+	{
+		if (cache->arenaChunks == nullptr)
+		{
+			continue;
+		}
+
+		const size_t used = cache->arenaUsedInFullChunks + (cache->arenaCursor - (char*)(cache->arenaChunks + 1));
+		arenaBytes += used;
+
+		if (cache->arenaChunks->next != nullptr)
+		{
+			// The frame spilled over several chunks: swap them for one that holds a whole frame.
+			ReleaseArena(cache);
+			if (ArenaAllocateSlow(cache, used, 16) == nullptr)
+			{
+				continue;
+			}
+		}
+		cache->arenaCursor = (char*)(cache->arenaChunks + 1);
+		cache->arenaUsedInFullChunks = 0;
+	}
+
+	frameArenaBytes = arenaBytes;
+	peakFrameArenaBytes = std::max(peakFrameArenaBytes, arenaBytes);
+	peakBytesInUse = std::max(peakBytesInUse, SumBytesInUse());
+}
+
+uint64_t PhysicsAllocator::SumBytesInUse() const
+{
+	// A block freed on another thread than the one that allocated it makes the per-cache
+	// differences wrap, but their sum is still right modulo 2^64.
+	uint64_t bytes = retiredBytesAllocated - retiredBytesFreed + largeBytesInUse.load(std::memory_order_relaxed);
+	for (const ThreadCache* cache : caches)
+	{
+		bytes += cache->bytesAllocated.load(std::memory_order_relaxed) - cache->bytesFreed.load(std::memory_order_relaxed);
+	}
+	return bytes;
+}
+
+PhysicsMemoryStats PhysicsAllocator::GetStats()
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+
+	PhysicsMemoryStats stats;
+	stats.bytesInUse = SumBytesInUse();
+	peakBytesInUse = std::max(peakBytesInUse, stats.bytesInUse);
+	stats.peakBytesInUse = peakBytesInUse;
+	stats.bytesReserved = bytesReserved.load(std::memory_order_relaxed);
+
+	stats.totalAllocations = retiredAllocations + largeAllocations.load(std::memory_order_relaxed);
+	stats.totalFrees = retiredFrees + largeFrees.load(std::memory_order_relaxed);
+	for (const ThreadCache* cache : caches)
+	{
+		stats.totalAllocations += cache->allocations.load(std::memory_order_relaxed);
+		stats.totalFrees += cache->frees.load(std::memory_order_relaxed);
+	}
+	stats.totalHeapAllocations = heapAllocations.load(std::memory_order_relaxed);
+
+	stats.frameArenaBytes = frameArenaBytes;
+	stats.peakFrameArenaBytes = peakFrameArenaBytes;
+	stats.hugePages = hugePagesActive.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void PhysicsAllocator::RetireThreadCache(ThreadCache* cache)
+{
+	for (int sizeClass = 0; sizeClass < CLASS_COUNT; ++sizeClass)
+	{
+		// Turn the rest of the slab into free blocks so another thread can use them.
+		const size_t classSize = GetClassSize(sizeClass);
+		while ((size_t)(cache->slabEnd[sizeClass] - cache->slabCursor[sizeClass]) >= classSize)
+		{
+			FreeBlock* block = (FreeBlock*)cache->slabCursor[sizeClass];
+			cache->slabCursor[sizeClass] += classSize;
+			block->next = cache->freeLists[sizeClass];
+			cache->freeLists[sizeClass] = block;
+			++cache->freeCounts[sizeClass];
+		}
+
+		while (cache->freeCounts[sizeClass] > 0)
+		{
+			PushBatch(cache, sizeClass, std::min(cache->freeCounts[sizeClass], BATCH_SIZE));
+		}
+	}
+
+	ReleaseArena(cache);
+
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		caches.erase(std::find(caches.begin(), caches.end(), cache));
+		retiredAllocations += cache->allocations.load(std::memory_order_relaxed);
+		retiredFrees += cache->frees.load(std::memory_order_relaxed);
+		retiredBytesAllocated += cache->bytesAllocated.load(std::memory_order_relaxed);
+		retiredBytesFreed += cache->bytesFreed.load(std::memory_order_relaxed);
+	}
+
+	delete cache;
+}
@@ -1 +1,638 @@
 #include "PhysicsManager.h"
+
+#include <algorithm>
+
+#include "ConsoleManager.h"
+#include "ProfilerManager.h"
+
+btEnterProfileZoneFunc* PhysicsManager::previousEnterZone = nullptr;
+
+btLeaveProfileZoneFunc* PhysicsManager::previousLeaveZone = nullptr;
+
+bool PhysicsSnapshot::GetInterpolatedTransform(PhysicsBodyHandle handle, btScalar alpha, btTransform& transform) const
+{
+	if (handle < 0 || handle >= (int)bodies.size() || !bodies[handle].valid)
+	{
+		return false;
+	}
+
+	const PhysicsBodyState& state = bodies[handle];
+	transform.setOrigin(state.previous.getOrigin().lerp(state.current.getOrigin(), alpha));
+	transform.setRotation(state.previous.getRotation().slerp(state.current.getRotation(), alpha));
+	return true;
+}
+
+PhysicsManager& PhysicsManager::GetInstance()
+{
+	static PhysicsManager instance;
+	return instance;
+}
+
+PhysicsManager::PhysicsManager()
+{
+	// Bodies can be created before Init(), so the allocator goes in before anything reaches Bullet.
+	PhysicsAllocator::GetInstance().Install();
+}
+
+PhysicsManager::~PhysicsManager()
+{
+	Shutdown();
+}
+
+bool PhysicsManager::Init(const PhysicsSettings& newSettings)
+{
+	if (world != nullptr || IsRunning())
+	{
+		console.Log("PhysicsManager::Init called after the world was created", API::PHYSICS, LEVEL::WARNING);
+		return false;
+	}
+
+	settings = newSettings;
+	settings.maxSubSteps = std::max(settings.maxSubSteps, 1);
+
+	if (!PhysicsMemory.SetHugePages(settings.hugePages))
+	{
+		console.Log("Huge pages are not available, the physics allocator uses normal pages", API::PHYSICS, LEVEL::WARNING);
+	}
+	return true;
+}
+
+void PhysicsManager::Start()
+{
+	if (IsRunning())
+	{
+		return;
+	}
+
+	running.store(true, std::memory_order_release);
+	simulationThread = std::thread(&PhysicsManager::SimulationLoop, this);
+}
+
+void PhysicsManager::Stop()
+{
+	running.store(false, std::memory_order_release);
+
+	if (simulationThread.joinable())
+	{
+		simulationThread.join();
+	}
+}
+
+void PhysicsManager::Shutdown()
+{
+	if (simulationThread.joinable())
+	{
+		Stop();
+	}
+	else
+	{
+		DestroyWorld();
+	}
+}
+
+void PhysicsManager::SimulationLoop()
+{
+	if (!CreateWorld())
+	{
+		return;
+	}
+
+	const std::chrono::duration<double> stepDuration(settings.fixedTimeStep);
+	std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+
+	while (running.load(std::memory_order_acquire))
+	{
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		Update(std::chrono::duration<double>(now - last).count());
+		last = now;
+
+		// Sleep until the accumulator holds a full step again.
+		const std::chrono::duration<double> untilNextStep = stepDuration - std::chrono::duration<double>(accumulator);
+		std::this_thread::sleep_until(now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(untilNextStep));
+	}
+
+	DestroyWorld();
+
+	// The workers are joined and this thread is about to exit, so the next simulation thread can take index 0.
+	btReleaseMainThreadIndex();
+}
+
+int PhysicsManager::Update(double elapsedSeconds)
+{
+	PROFILE_SCOPE("PhysicsManager::Update", API::PHYSICS);
+
+	if (world == nullptr && !CreateWorld())
+	{
+		return 0;
+	}
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	UpdateProfilingState(profilingRequested.load(std::memory_order_relaxed));
+	ApplyPendingCommands();
+
+	const double stepSeconds = settings.fixedTimeStep;
+	accumulator += elapsedSeconds;
+
+	// The tolerance absorbs the float rounding of fixedTimeStep, so a caller feeding exactly one step
+	// per update does not alternate between zero and two steps.
+	int steps = (int)(accumulator / stepSeconds + 1e-4);
+	if (steps > settings.maxSubSteps)
+	{
+		steps = settings.maxSubSteps;
+		accumulator = 0.0;
+	}
+	else
+	{
+		accumulator -= steps * stepSeconds;
+	}
+
+	for (int i = 0; i < steps; ++i)
+	{
+		if (i == steps - 1)
+		{
+			for (size_t handle = 0; handle < bodies.size(); ++handle)
+			{
+				if (bodies[handle] != nullptr)
+				{
+					previousTransforms[handle] = bodies[handle]->getWorldTransform();
+				}
+			}
+		}
+
+		// maxSubSteps = 0 makes Bullet take exactly one step of the given length.
+		world->stepSimulation(settings.fixedTimeStep, 0, settings.fixedTimeStep);
+		PhysicsMemory.ResetFrame();
+		++stepCount;
+	}
+
+	if (steps > 0)
+	{
+		PublishSnapshot(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), steps);
+	}
+
+	return steps;
+}
+
+bool PhysicsManager::CreateWorld()
+{
+	// btSetTaskScheduler and the Mt classes' per-thread arrays assume the stepping thread is Bullet thread 0.
+	if (btGetCurrentThreadIndex() != 0)
+	{
+		console.Log("The physics world must be stepped from the first thread that used Bullet's task scheduler, refusing to step", API::PHYSICS, LEVEL::ERRORS);
+		return false;
+	}
+
+	btITaskScheduler* scheduler = nullptr;
+	switch (settings.taskScheduler)
+	{
+	case TASK_SCHEDULER::DEFAULT:
+		taskScheduler = btCreateDefaultTaskScheduler();
+		scheduler = taskScheduler;
+		break;
+	case TASK_SCHEDULER::WORK_STEALING:
+		taskScheduler = btCreateWorkStealingTaskScheduler();
+		scheduler = taskScheduler;
+		break;
+	case TASK_SCHEDULER::SEQUENTIAL:
+		scheduler = btGetSequentialTaskScheduler();
+		break;
+	case TASK_SCHEDULER::OPENMP:
+		scheduler = btGetOpenMPTaskScheduler();
+		break;
+	case TASK_SCHEDULER::TBB:
+		scheduler = btGetTBBTaskScheduler();
+		break;
+	case TASK_SCHEDULER::PPL:
+		scheduler = btGetPPLTaskScheduler();
+		break;
+	}
+
+	if (scheduler == nullptr)
+	{
+		console.Log("The selected task scheduler is not available in this Bullet build, falling back to the sequential task scheduler", API::PHYSICS, LEVEL::WARNING);
+		scheduler = btGetSequentialTaskScheduler();
+	}
+	else if (settings.numThreads > 0)
+	{
+		scheduler->setNumThreads(std::min(settings.numThreads, scheduler->getMaxNumThreads()));
+	}
+	btSetTaskScheduler(scheduler);
+
+	// Update() rewinds the frame arenas after every step, so Bullet may only use them while the world exists.
+	btFrameAllocSetCustom(&PhysicsAllocator::AllocateFrame);
+
+	const int numThreads = btGetTaskScheduler()->getNumThreads();
+
+	// btCollisionDispatcherMt keeps its own growing per-thread pools, so the configuration's fixed ones stay unused
+	btDefaultCollisionConstructionInfo constructionInfo;
+	constructionInfo.m_defaultMaxPersistentManifoldPoolSize = 1;
+	constructionInfo.m_defaultMaxCollisionAlgorithmPoolSize = 1;
+	collisionConfiguration = new btDefaultCollisionConfiguration(constructionInfo);
+
+	dispatcher = new btCollisionDispatcherMt(collisionConfiguration);
+	dispatcher->setBatchedNarrowphase(settings.batchedNarrowphase);
+	if (settings.concurrentPairCache && settings.broadphase != BROADPHASE::DBVT)
+	{
+		btConcurrentOverlappingPairCache* concurrentPairCache = new btConcurrentOverlappingPairCache();
+		concurrentPairCache->setDeterministicOrder(true);
+		pairCache = concurrentPairCache;
+	}
+	if (settings.broadphase == BROADPHASE::SAP)
+	{
+		broadphase = new btSapBroadphaseMt(pairCache);
+	}
+	else if (settings.broadphase == BROADPHASE::GRID)
+	{
+		broadphase = new btGridBroadphaseMt(pairCache);
+	}
+	else
+	{
+		btDbvtBroadphaseMt* dbvtBroadphase = new btDbvtBroadphaseMt();
+		dbvtBroadphase->setParallelCollide(settings.parallelBroadphase);
+		broadphase = dbvtBroadphase;
+	}
+	solverPool = new btConstraintSolverPoolMt(numThreads);
+	if (settings.jacobiSolver)
+	{
+		solverMt = new btJacobiConstraintSolverMt();
+	}
+	else
+	{
+		solverMt = new btSequentialImpulseConstraintSolverMt();
+	}
+	btSequentialImpulseConstraintSolverMt::s_useIncrementalBatching = settings.incrementalBatching;
+
+	if (settings.pairEvents)
+	{
+		pairEventBuffer = new btPairEventBuffer();
+		dispatcher->setPairEventBuffer(pairEventBuffer);
+		broadphase->getOverlappingPairCache()->setPairEventCallback(pairEventBuffer);
+	}
+
+	world = new btDiscreteDynamicsWorldMt(dispatcher, broadphase, solverPool, solverMt, collisionConfiguration);
+	world->setGravity(settings.gravity);
+	world->getDispatchInfo().m_enableConvexCoherence = settings.convexCoherence;
+	world->getDispatchInfo().m_convexCoherenceContactMotion = settings.convexCoherenceContactMotion;
+	world->getDispatchInfo().m_concaveContactCapacity = settings.meshContactCapacity;
+	world->getDispatchInfo().m_enableTriangleQueryCache = settings.triangleQueryCache;
+
+	accumulator = 0.0;
+	stepCount = 0;
+
+	console.Log("Physics world created with the " + std::string(btGetTaskScheduler()->getName()) + " task scheduler and " + std::to_string(numThreads) + " threads", API::PHYSICS, LEVEL::INFO);
+	return true;
+}
+
+void PhysicsManager::DestroyWorld()
+{
+	{
+		std::lock_guard<std::mutex> lock(commandMutex);
+		for (std::pair<PhysicsBodyHandle, btRigidBody*>& create : pendingCreates)
+		{
+			delete create.second;
+		}
+		pendingCreates.clear();
+		pendingDestroys.clear();
+		freeHandles.clear();
+		nextHandle = 0;
+	}
+
+	if (world == nullptr)
+	{
+		return;
+	}
+
+	UpdateProfilingState(false);
+
+	for (btRigidBody* body : bodies)
+	{
+		if (body != nullptr)
+		{
+			world->removeRigidBody(body);
+			delete body;
+		}
+	}
+	bodies.clear();
+	previousTransforms.clear();
+
+	delete world;
+	world = nullptr;
+	delete solverMt;
+	solverMt = nullptr;
+	delete solverPool;
+	solverPool = nullptr;
+	delete broadphase;
+	broadphase = nullptr;
+	delete pairCache;
+	pairCache = nullptr;
+	delete pairEventBuffer;
+	pairEventBuffer = nullptr;
+	{
+		// The handles in the queued events are about to be reused.
+		std::lock_guard<std::mutex> lock(pairEventMutex);
+		pendingPairEvents.clear();
+	}
+	delete dispatcher;
+	dispatcher = nullptr;
+	delete collisionConfiguration;
+	collisionConfiguration = nullptr;
+
+	btFrameAllocSetCustom(nullptr);
+	btSetTaskScheduler(nullptr);
+	delete taskScheduler;
+	taskScheduler = nullptr;
+
+	// Every worker is joined, so a recreated scheduler numbers its workers from 1 again.
+	btResetThreadIndexCounter();
+}
+
+PhysicsBodyHandle PhysicsManager::CreateRigidBody(btCollisionShape* shape, btScalar mass, const btTransform& transform)
+{
+	btVector3 localInertia(0, 0, 0);
+	if (mass != btScalar(0))
+	{
+		shape->calculateLocalInertia(mass, localInertia);
+	}
+
+	// No motion state: the snapshot reads the world transforms directly after each update.
+	btRigidBody::btRigidBodyConstructionInfo info(mass, nullptr, shape, localInertia);
+	info.m_startWorldTransform = transform;
+	btRigidBody* body = new btRigidBody(info);
+
+	std::lock_guard<std::mutex> lock(commandMutex);
+
+	PhysicsBodyHandle handle;
+	if (!freeHandles.empty())
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+	}
+	else
+	{
+		handle = nextHandle++;
+	}
+
+	pendingCreates.emplace_back(handle, body);
+	return handle;
+}
+
+void PhysicsManager::DestroyRigidBody(PhysicsBodyHandle handle)
+{
+	if (handle == INVALID_BODY_HANDLE)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(commandMutex);
+	pendingDestroys.push_back(handle);
+}
+
+void PhysicsManager::ApplyPendingCommands()
+{
+	std::lock_guard<std::mutex> lock(commandMutex);
+
+	for (std::pair<PhysicsBodyHandle, btRigidBody*>& create : pendingCreates)
+	{
+		if (create.first >= (int)bodies.size())
+		{
+			bodies.resize(create.first + 1, nullptr);
+			previousTransforms.resize(create.first + 1);
+		}
+
+		// The user index is reserved for the handle, pair events identify the bodies by it.
+		create.second->setUserIndex(create.first);
+		bodies[create.first] = create.second;
+		previousTransforms[create.first] = create.second->getWorldTransform();
+		world->addRigidBody(create.second);
+	}
+	pendingCreates.clear();
+
+	for (PhysicsBodyHandle handle : pendingDestroys)
+	{
+		if (handle < 0 || handle >= (int)bodies.size() || bodies[handle] == nullptr)
+		{
+			continue;
+		}
+
+		world->removeRigidBody(bodies[handle]);
+		delete bodies[handle];
+		bodies[handle] = nullptr;
+		freeHandles.push_back(handle);
+	}
+	pendingDestroys.clear();
+}
+
+void PhysicsManager::PublishSnapshot(double updateMilliseconds, int steps)
+{
+	PhysicsSnapshot& snapshot = snapshots[backSnapshot];
+
+	snapshot.memory = PhysicsMemory.GetStats();
+
+	snapshot.profile.valid = profilingActive;
+	if (profilingActive)
+	{
+		CollectProfile(snapshot.profile, snapshot.memory, steps);
+	}
+
+	snapshot.bodies.resize(bodies.size());
+	for (size_t handle = 0; handle < bodies.size(); ++handle)
+	{
+		PhysicsBodyState& state = snapshot.bodies[handle];
+		state.valid = bodies[handle] != nullptr;
+		if (state.valid)
+		{
+			state.previous = previousTransforms[handle];
+			state.current = bodies[handle]->getWorldTransform();
+		}
+	}
+
+	if (pairEventBuffer != nullptr && pairEventBuffer->getNumEvents() > 0)
+	{
+		// Appended to a queue rather than the snapshot, which the reader may skip.
+		std::lock_guard<std::mutex> lock(pairEventMutex);
+		const size_t first = pendingPairEvents.size();
+		pendingPairEvents.resize(first + pairEventBuffer->getNumEvents());
+		for (int i = 0; i < pairEventBuffer->getNumEvents(); ++i)
+		{
+			const btPairEvent& event = pairEventBuffer->getEvent(i);
+			PhysicsPairEvent& pairEvent = pendingPairEvents[first + i];
+			pairEvent.type = event.m_type;
+			pairEvent.body0 = event.m_userIndex0;
+			pairEvent.body1 = event.m_userIndex1;
+		}
+		pairEventBuffer->clearEvents();
+	}
+
+	snapshot.stepCount = stepCount;
+	snapshot.publishTime = std::chrono::steady_clock::now();
+	snapshot.updateMilliseconds = updateMilliseconds;
+
+	backSnapshot = middleSnapshot.exchange(backSnapshot | SNAPSHOT_DIRTY, std::memory_order_acq_rel) & ~SNAPSHOT_DIRTY;
+}
+
+void PhysicsManager::UpdateProfilingState(bool requested)
+{
+	if (requested == profilingActive)
+	{
+		return;
+	}
+
+	// Between steps the workers are idle, so swapping the hooks and clearing their trees is safe here.
+	if (requested)
+	{
+		previousEnterZone = btGetCurrentEnterProfileZoneFunc();
+		previousLeaveZone = btGetCurrentLeaveProfileZoneFunc();
+		btSetCustomEnterProfileZoneFunc(&PhysicsManager::QuickprofEnterZone);
+		btSetCustomLeaveProfileZoneFunc(&PhysicsManager::QuickprofLeaveZone);
+
+		for (int thread = 0; thread < (int)BT_QUICKPROF_MAX_THREAD_COUNT; ++thread)
+		{
+			CProfileManager::Reset_Thread(thread);
+			profileIterators[thread] = CProfileManager::Get_Iterator(thread);
+		}
+		const PhysicsMemoryStats memory = PhysicsMemory.GetStats();
+		lastAlignedAllocs = memory.totalAllocations;
+		lastAlignedFrees = memory.totalFrees;
+		lastHeapAllocs = memory.totalHeapAllocations;
+		btConvexConvexAlgorithm::resetCoherenceStats();
+		btConvexConcaveCollisionAlgorithm::resetTriangleQueryCacheStats();
+	}
+	else
+	{
+		btSetCustomEnterProfileZoneFunc(previousEnterZone);
+		btSetCustomLeaveProfileZoneFunc(previousLeaveZone);
+
+		for (CProfileIterator*& iterator : profileIterators)
+		{
+			CProfileManager::Release_Iterator(iterator);
+			iterator = nullptr;
+		}
+	}
+
+	profilingActive = requested;
+}
+
+void PhysicsManager::QuickprofEnterZone(const char* name)
+{
+	CProfileManager::Start_Profile(name);
+	previousEnterZone(name);
+}
+
+void PhysicsManager::QuickprofLeaveZone()
+{
+	previousLeaveZone();
+	CProfileManager::Stop_Profile();
+}
+
+void PhysicsManager::CollectProfile(PhysicsProfile& profile, const PhysicsMemoryStats& memory, int steps)
+{
+	profile.scopeCount = 0;
+	profile.threadCount = std::min(btGetTaskScheduler()->getNumThreads(), (int)BT_QUICKPROF_MAX_THREAD_COUNT);
+	profile.steps = steps;
+
+	for (int thread = 0; thread < profile.threadCount; ++thread)
+	{
+		FlattenProfileScopes(profileIterators[thread], profile, -1, 0, thread);
+		CProfileManager::Reset_Thread(thread);
+	}
+
+	profile.alignedAllocs = memory.totalAllocations - lastAlignedAllocs;
+	profile.alignedFrees = memory.totalFrees - lastAlignedFrees;
+	profile.heapAllocs = memory.totalHeapAllocations - lastHeapAllocs;
+	lastAlignedAllocs = memory.totalAllocations;
+	lastAlignedFrees = memory.totalFrees;
+	lastHeapAllocs = memory.totalHeapAllocations;
+
+	profile.overlappingPairs = broadphase->getOverlappingPairCache()->getNumOverlappingPairs();
+	profile.manifolds = dispatcher->getNumManifolds();
+
+	btPoolAllocatorMtStats manifoldPool;
+	btPoolAllocatorMtStats algorithmPool;
+	dispatcher->getManifoldPoolMt().getStats(manifoldPool);
+	dispatcher->getCollisionAlgorithmPoolMt().getStats(algorithmPool);
+	profile.manifoldPoolHitRate = (float)manifoldPool.getHitRate();
+	profile.manifoldPoolCapacity = manifoldPool.m_capacity;
+	profile.algorithmPoolHitRate = (float)algorithmPool.getHitRate();
+	profile.algorithmPoolCapacity = algorithmPool.m_capacity;
+	profile.poolFallbacks = manifoldPool.m_fallbacks + algorithmPool.m_fallbacks;
+
+	btConvexCoherenceStats coherence;
+	btConvexConvexAlgorithm::getCoherenceStats(coherence);
+	btConvexConvexAlgorithm::resetCoherenceStats();
+	profile.convexQueries = coherence.m_queries;
+	profile.convexCoherenceHitRate = (float)coherence.getHitRate();
+
+	btTriangleQueryCacheStats triangleCache;
+	btConvexConcaveCollisionAlgorithm::getTriangleQueryCacheStats(triangleCache);
+	btConvexConcaveCollisionAlgorithm::resetTriangleQueryCacheStats();
+	profile.triangleQueries = triangleCache.m_queries;
+	profile.triangleCacheHitRate = (float)triangleCache.getHitRate();
+	profile.islands = static_cast<btSimulationIslandManagerMt*>(world->getSimulationIslandManager())->getNumActiveIslands();
+	profile.bodies = world->getNumCollisionObjects();
+}
+
+void PhysicsManager::FlattenProfileScopes(CProfileIterator* iterator, PhysicsProfile& profile, int parent, int depth, int thread)
+{
+	const int first = profile.scopeCount;
+
+	// Stop at the first child that does not fit, so every called child before childCount has a scope.
+	int childCount = 0;
+	for (iterator->First(); !iterator->Is_Done() && profile.scopeCount < PhysicsProfile::MAX_SCOPES; iterator->Next(), ++childCount)
+	{
+		if (iterator->Get_Current_Total_Calls() == 0)
+		{
+			continue;
+		}
+
+		PhysicsProfileScope& scope = profile.scopes[profile.scopeCount++];
+		scope.name = iterator->Get_Current_Name();
+		scope.parent = parent;
+		scope.depth = depth;
+		scope.thread = thread;
+		scope.milliseconds = iterator->Get_Current_Total_Time();
+		scope.calls = iterator->Get_Current_Total_Calls();
+	}
+
+	// Children are entered by position, so skip the uncalled ones the same way as above.
+	int scope = first;
+	for (int child = 0; child < childCount && profile.scopeCount < PhysicsProfile::MAX_SCOPES; ++child)
+	{
+		iterator->Enter_Child(child);
+		if (iterator->Get_Current_Parent_Total_Calls() != 0)
+		{
+			FlattenProfileScopes(iterator, profile, scope++, depth + 1, thread);
+		}
+		iterator->Enter_Parent();
+	}
+}
+
+const PhysicsSnapshot& PhysicsManager::AcquireSnapshot()
+{
+	if (middleSnapshot.load(std::memory_order_relaxed) & SNAPSHOT_DIRTY)
+	{
+		frontSnapshot = middleSnapshot.exchange(frontSnapshot, std::memory_order_acq_rel) & ~SNAPSHOT_DIRTY;
+	}
+
+	return snapshots[frontSnapshot];
+}
+
+void PhysicsManager::DrainPairEvents(std::vector<PhysicsPairEvent>& events)
+{
+	events.clear();
+
+	// Swapping hands the caller's emptied storage back to the queue, so neither side reallocates once warmed up.
+	std::lock_guard<std::mutex> lock(pairEventMutex);
+	events.swap(pendingPairEvents);
+}
+
+btScalar PhysicsManager::GetInterpolationAlpha(const PhysicsSnapshot& snapshot) const
+{
+	if (snapshot.stepCount == 0)
+	{
+		return btScalar(1);
+	}
+
+	const double sinceStep = std::chrono::duration<double>(std::chrono::steady_clock::now() - snapshot.publishTime).count();
+	return (btScalar)std::clamp(sinceStep / settings.fixedTimeStep, 0.0, 1.0);
+}
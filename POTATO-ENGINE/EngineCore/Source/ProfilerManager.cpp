@@ -0,0 +1,351 @@
+#include "ProfilerManager.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define POTATO_HAS_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define POTATO_HAS_TSC 1
+#endif
+
+namespace
+{
+	thread_local void* threadBuffer = nullptr;
+
+	const char* GetAPIName(API api)
+	{
+		switch (api)
+		{
+		case API::DX11: return "DX11";
+		case API::OPENGL: return "OPENGL";
+		case API::MAIN: return "MAIN";
+		case API::INPUT: return "INPUT";
+		case API::PHYSICS: return "PHYSICS";
+		case API::RENDERER: return "RENDERER";
+		case API::SHADER: return "SHADER";
+		case API::MODEL: return "MODEL";
+		case API::UI: return "UI";
+		default: return "UNKNOWN";
+		}
+	}
+
+	const int API_COUNT = (int)API::UI + 1;
+
+	/**
+	 * @brief Writes a string as a JSON string literal.
+	 */
+	void WriteJsonString(FILE* file, const char* text)
+	{
+		fputc('"', file);
+		for (const char* c = text; *c != '\0'; ++c)
+		{
+			if (*c == '"' || *c == '\\')
+			{
+				fputc('\\', file);
+				fputc(*c, file);
+			}
+			else if ((unsigned char)*c < 0x20)
+			{
+				fprintf(file, "\\u%04x", (unsigned char)*c);
+			}
+			else
+			{
+				fputc(*c, file);
+			}
+		}
+		fputc('"', file);
+	}
+}
+
+ProfilerManager& ProfilerManager::GetInstance()
+{
+	static ProfilerManager instance;
+	return instance;
+}
+
+ProfilerManager::ProfilerManager()
+{
+	referenceTime = std::chrono::steady_clock::now();
+	referenceTicks = ReadTicks();
+}
+
+ProfilerManager::~ProfilerManager()
+{
+	Disable();
+	for (std::atomic<ThreadBuffer*>& buffer : threads)
+	{
+		delete buffer.load(std::memory_order_acquire);
+	}
+}
+
+uint64_t ProfilerManager::ReadTicks()
+{
+#if defined(POTATO_HAS_TSC)
+	return __rdtsc();
+#else
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void ProfilerManager::Enable()
+{
+	if (enabled.exchange(true))
+	{
+		return;
+	}
+
+	previousEnterZone = btGetCurrentEnterProfileZoneFunc();
+	previousLeaveZone = btGetCurrentLeaveProfileZoneFunc();
+	btSetCustomEnterProfileZoneFunc(&ProfilerManager::BulletEnterZone);
+	btSetCustomLeaveProfileZoneFunc(&ProfilerManager::BulletLeaveZone);
+}
+
+void ProfilerManager::Disable()
+{
+	if (!enabled.exchange(false))
+	{
+		return;
+	}
+
+	btSetCustomEnterProfileZoneFunc(previousEnterZone);
+	btSetCustomLeaveProfileZoneFunc(previousLeaveZone);
+}
+
+void ProfilerManager::BulletEnterZone(const char* name)
+{
+	Profiler.BeginZone(name, API::PHYSICS);
+	Profiler.previousEnterZone(name);
+}
+
+void ProfilerManager::BulletLeaveZone()
+{
+	Profiler.previousLeaveZone();
+	Profiler.EndZone();
+}
+
+ProfilerManager::ThreadBuffer* ProfilerManager::GetThreadBuffer()
+{
+	if (threadBuffer != nullptr)
+	{
+		return static_cast<ThreadBuffer*>(threadBuffer);
+	}
+
+	const int slot = threadCount.fetch_add(1, std::memory_order_relaxed);
+	if (slot >= MAX_THREADS)
+	{
+		return nullptr;
+	}
+
+	ThreadBuffer* buffer = new ThreadBuffer;
+	snprintf(buffer->name, THREAD_NAME_SIZE, "Thread %d", slot);
+	threads[slot].store(buffer, std::memory_order_release);
+	threadBuffer = buffer;
+	return buffer;
+}
+
+void ProfilerManager::Record(const char* name, API api)
+{
+	ThreadBuffer* buffer = GetThreadBuffer();
+	if (buffer == nullptr)
+	{
+		return;
+	}
+
+	const uint64_t index = buffer->writeIndex.load(std::memory_order_relaxed);
+	ProfileEvent& event = buffer->events[index & (EVENTS_PER_THREAD - 1)];
+	event.ticks.store(ReadTicks(), std::memory_order_relaxed);
+	event.name.store(name, std::memory_order_relaxed);
+	event.api.store((uint8_t)api, std::memory_order_relaxed);
+	buffer->writeIndex.store(index + 1, std::memory_order_release);
+}
+
+void ProfilerManager::BeginZone(const char* name, API api)
+{
+	if (enabled.load(std::memory_order_relaxed))
+	{
+		Record(name, api);
+	}
+}
+
+void ProfilerManager::EndZone()
+{
+	// Not gated on enabled: a zone opened just before Disable() still needs its end mark.
+	Record(nullptr, API::MAIN);
+}
+
+void ProfilerManager::MarkFrame()
+{
+	const uint64_t frame = frameCount.load(std::memory_order_relaxed);
+	frameTicks[frame % MAX_FRAMES].store(ReadTicks(), std::memory_order_relaxed);
+	frameCount.store(frame + 1, std::memory_order_release);
+}
+
+void ProfilerManager::SetThreadName(const char* name)
+{
+	ThreadBuffer* buffer = GetThreadBuffer();
+	if (buffer != nullptr)
+	{
+		snprintf(buffer->name, THREAD_NAME_SIZE, "%s", name);
+	}
+}
+
+bool ProfilerManager::CaptureChromeTrace(const std::string& path, int requestedFrames)
+{
+	const uint64_t captureTicks = ReadTicks();
+	const std::chrono::steady_clock::time_point captureTime = std::chrono::steady_clock::now();
+
+	const double elapsedMicroseconds = std::chrono::duration<double, std::micro>(captureTime - referenceTime).count();
+	const double ticksPerMicrosecond = elapsedMicroseconds > 0.0 ? (double)(captureTicks - referenceTicks) / elapsedMicroseconds : 1.0;
+	auto toMicroseconds = [&](uint64_t ticks)
+	{
+		return (double)(int64_t)(ticks - referenceTicks) / ticksPerMicrosecond;
+	};
+
+	// The window starts at the oldest requested frame mark still held, or covers everything if there is none.
+	const uint64_t frames = frameCount.load(std::memory_order_acquire);
+	const uint64_t exported = std::min<uint64_t>({ (uint64_t)std::max(requestedFrames, 1), frames, MAX_FRAMES - 1 });
+	const uint64_t windowStart = exported > 0 ? frameTicks[(frames - exported) % MAX_FRAMES].load(std::memory_order_relaxed) : referenceTicks;
+
+	FILE* file = fopen(path.c_str(), "w");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	auto separator = [&]()
+	{
+		if (!first)
+		{
+			fprintf(file, ",\n");
+		}
+		first = false;
+	};
+
+	bool trackUsed[API_COUNT][MAX_THREADS] = {};
+
+	struct OpenZone
+	{
+		uint64_t ticks;
+		const char* name;
+		uint8_t api;
+	};
+	std::vector<OpenZone> stack;
+	std::vector<OpenZone> events(EVENTS_PER_THREAD);
+
+	const int registered = std::min(threadCount.load(std::memory_order_acquire), MAX_THREADS);
+	for (int tid = 0; tid < registered; ++tid)
+	{
+		ThreadBuffer* buffer = threads[tid].load(std::memory_order_acquire);
+		if (buffer == nullptr)
+		{
+			continue;
+		}
+
+		// Copy the ring, then drop whatever the owner may have overwritten while we were copying.
+		const uint64_t end = buffer->writeIndex.load(std::memory_order_acquire);
+		const uint64_t begin = end > EVENTS_PER_THREAD ? end - EVENTS_PER_THREAD : 0;
+		for (uint64_t i = begin; i < end; ++i)
+		{
+			const ProfileEvent& event = buffer->events[i & (EVENTS_PER_THREAD - 1)];
+			events[i - begin] = { event.ticks.load(std::memory_order_relaxed), event.name.load(std::memory_order_relaxed), event.api.load(std::memory_order_relaxed) };
+		}
+		const uint64_t endAfterCopy = buffer->writeIndex.load(std::memory_order_acquire);
+		const uint64_t firstValid = endAfterCopy >= EVENTS_PER_THREAD ? endAfterCopy - EVENTS_PER_THREAD + 1 : 0;
+		const uint64_t skipped = firstValid > begin ? std::min(firstValid - begin, end - begin) : 0;
+
+		auto writeZone = [&](const OpenZone& zone, uint64_t endTicks)
+		{
+			if (endTicks < windowStart)
+			{
+				return;
+			}
+
+			const uint64_t startTicks = std::max(zone.ticks, windowStart);
+			const int api = std::min<int>(zone.api, API_COUNT - 1);
+			trackUsed[api][tid] = true;
+
+			separator();
+			fprintf(file, "{\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"name\":", api, tid, toMicroseconds(startTicks), toMicroseconds(endTicks) - toMicroseconds(startTicks));
+			WriteJsonString(file, zone.name);
+			fprintf(file, "}");
+		};
+
+		// Pair the marks into complete events. An end mark whose begin was overwritten is dropped,
+		// zones still open at capture time end at the capture.
+		stack.clear();
+		for (uint64_t i = skipped; i < end - begin; ++i)
+		{
+			if (events[i].name != nullptr)
+			{
+				stack.push_back(events[i]);
+			}
+			else if (!stack.empty())
+			{
+				writeZone(stack.back(), events[i].ticks);
+				stack.pop_back();
+			}
+		}
+		while (!stack.empty())
+		{
+			writeZone(stack.back(), captureTicks);
+			stack.pop_back();
+		}
+	}
+
+	for (uint64_t frame = frames - exported; frame < frames; ++frame)
+	{
+		separator();
+		fprintf(file, "{\"ph\":\"i\",\"s\":\"g\",\"pid\":%d,\"tid\":0,\"ts\":%.3f,\"name\":\"Frame %llu\"}",
+			(int)API::MAIN, toMicroseconds(frameTicks[frame % MAX_FRAMES].load(std::memory_order_relaxed)), (unsigned long long)frame);
+	}
+
+	// Name the processes after the Console API categories and the tracks after the threads.
+	for (int api = 0; api < API_COUNT; ++api)
+	{
+		bool processUsed = false;
+		for (int tid = 0; tid < registered; ++tid)
+		{
+			if (!trackUsed[api][tid])
+			{
+				continue;
+			}
+			processUsed = true;
+			separator();
+			fprintf(file, "{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":", api, tid);
+			WriteJsonString(file, threads[tid].load(std::memory_order_acquire)->name);
+			fprintf(file, "}}");
+		}
+		if (processUsed)
+		{
+			separator();
+			fprintf(file, "{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\",\"args\":{\"name\":\"%s\"}}", api, GetAPIName((API)api));
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+
+	const bool written = ferror(file) == 0;
+	return fclose(file) == 0 && written;
+}
+
+ProfileScope::ProfileScope(const char* name, API api) : active(Profiler.IsEnabled())
+{
+	if (active)
+	{
+		Profiler.BeginZone(name, api);
+	}
+}
+
+ProfileScope::~ProfileScope()
+{
+	if (active)
+	{
+		Profiler.EndZone();
+	}
+}
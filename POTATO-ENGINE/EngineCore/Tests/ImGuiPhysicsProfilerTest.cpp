@@ -0,0 +1,89 @@
+#include "ImGuiPhysicsProfiler.h"
+#include "btUnitTest.h"
+
+#include "../../Libraries/imgui/imgui_internal.h"
+
+namespace
+{
+	const char* const PANEL_TITLE = "Physics Profiler";
+
+	/**
+	 * @brief Runs one ImGui frame without a renderer backend and returns the number of vertices it produced.
+	 */
+	int DrawFrame(ImGuiPhysicsProfiler& panel)
+	{
+		ImGuiIO& io = ImGui::GetIO();
+		io.DeltaTime = 1.0f / 60.0f;
+		ImGui::NewFrame();
+		ImGui::SetNextWindowSize(ImVec2(900, 700));
+		panel.Draw(PANEL_TITLE);
+		ImGui::Render();
+		return ImGui::GetDrawData()->TotalVtxCount;
+	}
+
+	/**
+	 * @brief Profiles a small world through the PhysicsManager and draws the panel from its snapshots.
+	 */
+	void TestDrawProfiledWorld()
+	{
+		ImGuiPhysicsProfiler& panel = ImGuiPhysicsProfiler::GetInstance();
+
+		// Before any profile the panel only shows a hint.
+		BT_CHECK(DrawFrame(panel) > 0);
+		BT_CHECK(ImGui::FindWindowByName(PANEL_TITLE) != nullptr);
+
+		PhysicsSettings settings;
+		settings.taskScheduler = TASK_SCHEDULER::SEQUENTIAL;
+		BT_CHECK(Physics.Init(settings));
+
+		btBoxShape ground(btVector3(20, 1, 20));
+		btBoxShape box(btVector3(btScalar(0.5), btScalar(0.5), btScalar(0.5)));
+		btTransform transform;
+		transform.setIdentity();
+		transform.setOrigin(btVector3(0, -1, 0));
+		Physics.CreateRigidBody(&ground, 0, transform);
+		for (int i = 0; i < 20; ++i)
+		{
+			transform.setOrigin(btVector3(btScalar(i % 4) * btScalar(1.1), btScalar(0.5 + i / 4), 0));
+			Physics.CreateRigidBody(&box, 1, transform);
+		}
+
+		Physics.SetProfilingEnabled(true);
+		int profiledFrames = 0;
+		int emptyFrames = 0;
+		for (int frame = 0; frame < 30; ++frame)
+		{
+			Physics.Update(settings.fixedTimeStep);
+			const PhysicsSnapshot& snapshot = Physics.AcquireSnapshot();
+			profiledFrames += snapshot.profile.valid && snapshot.profile.scopeCount > 0;
+
+			panel.Update(snapshot);
+			// A snapshot that was already recorded is ignored.
+			panel.Update(snapshot);
+			emptyFrames += DrawFrame(panel) == 0;
+		}
+		BT_CHECK(profiledFrames >= 29);
+		BT_CHECK(emptyFrames == 0);
+
+		Physics.Shutdown();
+	}
+}
+
+int main()
+{
+	ImGui::CreateContext();
+	ImGuiIO& io = ImGui::GetIO();
+	io.DisplaySize = ImVec2(1280, 720);
+	io.IniFilename = nullptr;
+
+	// No renderer: building the font atlas is enough for ImGui to lay out text.
+	unsigned char* pixels = nullptr;
+	int width = 0;
+	int height = 0;
+	io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+	TestDrawProfiledWorld();
+
+	ImGui::DestroyContext();
+	return btReportTest("ImGuiPhysicsProfilerTest");
+}
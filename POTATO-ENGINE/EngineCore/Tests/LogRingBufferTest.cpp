@@ -0,0 +1,254 @@
+#include "LogRingBuffer.h"
+#include "btUnitTest.h"
+
+#include <thread>
+#include <vector>
+
+namespace
+{
+	struct Entry
+	{
+		int producer = -1;
+
+		int sequence = -1;
+
+		int part = -1;
+	};
+
+	void TestCapacity()
+	{
+		BT_CHECK(LogRingBuffer<int>(0).Capacity() == 2);
+		BT_CHECK(LogRingBuffer<int>(3).Capacity() == 4);
+		BT_CHECK(LogRingBuffer<int>(1024).Capacity() == 1024);
+		BT_CHECK(LogRingBuffer<int>(1025).Capacity() == 2048);
+	}
+
+	void TestFullBuffer()
+	{
+		LogRingBuffer<int> buffer(8);
+		int next = 0;
+
+		for (int i = 0; i < 8; ++i)
+		{
+			BT_CHECK(buffer.TryPush([&](int& value) { value = next++; }));
+		}
+
+		bool filled = false;
+		BT_CHECK(!buffer.TryPush([&](int&) { filled = true; }));
+		BT_CHECK(!filled);
+		BT_CHECK(buffer.Claimed() == 8);
+
+		// Draining part of the buffer frees exactly that many slots, and the order survives the wrap.
+		std::vector<int> drained;
+		BT_CHECK(buffer.Drain([&](const int& value) { drained.push_back(value); }, 3) == 3);
+
+		for (int i = 0; i < 3; ++i)
+		{
+			BT_CHECK(buffer.TryPush([&](int& value) { value = next++; }));
+		}
+		BT_CHECK(!buffer.TryPush([](int&) {}));
+
+		BT_CHECK(buffer.Drain([&](const int& value) { drained.push_back(value); }, 100) == 8);
+		BT_CHECK(buffer.Drain([&](const int& value) { drained.push_back(value); }, 100) == 0);
+		BT_CHECK(buffer.Claimed() == 11);
+
+		BT_CHECK(drained.size() == 11);
+		for (size_t i = 0; i < drained.size(); ++i)
+		{
+			BT_CHECK(drained[i] == (int)i);
+		}
+	}
+
+	void TestRangeFullBuffer()
+	{
+		LogRingBuffer<int> buffer(8);
+
+		BT_CHECK(buffer.TryPushRange(0, [](int&, size_t) {}));
+		BT_CHECK(!buffer.TryPushRange(9, [](int&, size_t) {}));
+		BT_CHECK(buffer.TryPushRange(5, [](int& value, size_t index) { value = (int)index; }));
+
+		// Only three slots are left: a range of four is refused as a whole.
+		bool filled = false;
+		BT_CHECK(!buffer.TryPushRange(4, [&](int&, size_t) { filled = true; }));
+		BT_CHECK(!filled);
+		BT_CHECK(buffer.Claimed() == 5);
+
+		// Once the head is drained the range fits again, wrapping around the end of the storage.
+		std::vector<int> drained;
+		BT_CHECK(buffer.Drain([&](const int& value) { drained.push_back(value); }, 2) == 2);
+		BT_CHECK(buffer.TryPushRange(4, [](int& value, size_t index) { value = 10 + (int)index; }));
+		BT_CHECK(buffer.Drain([&](const int& value) { drained.push_back(value); }, 100) == 7);
+
+		const int expected[] = { 0, 1, 2, 3, 4, 10, 11, 12, 13 };
+		BT_CHECK(drained.size() == sizeof(expected) / sizeof(expected[0]));
+		for (size_t i = 0; i < drained.size() && i < sizeof(expected) / sizeof(expected[0]); ++i)
+		{
+			BT_CHECK(drained[i] == expected[i]);
+		}
+	}
+
+	/**
+	 * @brief Producers push ranges of varying length concurrently: the parts of a range must reach the
+	 * consumer back to back.
+	 */
+	void TestConcurrentRanges()
+	{
+		const int producerCount = 4;
+		const int rangesPerProducer = 20000;
+
+		LogRingBuffer<Entry> buffer(64);
+		std::vector<std::thread> producers;
+
+		for (int producer = 0; producer < producerCount; ++producer)
+		{
+			producers.emplace_back([&buffer, producer]()
+			{
+				for (int sequence = 0; sequence < rangesPerProducer; ++sequence)
+				{
+					const size_t parts = 1 + (size_t)(sequence % 8);
+					while (!buffer.TryPushRange(parts, [&](Entry& entry, size_t index)
+					{
+						entry.producer = producer;
+						entry.sequence = sequence;
+						entry.part = (int)(parts - 1 - index);
+					}))
+					{
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+
+		std::vector<int> nextSequence(producerCount, 0);
+		int openProducer = -1;
+		int openSequence = -1;
+		int expectedPart = -1;
+		int ranges = 0;
+		int errors = 0;
+
+		while (ranges < producerCount * rangesPerProducer)
+		{
+			const size_t count = buffer.Drain([&](const Entry& entry)
+			{
+				if (entry.producer < 0 || entry.producer >= producerCount)
+				{
+					++errors;
+					return;
+				}
+				if (openProducer < 0)
+				{
+					// First part of a range: parts count down to zero.
+					if (entry.sequence != nextSequence[entry.producer] || entry.part != entry.sequence % 8)
+					{
+						++errors;
+					}
+					openProducer = entry.producer;
+					openSequence = entry.sequence;
+					expectedPart = entry.part;
+				}
+				else if (entry.producer != openProducer || entry.sequence != openSequence || entry.part != expectedPart)
+				{
+					++errors;
+				}
+
+				if (--expectedPart < 0)
+				{
+					++nextSequence[openProducer];
+					openProducer = -1;
+					++ranges;
+				}
+			}, 256);
+
+			if (count == 0)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		for (std::thread& producer : producers)
+		{
+			producer.join();
+		}
+
+		BT_CHECK(errors == 0);
+		BT_CHECK(openProducer == -1);
+		for (int producer = 0; producer < producerCount; ++producer)
+		{
+			BT_CHECK(nextSequence[producer] == rangesPerProducer);
+		}
+	}
+
+	/**
+	 * @brief Producers race on a small buffer while the consumer drains it: nothing may be lost,
+	 * duplicated or reordered within a producer.
+	 */
+	void TestConcurrentProducers()
+	{
+		const int producerCount = 4;
+		const int entriesPerProducer = 100000;
+
+		LogRingBuffer<Entry> buffer(64);
+		std::vector<std::thread> producers;
+
+		for (int producer = 0; producer < producerCount; ++producer)
+		{
+			producers.emplace_back([&buffer, producer]()
+			{
+				for (int sequence = 0; sequence < entriesPerProducer; ++sequence)
+				{
+					while (!buffer.TryPush([&](Entry& entry) { entry.producer = producer; entry.sequence = sequence; }))
+					{
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+
+		std::vector<int> nextSequence(producerCount, 0);
+		int received = 0;
+		int errors = 0;
+
+		while (received < producerCount * entriesPerProducer)
+		{
+			const size_t count = buffer.Drain([&](const Entry& entry)
+			{
+				if (entry.producer < 0 || entry.producer >= producerCount || entry.sequence != nextSequence[entry.producer])
+				{
+					++errors;
+					return;
+				}
+				++nextSequence[entry.producer];
+			}, 256);
+
+			received += (int)count;
+			if (count == 0)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		for (std::thread& producer : producers)
+		{
+			producer.join();
+		}
+
+		BT_CHECK(errors == 0);
+		BT_CHECK(received == producerCount * entriesPerProducer);
+		BT_CHECK(buffer.Claimed() == (size_t)received);
+		BT_CHECK(buffer.Drain([](const Entry&) {}, 100) == 0);
+		for (int producer = 0; producer < producerCount; ++producer)
+		{
+			BT_CHECK(nextSequence[producer] == entriesPerProducer);
+		}
+	}
+}
+
+int main()
+{
+	TestCapacity();
+	TestFullBuffer();
+	TestConcurrentProducers();
+	TestRangeFullBuffer();
+	TestConcurrentRanges();
+	return btReportTest("LogRingBufferTest");
+}
@@ -0,0 +1,241 @@
+#include "PhysicsAllocator.h"
+#include "btUnitTest.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "LinearMath/btAlignedAllocator.h"
+
+namespace
+{
+	bool IsAligned(const void* memory, size_t alignment)
+	{
+		return ((uintptr_t)memory & (alignment - 1)) == 0;
+	}
+
+	/**
+	 * @brief True when no two blocks of (address, size) overlap.
+	 */
+	bool AreDisjoint(std::vector<std::pair<char*, size_t>> blocks)
+	{
+		std::sort(blocks.begin(), blocks.end());
+		for (size_t i = 1; i < blocks.size(); ++i)
+		{
+			if (blocks[i - 1].first + blocks[i - 1].second > blocks[i].first)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	size_t BlockSize(int thread, int index)
+	{
+		// Covers the 16-byte classes, the power of two classes and the large blocks.
+		static const size_t sizes[] = { 1, 16, 24, 100, 128, 129, 700, 4000, 8192, 9000 };
+		return sizes[(thread * 7 + index) % 10];
+	}
+
+	void TestSizes()
+	{
+		const PhysicsMemoryStats before = PhysicsMemory.GetStats();
+		const size_t sizes[] = { 0, 1, 15, 16, 17, 128, 129, 1000, 8191, 8192, 8193, 100000 };
+
+		std::vector<std::pair<char*, size_t>> blocks;
+		for (size_t size : sizes)
+		{
+			char* memory = (char*)PhysicsAllocator::Allocate(size);
+			BT_CHECK(memory != nullptr);
+			BT_CHECK(IsAligned(memory, 16));
+			std::memset(memory, 0xab, size);
+			blocks.emplace_back(memory, std::max<size_t>(size, 1));
+		}
+		BT_CHECK(AreDisjoint(blocks));
+
+		const PhysicsMemoryStats live = PhysicsMemory.GetStats();
+		BT_CHECK(live.totalAllocations - before.totalAllocations == blocks.size());
+		BT_CHECK(live.bytesInUse > before.bytesInUse);
+
+		for (const std::pair<char*, size_t>& block : blocks)
+		{
+			PhysicsAllocator::Free(block.first);
+		}
+		PhysicsAllocator::Free(nullptr);
+
+		const PhysicsMemoryStats after = PhysicsMemory.GetStats();
+		BT_CHECK(after.totalFrees - before.totalFrees == blocks.size());
+		BT_CHECK(after.bytesInUse == before.bytesInUse);
+	}
+
+	void TestBulletRouting()
+	{
+		const PhysicsMemoryStats before = PhysicsMemory.GetStats();
+
+		void* memory = btAlignedAlloc(200, 64);
+		BT_CHECK(memory != nullptr);
+		BT_CHECK(IsAligned(memory, 64));
+		BT_CHECK(PhysicsMemory.GetStats().totalAllocations == before.totalAllocations + 1);
+
+		btAlignedFree(memory);
+		BT_CHECK(PhysicsMemory.GetStats().bytesInUse == before.bytesInUse);
+	}
+
+	/**
+	 * @brief Every thread allocates blocks that the next thread checks and frees, so blocks
+	 * travel between the per-thread lists and the depot.
+	 */
+	void TestCrossThreadFree()
+	{
+		const int threadCount = 4;
+		const int blocksPerThread = 20000;
+		const PhysicsMemoryStats before = PhysicsMemory.GetStats();
+
+		std::vector<std::vector<char*>> blocks(threadCount);
+		std::vector<std::thread> threads;
+		for (int thread = 0; thread < threadCount; ++thread)
+		{
+			threads.emplace_back([&blocks, thread]()
+			{
+				for (int index = 0; index < blocksPerThread; ++index)
+				{
+					const size_t size = BlockSize(thread, index);
+					char* memory = (char*)PhysicsAllocator::Allocate(size);
+					std::memset(memory, thread * 31 + index, size);
+					blocks[thread].push_back(memory);
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		threads.clear();
+
+		std::vector<std::pair<char*, size_t>> allBlocks;
+		int misaligned = 0;
+		for (int thread = 0; thread < threadCount; ++thread)
+		{
+			for (int index = 0; index < blocksPerThread; ++index)
+			{
+				allBlocks.emplace_back(blocks[thread][index], BlockSize(thread, index));
+				misaligned += IsAligned(blocks[thread][index], 16) ? 0 : 1;
+			}
+		}
+		BT_CHECK(misaligned == 0);
+		BT_CHECK(AreDisjoint(allBlocks));
+
+		std::vector<int> corrupted(threadCount, 0);
+		for (int thread = 0; thread < threadCount; ++thread)
+		{
+			threads.emplace_back([&blocks, &corrupted, thread]()
+			{
+				const int owner = (thread + 1) % threadCount;
+				for (int index = 0; index < blocksPerThread; ++index)
+				{
+					const char* memory = blocks[owner][index];
+					const size_t size = BlockSize(owner, index);
+					for (size_t i = 0; i < size; ++i)
+					{
+						if (memory[i] != (char)(owner * 31 + index))
+						{
+							++corrupted[thread];
+							break;
+						}
+					}
+					PhysicsAllocator::Free(blocks[owner][index]);
+				}
+
+				// Reuse the blocks this thread just collected.
+				for (int index = 0; index < blocksPerThread; ++index)
+				{
+					PhysicsAllocator::Free(PhysicsAllocator::Allocate(BlockSize(owner, index)));
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		for (int thread = 0; thread < threadCount; ++thread)
+		{
+			BT_CHECK(corrupted[thread] == 0);
+		}
+
+		// The threads have exited and retired their caches: the counters must still balance.
+		const PhysicsMemoryStats after = PhysicsMemory.GetStats();
+		BT_CHECK(after.totalAllocations - before.totalAllocations == 2 * threadCount * blocksPerThread);
+		BT_CHECK(after.totalFrees - before.totalFrees == 2 * threadCount * blocksPerThread);
+		BT_CHECK(after.bytesInUse == before.bytesInUse);
+	}
+
+	void TestFrameArena()
+	{
+		const size_t alignments[] = { 16, 64, 4096 };
+		size_t requested = 0;
+
+		PhysicsMemory.ResetFrame();
+		char* first = (char*)PhysicsMemory.FrameAllocate(100);
+		BT_CHECK(first != nullptr && IsAligned(first, 16));
+		requested += 100;
+
+		std::vector<std::pair<char*, size_t>> blocks;
+		blocks.emplace_back(first, 100);
+		for (int i = 0; i < 30; ++i)
+		{
+			const size_t size = 1000 + i * 37;
+			const size_t alignment = alignments[i % 3];
+			char* memory = (char*)PhysicsMemory.FrameAllocate(size, alignment);
+			BT_CHECK(memory != nullptr && IsAligned(memory, alignment));
+			std::memset(memory, i, size);
+			blocks.emplace_back(memory, size);
+			requested += size;
+		}
+
+		// Larger than a chunk: spills into a chunk of its own.
+		char* large = (char*)PhysicsAllocator::AllocateFrame(size_t(3) << 20, 16);
+		BT_CHECK(large != nullptr);
+		std::memset(large, 1, size_t(3) << 20);
+		blocks.emplace_back(large, size_t(3) << 20);
+		requested += size_t(3) << 20;
+		BT_CHECK(AreDisjoint(blocks));
+
+		PhysicsMemory.ResetFrame();
+		PhysicsMemoryStats stats = PhysicsMemory.GetStats();
+		BT_CHECK(stats.frameArenaBytes >= requested);
+		BT_CHECK(stats.peakFrameArenaBytes >= stats.frameArenaBytes);
+
+		// After the spill the arena holds a whole frame in one chunk, which each reset rewinds.
+		char* rewound = (char*)PhysicsMemory.FrameAllocate(100);
+		PhysicsMemory.FrameAllocate(size_t(3) << 20);
+		PhysicsMemory.ResetFrame();
+		BT_CHECK(PhysicsMemory.FrameAllocate(100) == rewound);
+
+		PhysicsMemory.ResetFrame();
+		stats = PhysicsMemory.GetStats();
+		BT_CHECK(stats.frameArenaBytes >= 100 && stats.frameArenaBytes < requested);
+
+		// Each thread has an arena of its own.
+		std::thread thread([&]()
+		{
+			char* memory = (char*)PhysicsAllocator::AllocateFrame(256, 16);
+			BT_CHECK(memory != nullptr && memory != rewound);
+		});
+		thread.join();
+		PhysicsMemory.ResetFrame();
+	}
+}
+
+int main()
+{
+	PhysicsMemory.Install();
+
+	TestSizes();
+	TestBulletRouting();
+	TestCrossThreadFree();
+	TestFrameArena();
+	return btReportTest("PhysicsAllocatorTest");
+}
@@ -0,0 +1,153 @@
+#include "PhysicsManager.h"
+#include "btUnitTest.h"
+
+#include <chrono>
+#include <thread>
+
+namespace
+{
+	const btScalar SPHERE_RADIUS = btScalar(0.5);
+
+	btTransform At(btScalar x, btScalar y, btScalar z)
+	{
+		btTransform transform;
+		transform.setIdentity();
+		transform.setOrigin(btVector3(x, y, z));
+		return transform;
+	}
+
+	/**
+	 * @brief The dedicated simulation thread steps on its own and publishes snapshots the reader can pick up.
+	 */
+	void TestSimulationThread(btCollisionShape* ground, btCollisionShape* sphere)
+	{
+		PhysicsSettings settings;
+		settings.taskScheduler = TASK_SCHEDULER::SEQUENTIAL;
+		BT_CHECK(Physics.Init(settings));
+
+		Physics.CreateRigidBody(ground, 0, At(0, -1, 0));
+		const PhysicsBodyHandle body = Physics.CreateRigidBody(sphere, 1, At(0, 5, 0));
+		Physics.Start();
+		BT_CHECK(Physics.IsRunning());
+
+		const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		uint64_t stepCount = 0;
+		while (stepCount < 10 && std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			const PhysicsSnapshot& snapshot = Physics.AcquireSnapshot();
+			BT_CHECK(snapshot.stepCount >= stepCount);
+			stepCount = snapshot.stepCount;
+		}
+		BT_CHECK(stepCount >= 10);
+
+		const PhysicsSnapshot& snapshot = Physics.AcquireSnapshot();
+		btTransform transform;
+		BT_CHECK(snapshot.GetInterpolatedTransform(body, Physics.GetInterpolationAlpha(snapshot), transform));
+		BT_CHECK(transform.getOrigin().getY() < 5);
+
+		// Init is refused while the world exists.
+		BT_CHECK(!Physics.Init(settings));
+
+		Physics.Shutdown();
+		BT_CHECK(!Physics.IsRunning());
+		BT_CHECK(Physics.GetWorld() == nullptr);
+	}
+
+	/**
+	 * @brief A caller-owned loop: fixed steps, the sub-step cap, the snapshot contents and the handle lifecycle.
+	 */
+	void TestUpdate(btCollisionShape* ground, btCollisionShape* sphere)
+	{
+		PhysicsSettings settings;
+		settings.taskScheduler = TASK_SCHEDULER::SEQUENTIAL;
+		settings.maxSubSteps = 4;
+		settings.incrementalBatching = true;
+		BT_CHECK(Physics.Init(settings));
+
+		const PhysicsBodyHandle groundHandle = Physics.CreateRigidBody(ground, 0, At(0, -1, 0));
+		const PhysicsBodyHandle body = Physics.CreateRigidBody(sphere, 1, At(0, 5, 0));
+		BT_CHECK(groundHandle != body);
+
+		// The reader keeps the last snapshot of the previous world until the new one steps.
+		const uint64_t previousWorldSteps = Physics.AcquireSnapshot().stepCount;
+
+		// Less than a step creates the world and adds the bodies without stepping.
+		BT_CHECK(Physics.Update(settings.fixedTimeStep * 0.5) == 0);
+		BT_CHECK(Physics.GetWorld() != nullptr);
+		BT_CHECK(Physics.GetWorld()->getNumCollisionObjects() == 2);
+		BT_CHECK(Physics.AcquireSnapshot().stepCount == previousWorldSteps);
+		BT_CHECK(btSequentialImpulseConstraintSolverMt::s_useIncrementalBatching);
+
+		// The leftover half step carries over.
+		BT_CHECK(Physics.Update(settings.fixedTimeStep * 0.5) == 1);
+		{
+			const PhysicsSnapshot& snapshot = Physics.AcquireSnapshot();
+			BT_CHECK(snapshot.stepCount == 1);
+			BT_CHECK(snapshot.bodies.size() == 2);
+			BT_CHECK(snapshot.bodies[groundHandle].valid && snapshot.bodies[body].valid);
+
+			const PhysicsBodyState& state = snapshot.bodies[body];
+			BT_CHECK(state.previous.getOrigin().getY() == 5);
+			BT_CHECK(state.current.getOrigin().getY() < 5);
+
+			// Alpha 0 and 1 give back the previous and current transforms.
+			btTransform transform;
+			BT_CHECK(snapshot.GetInterpolatedTransform(body, 0, transform));
+			BT_CHECK(transform.getOrigin().getY() == state.previous.getOrigin().getY());
+			BT_CHECK(snapshot.GetInterpolatedTransform(body, 1, transform));
+			BT_CHECK(btFabs(transform.getOrigin().getY() - state.current.getOrigin().getY()) < btScalar(1e-6));
+			BT_CHECK(!snapshot.GetInterpolatedTransform(INVALID_BODY_HANDLE, 0, transform));
+			BT_CHECK(!snapshot.GetInterpolatedTransform(7, 0, transform));
+
+			const btScalar alpha = Physics.GetInterpolationAlpha(snapshot);
+			BT_CHECK(alpha >= 0 && alpha <= 1);
+		}
+
+		// A long frame is capped at maxSubSteps and the rest of the time is dropped.
+		BT_CHECK(Physics.Update(settings.fixedTimeStep * 10) == 4);
+		BT_CHECK(Physics.Update(0) == 0);
+		BT_CHECK(Physics.AcquireSnapshot().stepCount == 5);
+
+		// The sphere comes to rest on the ground, whose top is at y = 0.
+		for (int i = 0; i < 240; ++i)
+		{
+			Physics.Update(settings.fixedTimeStep);
+		}
+		{
+			const PhysicsSnapshot& snapshot = Physics.AcquireSnapshot();
+			BT_CHECK(snapshot.stepCount == 245);
+			BT_CHECK(btFabs(snapshot.bodies[body].current.getOrigin().getY() - SPHERE_RADIUS) < btScalar(0.05));
+		}
+
+		// Destroyed handles are invalid in the next snapshot and reused by the next body.
+		Physics.DestroyRigidBody(body);
+		Physics.Update(settings.fixedTimeStep);
+		BT_CHECK(!Physics.AcquireSnapshot().bodies[body].valid);
+		BT_CHECK(Physics.GetWorld()->getNumCollisionObjects() == 1);
+
+		const PhysicsBodyHandle reused = Physics.CreateRigidBody(sphere, 1, At(2, 5, 0));
+		BT_CHECK(reused == body);
+		Physics.Update(settings.fixedTimeStep);
+		{
+			const PhysicsSnapshot& snapshot = Physics.AcquireSnapshot();
+			BT_CHECK(snapshot.bodies[reused].valid);
+			BT_CHECK(snapshot.bodies[reused].current.getOrigin().getX() == 2);
+		}
+
+		Physics.Shutdown();
+		BT_CHECK(Physics.GetWorld() == nullptr);
+	}
+}
+
+int main()
+{
+	btBoxShape ground(btVector3(50, 1, 50));
+	btSphereShape sphere(SPHERE_RADIUS);
+
+	// The simulation thread has to be the first to use Bullet's task scheduler, so it runs before
+	// the main thread steps the world itself.
+	TestSimulationThread(&ground, &sphere);
+	TestUpdate(&ground, &sphere);
+	return btReportTest("PhysicsManagerTest");
+}
@@ -0,0 +1,19 @@
+#include "ConsoleManager.h"
+#include "HeadlessRunner.h"
+
+int main(int argc, char** argv)
+{
+    HeadlessSettings settings;
+    if (!HeadlessRunner::ParseArguments(argc, argv, settings))
+    {
+        console.Log("Usage: PotatoHeadless [--frames N] [--dt SECONDS] [--bodies N] [--sounds N] [--threads N] [--scheduler default|workstealing|sequential|openmp|tbb|ppl] [--huge-pages 0|1] [--broadphase dbvt|sap|grid] [--parallel-broadphase 0|1] [--concurrent-pairs 0|1] [--pair-events 0|1] [--batched-narrowphase 0|1] [--convex-coherence 0|1] [--out FILE.csv|FILE.json] [--trace FILE.json] [--trace-frames N]", API::MAIN, LEVEL::PRINT);
+        console.Flush();
+        return 2;
+    }
+
+    HeadlessRunner runner;
+    const int result = runner.Run(settings);
+
+    console.Flush();
+    return result;
+}
@@ -0,0 +1,544 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btConcurrentOverlappingPairCache.h"
+#include "btCollisionAlgorithm.h"
+#include "btDispatcher.h"
+#include "LinearMath/btQuickprof.h"
+
+#include <atomic>
+#include <new>
+
+static const int BT_PAIR_CACHE_MIN_SLOTS = 256;
+
+typedef btConcurrentOverlappingPairCache::btPairSlot btPairSlot;
+
+// the slots and the pair counter are plain data in the header and only accessed atomically here, as btSpinMutex does
+static SIMD_FORCE_INLINE std::atomic<unsigned long long>* btPairSlotKey(btPairSlot& slot)
+{
+	return reinterpret_cast<std::atomic<unsigned long long>*>(&slot.m_key);
+}
+
+static SIMD_FORCE_INLINE std::atomic<int>* btPairSlotIndex(btPairSlot& slot)
+{
+	return reinterpret_cast<std::atomic<int>*>(&slot.m_pairIndex);
+}
+
+// proxies must be ordered by uid, the larger uid is at least 1 so a key is never 0
+static SIMD_FORCE_INLINE unsigned long long btPairKey(const btBroadphaseProxy* proxy0, const btBroadphaseProxy* proxy1)
+{
+	return ((unsigned long long)(unsigned int)proxy0->getUid() << 32) | (unsigned int)proxy1->getUid();
+}
+
+struct btConcurrentPairCacheLoop : public btIParallelForBody
+{
+	btConcurrentOverlappingPairCache* m_pairCache;
+
+	btConcurrentPairCacheLoop(btConcurrentOverlappingPairCache* pairCache)
+		: m_pairCache(pairCache)
+	{
+	}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		m_pairCache->writeSlotIndices(iBegin, iEnd);
+	}
+};
+
+btConcurrentOverlappingPairCache::btConcurrentOverlappingPairCache()
+	: m_overlapFilterCallback(0),
+	  m_ghostPairCallback(0),
+	  m_pairEventCallback(0),
+	  m_numPairs(0),
+	  m_maxSlotClaims(0),
+	  m_numNewPairs(0),
+	  m_concurrentBegin(0),
+	  m_concurrent(false),
+	  m_deterministicOrder(false)
+{
+	btAssert(sizeof(std::atomic<unsigned long long>) == sizeof(unsigned long long));
+	btAssert(sizeof(std::atomic<int>) == sizeof(int));
+	rebuildTable(BT_PAIR_CACHE_MIN_SLOTS);
+}
+
+btConcurrentOverlappingPairCache::~btConcurrentOverlappingPairCache()
+{
+}
+
+void btConcurrentOverlappingPairCache::rebuildTable(int numSlots)
+{
+	btAssert(!m_concurrent);
+	btAssert((numSlots & (numSlots - 1)) == 0);
+	btPairSlot empty;
+	empty.m_key = 0;
+	empty.m_pairIndex = BT_PAIR_SLOT_PENDING;
+	empty.m_pad = 0;
+	m_slots.resizeNoInitialize(numSlots);
+	for (int i = 0; i < numSlots; ++i)
+	{
+		m_slots[i] = empty;
+	}
+	m_maxSlotClaims = numSlots / 4 * 3;
+
+	const int mask = numSlots - 1;
+	for (int i = 0; i < m_overlappingPairArray.size(); ++i)
+	{
+		const btBroadphasePair& pair = m_overlappingPairArray[i];
+		const unsigned long long key = btPairKey(pair.m_pProxy0, pair.m_pProxy1);
+		int slot = getHomeSlot(key);
+		while (m_slots[slot].m_key)
+		{
+			slot = (slot + 1) & mask;
+		}
+		m_slots[slot].m_key = key;
+		m_slots[slot].m_pairIndex = i;
+	}
+}
+
+int btConcurrentOverlappingPairCache::findSlot(unsigned long long key) const
+{
+	btPairSlot* slots = const_cast<btPairSlot*>(&m_slots[0]);
+	const int mask = m_slots.size() - 1;
+	int slot = getHomeSlot(key);
+	for (;;)
+	{
+		const unsigned long long slotKey = btPairSlotKey(slots[slot])->load(std::memory_order_acquire);
+		if (slotKey == key)
+		{
+			return slot;
+		}
+		if (slotKey == 0)
+		{
+			return -1;
+		}
+		slot = (slot + 1) & mask;
+	}
+}
+
+void btConcurrentOverlappingPairCache::removeSlot(int slot)
+{
+	// backward shift deletion: move later slots of the probe run into the hole unless that would put them before their home slot
+	const int mask = m_slots.size() - 1;
+	int hole = slot;
+	int next = slot;
+	for (;;)
+	{
+		next = (next + 1) & mask;
+		if (m_slots[next].m_key == 0)
+		{
+			break;
+		}
+		const int home = getHomeSlot(m_slots[next].m_key);
+		const bool stays = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+		if (!stays)
+		{
+			m_slots[hole] = m_slots[next];
+			hole = next;
+		}
+	}
+	m_slots[hole].m_key = 0;
+	m_slots[hole].m_pairIndex = BT_PAIR_SLOT_PENDING;
+}
+
+btBroadphasePair* btConcurrentOverlappingPairCache::findPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
+{
+	if (proxy0->m_uniqueId > proxy1->m_uniqueId)
+		btSwap(proxy0, proxy1);
+
+	const int slot = findSlot(btPairKey(proxy0, proxy1));
+	if (slot < 0)
+	{
+		return 0;
+	}
+	// the slot may have been claimed by another thread that has not written its pair yet
+	std::atomic<int>* pairIndex = btPairSlotIndex(m_slots[slot]);
+	int index;
+	while ((index = pairIndex->load(std::memory_order_acquire)) == BT_PAIR_SLOT_PENDING)
+	{
+	}
+	return index >= 0 ? &m_overlappingPairArray[index] : 0;
+}
+
+btBroadphasePair* btConcurrentOverlappingPairCache::addOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
+{
+	if (!needsBroadphaseCollision(proxy0, proxy1))
+		return 0;
+
+	if (proxy0->m_uniqueId > proxy1->m_uniqueId)
+		btSwap(proxy0, proxy1);
+
+	if (m_concurrent)
+	{
+		return concurrentAddPair(proxy0, proxy1);
+	}
+
+	const int numPairs = m_overlappingPairArray.size();
+	btBroadphasePair* pair = internalAddPair(proxy0, proxy1);
+	if (m_overlappingPairArray.size() != numPairs)
+	{
+		if (m_ghostPairCallback)
+			m_ghostPairCallback->addOverlappingPair(proxy0, proxy1);
+		if (m_pairEventCallback)
+			m_pairEventCallback->addOverlappingPair(proxy0, proxy1);
+	}
+	return pair;
+}
+
+btBroadphasePair* btConcurrentOverlappingPairCache::concurrentAddPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
+{
+	const unsigned long long key = btPairKey(proxy0, proxy1);
+	const int mask = m_slots.size() - 1;
+	std::atomic<int>* numPairs = reinterpret_cast<std::atomic<int>*>(&m_numPairs);
+	int slot = getHomeSlot(key);
+	for (;;)
+	{
+		std::atomic<unsigned long long>* slotKey = btPairSlotKey(m_slots[slot]);
+		unsigned long long currentKey = slotKey->load(std::memory_order_acquire);
+		if (currentKey == 0)
+		{
+			if (numPairs->load(std::memory_order_relaxed) >= m_maxSlotClaims)
+			{
+				// the table is as full as it may get, endConcurrentInsertion removes any duplicates
+				break;
+			}
+			if (slotKey->compare_exchange_strong(currentKey, key, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				std::atomic<int>* pairIndex = btPairSlotIndex(m_slots[slot]);
+				const int index = numPairs->fetch_add(1, std::memory_order_relaxed);
+				if (index < m_overlappingPairArray.size())
+				{
+					btBroadphasePair* pair = new (&m_overlappingPairArray[index]) btBroadphasePair(*proxy0, *proxy1);
+					pairIndex->store(index, std::memory_order_release);
+					return pair;
+				}
+				pairIndex->store(BT_PAIR_SLOT_DEFERRED, std::memory_order_release);
+				break;
+			}
+			// another thread claimed the slot, currentKey now holds its key
+		}
+		if (currentKey == key)
+		{
+			std::atomic<int>* pairIndex = btPairSlotIndex(m_slots[slot]);
+			int index;
+			while ((index = pairIndex->load(std::memory_order_acquire)) == BT_PAIR_SLOT_PENDING)
+			{
+			}
+			return index >= 0 ? &m_overlappingPairArray[index] : 0;
+		}
+		if (currentKey != 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	// no room left, keep the pair aside until endConcurrentInsertion
+	btMutexLock(&m_deferredMutex);
+	m_deferredPairs.push_back(btBroadphasePair(*proxy0, *proxy1));
+	btMutexUnlock(&m_deferredMutex);
+	return 0;
+}
+
+btBroadphasePair* btConcurrentOverlappingPairCache::internalAddPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
+{
+	btAssert(proxy0->m_uniqueId < proxy1->m_uniqueId);
+	const unsigned long long key = btPairKey(proxy0, proxy1);
+	const int mask = m_slots.size() - 1;
+	int slot = getHomeSlot(key);
+	while (m_slots[slot].m_key != key)
+	{
+		if (m_slots[slot].m_key == 0)
+		{
+			if ((m_overlappingPairArray.size() + 1) * 2 > m_slots.size())
+			{
+				rebuildTable(m_slots.size() * 2);
+				return internalAddPair(proxy0, proxy1);
+			}
+			m_slots[slot].m_key = key;
+			break;
+		}
+		slot = (slot + 1) & mask;
+	}
+	if (m_slots[slot].m_pairIndex >= 0)
+	{
+		return &m_overlappingPairArray[m_slots[slot].m_pairIndex];
+	}
+
+	// a new pair, or one kept aside during the concurrent phase
+	const int index = m_overlappingPairArray.size();
+	btBroadphasePair* pair = new (&m_overlappingPairArray.expandNonInitializing()) btBroadphasePair(*proxy0, *proxy1);
+	m_slots[slot].m_pairIndex = index;
+	return pair;
+}
+
+void* btConcurrentOverlappingPairCache::removeOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1, btDispatcher* dispatcher)
+{
+	btAssert(!m_concurrent);
+	if (proxy0->m_uniqueId > proxy1->m_uniqueId)
+		btSwap(proxy0, proxy1);
+
+	const int slot = findSlot(btPairKey(proxy0, proxy1));
+	if (slot < 0)
+	{
+		return 0;
+	}
+	const int pairIndex = m_slots[slot].m_pairIndex;
+	btAssert(pairIndex >= 0 && pairIndex < m_overlappingPairArray.size());
+	btBroadphasePair* pair = &m_overlappingPairArray[pairIndex];
+
+	cleanOverlappingPair(*pair, dispatcher);
+
+	void* userData = pair->m_internalInfo1;
+
+	removeSlot(slot);
+
+	if (m_ghostPairCallback)
+		m_ghostPairCallback->removeOverlappingPair(proxy0, proxy1, dispatcher);
+	if (m_pairEventCallback)
+		m_pairEventCallback->removeOverlappingPair(proxy0, proxy1, dispatcher);
+
+	// move the last pair into the freed place and point its slot there
+	const int lastPairIndex = m_overlappingPairArray.size() - 1;
+	if (pairIndex != lastPairIndex)
+	{
+		const btBroadphasePair& last = m_overlappingPairArray[lastPairIndex];
+		const int lastSlot = findSlot(btPairKey(last.m_pProxy0, last.m_pProxy1));
+		btAssert(lastSlot >= 0 && m_slots[lastSlot].m_pairIndex == lastPairIndex);
+		m_overlappingPairArray[pairIndex] = last;
+		m_slots[lastSlot].m_pairIndex = pairIndex;
+	}
+	m_overlappingPairArray.pop_back();
+
+	return userData;
+}
+
+void btConcurrentOverlappingPairCache::cleanOverlappingPair(btBroadphasePair& pair, btDispatcher* dispatcher)
+{
+	if (pair.m_algorithm && dispatcher)
+	{
+		pair.m_algorithm->~btCollisionAlgorithm();
+		dispatcher->freeCollisionAlgorithm(pair.m_algorithm);
+		pair.m_algorithm = 0;
+	}
+}
+
+void btConcurrentOverlappingPairCache::cleanProxyFromPairs(btBroadphaseProxy* proxy, btDispatcher* dispatcher)
+{
+	for (int i = 0; i < m_overlappingPairArray.size(); ++i)
+	{
+		btBroadphasePair& pair = m_overlappingPairArray[i];
+		if (pair.m_pProxy0 == proxy || pair.m_pProxy1 == proxy)
+		{
+			cleanOverlappingPair(pair, dispatcher);
+		}
+	}
+}
+
+void btConcurrentOverlappingPairCache::removeOverlappingPairsContainingProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher)
+{
+	class RemovePairCallback : public btOverlapCallback
+	{
+		btBroadphaseProxy* m_obsoleteProxy;
+
+	public:
+		RemovePairCallback(btBroadphaseProxy* obsoleteProxy)
+			: m_obsoleteProxy(obsoleteProxy)
+		{
+		}
+		virtual bool processOverlap(btBroadphasePair& pair)
+		{
+			return ((pair.m_pProxy0 == m_obsoleteProxy) ||
+					(pair.m_pProxy1 == m_obsoleteProxy));
+		}
+	};
+
+	RemovePairCallback removeCallback(proxy);
+
+	processAllOverlappingPairs(&removeCallback, dispatcher);
+}
+
+void btConcurrentOverlappingPairCache::processAllOverlappingPairs(btOverlapCallback* callback, btDispatcher* dispatcher)
+{
+	BT_PROFILE("btConcurrentOverlappingPairCache::processAllOverlappingPairs");
+	btAssert(!m_concurrent);
+	for (int i = 0; i < m_overlappingPairArray.size();)
+	{
+		btBroadphasePair* pair = &m_overlappingPairArray[i];
+		if (callback->processOverlap(*pair))
+		{
+			removeOverlappingPair(pair->m_pProxy0, pair->m_pProxy1, dispatcher);
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+void btConcurrentOverlappingPairCache::processAllOverlappingPairs(btOverlapCallback* callback, btDispatcher* dispatcher, const struct btDispatcherInfo& dispatchInfo)
+{
+	if (!dispatchInfo.m_deterministicOverlappingPairs)
+	{
+		processAllOverlappingPairs(callback, dispatcher);
+		return;
+	}
+
+	BT_PROFILE("btConcurrentOverlappingPairCache::processAllOverlappingPairs");
+	btAssert(!m_concurrent);
+	// visit the pairs by uid, looking each one up again since a removal moves the last pair
+	m_sortedPairs.copyFromArray(m_overlappingPairArray);
+	m_sortedPairs.quickSort(btBroadphasePairSortPredicate());
+	for (int i = 0; i < m_sortedPairs.size(); ++i)
+	{
+		btBroadphasePair* pair = findPair(m_sortedPairs[i].m_pProxy0, m_sortedPairs[i].m_pProxy1);
+		if (pair && callback->processOverlap(*pair))
+		{
+			removeOverlappingPair(pair->m_pProxy0, pair->m_pProxy1, dispatcher);
+		}
+	}
+}
+
+void btConcurrentOverlappingPairCache::sortOverlappingPairs(btDispatcher* dispatcher)
+{
+	(void)dispatcher;
+	btAssert(!m_concurrent);
+	m_overlappingPairArray.quickSort(btBroadphasePairSortPredicate());
+	rebuildTable(m_slots.size());
+}
+
+void btConcurrentOverlappingPairCache::beginConcurrentInsertion(int numNewPairs)
+{
+	BT_PROFILE("btConcurrentOverlappingPairCache::beginConcurrentInsertion");
+	btAssert(!m_concurrent);
+	m_concurrentBegin = m_overlappingPairArray.size();
+	const int capacity = m_concurrentBegin + btMax(numNewPairs, 0);
+
+	// keep the table at most half full with all the reserved pairs in it
+	int numSlots = m_slots.size();
+	while (numSlots < capacity * 2)
+	{
+		numSlots *= 2;
+	}
+	if (numSlots != m_slots.size())
+	{
+		rebuildTable(numSlots);
+	}
+
+	m_overlappingPairArray.resizeNoInitialize(capacity);
+	m_numPairs = m_concurrentBegin;
+	m_deferredPairs.resizeNoInitialize(0);
+	m_concurrent = true;
+}
+
+void btConcurrentOverlappingPairCache::endConcurrentInsertion()
+{
+	BT_PROFILE("btConcurrentOverlappingPairCache::endConcurrentInsertion");
+	btAssert(m_concurrent);
+	m_concurrent = false;
+	m_overlappingPairArray.resizeNoInitialize(btMin(m_numPairs, m_overlappingPairArray.size()));
+
+	if (m_deferredPairs.size())
+	{
+		BT_PROFILE("insertDeferredPairs");
+		const int capacity = m_overlappingPairArray.size() + m_deferredPairs.size();
+		int numSlots = m_slots.size();
+		while (numSlots < capacity * 2)
+		{
+			numSlots *= 2;
+		}
+		if (numSlots != m_slots.size())
+		{
+			rebuildTable(numSlots);
+		}
+		m_overlappingPairArray.reserve(capacity);
+		for (int i = 0; i < m_deferredPairs.size(); ++i)
+		{
+			internalAddPair(m_deferredPairs[i].m_pProxy0, m_deferredPairs[i].m_pProxy1);
+		}
+		m_deferredPairs.resizeNoInitialize(0);
+	}
+	m_numPairs = m_overlappingPairArray.size();
+	m_numNewPairs = m_numPairs - m_concurrentBegin;
+
+	if (m_deterministicOrder && m_numNewPairs > 1)
+	{
+		sortNewPairs(m_concurrentBegin);
+	}
+
+	for (int i = m_concurrentBegin; i < m_numPairs; ++i)
+	{
+		const btBroadphasePair& pair = m_overlappingPairArray[i];
+		if (m_ghostPairCallback)
+			m_ghostPairCallback->addOverlappingPair(pair.m_pProxy0, pair.m_pProxy1);
+		if (m_pairEventCallback)
+			m_pairEventCallback->addOverlappingPair(pair.m_pProxy0, pair.m_pProxy1);
+	}
+}
+
+void btConcurrentOverlappingPairCache::sortNewPairs(int pairBegin)
+{
+	BT_PROFILE("sortNewPairs");
+	const int numNewPairs = m_overlappingPairArray.size() - pairBegin;
+
+	// two stable passes, by the larger uid and then by the smaller one
+	m_sort.resize(numNewPairs);
+	unsigned int* keys = m_sort.getKeys();
+	int* values = m_sort.getValues();
+	for (int i = 0; i < numNewPairs; ++i)
+	{
+		keys[i] = (unsigned int)m_overlappingPairArray[pairBegin + i].m_pProxy1->getUid();
+		values[i] = i;
+	}
+	m_sort.sort();
+
+	m_sortOrder.resizeNoInitialize(numNewPairs);
+	for (int i = 0; i < numNewPairs; ++i)
+	{
+		m_sortOrder[i] = m_sort.getValues()[i];
+	}
+	m_sort.resize(numNewPairs);
+	keys = m_sort.getKeys();
+	values = m_sort.getValues();
+	for (int i = 0; i < numNewPairs; ++i)
+	{
+		keys[i] = (unsigned int)m_overlappingPairArray[pairBegin + m_sortOrder[i]].m_pProxy0->getUid();
+		values[i] = m_sortOrder[i];
+	}
+	m_sort.sort();
+
+	values = m_sort.getValues();
+	m_sortedPairs.resizeNoInitialize(numNewPairs);
+	for (int i = 0; i < numNewPairs; ++i)
+	{
+		m_sortedPairs[i] = m_overlappingPairArray[pairBegin + values[i]];
+	}
+	for (int i = 0; i < numNewPairs; ++i)
+	{
+		m_overlappingPairArray[pairBegin + i] = m_sortedPairs[i];
+	}
+
+	btConcurrentPairCacheLoop loop(this);
+	btParallelFor(pairBegin, m_overlappingPairArray.size(), 1000, loop);
+}
+
+void btConcurrentOverlappingPairCache::writeSlotIndices(int iBegin, int iEnd)
+{
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		const btBroadphasePair& pair = m_overlappingPairArray[i];
+		const int slot = findSlot(btPairKey(pair.m_pProxy0, pair.m_pProxy1));
+		btAssert(slot >= 0);
+		m_slots[slot].m_pairIndex = i;
+	}
+}
@@ -0,0 +1,200 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_CONCURRENT_OVERLAPPING_PAIR_CACHE_H
+#define BT_CONCURRENT_OVERLAPPING_PAIR_CACHE_H
+
+#include "btOverlappingPairCache.h"
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btParallelRadixSort.h"
+
+///The btConcurrentOverlappingPairCache is a hashed pair cache that several threads can add pairs to at the same time.
+///Pairs are found through an open addressing table with linear probing, where a slot is claimed by an atomic compare and swap
+///of the key made of the two proxy uids, starting at the same Thomas Wang hash as btHashedOverlappingPairCache.
+///Between beginConcurrentInsertion and endConcurrentInsertion, addOverlappingPair and findPair take no lock and can be called
+///from any thread; nothing else may be called. The table and the pair array are sized at beginConcurrentInsertion and never
+///grow in between; pairs beyond the reserved room are kept aside and inserted at endConcurrentInsertion, where the ghost pair
+///and pair event callbacks are also called for the new pairs. The new pairs are stored in the order the threads added them, unless
+///setDeterministicOrder is set, in which case endConcurrentInsertion sorts them by proxy uids.
+///Outside of the concurrent phase the cache behaves like btHashedOverlappingPairCache and grows as needed.
+///An overlap filter callback is called from several threads during the concurrent phase, so it must be thread safe.
+ATTRIBUTE_ALIGNED16(class)
+btConcurrentOverlappingPairCache : public btOverlappingPairCache
+{
+public:
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	btConcurrentOverlappingPairCache();
+	virtual ~btConcurrentOverlappingPairCache();
+
+	///makes room for numNewPairs pairs, after which addOverlappingPair and findPair can be called from any thread
+	void beginConcurrentInsertion(int numNewPairs);
+	///inserts the pairs that did not fit, calls the ghost pair and pair event callbacks for the new pairs and sorts them if requested
+	void endConcurrentInsertion();
+	bool isInConcurrentInsertion() const
+	{
+		return m_concurrent;
+	}
+	///number of pairs added during the last concurrent phase, a hint for the room to reserve at the next one
+	int getNumNewPairs() const
+	{
+		return m_numNewPairs;
+	}
+
+	///sort the pairs added during a concurrent phase by proxy uids, so their order does not depend on the threads
+	void setDeterministicOrder(bool deterministicOrder)
+	{
+		m_deterministicOrder = deterministicOrder;
+	}
+	bool getDeterministicOrder() const
+	{
+		return m_deterministicOrder;
+	}
+
+	virtual bool hasConcurrentInsertion() BT_OVERRIDE
+	{
+		return true;
+	}
+
+	// Add a pair and return the new pair. If the pair already exists,
+	// no new pair is created and the old one is returned.
+	// During the concurrent phase, returns 0 for a pair that is kept aside until endConcurrentInsertion.
+	virtual btBroadphasePair* addOverlappingPair(btBroadphaseProxy * proxy0, btBroadphaseProxy * proxy1) BT_OVERRIDE;
+	virtual btBroadphasePair* findPair(btBroadphaseProxy * proxy0, btBroadphaseProxy * proxy1) BT_OVERRIDE;
+
+	virtual void* removeOverlappingPair(btBroadphaseProxy * proxy0, btBroadphaseProxy * proxy1, btDispatcher * dispatcher) BT_OVERRIDE;
+	virtual void removeOverlappingPairsContainingProxy(btBroadphaseProxy * proxy, btDispatcher * dispatcher) BT_OVERRIDE;
+	virtual void cleanProxyFromPairs(btBroadphaseProxy * proxy, btDispatcher * dispatcher) BT_OVERRIDE;
+	virtual void cleanOverlappingPair(btBroadphasePair & pair, btDispatcher * dispatcher) BT_OVERRIDE;
+
+	virtual void processAllOverlappingPairs(btOverlapCallback*, btDispatcher * dispatcher) BT_OVERRIDE;
+	virtual void processAllOverlappingPairs(btOverlapCallback * callback, btDispatcher * dispatcher, const struct btDispatcherInfo& dispatchInfo) BT_OVERRIDE;
+
+	virtual void sortOverlappingPairs(btDispatcher * dispatcher) BT_OVERRIDE;
+
+	virtual bool needsBroadphaseCollision(btBroadphaseProxy * proxy0, btBroadphaseProxy * proxy1) const BT_OVERRIDE
+	{
+		if (m_overlapFilterCallback)
+			return m_overlapFilterCallback->needBroadphaseCollision(proxy0, proxy1);
+
+		bool collides = (proxy0->m_collisionFilterGroup & proxy1->m_collisionFilterMask) != 0;
+		collides = collides && (proxy1->m_collisionFilterGroup & proxy0->m_collisionFilterMask);
+
+		return collides;
+	}
+
+	virtual btBroadphasePair* getOverlappingPairArrayPtr() BT_OVERRIDE
+	{
+		return m_overlappingPairArray.size() ? &m_overlappingPairArray[0] : 0;
+	}
+	virtual const btBroadphasePair* getOverlappingPairArrayPtr() const BT_OVERRIDE
+	{
+		return m_overlappingPairArray.size() ? &m_overlappingPairArray[0] : 0;
+	}
+	///during the concurrent phase the array also holds the reserved room, use getNumOverlappingPairs for the pair count
+	virtual btBroadphasePairArray& getOverlappingPairArray() BT_OVERRIDE
+	{
+		return m_overlappingPairArray;
+	}
+	virtual int getNumOverlappingPairs() const BT_OVERRIDE
+	{
+		return m_concurrent ? btMin(m_numPairs, m_overlappingPairArray.size()) : m_overlappingPairArray.size();
+	}
+
+	virtual btOverlapFilterCallback* getOverlapFilterCallback() BT_OVERRIDE
+	{
+		return m_overlapFilterCallback;
+	}
+	virtual void setOverlapFilterCallback(btOverlapFilterCallback * callback) BT_OVERRIDE
+	{
+		m_overlapFilterCallback = callback;
+	}
+
+	virtual bool hasDeferredRemoval() BT_OVERRIDE
+	{
+		return false;
+	}
+	virtual void setInternalGhostPairCallback(btOverlappingPairCallback * ghostPairCallback) BT_OVERRIDE
+	{
+		m_ghostPairCallback = ghostPairCallback;
+	}
+	virtual void setPairEventCallback(btOverlappingPairCallback * pairEventCallback) BT_OVERRIDE
+	{
+		m_pairEventCallback = pairEventCallback;
+	}
+
+	///slot of the hash table, a key of 0 is an empty slot
+	struct btPairSlot
+	{
+		unsigned long long m_key;  // smaller proxy uid in the high 32 bits, larger in the low 32 bits
+		int m_pairIndex;           // BT_PAIR_SLOT_PENDING until the pair is written, BT_PAIR_SLOT_DEFERRED while it is kept aside
+		int m_pad;
+	};
+
+	enum
+	{
+		BT_PAIR_SLOT_PENDING = -1,
+		BT_PAIR_SLOT_DEFERRED = -2,
+	};
+
+	void writeSlotIndices(int iBegin, int iEnd);
+
+private:
+	btBroadphasePair* internalAddPair(btBroadphaseProxy * proxy0, btBroadphaseProxy * proxy1);
+	btBroadphasePair* concurrentAddPair(btBroadphaseProxy * proxy0, btBroadphaseProxy * proxy1);
+	int findSlot(unsigned long long key) const;
+	void removeSlot(int slot);
+	void rebuildTable(int numSlots);
+	void sortNewPairs(int pairBegin);
+
+	SIMD_FORCE_INLINE unsigned int getHash(unsigned int proxyId1, unsigned int proxyId2) const
+	{
+		unsigned int key = proxyId1 | (proxyId2 << 16);
+		// Thomas Wang's hash
+
+		key += ~(key << 15);
+		key ^= (key >> 10);
+		key += (key << 3);
+		key ^= (key >> 6);
+		key += ~(key << 11);
+		key ^= (key >> 16);
+		return key;
+	}
+
+	SIMD_FORCE_INLINE int getHomeSlot(unsigned long long key) const
+	{
+		return int(getHash((unsigned int)(key >> 32), (unsigned int)(key)) & (unsigned int)(m_slots.size() - 1));
+	}
+
+	btBroadphasePairArray m_overlappingPairArray;
+	btAlignedObjectArray<btPairSlot> m_slots;  // power of two size, at most half full
+	btOverlapFilterCallback* m_overlapFilterCallback;
+	btOverlappingPairCallback* m_ghostPairCallback;
+	btOverlappingPairCallback* m_pairEventCallback;
+	int m_numPairs;        // atomic counter of the slots claimed during the concurrent phase
+	int m_maxSlotClaims;  // past this many claims new pairs are kept aside, so the table never fills up
+	int m_numNewPairs;
+	int m_concurrentBegin;  // pair count at beginConcurrentInsertion
+	bool m_concurrent;
+	bool m_deterministicOrder;
+	btSpinMutex m_deferredMutex;
+	btAlignedObjectArray<btBroadphasePair> m_deferredPairs;  // pairs that did not fit in the reserved room
+	btParallelRadixSort m_sort;
+	btAlignedObjectArray<int> m_sortOrder;
+	btBroadphasePairArray m_sortedPairs;
+};
+
+#endif  //BT_CONCURRENT_OVERLAPPING_PAIR_CACHE_H
@@ -565,18 +565,9 @@ void btDbvtBroadphase::collide(btDispatcher* dispatcher)
 		m_needcleanup = true;
 	}
 	/* collide dynamics		*/
+	if (m_deferedcollide)
 	{
-		btDbvtTreeCollider collider(this);
-		if (m_deferedcollide)
-		{
-			SPC(m_profiling.m_fdcollide);
-			m_sets[0].collideTTpersistentStack(m_sets[0].m_root, m_sets[1].m_root, collider);
-		}
-		if (m_deferedcollide)
-		{
-			SPC(m_profiling.m_ddcollide);
-			m_sets[0].collideTTpersistentStack(m_sets[0].m_root, m_sets[0].m_root, collider);
-		}
+		collideDeferred();
 	}
 	/* clean up				*/
 	if (m_needcleanup)
@@ -623,6 +614,20 @@ void btDbvtBroadphase::collide(btDispatcher* dispatcher)
 	m_updates_call /= 2;
 }
 
+//
+void btDbvtBroadphase::collideDeferred()
+{
+	btDbvtTreeCollider collider(this);
+	{
+		SPC(m_profiling.m_fdcollide);
+		m_sets[0].collideTTpersistentStack(m_sets[0].m_root, m_sets[1].m_root, collider);
+	}
+	{
+		SPC(m_profiling.m_ddcollide);
+		m_sets[0].collideTTpersistentStack(m_sets[0].m_root, m_sets[0].m_root, collider);
+	}
+}
+
 //
 void btDbvtBroadphase::optimize()
 {
@@ -104,6 +104,8 @@ struct btDbvtBroadphase : btBroadphaseInterface
 	btDbvtBroadphase(btOverlappingPairCache* paircache = 0);
 	~btDbvtBroadphase();
 	void collide(btDispatcher* dispatcher);
+	///collides the dynamic set against both sets when the collision of moved proxies is deferred to collide
+	virtual void collideDeferred();
 	void optimize();
 
 	/* btBroadphaseInterface Implementation	*/
@@ -0,0 +1,332 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btDbvtBroadphaseMt.h"
+#include "LinearMath/btQuickprof.h"
+
+static void btRefitDbvtSubtree(btDbvtNode* node)
+{
+	if (node->isinternal())
+	{
+		btRefitDbvtSubtree(node->childs[0]);
+		btRefitDbvtSubtree(node->childs[1]);
+		Merge(node->childs[0]->volume, node->childs[1]->volume, node->volume);
+	}
+}
+
+struct btDbvtCollideTasksLoop : public btIParallelForBody
+{
+	btDbvtBroadphaseMt* m_broadphase;
+
+	btDbvtCollideTasksLoop(btDbvtBroadphaseMt* broadphase)
+		: m_broadphase(broadphase)
+	{
+	}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			m_broadphase->collideTask(i);
+		}
+	}
+};
+
+btDbvtBroadphaseMt::btDbvtBroadphaseMt(btOverlappingPairCache* paircache)
+	: btDbvtBroadphase(paircache)
+{
+	m_parallelCollide = false;
+	m_needrefit = false;
+	m_taskCount = 128;
+	m_rebuildThreshold = 10;
+	m_bulkUpdates = 0;
+	m_threadPairs.resize(BT_MAX_THREAD_COUNT);
+	m_threadStacks.resize(BT_MAX_THREAD_COUNT);
+	setParallelCollide(true);
+}
+
+void btDbvtBroadphaseMt::setParallelCollide(bool parallel)
+{
+	if (m_needrefit)
+	{
+		btRefitDbvtSubtree(m_sets[0].m_root);
+		m_needrefit = false;
+	}
+	m_parallelCollide = parallel;
+	m_deferedcollide = parallel;
+	m_bulkUpdates = 0;
+}
+
+btBroadphaseProxy* btDbvtBroadphaseMt::createProxy(const btVector3& aabbMin,
+												   const btVector3& aabbMax,
+												   int shapeType,
+												   void* userPtr,
+												   int collisionFilterGroup,
+												   int collisionFilterMask,
+												   btDispatcher* dispatcher)
+{
+	++m_bulkUpdates;
+	return btDbvtBroadphase::createProxy(aabbMin, aabbMax, shapeType, userPtr, collisionFilterGroup, collisionFilterMask, dispatcher);
+}
+
+void btDbvtBroadphaseMt::setAabb(btBroadphaseProxy* absproxy,
+								 const btVector3& aabbMin,
+								 const btVector3& aabbMax,
+								 btDispatcher* dispatcher)
+{
+	btDbvtProxy* proxy = (btDbvtProxy*)absproxy;
+	ATTRIBUTE_ALIGNED16(btDbvtVolume)
+	aabb = btDbvtVolume::FromMM(aabbMin, aabbMax);
+	if (proxy->stage == STAGECOUNT || !Intersect(proxy->leaf->volume, aabb))
+	{
+		// inserted into the dynamic set by btDbvtBroadphase::setAabb
+		++m_bulkUpdates;
+	}
+	else if (m_parallelCollide)
+	{
+		btDbvtNode* leaf = proxy->leaf;
+		if (!leaf->volume.Contain(aabb))
+		{
+			// enlarge the leaf the way btDbvt::update would, but leave its parents to refitDynamicSet
+			const btVector3 delta = aabbMin - proxy->m_aabbMin;
+			btVector3 velocity(((proxy->m_aabbMax - proxy->m_aabbMin) / 2) * m_prediction);
+			if (delta[0] < 0) velocity[0] = -velocity[0];
+			if (delta[1] < 0) velocity[1] = -velocity[1];
+			if (delta[2] < 0) velocity[2] = -velocity[2];
+			aabb.Expand(btVector3(gDbvtMargin, gDbvtMargin, gDbvtMargin));
+			aabb.SignedExpand(velocity);
+			leaf->volume = aabb;
+			m_needrefit = true;
+			m_needcleanup = true;
+			++m_updates_done;
+		}
+	}
+	// the leaf now contains the box unless the proxy is fixed or teleported, which still takes the serial path
+	btDbvtBroadphase::setAabb(absproxy, aabbMin, aabbMax, dispatcher);
+}
+
+void btDbvtBroadphaseMt::rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	// queries between setAabb and collide refit on the calling thread
+	if (m_needrefit)
+	{
+		btRefitDbvtSubtree(m_sets[0].m_root);
+		m_needrefit = false;
+	}
+	btDbvtBroadphase::rayTest(rayFrom, rayTo, rayCallback, aabbMin, aabbMax);
+}
+
+void btDbvtBroadphaseMt::aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback)
+{
+	if (m_needrefit)
+	{
+		btRefitDbvtSubtree(m_sets[0].m_root);
+		m_needrefit = false;
+	}
+	btDbvtBroadphase::aabbTest(aabbMin, aabbMax, callback);
+}
+
+void btDbvtBroadphaseMt::refitDynamicSet()
+{
+	BT_PROFILE("refitDynamicSet");
+	m_needrefit = false;
+	m_builder.setTaskCount(m_taskCount);
+	m_builder.refit(m_sets[0].m_root);
+}
+
+void btDbvtBroadphaseMt::rebuildTrees()
+{
+	BT_PROFILE("rebuildTrees");
+	m_builder.setTaskCount(m_taskCount);
+	m_builder.build(m_sets[0]);
+	m_builder.build(m_sets[1]);
+	m_needrefit = false;
+	m_bulkUpdates = 0;
+	m_fixedleft = 0;
+}
+
+void btDbvtBroadphaseMt::collideDeferred()
+{
+	if (!m_parallelCollide)
+	{
+		btDbvtBroadphase::collideDeferred();
+		return;
+	}
+
+	if (m_sets[0].m_leaves > 1 && m_bulkUpdates * 100 > m_sets[0].m_leaves * m_rebuildThreshold)
+	{
+		// after a bulk change the incremental optimization would take many steps to recover the tree
+		m_builder.setTaskCount(m_taskCount);
+		m_builder.build(m_sets[0]);
+		m_needrefit = false;
+	}
+	else if (m_needrefit)
+	{
+		refitDynamicSet();
+	}
+	m_bulkUpdates = 0;
+
+	BT_PROFILE("collideDeferredMt");
+	const btDbvtNode* dynamicRoot = m_sets[0].m_root;
+	const btDbvtNode* fixedRoot = m_sets[1].m_root;
+	m_tasks.resize(0);
+	if (dynamicRoot)
+	{
+		if (fixedRoot)
+		{
+			m_tasks.push_back(btDbvt::sStkNN(dynamicRoot, fixedRoot));
+		}
+		m_tasks.push_back(btDbvt::sStkNN(dynamicRoot, dynamicRoot));
+	}
+
+	// split the traversal breadth first, following collideTTpersistentStack, until there are enough tasks.
+	// Node pairs that cannot overlap are dropped on the way
+	bool split = true;
+	while (split && m_tasks.size() > 0 && m_tasks.size() < m_taskCount)
+	{
+		split = false;
+		m_splitTasks.resize(0);
+		for (int i = 0; i < m_tasks.size(); ++i)
+		{
+			const btDbvt::sStkNN p = m_tasks[i];
+			if (p.a == p.b)
+			{
+				if (p.a->isinternal())
+				{
+					m_splitTasks.push_back(btDbvt::sStkNN(p.a->childs[0], p.a->childs[0]));
+					m_splitTasks.push_back(btDbvt::sStkNN(p.a->childs[1], p.a->childs[1]));
+					m_splitTasks.push_back(btDbvt::sStkNN(p.a->childs[0], p.a->childs[1]));
+					split = true;
+				}
+			}
+			else if (Intersect(p.a->volume, p.b->volume))
+			{
+				if (p.a->isinternal())
+				{
+					if (p.b->isinternal())
+					{
+						m_splitTasks.push_back(btDbvt::sStkNN(p.a->childs[0], p.b->childs[0]));
+						m_splitTasks.push_back(btDbvt::sStkNN(p.a->childs[1], p.b->childs[0]));
+						m_splitTasks.push_back(btDbvt::sStkNN(p.a->childs[0], p.b->childs[1]));
+						m_splitTasks.push_back(btDbvt::sStkNN(p.a->childs[1], p.b->childs[1]));
+					}
+					else
+					{
+						m_splitTasks.push_back(btDbvt::sStkNN(p.a->childs[0], p.b));
+						m_splitTasks.push_back(btDbvt::sStkNN(p.a->childs[1], p.b));
+					}
+					split = true;
+				}
+				else if (p.b->isinternal())
+				{
+					m_splitTasks.push_back(btDbvt::sStkNN(p.a, p.b->childs[0]));
+					m_splitTasks.push_back(btDbvt::sStkNN(p.a, p.b->childs[1]));
+					split = true;
+				}
+				else
+				{
+					m_splitTasks.push_back(p);
+				}
+			}
+		}
+		m_tasks.copyFromArray(m_splitTasks);
+	}
+
+	const int numTasks = m_tasks.size();
+	m_taskPairs.resizeNoInitialize(numTasks);
+	for (int i = 0; i < m_threadPairs.size(); ++i)
+	{
+		m_threadPairs[i].resizeNoInitialize(0);
+	}
+	{
+		BT_PROFILE("collideTasks");
+		btDbvtCollideTasksLoop collideLoop(this);
+		btParallelFor(0, numTasks, 1, collideLoop);
+	}
+
+	{
+		// merge in task order so the pair cache does not depend on which thread ran which task
+		BT_PROFILE("mergePairs");
+		for (int i = 0; i < numTasks; ++i)
+		{
+			const btTaskPairs& task = m_taskPairs[i];
+			const btAlignedObjectArray<btProxyPair>& pairs = m_threadPairs[task.m_threadIndex];
+			for (int j = task.m_begin; j < task.m_end; ++j)
+			{
+				m_paircache->addOverlappingPair(pairs[j].m_proxy0, pairs[j].m_proxy1);
+			}
+			m_newpairs += task.m_end - task.m_begin;
+		}
+	}
+}
+
+void btDbvtBroadphaseMt::collideTask(int taskIndex)
+{
+	const unsigned int threadIndex = btGetCurrentThreadIndex();
+	btAssert(threadIndex < BT_MAX_THREAD_COUNT);
+	btAlignedObjectArray<btProxyPair>& pairs = m_threadPairs[threadIndex];
+	btTaskPairs& task = m_taskPairs[taskIndex];
+	task.m_threadIndex = threadIndex;
+	task.m_begin = pairs.size();
+
+	btAlignedObjectArray<btDbvt::sStkNN>& stack = m_threadStacks[threadIndex];
+	stack.resizeNoInitialize(0);
+	stack.push_back(m_tasks[taskIndex]);
+	do
+	{
+		const btDbvt::sStkNN p = stack[stack.size() - 1];
+		stack.pop_back();
+		if (p.a == p.b)
+		{
+			if (p.a->isinternal())
+			{
+				stack.push_back(btDbvt::sStkNN(p.a->childs[0], p.a->childs[0]));
+				stack.push_back(btDbvt::sStkNN(p.a->childs[1], p.a->childs[1]));
+				stack.push_back(btDbvt::sStkNN(p.a->childs[0], p.a->childs[1]));
+			}
+		}
+		else if (Intersect(p.a->volume, p.b->volume))
+		{
+			if (p.a->isinternal())
+			{
+				if (p.b->isinternal())
+				{
+					stack.push_back(btDbvt::sStkNN(p.a->childs[0], p.b->childs[0]));
+					stack.push_back(btDbvt::sStkNN(p.a->childs[1], p.b->childs[0]));
+					stack.push_back(btDbvt::sStkNN(p.a->childs[0], p.b->childs[1]));
+					stack.push_back(btDbvt::sStkNN(p.a->childs[1], p.b->childs[1]));
+				}
+				else
+				{
+					stack.push_back(btDbvt::sStkNN(p.a->childs[0], p.b));
+					stack.push_back(btDbvt::sStkNN(p.a->childs[1], p.b));
+				}
+			}
+			else if (p.b->isinternal())
+			{
+				stack.push_back(btDbvt::sStkNN(p.a, p.b->childs[0]));
+				stack.push_back(btDbvt::sStkNN(p.a, p.b->childs[1]));
+			}
+			else
+			{
+				btProxyPair pair;
+				pair.m_proxy0 = (btDbvtProxy*)p.a->data;
+				pair.m_proxy1 = (btDbvtProxy*)p.b->data;
+				pairs.push_back(pair);
+			}
+		}
+	} while (stack.size());
+	task.m_end = pairs.size();
+}
@@ -0,0 +1,103 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_DBVT_BROADPHASE_MT_H
+#define BT_DBVT_BROADPHASE_MT_H
+
+#include "BulletCollision/BroadphaseCollision/btDbvtBroadphase.h"
+#include "BulletCollision/BroadphaseCollision/btDbvtLinearBvhBuilder.h"
+#include "LinearMath/btThreads.h"
+
+///The btDbvtBroadphaseMt finds the overlapping pairs of a btDbvtBroadphase on the task scheduler.
+///In parallel mode, setAabb no longer collides each moved proxy against both trees on the calling thread.
+///A moved leaf that still overlaps its old volume is enlarged in place, and a leaf that jumped away is
+///reinserted as before. collide then refits the dynamic tree once, splitting it into subtrees refit in parallel.
+///It then traverses dynamic-vs-fixed and dynamic-vs-dynamic as tree-vs-tree tasks over the task scheduler.
+///Each task collects its pairs into its own buffer, and the buffers are added to the pair cache in task order.
+///The tasks only depend on the trees, so the pair cache comes out the same for any number of threads.
+///Refitting keeps the tree topology, so raise m_dupdates when bodies travel far over the life of the tree.
+///When many proxies were created or teleported since the last collide, the dynamic tree is rebuilt instead, as a linear BVH
+///on the task scheduler (btDbvtLinearBvhBuilder), rather than left to the incremental optimization. rebuildTrees does the
+///same for both trees on demand, for instance after loading a level.
+struct btDbvtBroadphaseMt : btDbvtBroadphase
+{
+	btDbvtBroadphaseMt(btOverlappingPairCache* paircache = 0);
+
+	virtual btBroadphaseProxy* createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* dispatcher) BT_OVERRIDE;
+	virtual void setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher) BT_OVERRIDE;
+	virtual void rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin = btVector3(0, 0, 0), const btVector3& aabbMax = btVector3(0, 0, 0)) BT_OVERRIDE;
+	virtual void aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback) BT_OVERRIDE;
+	virtual void collideDeferred() BT_OVERRIDE;
+
+	///switching modes is allowed between two calls to calculateOverlappingPairs
+	void setParallelCollide(bool parallel);
+	bool getParallelCollide() const
+	{
+		return m_parallelCollide;
+	}
+
+	///number of tree-vs-tree tasks (and subtrees to refit) a collide aims for, independently of the thread count
+	void setTaskCount(int taskCount)
+	{
+		m_taskCount = btMax(taskCount, 1);
+	}
+	int getTaskCount() const
+	{
+		return m_taskCount;
+	}
+
+	///rebuilds the dynamic and fixed trees as linear BVHs on the task scheduler
+	void rebuildTrees();
+	///percentage of the dynamic leaves that, created or teleported between two collides, rebuilds the dynamic tree in parallel mode
+	void setRebuildThreshold(int percent)
+	{
+		m_rebuildThreshold = btMax(percent, 0);
+	}
+	int getRebuildThreshold() const
+	{
+		return m_rebuildThreshold;
+	}
+
+	struct btProxyPair
+	{
+		btDbvtProxy* m_proxy0;
+		btDbvtProxy* m_proxy1;
+	};
+
+	///pairs found by a task, a range of the buffer of the thread that ran it
+	struct btTaskPairs
+	{
+		int m_threadIndex;
+		int m_begin;
+		int m_end;
+	};
+
+	void refitDynamicSet();
+	void collideTask(int taskIndex);
+
+	bool m_parallelCollide;
+	bool m_needrefit;  // leaves of the dynamic set were enlarged without refitting their parents
+	int m_taskCount;
+	int m_rebuildThreshold;
+	int m_bulkUpdates;  // leaves inserted into the dynamic set, or moved out of their volume, since the last collide
+	btDbvtLinearBvhBuilder m_builder;
+	btAlignedObjectArray<btDbvt::sStkNN> m_tasks;
+	btAlignedObjectArray<btDbvt::sStkNN> m_splitTasks;
+	btAlignedObjectArray<btTaskPairs> m_taskPairs;
+	btAlignedObjectArray<btAlignedObjectArray<btProxyPair> > m_threadPairs;
+	btAlignedObjectArray<btAlignedObjectArray<btDbvt::sStkNN> > m_threadStacks;
+};
+
+#endif  //BT_DBVT_BROADPHASE_MT_H
@@ -0,0 +1,310 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btDbvtLinearBvhBuilder.h"
+#include "LinearMath/btQuickprof.h"
+
+static const int BT_LBVH_MIN_BATCH_SIZE = 256;
+static const int BT_LBVH_AXIS_BITS = 10;
+
+// spreads the 10 low bits of v to every third bit
+static SIMD_FORCE_INLINE unsigned int btLbvhExpandBits(unsigned int v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+static SIMD_FORCE_INLINE int btLbvhCountLeadingZeros(unsigned int x)
+{
+	if (x == 0)
+	{
+		return 32;
+	}
+	int n = 0;
+	if (x <= 0x0000FFFFu)
+	{
+		n += 16;
+		x <<= 16;
+	}
+	if (x <= 0x00FFFFFFu)
+	{
+		n += 8;
+		x <<= 8;
+	}
+	if (x <= 0x0FFFFFFFu)
+	{
+		n += 4;
+		x <<= 4;
+	}
+	if (x <= 0x3FFFFFFFu)
+	{
+		n += 2;
+		x <<= 2;
+	}
+	if (x <= 0x7FFFFFFFu)
+	{
+		n += 1;
+	}
+	return n;
+}
+
+static void btLbvhRefitSubtree(btDbvtNode* node)
+{
+	if (node->isinternal())
+	{
+		btLbvhRefitSubtree(node->childs[0]);
+		btLbvhRefitSubtree(node->childs[1]);
+		Merge(node->childs[0]->volume, node->childs[1]->volume, node->volume);
+	}
+}
+
+struct btDbvtLinearBvhLoop : public btIParallelForBody
+{
+	enum Stage
+	{
+		STAGE_MORTON_CODES,
+		STAGE_EMIT_NODES,
+		STAGE_REFIT_SUBTREES,
+	};
+
+	btDbvtLinearBvhBuilder* m_builder;
+	Stage m_stage;
+
+	btDbvtLinearBvhLoop(btDbvtLinearBvhBuilder* builder, Stage stage)
+		: m_builder(builder),
+		  m_stage(stage)
+	{
+	}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		switch (m_stage)
+		{
+			case STAGE_MORTON_CODES:
+				m_builder->computeMortonCodes(iBegin, iEnd);
+				break;
+			case STAGE_EMIT_NODES:
+				m_builder->emitNodes(iBegin, iEnd);
+				break;
+			case STAGE_REFIT_SUBTREES:
+				for (int i = iBegin; i < iEnd; ++i)
+				{
+					btLbvhRefitSubtree(m_builder->m_refitRoots[i]);
+				}
+				break;
+		}
+	}
+};
+
+btDbvtLinearBvhBuilder::btDbvtLinearBvhBuilder()
+	: m_taskCount(128),
+	  m_centerMin(0, 0, 0),
+	  m_centerMax(0, 0, 0)
+{
+}
+
+void btDbvtLinearBvhBuilder::collectNodes(btDbvtNode* root)
+{
+	m_leaves.resizeNoInitialize(0);
+	m_internalNodes.resizeNoInitialize(0);
+	m_stack.resizeNoInitialize(0);
+	m_centerMin.setValue(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+	m_centerMax.setValue(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+	m_stack.push_back(root);
+	while (m_stack.size())
+	{
+		btDbvtNode* node = m_stack[m_stack.size() - 1];
+		m_stack.pop_back();
+		if (node->isinternal())
+		{
+			m_internalNodes.push_back(node);
+			m_stack.push_back(node->childs[1]);
+			m_stack.push_back(node->childs[0]);
+		}
+		else
+		{
+			m_leaves.push_back(node);
+			const btVector3 center = node->volume.Center();
+			m_centerMin.setMin(center);
+			m_centerMax.setMax(center);
+		}
+	}
+}
+
+void btDbvtLinearBvhBuilder::computeMortonCodes(int iBegin, int iEnd)
+{
+	unsigned int* keys = m_sort.getKeys();
+	int* order = m_sort.getValues();
+	const btScalar cells = btScalar((1 << BT_LBVH_AXIS_BITS) - 1);
+	const btVector3 extent = m_centerMax - m_centerMin;
+	btVector3 scale;
+	for (int k = 0; k < 3; ++k)
+	{
+		scale[k] = extent[k] > 0 ? cells / extent[k] : btScalar(0);
+	}
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		const btVector3 position = (m_leaves[i]->volume.Center() - m_centerMin) * scale;
+		unsigned int code = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			unsigned int cell = (unsigned int)btMax(btScalar(0), btMin(position[k], cells));
+			code |= btLbvhExpandBits(cell) << (2 - k);
+		}
+		keys[i] = code;
+		order[i] = i;
+	}
+}
+
+int btDbvtLinearBvhBuilder::commonPrefix(int i, int j) const
+{
+	// length of the common prefix of the codes of sorted leaves i and j, equal codes extended by the leaf indices
+	if (j < 0 || j >= m_leaves.size())
+	{
+		return -1;
+	}
+	const unsigned int* keys = m_sort.getKeys();
+	if (keys[i] == keys[j])
+	{
+		return 32 + btLbvhCountLeadingZeros((unsigned int)(i ^ j));
+	}
+	return btLbvhCountLeadingZeros(keys[i] ^ keys[j]);
+}
+
+void btDbvtLinearBvhBuilder::emitNodes(int iBegin, int iEnd)
+{
+	const int* order = m_sort.getValues();
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		// the range of the node runs from leaf i towards the neighbour it shares the longer prefix with
+		const int direction = (commonPrefix(i, i + 1) - commonPrefix(i, i - 1)) >= 0 ? 1 : -1;
+		const int prefixMin = commonPrefix(i, i - direction);
+		int lengthMax = 2;
+		while (commonPrefix(i, i + lengthMax * direction) > prefixMin)
+		{
+			lengthMax *= 2;
+		}
+		int length = 0;
+		for (int t = lengthMax / 2; t >= 1; t /= 2)
+		{
+			if (commonPrefix(i, i + (length + t) * direction) > prefixMin)
+			{
+				length += t;
+			}
+		}
+		const int j = i + length * direction;
+
+		// the split is where the prefix of the range ends
+		const int prefixNode = commonPrefix(i, j);
+		int split = 0;
+		int divisor = 2;
+		int t;
+		do
+		{
+			t = (length + divisor - 1) / divisor;
+			if (commonPrefix(i, i + (split + t) * direction) > prefixNode)
+			{
+				split += t;
+			}
+			divisor *= 2;
+		} while (t > 1);
+		const int gamma = i + split * direction + btMin(direction, 0);
+
+		btDbvtNode* node = m_internalNodes[i];
+		btDbvtNode* child0 = (btMin(i, j) == gamma) ? m_leaves[order[gamma]] : m_internalNodes[gamma];
+		btDbvtNode* child1 = (btMax(i, j) == gamma + 1) ? m_leaves[order[gamma + 1]] : m_internalNodes[gamma + 1];
+		node->childs[0] = child0;
+		node->childs[1] = child1;
+		child0->parent = node;
+		child1->parent = node;
+	}
+}
+
+void btDbvtLinearBvhBuilder::build(btDbvt& tree)
+{
+	BT_PROFILE("btDbvtLinearBvhBuilder::build");
+	if (tree.m_root == 0 || tree.m_root->isleaf())
+	{
+		return;
+	}
+	collectNodes(tree.m_root);
+	const int numLeaves = m_leaves.size();
+	btAssert(m_internalNodes.size() == numLeaves - 1);
+
+	m_sort.resize(numLeaves);
+	{
+		btDbvtLinearBvhLoop loop(this, btDbvtLinearBvhLoop::STAGE_MORTON_CODES);
+		btParallelFor(0, numLeaves, BT_LBVH_MIN_BATCH_SIZE, loop);
+	}
+	m_sort.setChunkCount(m_taskCount);
+	m_sort.sort(3 * BT_LBVH_AXIS_BITS);
+	{
+		BT_PROFILE("emitNodes");
+		btDbvtLinearBvhLoop loop(this, btDbvtLinearBvhLoop::STAGE_EMIT_NODES);
+		btParallelFor(0, numLeaves - 1, BT_LBVH_MIN_BATCH_SIZE, loop);
+	}
+	tree.m_root = m_internalNodes[0];
+	tree.m_root->parent = 0;
+	refit(tree.m_root);
+}
+
+void btDbvtLinearBvhBuilder::refit(btDbvtNode* root)
+{
+	BT_PROFILE("btDbvtLinearBvhBuilder::refit");
+	m_refitTop.resizeNoInitialize(0);
+	m_refitRoots.resizeNoInitialize(0);
+	if (root == 0)
+	{
+		return;
+	}
+
+	// split the tree breadth first until there are enough subtrees, remembering the nodes above them
+	m_refitRoots.push_back(root);
+	bool split = true;
+	while (split && m_refitRoots.size() < m_taskCount)
+	{
+		split = false;
+		m_splitRoots.resizeNoInitialize(0);
+		for (int i = 0; i < m_refitRoots.size(); ++i)
+		{
+			btDbvtNode* node = m_refitRoots[i];
+			if (node->isinternal())
+			{
+				m_refitTop.push_back(node);
+				m_splitRoots.push_back(node->childs[0]);
+				m_splitRoots.push_back(node->childs[1]);
+				split = true;
+			}
+			else
+			{
+				m_splitRoots.push_back(node);
+			}
+		}
+		m_refitRoots.copyFromArray(m_splitRoots);
+	}
+
+	{
+		btDbvtLinearBvhLoop loop(this, btDbvtLinearBvhLoop::STAGE_REFIT_SUBTREES);
+		btParallelFor(0, m_refitRoots.size(), 1, loop);
+	}
+	for (int i = m_refitTop.size() - 1; i >= 0; --i)
+	{
+		btDbvtNode* node = m_refitTop[i];
+		Merge(node->childs[0]->volume, node->childs[1]->volume, node->volume);
+	}
+}
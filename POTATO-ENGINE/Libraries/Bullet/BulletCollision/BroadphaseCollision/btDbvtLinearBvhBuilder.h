@@ -0,0 +1,70 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_DBVT_LINEAR_BVH_BUILDER_H
+#define BT_DBVT_LINEAR_BVH_BUILDER_H
+
+#include "btDbvt.h"
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btParallelRadixSort.h"
+
+///The btDbvtLinearBvhBuilder rebuilds the hierarchy of a btDbvt over its leaves on the task scheduler, a CPU version of the
+///linear BVH build of b3GpuParallelLinearBvh. The leaves get 30 bit Morton codes of their centers, which are radix sorted,
+///and every internal node then finds its own range of leaves and split from the sorted codes alone (Karras, Maximizing
+///Parallelism in the Construction of BVHs, Octrees, and k-d Trees), so all internal nodes are emitted in parallel.
+///The volumes are refit bottom-up, subtrees in parallel and the few nodes above them on the calling thread.
+///The leaves and internal nodes of the tree are reused, nothing is allocated or freed in the tree, and leaves with the same
+///code keep their order in the old tree, so the result does not depend on the thread count.
+///A linear BVH is built much faster than by optimizeTopDown but is of lower quality, which suits bulk changes such as loading
+///a level or teleporting many objects, after which the incremental optimization of btDbvtBroadphase takes over.
+class btDbvtLinearBvhBuilder
+{
+public:
+	btDbvtLinearBvhBuilder();
+
+	///rebuilds the internal nodes of the tree over its current leaves
+	void build(btDbvt& tree);
+	///recomputes the volumes of the internal nodes below root from its leaves
+	void refit(btDbvtNode* root);
+
+	///number of tasks the sort and the refit are cut into, independently of the thread count
+	void setTaskCount(int taskCount)
+	{
+		m_taskCount = btMax(taskCount, 1);
+	}
+	int getTaskCount() const
+	{
+		return m_taskCount;
+	}
+
+	void collectNodes(btDbvtNode* root);
+	void computeMortonCodes(int iBegin, int iEnd);
+	void emitNodes(int iBegin, int iEnd);
+	int commonPrefix(int i, int j) const;
+
+	int m_taskCount;
+	btVector3 m_centerMin;  // bounds of the leaf centers
+	btVector3 m_centerMax;
+	btAlignedObjectArray<btDbvtNode*> m_leaves;         // leaves in the order of the old tree
+	btAlignedObjectArray<btDbvtNode*> m_internalNodes;  // internal nodes of the old tree, reused in emission order, the root first
+	btAlignedObjectArray<btDbvtNode*> m_stack;
+	btParallelRadixSort m_sort;                        // Morton codes, with leaf indices as values
+	btAlignedObjectArray<btDbvtNode*> m_refitTop;      // internal nodes above the refit subtrees, parents first
+	btAlignedObjectArray<btDbvtNode*> m_refitRoots;    // subtrees refit in parallel
+	btAlignedObjectArray<btDbvtNode*> m_splitRoots;
+};
+
+#endif  //BT_DBVT_LINEAR_BVH_BUILDER_H
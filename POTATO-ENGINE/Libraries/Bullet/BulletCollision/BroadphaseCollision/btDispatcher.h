@@ -47,7 +47,12 @@ struct btDispatcherInfo
 		  m_allowedCcdPenetration(btScalar(0.04)),
 		  m_useConvexConservativeDistanceUtil(false),
 		  m_convexConservativeDistanceThreshold(0.0f),
-		  m_deterministicOverlappingPairs(false)
+		  m_deterministicOverlappingPairs(false),
+		  m_enableConvexCoherence(false),
+		  m_convexCoherenceContactMotion(btScalar(0.)),
+		  m_concaveContactCapacity(0),
+		  m_enableTriangleQueryCache(false),
+		  m_triangleQueryCacheMargin(btScalar(0.2))
 	{
 	}
 	btScalar m_timeStep;
@@ -63,6 +68,18 @@ struct btDispatcherInfo
 	bool m_useConvexConservativeDistanceUtil;
 	btScalar m_convexConservativeDistanceThreshold;
 	bool m_deterministicOverlappingPairs;
+	///btConvexConvexAlgorithm skips the query of a pair while the bodies moved less than the separation found by the last one
+	bool m_enableConvexCoherence;
+	///motion below which btConvexConvexAlgorithm only refreshes the contacts of a touching pair instead of querying it again,
+	///0 to always query touching pairs so the cache gives the same contacts as running without it. A tolerance such as 0.001
+	///trades exact contacts of resting pairs for speed
+	btScalar m_convexCoherenceContactMotion;
+	///points kept by the manifolds of convex against concave pairs, up to MANIFOLD_CACHE_SIZE, 0 for MANIFOLD_DEFAULT_CAPACITY
+	int m_concaveContactCapacity;
+	///btConvexConcaveCollisionAlgorithm keeps the triangles around the convex and reuses them while the convex stays among them
+	bool m_enableTriangleQueryCache;
+	///distance by which the triangle query cache box exceeds the box of the convex
+	btScalar m_triangleQueryCacheMargin;
 };
 
 enum ebtDispatcherQueryType
@@ -0,0 +1,915 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btGridBroadphaseMt.h"
+#include "btConcurrentOverlappingPairCache.h"
+#include "LinearMath/btAabbUtil2.h"
+#include "LinearMath/btQuickprof.h"
+
+#include <math.h>
+#include <new>
+
+static const int BT_GRID_MIN_BATCH_SIZE = 256;
+static const int BT_GRID_MIN_HASH_BITS = 6;
+static const int BT_GRID_MIN_NEW_PAIRS = 1024;  // room reserved in a concurrent pair cache
+static const btScalar BT_GRID_CELL_LIMIT = btScalar(1 << 28);  // cell coordinates are clamped, far away cells merge but stay ordered
+
+static SIMD_FORCE_INLINE btScalar btGridMaxExtent(const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	btVector3 extent = aabbMax - aabbMin;
+	return btMax(extent.x(), btMax(extent.y(), extent.z()));
+}
+
+static SIMD_FORCE_INLINE bool btGridTestFilter(int group0, int mask0, int group1, int mask1)
+{
+	return (group0 & mask1) && (group1 & mask0);
+}
+
+struct btGridBroadphaseLoop : public btIParallelForBody
+{
+	enum Stage
+	{
+		STAGE_CLASSIFY_PROXIES,
+		STAGE_CLEAR_BUCKETS,
+		STAGE_GATHER_ENTRIES,
+		STAGE_FIND_PAIRS,
+		STAGE_ADD_PAIRS,
+		STAGE_TEST_PAIRS,
+	};
+
+	btGridBroadphaseMt* m_broadphase;
+	Stage m_stage;
+
+	btGridBroadphaseLoop(btGridBroadphaseMt* broadphase, Stage stage)
+		: m_broadphase(broadphase),
+		  m_stage(stage)
+	{
+	}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		switch (m_stage)
+		{
+			case STAGE_CLASSIFY_PROXIES:
+				m_broadphase->classifyProxies(iBegin, iEnd);
+				break;
+			case STAGE_CLEAR_BUCKETS:
+				m_broadphase->clearBuckets(iBegin, iEnd);
+				break;
+			case STAGE_GATHER_ENTRIES:
+				m_broadphase->gatherEntries(iBegin, iEnd);
+				break;
+			case STAGE_FIND_PAIRS:
+				for (int i = iBegin; i < iEnd; ++i)
+				{
+					m_broadphase->findPairsTask(i);
+				}
+				break;
+			case STAGE_ADD_PAIRS:
+				for (int i = iBegin; i < iEnd; ++i)
+				{
+					m_broadphase->addPairsTask(i);
+				}
+				break;
+			case STAGE_TEST_PAIRS:
+				m_broadphase->testPairs(iBegin, iEnd);
+				break;
+		}
+	}
+};
+
+///collects the pairs of a grid proxy with the oversized proxies, and of the oversized proxies with each other
+struct btGridTreeCollider : btDbvt::ICollide
+{
+	btAlignedObjectArray<btGridBroadphaseMt::btProxyPair>* m_pairs;
+	const btGridBroadphaseMt::btGridEntry* m_entry;
+	bool m_filterPairs;
+
+	btGridTreeCollider(btAlignedObjectArray<btGridBroadphaseMt::btProxyPair>* pairs, bool filterPairs)
+		: m_pairs(pairs),
+		  m_entry(0),
+		  m_filterPairs(filterPairs)
+	{
+	}
+
+	void addPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
+	{
+		if (m_filterPairs && !btGridTestFilter(proxy0->m_collisionFilterGroup, proxy0->m_collisionFilterMask, proxy1->m_collisionFilterGroup, proxy1->m_collisionFilterMask))
+		{
+			return;
+		}
+		btGridBroadphaseMt::btProxyPair pair;
+		pair.m_proxy0 = proxy0;
+		pair.m_proxy1 = proxy1;
+		m_pairs->push_back(pair);
+	}
+	void Process(const btDbvtNode* na, const btDbvtNode* nb)
+	{
+		if (na != nb)
+		{
+			addPair((btBroadphaseProxy*)na->data, (btBroadphaseProxy*)nb->data);
+		}
+	}
+	void Process(const btDbvtNode* leaf)
+	{
+		addPair(m_entry->m_proxy, (btBroadphaseProxy*)leaf->data);
+	}
+};
+
+struct btGridRayTester : btDbvt::ICollide
+{
+	btBroadphaseRayCallback& m_rayCallback;
+	btGridRayTester(btBroadphaseRayCallback& rayCallback)
+		: m_rayCallback(rayCallback)
+	{
+	}
+	void Process(const btDbvtNode* leaf)
+	{
+		m_rayCallback.process((btBroadphaseProxy*)leaf->data);
+	}
+};
+
+struct btGridAabbTester : btDbvt::ICollide
+{
+	btBroadphaseAabbCallback& m_callback;
+	btGridAabbTester(btBroadphaseAabbCallback& callback)
+		: m_callback(callback)
+	{
+	}
+	void Process(const btDbvtNode* leaf)
+	{
+		m_callback.process((btBroadphaseProxy*)leaf->data);
+	}
+};
+
+///tests the ray against the entries of the cells of one level
+struct btGridRayCellVisitor
+{
+	const btGridBroadphaseMt* m_broadphase;
+	int m_level;
+	btVector3 m_rayFrom;
+	btVector3 m_aabbMin;  // box of the ray shape
+	btVector3 m_aabbMax;
+	btBroadphaseRayCallback& m_rayCallback;
+
+	btGridRayCellVisitor(const btGridBroadphaseMt* broadphase, int level, const btVector3& rayFrom, const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseRayCallback& rayCallback)
+		: m_broadphase(broadphase),
+		  m_level(level),
+		  m_rayFrom(rayFrom),
+		  m_aabbMin(aabbMin),
+		  m_aabbMax(aabbMax),
+		  m_rayCallback(rayCallback)
+	{
+	}
+
+	void testEntry(const btGridBroadphaseMt::btGridEntry& entry)
+	{
+		// the box of the ray shape widens the box of the proxy, as in btDbvt::rayTestInternal
+		btVector3 bounds[2];
+		bounds[0] = entry.m_aabbMin - m_aabbMax;
+		bounds[1] = entry.m_aabbMax - m_aabbMin;
+		btScalar tmin = 1.f;
+		if (btRayAabb2(m_rayFrom, m_rayCallback.m_rayDirectionInverse, m_rayCallback.m_signs, bounds, tmin, 0, m_rayCallback.m_lambda_max))
+		{
+			m_rayCallback.process(entry.m_proxy);
+		}
+	}
+	void visitCell(const int* cell)
+	{
+		const btGridBroadphaseMt::btGridBucket& bucket = m_broadphase->getBucket(cell, m_level);
+		for (int i = bucket.m_begin; i < bucket.m_end; ++i)
+		{
+			const btGridBroadphaseMt::btGridEntry& entry = m_broadphase->m_entries[i];
+			if (entry.m_level == m_level && entry.m_cell[0] == cell[0] && entry.m_cell[1] == cell[1] && entry.m_cell[2] == cell[2])
+			{
+				testEntry(entry);
+			}
+		}
+	}
+	///visits the cells [center - radius, center + radius] on every axis but fixedAxis, where the cell is fixedCell
+	void visitSlab(const int* center, int radius, int fixedAxis, int fixedCell)
+	{
+		const int axis1 = (fixedAxis + 1) % 3;
+		const int axis2 = (fixedAxis + 2) % 3;
+		int cell[3];
+		cell[fixedAxis] = fixedCell;
+		for (int i = -radius; i <= radius; ++i)
+		{
+			cell[axis1] = center[axis1] + i;
+			for (int j = -radius; j <= radius; ++j)
+			{
+				cell[axis2] = center[axis2] + j;
+				visitCell(cell);
+			}
+		}
+	}
+};
+
+btGridBroadphaseMt::btGridBroadphaseMt(btOverlappingPairCache* pairCache)
+	: m_pairCache(pairCache),
+	  m_ownsPairCache(false),
+	  m_filterPairs(true),
+	  m_gridDirty(true),
+	  m_taskCount(128),
+	  m_numLevels(4),
+	  m_fixedCellSize(0),
+	  m_cellSize(1),
+	  m_hashBits(BT_GRID_MIN_HASH_BITS),
+	  m_numGridProxies(0),
+	  m_centerMin(0, 0, 0),
+	  m_centerMax(0, 0, 0),
+	  m_nextUniqueId(2)
+{
+	if (!m_pairCache)
+	{
+		void* mem = btAlignedAlloc(sizeof(btHashedOverlappingPairCache), 16);
+		m_pairCache = new (mem) btHashedOverlappingPairCache();
+		m_ownsPairCache = true;
+	}
+	// stale pairs are removed as soon as they are found
+	btAssert(!m_pairCache->hasDeferredRemoval());
+	m_threadPairs.resize(BT_MAX_THREAD_COUNT);
+	for (int i = 0; i < BT_GRID_MAX_LEVELS; ++i)
+	{
+		m_levelCounts[i] = 0;
+	}
+}
+
+btGridBroadphaseMt::~btGridBroadphaseMt()
+{
+	for (int i = 0; i < m_proxies.size(); ++i)
+	{
+		m_proxies[i]->~btGridBroadphaseMtProxy();
+		btAlignedFree(m_proxies[i]);
+	}
+	if (m_ownsPairCache)
+	{
+		m_pairCache->~btOverlappingPairCache();
+		btAlignedFree(m_pairCache);
+	}
+}
+
+btBroadphaseProxy* btGridBroadphaseMt::createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int /*shapeType*/, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* /*dispatcher*/)
+{
+	void* mem = btAlignedAlloc(sizeof(btGridBroadphaseMtProxy), 16);
+	btGridBroadphaseMtProxy* proxy = new (mem) btGridBroadphaseMtProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask);
+	proxy->m_uniqueId = m_nextUniqueId++;
+	proxy->m_index = m_proxies.size();
+	m_proxies.push_back(proxy);
+	m_gridDirty = true;
+	return proxy;
+}
+
+void btGridBroadphaseMt::destroyProxy(btBroadphaseProxy* absproxy, btDispatcher* dispatcher)
+{
+	btGridBroadphaseMtProxy* proxy = static_cast<btGridBroadphaseMtProxy*>(absproxy);
+	m_pairCache->removeOverlappingPairsContainingProxy(proxy, dispatcher);
+	if (proxy->m_leaf)
+	{
+		m_tree.remove(proxy->m_leaf);
+	}
+	int index = proxy->m_index;
+	btGridBroadphaseMtProxy* last = m_proxies[m_proxies.size() - 1];
+	m_proxies[index] = last;
+	last->m_index = index;
+	m_proxies.pop_back();
+	proxy->~btGridBroadphaseMtProxy();
+	btAlignedFree(proxy);
+	m_gridDirty = true;
+}
+
+void btGridBroadphaseMt::setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* /*dispatcher*/)
+{
+	proxy->m_aabbMin = aabbMin;
+	proxy->m_aabbMax = aabbMax;
+	m_gridDirty = true;
+}
+
+void btGridBroadphaseMt::getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const
+{
+	aabbMin = proxy->m_aabbMin;
+	aabbMax = proxy->m_aabbMax;
+}
+
+void btGridBroadphaseMt::getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const
+{
+	if (m_proxies.size() == 0)
+	{
+		aabbMin.setValue(0, 0, 0);
+		aabbMax.setValue(0, 0, 0);
+		return;
+	}
+	aabbMin = m_proxies[0]->m_aabbMin;
+	aabbMax = m_proxies[0]->m_aabbMax;
+	for (int i = 1; i < m_proxies.size(); ++i)
+	{
+		aabbMin.setMin(m_proxies[i]->m_aabbMin);
+		aabbMax.setMax(m_proxies[i]->m_aabbMax);
+	}
+}
+
+void btGridBroadphaseMt::getCell(const btVector3& point, int level, int* cell) const
+{
+	// cells of a level are the cells of the lowest level shifted down, so the levels nest exactly
+	for (int i = 0; i < 3; ++i)
+	{
+		btScalar c = floor(point[i] / m_cellSize);
+		c = btMax(-BT_GRID_CELL_LIMIT, btMin(c, BT_GRID_CELL_LIMIT));
+		cell[i] = int(c) >> level;
+	}
+}
+
+unsigned int btGridBroadphaseMt::hashCell(const int* cell, int level) const
+{
+	unsigned int hash = (unsigned int)(cell[0]) * 73856093u ^ (unsigned int)(cell[1]) * 19349663u ^ (unsigned int)(cell[2]) * 83492791u ^ (unsigned int)(level)*2654435761u;
+	hash ^= hash >> 16;
+	return hash & ((1u << m_hashBits) - 1);
+}
+
+void btGridBroadphaseMt::chooseCellSize()
+{
+	if (m_fixedCellSize > 0)
+	{
+		m_cellSize = m_fixedCellSize;
+		return;
+	}
+	const int numProxies = m_proxies.size();
+	if (numProxies == 0)
+	{
+		return;
+	}
+	// median of the box sizes rounded up to a power of two, so that half of the proxies fit the cells of the lowest level
+	const int BT_GRID_EXPONENT_BINS = 128;
+	int counts[BT_GRID_EXPONENT_BINS];
+	for (int i = 0; i < BT_GRID_EXPONENT_BINS; ++i)
+	{
+		counts[i] = 0;
+	}
+	for (int i = 0; i < numProxies; ++i)
+	{
+		const btGridBroadphaseMtProxy* proxy = m_proxies[i];
+		btScalar extent = btGridMaxExtent(proxy->m_aabbMin, proxy->m_aabbMax);
+		int exponent = -BT_GRID_EXPONENT_BINS / 2;
+		if (extent > 0 && extent <= SIMD_INFINITY)
+		{
+			frexp(double(extent), &exponent);
+		}
+		exponent = btMax(-BT_GRID_EXPONENT_BINS / 2, btMin(exponent, BT_GRID_EXPONENT_BINS / 2 - 1));
+		counts[exponent + BT_GRID_EXPONENT_BINS / 2]++;
+	}
+	int median = 0;
+	for (int count = 0; median < BT_GRID_EXPONENT_BINS; ++median)
+	{
+		count += counts[median];
+		if (2 * count >= numProxies)
+		{
+			break;
+		}
+	}
+	m_cellSize = btScalar(ldexp(1.0, median - BT_GRID_EXPONENT_BINS / 2));
+}
+
+void btGridBroadphaseMt::classifyProxies(int iBegin, int iEnd)
+{
+	unsigned int* keys = m_sort.getKeys();
+	int* order = m_sort.getValues();
+	const btScalar topLevelRatio = btScalar(1 << (m_numLevels - 1));
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		btGridBroadphaseMtProxy* proxy = m_proxies[i];
+		// lowest level whose cells are at least as large as the box, the proxies larger than the top level cells go to the tree
+		btScalar ratio = btGridMaxExtent(proxy->m_aabbMin, proxy->m_aabbMax) / m_cellSize;
+		int level = m_numLevels;
+		if (ratio <= 1)
+		{
+			level = 0;
+		}
+		else if (ratio <= topLevelRatio)
+		{
+			int exponent;
+			double mantissa = frexp(double(ratio), &exponent);
+			level = (mantissa == 0.5) ? exponent - 1 : exponent;
+		}
+		proxy->m_level = level;
+		if (level < m_numLevels)
+		{
+			int cell[3];
+			getCell((proxy->m_aabbMin + proxy->m_aabbMax) * btScalar(0.5), level, cell);
+			keys[i] = hashCell(cell, level);
+		}
+		else
+		{
+			// after every bucket
+			keys[i] = 1u << m_hashBits;
+		}
+		order[i] = i;
+	}
+}
+
+void btGridBroadphaseMt::updateTree()
+{
+	BT_PROFILE("updateTree");
+	m_numGridProxies = 0;
+	for (int i = 0; i < BT_GRID_MAX_LEVELS; ++i)
+	{
+		m_levelCounts[i] = 0;
+	}
+	m_centerMin.setValue(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+	m_centerMax.setValue(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+	for (int i = 0; i < m_proxies.size(); ++i)
+	{
+		btGridBroadphaseMtProxy* proxy = m_proxies[i];
+		if (proxy->m_level < m_numLevels)
+		{
+			if (proxy->m_leaf)
+			{
+				m_tree.remove(proxy->m_leaf);
+				proxy->m_leaf = 0;
+			}
+			m_numGridProxies++;
+			m_levelCounts[proxy->m_level]++;
+			btVector3 center = (proxy->m_aabbMin + proxy->m_aabbMax) * btScalar(0.5);
+			m_centerMin.setMin(center);
+			m_centerMax.setMax(center);
+		}
+		else
+		{
+			ATTRIBUTE_ALIGNED16(btDbvtVolume)
+			volume = btDbvtVolume::FromMM(proxy->m_aabbMin, proxy->m_aabbMax);
+			if (proxy->m_leaf)
+			{
+				m_tree.update(proxy->m_leaf, volume);
+			}
+			else
+			{
+				proxy->m_leaf = m_tree.insert(volume, proxy);
+			}
+		}
+	}
+}
+
+void btGridBroadphaseMt::clearBuckets(int iBegin, int iEnd)
+{
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		m_buckets[i].m_begin = 0;
+		m_buckets[i].m_end = 0;
+	}
+}
+
+void btGridBroadphaseMt::gatherEntries(int iBegin, int iEnd)
+{
+	const unsigned int* keys = m_sort.getKeys();
+	const int* order = m_sort.getValues();
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		btGridBroadphaseMtProxy* proxy = m_proxies[order[i]];
+		btGridEntry& entry = m_entries[i];
+		entry.m_aabbMin = proxy->m_aabbMin;
+		entry.m_aabbMax = proxy->m_aabbMax;
+		entry.m_level = proxy->m_level;
+		getCell((proxy->m_aabbMin + proxy->m_aabbMax) * btScalar(0.5), proxy->m_level, entry.m_cell);
+		entry.m_collisionFilterGroup = proxy->m_collisionFilterGroup;
+		entry.m_collisionFilterMask = proxy->m_collisionFilterMask;
+		entry.m_proxy = proxy;
+		// the entries of a bucket are consecutive, the first and last of them write its range
+		const unsigned int key = keys[i];
+		if (i == 0 || keys[i - 1] != key)
+		{
+			m_buckets[key].m_begin = i;
+		}
+		if (i + 1 == m_numGridProxies || keys[i + 1] != key)
+		{
+			m_buckets[key].m_end = i + 1;
+		}
+	}
+}
+
+void btGridBroadphaseMt::buildGrid()
+{
+	BT_PROFILE("buildGrid");
+	chooseCellSize();
+	const int numProxies = m_proxies.size();
+	// about two buckets per proxy
+	m_hashBits = BT_GRID_MIN_HASH_BITS;
+	while ((1 << m_hashBits) < 2 * numProxies && m_hashBits < 30)
+	{
+		m_hashBits++;
+	}
+	m_sort.resize(numProxies);
+	{
+		btGridBroadphaseLoop loop(this, btGridBroadphaseLoop::STAGE_CLASSIFY_PROXIES);
+		btParallelFor(0, numProxies, BT_GRID_MIN_BATCH_SIZE, loop);
+	}
+	updateTree();
+
+	// the passes are stable so the entries of a bucket keep the order of the proxy array, the tree proxies sort last
+	m_sort.setChunkCount(m_taskCount);
+	m_sort.sort(m_hashBits + 1);
+
+	const int numBuckets = 1 << m_hashBits;
+	m_buckets.resizeNoInitialize(numBuckets);
+	{
+		btGridBroadphaseLoop loop(this, btGridBroadphaseLoop::STAGE_CLEAR_BUCKETS);
+		btParallelFor(0, numBuckets, 4 * BT_GRID_MIN_BATCH_SIZE, loop);
+	}
+	m_entries.resizeNoInitialize(m_numGridProxies);
+	{
+		btGridBroadphaseLoop loop(this, btGridBroadphaseLoop::STAGE_GATHER_ENTRIES);
+		btParallelFor(0, m_numGridProxies, BT_GRID_MIN_BATCH_SIZE, loop);
+	}
+	m_gridDirty = false;
+}
+
+void btGridBroadphaseMt::findPairsTask(int taskIndex)
+{
+	const unsigned int threadIndex = btGetCurrentThreadIndex();
+	btAssert(threadIndex < BT_MAX_THREAD_COUNT);
+	btAlignedObjectArray<btProxyPair>& pairs = m_threadPairs[threadIndex];
+	btTaskPairs& task = m_taskPairs[taskIndex];
+	task.m_threadIndex = threadIndex;
+	task.m_begin = pairs.size();
+
+	btGridTreeCollider collider(&pairs, m_filterPairs);
+	const int iBegin = int((long long)(taskIndex)*m_numGridProxies / m_taskCount);
+	const int iEnd = int((long long)(taskIndex + 1) * m_numGridProxies / m_taskCount);
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		const btGridEntry& entry0 = m_entries[i];
+		// a box is no larger than the cells of its level, so the centers of two overlapping boxes are in neighbouring cells
+		// of the higher of their levels; pairs on the same level are found by the first entry, the others by the lower one
+		for (int level = entry0.m_level; level < m_numLevels; ++level)
+		{
+			if (m_levelCounts[level] == 0)
+			{
+				continue;
+			}
+			const int shift = level - entry0.m_level;
+			int center[3];
+			int cell[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				center[k] = entry0.m_cell[k] >> shift;
+			}
+			for (int dz = -1; dz <= 1; ++dz)
+			{
+				cell[2] = center[2] + dz;
+				for (int dy = -1; dy <= 1; ++dy)
+				{
+					cell[1] = center[1] + dy;
+					for (int dx = -1; dx <= 1; ++dx)
+					{
+						cell[0] = center[0] + dx;
+						const btGridBucket& bucket = getBucket(cell, level);
+						const int jBegin = (shift == 0) ? btMax(bucket.m_begin, i + 1) : bucket.m_begin;
+						for (int j = jBegin; j < bucket.m_end; ++j)
+						{
+							const btGridEntry& entry1 = m_entries[j];
+							if (entry1.m_level != level || entry1.m_cell[0] != cell[0] || entry1.m_cell[1] != cell[1] || entry1.m_cell[2] != cell[2])
+							{
+								continue;
+							}
+							if (m_filterPairs && !btGridTestFilter(entry0.m_collisionFilterGroup, entry0.m_collisionFilterMask, entry1.m_collisionFilterGroup, entry1.m_collisionFilterMask))
+							{
+								continue;
+							}
+							if (TestAabbAgainstAabb2(entry0.m_aabbMin, entry0.m_aabbMax, entry1.m_aabbMin, entry1.m_aabbMax))
+							{
+								btProxyPair pair;
+								pair.m_proxy0 = entry0.m_proxy;
+								pair.m_proxy1 = entry1.m_proxy;
+								pairs.push_back(pair);
+							}
+						}
+					}
+				}
+			}
+		}
+		if (m_tree.m_root)
+		{
+			collider.m_entry = &entry0;
+			m_tree.collideTV(m_tree.m_root, btDbvtVolume::FromMM(entry0.m_aabbMin, entry0.m_aabbMax), collider);
+		}
+	}
+	task.m_end = pairs.size();
+}
+
+void btGridBroadphaseMt::addPairsTask(int taskIndex)
+{
+	const btTaskPairs& task = m_taskPairs[taskIndex];
+	const btAlignedObjectArray<btProxyPair>& pairs = m_threadPairs[task.m_threadIndex];
+	for (int i = task.m_begin; i < task.m_end; ++i)
+	{
+		m_pairCache->addOverlappingPair(pairs[i].m_proxy0, pairs[i].m_proxy1);
+	}
+}
+
+void btGridBroadphaseMt::testPairs(int iBegin, int iEnd)
+{
+	const btBroadphasePairArray& pairArray = m_pairCache->getOverlappingPairArray();
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		const btBroadphasePair& pair = pairArray[i];
+		bool overlap = TestAabbAgainstAabb2(pair.m_pProxy0->m_aabbMin, pair.m_pProxy0->m_aabbMax, pair.m_pProxy1->m_aabbMin, pair.m_pProxy1->m_aabbMax);
+		m_removePairs[i] = overlap ? 0 : 1;
+	}
+}
+
+void btGridBroadphaseMt::calculateOverlappingPairs(btDispatcher* dispatcher)
+{
+	BT_PROFILE("btGridBroadphaseMt::calculateOverlappingPairs");
+	m_filterPairs = (m_pairCache->getOverlapFilterCallback() == 0);
+	if (m_gridDirty)
+	{
+		buildGrid();
+	}
+
+	m_taskPairs.resizeNoInitialize(m_taskCount);
+	for (int i = 0; i < m_threadPairs.size(); ++i)
+	{
+		m_threadPairs[i].resizeNoInitialize(0);
+	}
+	{
+		BT_PROFILE("findPairsTasks");
+		btGridBroadphaseLoop loop(this, btGridBroadphaseLoop::STAGE_FIND_PAIRS);
+		btParallelFor(0, m_taskCount, 1, loop);
+	}
+	m_treePairs.resizeNoInitialize(0);
+	if (m_tree.m_root)
+	{
+		BT_PROFILE("treePairs");
+		btGridTreeCollider collider(&m_treePairs, m_filterPairs);
+		m_tree.collideTT(m_tree.m_root, m_tree.m_root, collider);
+	}
+
+	if (m_pairCache->hasConcurrentInsertion())
+	{
+		// every task adds its own pairs, the cache orders the new pairs if it is set to
+		BT_PROFILE("addPairsConcurrent");
+		btConcurrentOverlappingPairCache* pairCache = static_cast<btConcurrentOverlappingPairCache*>(m_pairCache);
+		pairCache->beginConcurrentInsertion(btMax(pairCache->getNumNewPairs() * 2, BT_GRID_MIN_NEW_PAIRS));
+		btGridBroadphaseLoop loop(this, btGridBroadphaseLoop::STAGE_ADD_PAIRS);
+		btParallelFor(0, m_taskCount, 1, loop);
+		for (int i = 0; i < m_treePairs.size(); ++i)
+		{
+			pairCache->addOverlappingPair(m_treePairs[i].m_proxy0, m_treePairs[i].m_proxy1);
+		}
+		pairCache->endConcurrentInsertion();
+	}
+	else
+	{
+		// merge in task order so the pair cache does not depend on which thread ran which task
+		BT_PROFILE("mergePairs");
+		for (int i = 0; i < m_taskCount; ++i)
+		{
+			addPairsTask(i);
+		}
+		for (int i = 0; i < m_treePairs.size(); ++i)
+		{
+			m_pairCache->addOverlappingPair(m_treePairs[i].m_proxy0, m_treePairs[i].m_proxy1);
+		}
+	}
+
+	{
+		// every overlapping pair was just added, so the pairs whose boxes are apart are the stale ones
+		BT_PROFILE("removeStalePairs");
+		const int numPairs = m_pairCache->getNumOverlappingPairs();
+		m_removePairs.resizeNoInitialize(numPairs);
+		{
+			btGridBroadphaseLoop loop(this, btGridBroadphaseLoop::STAGE_TEST_PAIRS);
+			btParallelFor(0, numPairs, 500, loop);
+		}
+		// backwards, a removal moves the last pair, which is already tested and kept, into the freed slot
+		btBroadphasePairArray& pairArray = m_pairCache->getOverlappingPairArray();
+		for (int i = numPairs - 1; i >= 0; --i)
+		{
+			if (m_removePairs[i])
+			{
+				m_pairCache->removeOverlappingPair(pairArray[i].m_pProxy0, pairArray[i].m_pProxy1, dispatcher);
+			}
+		}
+	}
+}
+
+void btGridBroadphaseMt::rayTestLevel(int level, const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	btGridRayCellVisitor visitor(this, level, rayFrom, aabbMin, aabbMax, rayCallback);
+	const btScalar cellSize = getLevelCellSize(level);
+	const btScalar shapeRadius = btMax(btMax(btFabs(aabbMin.x()), btFabs(aabbMax.x())),
+									   btMax(btMax(btFabs(aabbMin.y()), btFabs(aabbMax.y())), btMax(btFabs(aabbMin.z()), btFabs(aabbMax.z()))));
+
+	// the ray reaches a proxy of this level only where it passes within half a cell and the ray shape of its center
+	const btScalar reach = cellSize * btScalar(0.5) + shapeRadius;
+	const btVector3 boundsMin = m_centerMin - btVector3(reach, reach, reach);
+	const btVector3 boundsMax = m_centerMax + btVector3(reach, reach, reach);
+	const btVector3 direction = rayTo - rayFrom;
+	// the callback measures the ray in its own units, usually the length of the ray, lambdaScale of them per unit of direction
+	const int mainAxis = direction.absolute().maxAxis();
+	btScalar lambdaScale = direction[mainAxis] * rayCallback.m_rayDirectionInverse[mainAxis];
+	if (!(lambdaScale > 0))
+	{
+		lambdaScale = 1;
+	}
+	btScalar tBegin = 0;
+	btScalar tEnd = rayCallback.m_lambda_max / lambdaScale;
+	for (int i = 0; i < 3; ++i)
+	{
+		if (direction[i] == 0)
+		{
+			if (rayFrom[i] < boundsMin[i] || rayFrom[i] > boundsMax[i])
+			{
+				return;
+			}
+			continue;
+		}
+		btScalar t0 = (boundsMin[i] - rayFrom[i]) / direction[i];
+		btScalar t1 = (boundsMax[i] - rayFrom[i]) / direction[i];
+		if (t0 > t1)
+		{
+			btSwap(t0, t1);
+		}
+		tBegin = btMax(tBegin, t0);
+		tEnd = btMin(tEnd, t1);
+	}
+	if (tBegin > tEnd)
+	{
+		return;
+	}
+
+	// the cells around the path of the ray holding the centers that are close enough, or every entry when that is cheaper
+	int cell[3];
+	int lastCell[3];
+	getCell(rayFrom + direction * tBegin, level, cell);
+	getCell(rayFrom + direction * tEnd, level, lastCell);
+	const btScalar radiusCells = ceil(shapeRadius / cellSize);
+	int numSteps = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		numSteps += btMax(lastCell[i] - cell[i], cell[i] - lastCell[i]);
+	}
+	const btScalar side = 2 * radiusCells + 3;
+	if (side * side * (side + btScalar(numSteps)) > btScalar(m_numGridProxies))
+	{
+		for (int i = 0; i < m_numGridProxies; ++i)
+		{
+			if (m_entries[i].m_level == level)
+			{
+				visitor.testEntry(m_entries[i]);
+			}
+		}
+		return;
+	}
+	const int radius = 1 + int(radiusCells);
+
+	// walks the cells of the ray as in Amanatides and Woo, the first cell visits the whole cube around it and each step
+	// the side of the cube it enters, which no earlier cube overlaps since the path is monotonic along every axis
+	int step[3];
+	btScalar tNext[3];
+	btScalar tDelta[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		if (direction[i] > 0)
+		{
+			step[i] = 1;
+			tNext[i] = (btScalar(cell[i] + 1) * cellSize - rayFrom[i]) / direction[i];
+			tDelta[i] = cellSize / direction[i];
+		}
+		else if (direction[i] < 0)
+		{
+			step[i] = -1;
+			tNext[i] = (btScalar(cell[i]) * cellSize - rayFrom[i]) / direction[i];
+			tDelta[i] = -cellSize / direction[i];
+		}
+		else
+		{
+			step[i] = 0;
+			tNext[i] = SIMD_INFINITY;
+			tDelta[i] = 0;
+		}
+	}
+	for (int i = -radius; i <= radius; ++i)
+	{
+		visitor.visitSlab(cell, radius, 2, cell[2] + i);
+	}
+	// a few more steps than the end cells are apart, in case rounding crosses a boundary twice
+	for (int s = 0; s < numSteps + 3; ++s)
+	{
+		const int axis = (tNext[0] < tNext[1]) ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+		// the callback may shorten the ray
+		if (tNext[axis] > tEnd || tNext[axis] * lambdaScale > rayCallback.m_lambda_max)
+		{
+			break;
+		}
+		cell[axis] += step[axis];
+		tNext[axis] += tDelta[axis];
+		visitor.visitSlab(cell, radius, axis, cell[axis] + step[axis] * radius);
+	}
+}
+
+void btGridBroadphaseMt::rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	BT_PROFILE("btGridBroadphaseMt::rayTest");
+	if (m_gridDirty)
+	{
+		buildGrid();
+	}
+	for (int level = 0; level < m_numLevels; ++level)
+	{
+		if (m_levelCounts[level])
+		{
+			rayTestLevel(level, rayFrom, rayTo, rayCallback, aabbMin, aabbMax);
+		}
+	}
+	if (m_tree.m_root)
+	{
+		btGridRayTester tester(rayCallback);
+		btAlignedObjectArray<const btDbvtNode*> stack;
+		m_tree.rayTestInternal(m_tree.m_root,
+							   rayFrom,
+							   rayTo,
+							   rayCallback.m_rayDirectionInverse,
+							   rayCallback.m_signs,
+							   rayCallback.m_lambda_max,
+							   aabbMin,
+							   aabbMax,
+							   stack,
+							   tester);
+	}
+}
+
+void btGridBroadphaseMt::aabbTestLevel(int level, const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback)
+{
+	// the centers of the proxies of this level that overlap the box are at most half a cell outside of it
+	const btScalar halfCellSize = getLevelCellSize(level) * btScalar(0.5);
+	const btVector3 margin(halfCellSize, halfCellSize, halfCellSize);
+	int cellMin[3];
+	int cellMax[3];
+	getCell(aabbMin - margin, level, cellMin);
+	getCell(aabbMax + margin, level, cellMax);
+	const btScalar numCells = btScalar(cellMax[0] - cellMin[0] + 1) * btScalar(cellMax[1] - cellMin[1] + 1) * btScalar(cellMax[2] - cellMin[2] + 1);
+	if (numCells > btScalar(m_numGridProxies))
+	{
+		for (int i = 0; i < m_numGridProxies; ++i)
+		{
+			const btGridEntry& entry = m_entries[i];
+			if (entry.m_level == level && TestAabbAgainstAabb2(aabbMin, aabbMax, entry.m_aabbMin, entry.m_aabbMax))
+			{
+				callback.process(entry.m_proxy);
+			}
+		}
+		return;
+	}
+	int cell[3];
+	for (cell[2] = cellMin[2]; cell[2] <= cellMax[2]; ++cell[2])
+	{
+		for (cell[1] = cellMin[1]; cell[1] <= cellMax[1]; ++cell[1])
+		{
+			for (cell[0] = cellMin[0]; cell[0] <= cellMax[0]; ++cell[0])
+			{
+				const btGridBucket& bucket = getBucket(cell, level);
+				for (int i = bucket.m_begin; i < bucket.m_end; ++i)
+				{
+					const btGridEntry& entry = m_entries[i];
+					if (entry.m_level == level && entry.m_cell[0] == cell[0] && entry.m_cell[1] == cell[1] && entry.m_cell[2] == cell[2] &&
+						TestAabbAgainstAabb2(aabbMin, aabbMax, entry.m_aabbMin, entry.m_aabbMax))
+					{
+						callback.process(entry.m_proxy);
+					}
+				}
+			}
+		}
+	}
+}
+
+void btGridBroadphaseMt::aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback)
+{
+	BT_PROFILE("btGridBroadphaseMt::aabbTest");
+	if (m_gridDirty)
+	{
+		buildGrid();
+	}
+	for (int level = 0; level < m_numLevels; ++level)
+	{
+		if (m_levelCounts[level])
+		{
+			aabbTestLevel(level, aabbMin, aabbMax, callback);
+		}
+	}
+	if (m_tree.m_root)
+	{
+		btGridAabbTester tester(callback);
+		m_tree.collideTV(m_tree.m_root, btDbvtVolume::FromMM(aabbMin, aabbMax), tester);
+	}
+}
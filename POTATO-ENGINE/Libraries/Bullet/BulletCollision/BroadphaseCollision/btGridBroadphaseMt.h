@@ -0,0 +1,206 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_GRID_BROADPHASE_MT_H
+#define BT_GRID_BROADPHASE_MT_H
+
+#include "btBroadphaseInterface.h"
+#include "btOverlappingPairCache.h"
+#include "btDbvt.h"
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btParallelRadixSort.h"
+
+struct btGridBroadphaseMtProxy : public btBroadphaseProxy
+{
+	int m_index;         // position in btGridBroadphaseMt::m_proxies
+	int m_level;         // grid level, or the number of levels for proxies in the tree
+	btDbvtNode* m_leaf;  // leaf in the tree of oversized proxies
+
+	btGridBroadphaseMtProxy(const btVector3& aabbMin, const btVector3& aabbMax, void* userPtr, int collisionFilterGroup, int collisionFilterMask)
+		: btBroadphaseProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask),
+		  m_index(-1),
+		  m_level(0),
+		  m_leaf(0)
+	{
+	}
+};
+
+///The btGridBroadphaseMt is a uniform grid broadphase for large numbers of small moving proxies, such as particles and debris.
+///The grid has a few levels, the cells of each level twice the size of the cells of the level below. Every proxy goes to the
+///lowest level whose cells are at least as large as its box, and to the one cell of that level that holds the center of its box,
+///so two proxies of the same level can only overlap when their cells are neighbours. The cells are hashed into buckets and the
+///proxies radix sorted by bucket at every calculateOverlappingPairs, on the task scheduler. Each proxy then tests the 27 cells
+///around it on its own level and on every level above, in a fixed number of tasks that collect their pairs into per-thread
+///buffers, which are added to the pair cache in task order, so the pair cache comes out the same for any number of threads.
+///With a btConcurrentOverlappingPairCache the tasks add their pairs to the cache in parallel instead, and the cache comes out
+///the same only if it is set to a deterministic order.
+///By default the cell size is the median box size of the proxies, rounded to a power of two, and is chosen again at every
+///calculateOverlappingPairs. Proxies too large for the top level go to a btDbvt instead, which is tested against every proxy.
+///Ray tests walk the cells along the ray on every level, box tests visit the cells around the box.
+///The grid is built again by the queries when proxies were created, destroyed or moved since it was built, so queries from
+///several threads at once are only safe right after calculateOverlappingPairs.
+class btGridBroadphaseMt : public btBroadphaseInterface
+{
+public:
+	btGridBroadphaseMt(btOverlappingPairCache* pairCache = 0);
+	virtual ~btGridBroadphaseMt();
+
+	virtual btBroadphaseProxy* createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* dispatcher) BT_OVERRIDE;
+	virtual void destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher) BT_OVERRIDE;
+	virtual void setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher) BT_OVERRIDE;
+	virtual void getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const BT_OVERRIDE;
+
+	virtual void rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin = btVector3(0, 0, 0), const btVector3& aabbMax = btVector3(0, 0, 0)) BT_OVERRIDE;
+	virtual void aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback) BT_OVERRIDE;
+
+	virtual void calculateOverlappingPairs(btDispatcher* dispatcher) BT_OVERRIDE;
+
+	virtual btOverlappingPairCache* getOverlappingPairCache() BT_OVERRIDE
+	{
+		return m_pairCache;
+	}
+	virtual const btOverlappingPairCache* getOverlappingPairCache() const BT_OVERRIDE
+	{
+		return m_pairCache;
+	}
+
+	virtual void getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const BT_OVERRIDE;
+	virtual void printStats() BT_OVERRIDE
+	{
+	}
+
+	///number of tasks the sort and the pair search are cut into, independently of the thread count
+	void setTaskCount(int taskCount)
+	{
+		m_taskCount = btMax(taskCount, 1);
+	}
+	int getTaskCount() const
+	{
+		return m_taskCount;
+	}
+	///size of the cells of the lowest level, 0 chooses it from the proxy boxes at every calculateOverlappingPairs
+	void setCellSize(btScalar cellSize)
+	{
+		m_fixedCellSize = btMax(cellSize, btScalar(0));
+		m_gridDirty = true;
+	}
+	btScalar getCellSize() const
+	{
+		return m_cellSize;
+	}
+	///number of grid levels, proxies larger than the cells of the top level go to the tree
+	void setNumLevels(int numLevels)
+	{
+		m_numLevels = btMax(1, btMin(numLevels, int(BT_GRID_MAX_LEVELS)));
+		m_gridDirty = true;
+	}
+	int getNumLevels() const
+	{
+		return m_numLevels;
+	}
+	///number of proxies in the tree of oversized proxies after the last build of the grid
+	int getNumTreeProxies() const
+	{
+		return m_proxies.size() - m_numGridProxies;
+	}
+
+	enum
+	{
+		BT_GRID_MAX_LEVELS = 16
+	};
+
+	///copy of a proxy in bucket order, so that the search reads consecutive memory
+	struct btGridEntry
+	{
+		btVector3 m_aabbMin;
+		btVector3 m_aabbMax;
+		int m_cell[3];  // cell on the level of the proxy
+		int m_level;
+		int m_collisionFilterGroup;
+		int m_collisionFilterMask;
+		btBroadphaseProxy* m_proxy;
+	};
+
+	///entries [m_begin, m_end) are hashed to a bucket
+	struct btGridBucket
+	{
+		int m_begin;
+		int m_end;
+	};
+
+	struct btProxyPair
+	{
+		btBroadphaseProxy* m_proxy0;
+		btBroadphaseProxy* m_proxy1;
+	};
+
+	///pairs found by a task, a range of the buffer of the thread that ran it
+	struct btTaskPairs
+	{
+		int m_threadIndex;
+		int m_begin;
+		int m_end;
+	};
+
+	void buildGrid();
+	void chooseCellSize();
+	void updateTree();
+	void classifyProxies(int iBegin, int iEnd);
+	void clearBuckets(int iBegin, int iEnd);
+	void gatherEntries(int iBegin, int iEnd);
+	void findPairsTask(int taskIndex);
+	void addPairsTask(int taskIndex);
+	void testPairs(int iBegin, int iEnd);
+
+	void getCell(const btVector3& point, int level, int* cell) const;
+	unsigned int hashCell(const int* cell, int level) const;
+	const btGridBucket& getBucket(const int* cell, int level) const
+	{
+		return m_buckets[hashCell(cell, level)];
+	}
+	btScalar getLevelCellSize(int level) const
+	{
+		return m_cellSize * btScalar(1 << level);
+	}
+	void rayTestLevel(int level, const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin, const btVector3& aabbMax);
+	void aabbTestLevel(int level, const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback);
+
+	btOverlappingPairCache* m_pairCache;
+	bool m_ownsPairCache;
+	bool m_filterPairs;  // the tasks test the collision filter masks, only without an overlap filter callback
+	bool m_gridDirty;    // proxies were created, destroyed or moved since the grid was built
+	int m_taskCount;
+	int m_numLevels;
+	btScalar m_fixedCellSize;
+	btScalar m_cellSize;       // cell size of the lowest level
+	int m_hashBits;            // the bucket table has 1 << m_hashBits buckets
+	int m_numGridProxies;      // proxies in the grid, the first entries of the sort, the others are in the tree
+	int m_levelCounts[BT_GRID_MAX_LEVELS];
+	btVector3 m_centerMin;  // bounds of the box centers of the grid proxies
+	btVector3 m_centerMax;
+	int m_nextUniqueId;
+	btAlignedObjectArray<btGridBroadphaseMtProxy*> m_proxies;
+	btDbvt m_tree;               // oversized proxies
+	btParallelRadixSort m_sort;  // bucket of each proxy, with proxy indices as values
+	btAlignedObjectArray<btGridEntry> m_entries;
+	btAlignedObjectArray<btGridBucket> m_buckets;
+	btAlignedObjectArray<btTaskPairs> m_taskPairs;
+	btAlignedObjectArray<btAlignedObjectArray<btProxyPair> > m_threadPairs;
+	btAlignedObjectArray<btProxyPair> m_treePairs;  // pairs of two oversized proxies
+	btAlignedObjectArray<char> m_removePairs;
+};
+
+#endif  //BT_GRID_BROADPHASE_MT_H
@@ -22,7 +22,8 @@ subject to the following restrictions:
 #include <stdio.h>
 
 btHashedOverlappingPairCache::btHashedOverlappingPairCache() : m_overlapFilterCallback(0),
-															   m_ghostPairCallback(0)
+															   m_ghostPairCallback(0),
+															   m_pairEventCallback(0)
 {
 	int initialAllocatedSize = 2;
 	m_overlappingPairArray.reserve(initialAllocatedSize);
@@ -204,6 +205,8 @@ btBroadphasePair* btHashedOverlappingPairCache::internalAddPair(btBroadphaseProx
 	//this is where we add an actual pair, so also call the 'ghost'
 	if (m_ghostPairCallback)
 		m_ghostPairCallback->addOverlappingPair(proxy0, proxy1);
+	if (m_pairEventCallback)
+		m_pairEventCallback->addOverlappingPair(proxy0, proxy1);
 
 	int newCapacity = m_overlappingPairArray.capacity();
 
@@ -283,6 +286,8 @@ void* btHashedOverlappingPairCache::removeOverlappingPair(btBroadphaseProxy* pro
 
 	if (m_ghostPairCallback)
 		m_ghostPairCallback->removeOverlappingPair(proxy0, proxy1, dispatcher);
+	if (m_pairEventCallback)
+		m_pairEventCallback->removeOverlappingPair(proxy0, proxy1, dispatcher);
 
 	// If the removed pair is the last pair, we are done.
 	if (lastPairIndex == pairIndex)
@@ -418,6 +423,9 @@ void btHashedOverlappingPairCache::sortOverlappingPairs(btDispatcher* dispatcher
 	///need to keep hashmap in sync with pair address, so rebuild all
 	btBroadphasePairArray tmpPairs;
 	int i;
+	// the pairs stay, so no events for their removal and addition
+	btOverlappingPairCallback* pairEventCallback = m_pairEventCallback;
+	m_pairEventCallback = 0;
 	for (i = 0; i < m_overlappingPairArray.size(); i++)
 	{
 		tmpPairs.push_back(m_overlappingPairArray[i]);
@@ -439,6 +447,7 @@ void btHashedOverlappingPairCache::sortOverlappingPairs(btDispatcher* dispatcher
 	{
 		addOverlappingPair(tmpPairs[i].m_pProxy0, tmpPairs[i].m_pProxy1);
 	}
+	m_pairEventCallback = pairEventCallback;
 }
 
 void* btSortedOverlappingPairCache::removeOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1, btDispatcher* dispatcher)
@@ -77,8 +77,21 @@ public:
 
 	virtual bool hasDeferredRemoval() = 0;
 
+	///true when addOverlappingPair and findPair can be called from several threads, see btConcurrentOverlappingPairCache
+	virtual bool hasConcurrentInsertion()
+	{
+		return false;
+	}
+
 	virtual void setInternalGhostPairCallback(btOverlappingPairCallback* ghostPairCallback) = 0;
 
+	///reports the pairs the cache adds and removes, next to the ghost pair callback, see btPairEventBuffer.
+	///Only btHashedOverlappingPairCache and btConcurrentOverlappingPairCache report them
+	virtual void setPairEventCallback(btOverlappingPairCallback* pairEventCallback)
+	{
+		(void)pairEventCallback;
+	}
+
 	virtual void sortOverlappingPairs(btDispatcher* dispatcher) = 0;
 };
 
@@ -94,6 +107,7 @@ protected:
 	btAlignedObjectArray<int> m_hashTable;
 	btAlignedObjectArray<int> m_next;
 	btOverlappingPairCallback* m_ghostPairCallback;
+	btOverlappingPairCallback* m_pairEventCallback;
 
 public:
 	BT_DECLARE_ALIGNED_ALLOCATOR();
@@ -250,6 +264,11 @@ private:
 		m_ghostPairCallback = ghostPairCallback;
 	}
 
+	virtual void setPairEventCallback(btOverlappingPairCallback * pairEventCallback)
+	{
+		m_pairEventCallback = pairEventCallback;
+	}
+
 	virtual void sortOverlappingPairs(btDispatcher * dispatcher);
 };
 
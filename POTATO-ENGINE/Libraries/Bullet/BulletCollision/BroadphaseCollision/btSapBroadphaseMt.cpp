@@ -0,0 +1,385 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btSapBroadphaseMt.h"
+#include "btConcurrentOverlappingPairCache.h"
+#include "LinearMath/btAabbUtil2.h"
+#include "LinearMath/btQuickprof.h"
+
+#include <string.h>
+#include <new>
+
+static const int BT_SAP_MIN_CHUNK_SIZE = 256;
+static const int BT_SAP_MIN_NEW_PAIRS = 1024;  // room reserved in a concurrent pair cache
+
+// maps the order of the values to the order of the unsigned keys, float conversion and flip are both monotonic
+static SIMD_FORCE_INLINE unsigned int btSapSortKey(btScalar value)
+{
+	float f = float(value);
+	unsigned int bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+struct btSapBroadphaseLoop : public btIParallelForBody
+{
+	enum Stage
+	{
+		STAGE_INIT_KEYS,
+		STAGE_GATHER_SORTED,
+		STAGE_SWEEP,
+		STAGE_ADD_PAIRS,
+		STAGE_TEST_PAIRS,
+	};
+
+	btSapBroadphaseMt* m_broadphase;
+	Stage m_stage;
+
+	btSapBroadphaseLoop(btSapBroadphaseMt* broadphase, Stage stage)
+		: m_broadphase(broadphase),
+		  m_stage(stage)
+	{
+	}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		switch (m_stage)
+		{
+			case STAGE_INIT_KEYS:
+				m_broadphase->initKeys(iBegin, iEnd);
+				break;
+			case STAGE_GATHER_SORTED:
+				m_broadphase->gatherSorted(iBegin, iEnd);
+				break;
+			case STAGE_SWEEP:
+				for (int i = iBegin; i < iEnd; ++i)
+				{
+					m_broadphase->sweepTask(i);
+				}
+				break;
+			case STAGE_ADD_PAIRS:
+				for (int i = iBegin; i < iEnd; ++i)
+				{
+					m_broadphase->addPairsTask(i);
+				}
+				break;
+			case STAGE_TEST_PAIRS:
+				m_broadphase->testPairs(iBegin, iEnd);
+				break;
+		}
+	}
+};
+
+btSapBroadphaseMt::btSapBroadphaseMt(btOverlappingPairCache* pairCache)
+	: m_pairCache(pairCache),
+	  m_ownsPairCache(false),
+	  m_filterPairs(true),
+	  m_taskCount(128),
+	  m_axis(0),
+	  m_nextUniqueId(2)
+{
+	if (!m_pairCache)
+	{
+		void* mem = btAlignedAlloc(sizeof(btHashedOverlappingPairCache), 16);
+		m_pairCache = new (mem) btHashedOverlappingPairCache();
+		m_ownsPairCache = true;
+	}
+	// stale pairs are removed as soon as they are found
+	btAssert(!m_pairCache->hasDeferredRemoval());
+	m_threadPairs.resize(BT_MAX_THREAD_COUNT);
+}
+
+btSapBroadphaseMt::~btSapBroadphaseMt()
+{
+	for (int i = 0; i < m_proxies.size(); ++i)
+	{
+		m_proxies[i]->~btSapBroadphaseMtProxy();
+		btAlignedFree(m_proxies[i]);
+	}
+	if (m_ownsPairCache)
+	{
+		m_pairCache->~btOverlappingPairCache();
+		btAlignedFree(m_pairCache);
+	}
+}
+
+btBroadphaseProxy* btSapBroadphaseMt::createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int /*shapeType*/, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* /*dispatcher*/)
+{
+	void* mem = btAlignedAlloc(sizeof(btSapBroadphaseMtProxy), 16);
+	btSapBroadphaseMtProxy* proxy = new (mem) btSapBroadphaseMtProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask);
+	proxy->m_uniqueId = m_nextUniqueId++;
+	proxy->m_index = m_proxies.size();
+	m_proxies.push_back(proxy);
+	return proxy;
+}
+
+void btSapBroadphaseMt::destroyProxy(btBroadphaseProxy* absproxy, btDispatcher* dispatcher)
+{
+	btSapBroadphaseMtProxy* proxy = static_cast<btSapBroadphaseMtProxy*>(absproxy);
+	m_pairCache->removeOverlappingPairsContainingProxy(proxy, dispatcher);
+	int index = proxy->m_index;
+	btSapBroadphaseMtProxy* last = m_proxies[m_proxies.size() - 1];
+	m_proxies[index] = last;
+	last->m_index = index;
+	m_proxies.pop_back();
+	proxy->~btSapBroadphaseMtProxy();
+	btAlignedFree(proxy);
+}
+
+void btSapBroadphaseMt::setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* /*dispatcher*/)
+{
+	proxy->m_aabbMin = aabbMin;
+	proxy->m_aabbMax = aabbMax;
+}
+
+void btSapBroadphaseMt::getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const
+{
+	aabbMin = proxy->m_aabbMin;
+	aabbMax = proxy->m_aabbMax;
+}
+
+void btSapBroadphaseMt::rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	BT_PROFILE("btSapBroadphaseMt::rayTest");
+	(void)rayTo;
+	btVector3 bounds[2];
+	for (int i = 0; i < m_proxies.size(); ++i)
+	{
+		const btSapBroadphaseMtProxy* proxy = m_proxies[i];
+		// the box of the ray shape widens the box of the proxy, as in btDbvt::rayTestInternal
+		bounds[0] = proxy->m_aabbMin - aabbMax;
+		bounds[1] = proxy->m_aabbMax - aabbMin;
+		btScalar tmin = 1.f;
+		if (btRayAabb2(rayFrom, rayCallback.m_rayDirectionInverse, rayCallback.m_signs, bounds, tmin, 0, rayCallback.m_lambda_max))
+		{
+			rayCallback.process(proxy);
+		}
+	}
+}
+
+void btSapBroadphaseMt::aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback)
+{
+	BT_PROFILE("btSapBroadphaseMt::aabbTest");
+	for (int i = 0; i < m_proxies.size(); ++i)
+	{
+		const btSapBroadphaseMtProxy* proxy = m_proxies[i];
+		if (TestAabbAgainstAabb2(aabbMin, aabbMax, proxy->m_aabbMin, proxy->m_aabbMax))
+		{
+			callback.process(proxy);
+		}
+	}
+}
+
+void btSapBroadphaseMt::getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const
+{
+	if (m_proxies.size() == 0)
+	{
+		aabbMin.setValue(0, 0, 0);
+		aabbMax.setValue(0, 0, 0);
+		return;
+	}
+	aabbMin = m_proxies[0]->m_aabbMin;
+	aabbMax = m_proxies[0]->m_aabbMax;
+	for (int i = 1; i < m_proxies.size(); ++i)
+	{
+		aabbMin.setMin(m_proxies[i]->m_aabbMin);
+		aabbMax.setMax(m_proxies[i]->m_aabbMax);
+	}
+}
+
+void btSapBroadphaseMt::chooseSweepAxis()
+{
+	// the axis along which the box centers have the largest variance, as in b3GpuSapBroadphase
+	const int numProxies = m_proxies.size();
+	btVector3 sum(0, 0, 0);
+	btVector3 sumSquares(0, 0, 0);
+	for (int i = 0; i < numProxies; ++i)
+	{
+		const btSapBroadphaseMtProxy* proxy = m_proxies[i];
+		btVector3 center = (proxy->m_aabbMin + proxy->m_aabbMax) * btScalar(0.5);
+		sum += center;
+		sumSquares += center * center;
+	}
+	btVector3 variance = sumSquares - (sum * sum) / btScalar(btMax(numProxies, 1));
+	m_axis = variance.maxAxis();
+}
+
+void btSapBroadphaseMt::initKeys(int iBegin, int iEnd)
+{
+	unsigned int* keys = m_sort.getKeys();
+	int* order = m_sort.getValues();
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		keys[i] = btSapSortKey(m_proxies[i]->m_aabbMin[m_axis]);
+		order[i] = i;
+	}
+}
+
+void btSapBroadphaseMt::sortProxies()
+{
+	BT_PROFILE("sortProxies");
+	const int numProxies = m_proxies.size();
+	m_sorted.resizeNoInitialize(numProxies);
+	if (numProxies == 0)
+	{
+		return;
+	}
+	m_sort.resize(numProxies);
+	{
+		btSapBroadphaseLoop loop(this, btSapBroadphaseLoop::STAGE_INIT_KEYS);
+		btParallelFor(0, numProxies, BT_SAP_MIN_CHUNK_SIZE, loop);
+	}
+	// the passes are stable so equal keys keep the order of the proxy array
+	m_sort.setChunkCount(m_taskCount);
+	m_sort.sort();
+
+	{
+		btSapBroadphaseLoop loop(this, btSapBroadphaseLoop::STAGE_GATHER_SORTED);
+		btParallelFor(0, numProxies, BT_SAP_MIN_CHUNK_SIZE, loop);
+	}
+}
+
+void btSapBroadphaseMt::gatherSorted(int iBegin, int iEnd)
+{
+	const unsigned int* keys = m_sort.getKeys();
+	const int* order = m_sort.getValues();
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		btSapBroadphaseMtProxy* proxy = m_proxies[order[i]];
+		btSortedProxy& sorted = m_sorted[i];
+		sorted.m_aabbMin = proxy->m_aabbMin;
+		sorted.m_aabbMax = proxy->m_aabbMax;
+		sorted.m_minKey = keys[i];
+		sorted.m_maxKey = btSapSortKey(proxy->m_aabbMax[m_axis]);
+		sorted.m_collisionFilterGroup = proxy->m_collisionFilterGroup;
+		sorted.m_collisionFilterMask = proxy->m_collisionFilterMask;
+		sorted.m_proxy = proxy;
+	}
+}
+
+void btSapBroadphaseMt::sweepTask(int taskIndex)
+{
+	const unsigned int threadIndex = btGetCurrentThreadIndex();
+	btAssert(threadIndex < BT_MAX_THREAD_COUNT);
+	btAlignedObjectArray<btProxyPair>& pairs = m_threadPairs[threadIndex];
+	btTaskPairs& task = m_taskPairs[taskIndex];
+	task.m_threadIndex = threadIndex;
+	task.m_begin = pairs.size();
+
+	const int numSorted = m_sorted.size();
+	const int iBegin = int((long long)(taskIndex)*numSorted / m_taskCount);
+	const int iEnd = int((long long)(taskIndex + 1) * numSorted / m_taskCount);
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		const btSortedProxy& sorted0 = m_sorted[i];
+		// keys round outwards, so this visits every proxy whose box overlaps along the axis, and then some
+		for (int j = i + 1; j < numSorted && m_sorted[j].m_minKey <= sorted0.m_maxKey; ++j)
+		{
+			const btSortedProxy& sorted1 = m_sorted[j];
+			if (m_filterPairs && !((sorted0.m_collisionFilterGroup & sorted1.m_collisionFilterMask) && (sorted1.m_collisionFilterGroup & sorted0.m_collisionFilterMask)))
+			{
+				continue;
+			}
+			if (TestAabbAgainstAabb2(sorted0.m_aabbMin, sorted0.m_aabbMax, sorted1.m_aabbMin, sorted1.m_aabbMax))
+			{
+				btProxyPair pair;
+				pair.m_proxy0 = sorted0.m_proxy;
+				pair.m_proxy1 = sorted1.m_proxy;
+				pairs.push_back(pair);
+			}
+		}
+	}
+	task.m_end = pairs.size();
+}
+
+void btSapBroadphaseMt::addPairsTask(int taskIndex)
+{
+	const btTaskPairs& task = m_taskPairs[taskIndex];
+	const btAlignedObjectArray<btProxyPair>& pairs = m_threadPairs[task.m_threadIndex];
+	for (int i = task.m_begin; i < task.m_end; ++i)
+	{
+		m_pairCache->addOverlappingPair(pairs[i].m_proxy0, pairs[i].m_proxy1);
+	}
+}
+
+void btSapBroadphaseMt::testPairs(int iBegin, int iEnd)
+{
+	const btBroadphasePairArray& pairArray = m_pairCache->getOverlappingPairArray();
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		const btBroadphasePair& pair = pairArray[i];
+		bool overlap = TestAabbAgainstAabb2(pair.m_pProxy0->m_aabbMin, pair.m_pProxy0->m_aabbMax, pair.m_pProxy1->m_aabbMin, pair.m_pProxy1->m_aabbMax);
+		m_removePairs[i] = overlap ? 0 : 1;
+	}
+}
+
+void btSapBroadphaseMt::calculateOverlappingPairs(btDispatcher* dispatcher)
+{
+	BT_PROFILE("btSapBroadphaseMt::calculateOverlappingPairs");
+	m_filterPairs = (m_pairCache->getOverlapFilterCallback() == 0);
+	chooseSweepAxis();
+	sortProxies();
+
+	m_taskPairs.resizeNoInitialize(m_taskCount);
+	for (int i = 0; i < m_threadPairs.size(); ++i)
+	{
+		m_threadPairs[i].resizeNoInitialize(0);
+	}
+	{
+		BT_PROFILE("sweepTasks");
+		btSapBroadphaseLoop loop(this, btSapBroadphaseLoop::STAGE_SWEEP);
+		btParallelFor(0, m_taskCount, 1, loop);
+	}
+
+	if (m_pairCache->hasConcurrentInsertion())
+	{
+		// every task adds its own pairs, the cache orders the new pairs if it is set to
+		BT_PROFILE("addPairsConcurrent");
+		btConcurrentOverlappingPairCache* pairCache = static_cast<btConcurrentOverlappingPairCache*>(m_pairCache);
+		pairCache->beginConcurrentInsertion(btMax(pairCache->getNumNewPairs() * 2, BT_SAP_MIN_NEW_PAIRS));
+		btSapBroadphaseLoop loop(this, btSapBroadphaseLoop::STAGE_ADD_PAIRS);
+		btParallelFor(0, m_taskCount, 1, loop);
+		pairCache->endConcurrentInsertion();
+	}
+	else
+	{
+		// merge in task order so the pair cache does not depend on which thread ran which task
+		BT_PROFILE("mergePairs");
+		for (int i = 0; i < m_taskCount; ++i)
+		{
+			addPairsTask(i);
+		}
+	}
+
+	{
+		// every overlapping pair was just added, so the pairs whose boxes are apart are the stale ones
+		BT_PROFILE("removeStalePairs");
+		const int numPairs = m_pairCache->getNumOverlappingPairs();
+		m_removePairs.resizeNoInitialize(numPairs);
+		{
+			btSapBroadphaseLoop loop(this, btSapBroadphaseLoop::STAGE_TEST_PAIRS);
+			btParallelFor(0, numPairs, 500, loop);
+		}
+		// backwards, a removal moves the last pair, which is already tested and kept, into the freed slot
+		btBroadphasePairArray& pairArray = m_pairCache->getOverlappingPairArray();
+		for (int i = numPairs - 1; i >= 0; --i)
+		{
+			if (m_removePairs[i])
+			{
+				m_pairCache->removeOverlappingPair(pairArray[i].m_pProxy0, pairArray[i].m_pProxy1, dispatcher);
+			}
+		}
+	}
+}
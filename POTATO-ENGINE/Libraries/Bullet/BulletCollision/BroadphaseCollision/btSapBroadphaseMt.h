@@ -0,0 +1,139 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_SAP_BROADPHASE_MT_H
+#define BT_SAP_BROADPHASE_MT_H
+
+#include "btBroadphaseInterface.h"
+#include "btOverlappingPairCache.h"
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btParallelRadixSort.h"
+
+struct btSapBroadphaseMtProxy : public btBroadphaseProxy
+{
+	int m_index;  // position in btSapBroadphaseMt::m_proxies
+
+	btSapBroadphaseMtProxy(const btVector3& aabbMin, const btVector3& aabbMax, void* userPtr, int collisionFilterGroup, int collisionFilterMask)
+		: btBroadphaseProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask),
+		  m_index(-1)
+	{
+	}
+};
+
+///The btSapBroadphaseMt is a sweep and prune broadphase that sorts all proxies again at every calculateOverlappingPairs,
+///on the task scheduler, following the host path of b3GpuSapBroadphase.
+///The proxies are radix sorted by the minimum of their box along the axis where the box centers have the largest variance.
+///Each proxy is then swept against the proxies after it until their minimum passes its maximum, in a fixed number of tasks
+///that collect their pairs into per-thread buffers. The pairs are added to the pair cache in task order and the pairs that no
+///longer overlap are removed, so the pair cache comes out the same for any number of threads.
+///With a btConcurrentOverlappingPairCache the tasks add their pairs to the cache in parallel instead, and the cache comes out
+///the same only if it is set to a deterministic order.
+///Unlike btAxisSweep3 nothing is done in setAabb, and unlike btDbvtBroadphase there is no tree to maintain, which suits scenes
+///where most proxies move at every step. Ray and box queries test every proxy, so prefer btDbvtBroadphase for query heavy use.
+class btSapBroadphaseMt : public btBroadphaseInterface
+{
+public:
+	btSapBroadphaseMt(btOverlappingPairCache* pairCache = 0);
+	virtual ~btSapBroadphaseMt();
+
+	virtual btBroadphaseProxy* createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* dispatcher) BT_OVERRIDE;
+	virtual void destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher) BT_OVERRIDE;
+	virtual void setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher) BT_OVERRIDE;
+	virtual void getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const BT_OVERRIDE;
+
+	virtual void rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin = btVector3(0, 0, 0), const btVector3& aabbMax = btVector3(0, 0, 0)) BT_OVERRIDE;
+	virtual void aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback) BT_OVERRIDE;
+
+	virtual void calculateOverlappingPairs(btDispatcher* dispatcher) BT_OVERRIDE;
+
+	virtual btOverlappingPairCache* getOverlappingPairCache() BT_OVERRIDE
+	{
+		return m_pairCache;
+	}
+	virtual const btOverlappingPairCache* getOverlappingPairCache() const BT_OVERRIDE
+	{
+		return m_pairCache;
+	}
+
+	virtual void getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const BT_OVERRIDE;
+	virtual void printStats() BT_OVERRIDE
+	{
+	}
+
+	///number of tasks the sort and the sweep are cut into, independently of the thread count
+	void setTaskCount(int taskCount)
+	{
+		m_taskCount = btMax(taskCount, 1);
+	}
+	int getTaskCount() const
+	{
+		return m_taskCount;
+	}
+	///axis of the last sweep
+	int getSweepAxis() const
+	{
+		return m_axis;
+	}
+
+	///copy of a proxy in sweep order, so that the sweep reads consecutive memory
+	struct btSortedProxy
+	{
+		btVector3 m_aabbMin;
+		btVector3 m_aabbMax;
+		unsigned int m_minKey;  // radix sort keys of the minimum and maximum along the sweep axis
+		unsigned int m_maxKey;
+		int m_collisionFilterGroup;
+		int m_collisionFilterMask;
+		btBroadphaseProxy* m_proxy;
+	};
+
+	struct btProxyPair
+	{
+		btBroadphaseProxy* m_proxy0;
+		btBroadphaseProxy* m_proxy1;
+	};
+
+	///pairs found by a task, a range of the buffer of the thread that ran it
+	struct btTaskPairs
+	{
+		int m_threadIndex;
+		int m_begin;
+		int m_end;
+	};
+
+	void chooseSweepAxis();
+	void sortProxies();
+	void sweepTask(int taskIndex);
+	void initKeys(int iBegin, int iEnd);
+	void gatherSorted(int iBegin, int iEnd);
+	void addPairsTask(int taskIndex);
+	void testPairs(int iBegin, int iEnd);
+
+	btOverlappingPairCache* m_pairCache;
+	bool m_ownsPairCache;
+	bool m_filterPairs;  // the tasks test the collision filter masks, only without an overlap filter callback
+	int m_taskCount;
+	int m_axis;
+	int m_nextUniqueId;
+	btAlignedObjectArray<btSapBroadphaseMtProxy*> m_proxies;
+	btParallelRadixSort m_sort;  // minimum keys along the sweep axis, with proxy indices as values
+	btAlignedObjectArray<btSortedProxy> m_sorted;
+	btAlignedObjectArray<btTaskPairs> m_taskPairs;
+	btAlignedObjectArray<btAlignedObjectArray<btProxyPair> > m_threadPairs;
+	btAlignedObjectArray<char> m_removePairs;
+};
+
+#endif  //BT_SAP_BROADPHASE_MT_H
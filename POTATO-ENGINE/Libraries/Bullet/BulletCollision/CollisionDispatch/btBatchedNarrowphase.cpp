@@ -0,0 +1,707 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose, 
+including commercial applications, and to alter it and redistribute it freely, 
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btBatchedNarrowphase.h"
+#include "BulletCollision/BroadphaseCollision/btCollisionAlgorithm.h"
+#include "BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcher.h"
+#include "BulletCollision/CollisionDispatch/btCollisionObject.h"
+#include "BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h"
+#include "BulletCollision/CollisionDispatch/btManifoldResult.h"
+#include "BulletCollision/CollisionShapes/btBoxShape.h"
+#include "BulletCollision/CollisionShapes/btCapsuleShape.h"
+#include "BulletCollision/CollisionShapes/btSphereShape.h"
+#include "BulletCollision/CollisionShapes/btStaticPlaneShape.h"
+#include "BulletCollision/NarrowPhaseCollision/btPersistentManifold.h"
+#include "LinearMath/btQuickprof.h"
+
+#include <atomic>
+
+// pairs gathered into the SoA arrays of a kernel at a time
+#define BT_NARROWPHASE_BLOCK_SIZE 64
+
+// sort keys are the kernel above the two shape types, which fit in 8 bits each
+static const int btNarrowphaseKernelShift = 16;
+static const int btNarrowphaseKeyBits = btNarrowphaseKernelShift + 3;
+// pairs that do not need collision, or have no algorithm, sort after every kernel
+static const unsigned int btNarrowphaseSkipKey = (unsigned int)btBatchedNarrowphase::KERNEL_COUNT << btNarrowphaseKernelShift;
+
+struct btNarrowphaseContext
+{
+	btBroadphasePair* m_pairs;
+	btPersistentManifold* const* m_pairManifolds;
+	const int* m_sortedPairs;
+	btCollisionDispatcher* m_dispatcher;
+	const btDispatcherInfo* m_info;
+	std::atomic<int>* m_numTestedPairsTouching;
+
+	btPersistentManifold* getManifold(int sortedIndex) const
+	{
+		return m_pairManifolds[m_sortedPairs[sortedIndex]];
+	}
+
+	void processPair(int sortedIndex) const
+	{
+		m_dispatcher->getNearCallback()(m_pairs[m_sortedPairs[sortedIndex]], *m_dispatcher, *m_info);
+	}
+};
+
+// adds a contact with normalOnB pointing from body 1 to body 0 of the manifold, as the collision algorithms report them;
+// swapped when the kernel took body 1 as A, which turns the contact around
+static void btNarrowphaseAddContact(btPersistentManifold* manifold, bool swapped, const btVector3& normalOnB, const btVector3& pointOnB, btScalar depth)
+{
+	const btCollisionObject* body0 = manifold->getBody0();
+	const btCollisionObject* body1 = manifold->getBody1();
+	btCollisionObjectWrapper body0Wrap(0, body0->getCollisionShape(), body0, body0->getWorldTransform(), -1, -1);
+	btCollisionObjectWrapper body1Wrap(0, body1->getCollisionShape(), body1, body1->getWorldTransform(), -1, -1);
+	btManifoldResult result(&body0Wrap, &body1Wrap);
+	result.setPersistentManifold(manifold);
+	if (swapped)
+	{
+		result.addContactPoint(-normalOnB, pointOnB + normalOnB * depth, depth);
+	}
+	else
+	{
+		result.addContactPoint(normalOnB, pointOnB, depth);
+	}
+}
+
+static void btNarrowphaseRefreshContacts(btPersistentManifold* manifold)
+{
+	if (manifold->getNumContacts())
+	{
+		manifold->refreshContactPoints(manifold->getBody0()->getWorldTransform(), manifold->getBody1()->getWorldTransform());
+	}
+}
+
+// same as btSphereSphereCollisionAlgorithm
+static void btNarrowphaseSphereSphere(const btNarrowphaseContext& context, int iBegin, int iEnd)
+{
+	btScalar dx[BT_NARROWPHASE_BLOCK_SIZE], dy[BT_NARROWPHASE_BLOCK_SIZE], dz[BT_NARROWPHASE_BLOCK_SIZE];
+	btScalar radius0[BT_NARROWPHASE_BLOCK_SIZE], radius1[BT_NARROWPHASE_BLOCK_SIZE];
+	btScalar length[BT_NARROWPHASE_BLOCK_SIZE];
+	const int count = iEnd - iBegin;
+
+	for (int i = 0; i < count; ++i)
+	{
+		const btPersistentManifold* manifold = context.getManifold(iBegin + i);
+		const btVector3& origin0 = manifold->getBody0()->getWorldTransform().getOrigin();
+		const btVector3& origin1 = manifold->getBody1()->getWorldTransform().getOrigin();
+		dx[i] = origin0.x() - origin1.x();
+		dy[i] = origin0.y() - origin1.y();
+		dz[i] = origin0.z() - origin1.z();
+		radius0[i] = static_cast<const btSphereShape*>(manifold->getBody0()->getCollisionShape())->getRadius();
+		radius1[i] = static_cast<const btSphereShape*>(manifold->getBody1()->getCollisionShape())->getRadius();
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		length[i] = btSqrt(dx[i] * dx[i] + dy[i] * dy[i] + dz[i] * dz[i]);
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		btPersistentManifold* manifold = context.getManifold(iBegin + i);
+		// the algorithm keeps only the latest contact
+		manifold->clearManifold();
+		const btScalar distance = length[i] - (radius0[i] + radius1[i]);
+		if (distance <= btScalar(0))
+		{
+			btVector3 normalOnB(1, 0, 0);
+			if (length[i] > SIMD_EPSILON)
+			{
+				normalOnB = btVector3(dx[i], dy[i], dz[i]) / length[i];
+			}
+			const btVector3 pointOnB = manifold->getBody1()->getWorldTransform().getOrigin() + radius1[i] * normalOnB;
+			btNarrowphaseAddContact(manifold, false, normalOnB, pointOnB, distance);
+		}
+	}
+}
+
+// same as btSphereBoxCollisionAlgorithm::getSpherePenetration, for a sphere center inside the box
+static btScalar btNarrowphaseSphereBoxPenetration(const btVector3& halfExtents, const btVector3& sphereRelPos, btVector3& closestPoint, btVector3& normal)
+{
+	btScalar minDistance = halfExtents.getX() - sphereRelPos.getX();
+	closestPoint = sphereRelPos;
+	closestPoint.setX(halfExtents.getX());
+	normal.setValue(1, 0, 0);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		for (int side = (axis == 0 ? 1 : 0); side < 2; ++side)
+		{
+			const btScalar sign = side ? btScalar(-1) : btScalar(1);
+			const btScalar faceDistance = halfExtents[axis] - sign * sphereRelPos[axis];
+			if (faceDistance < minDistance)
+			{
+				minDistance = faceDistance;
+				closestPoint = sphereRelPos;
+				closestPoint[axis] = sign * halfExtents[axis];
+				normal.setValue(0, 0, 0);
+				normal[axis] = sign;
+			}
+		}
+	}
+	return minDistance;
+}
+
+// same as btSphereBoxCollisionAlgorithm, with the box margin rounding the box
+static void btNarrowphaseSphereBox(const btNarrowphaseContext& context, int iBegin, int iEnd)
+{
+	btScalar relX[BT_NARROWPHASE_BLOCK_SIZE], relY[BT_NARROWPHASE_BLOCK_SIZE], relZ[BT_NARROWPHASE_BLOCK_SIZE];
+	btScalar halfX[BT_NARROWPHASE_BLOCK_SIZE], halfY[BT_NARROWPHASE_BLOCK_SIZE], halfZ[BT_NARROWPHASE_BLOCK_SIZE];
+	btScalar closestX[BT_NARROWPHASE_BLOCK_SIZE], closestY[BT_NARROWPHASE_BLOCK_SIZE], closestZ[BT_NARROWPHASE_BLOCK_SIZE];
+	btScalar contactDistance[BT_NARROWPHASE_BLOCK_SIZE], distance2[BT_NARROWPHASE_BLOCK_SIZE];
+	const int count = iEnd - iBegin;
+
+	for (int i = 0; i < count; ++i)
+	{
+		const btPersistentManifold* manifold = context.getManifold(iBegin + i);
+		const bool swapped = manifold->getBody0()->getCollisionShape()->getShapeType() == BOX_SHAPE_PROXYTYPE;
+		const btCollisionObject* sphereObject = swapped ? manifold->getBody1() : manifold->getBody0();
+		const btCollisionObject* boxObject = swapped ? manifold->getBody0() : manifold->getBody1();
+		const btBoxShape* box = static_cast<const btBoxShape*>(boxObject->getCollisionShape());
+		const btScalar radius = static_cast<const btSphereShape*>(sphereObject->getCollisionShape())->getRadius();
+		// sphere center in the space of the box
+		const btVector3 relPos = boxObject->getWorldTransform().invXform(sphereObject->getWorldTransform().getOrigin());
+		relX[i] = relPos.x();
+		relY[i] = relPos.y();
+		relZ[i] = relPos.z();
+		const btVector3& halfExtents = box->getHalfExtentsWithoutMargin();
+		halfX[i] = halfExtents.x();
+		halfY[i] = halfExtents.y();
+		halfZ[i] = halfExtents.z();
+		contactDistance[i] = radius + box->getMargin() + manifold->getContactBreakingThreshold();
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		closestX[i] = btMax(-halfX[i], btMin(halfX[i], relX[i]));
+		closestY[i] = btMax(-halfY[i], btMin(halfY[i], relY[i]));
+		closestZ[i] = btMax(-halfZ[i], btMin(halfZ[i], relZ[i]));
+		const btScalar nx = relX[i] - closestX[i];
+		const btScalar ny = relY[i] - closestY[i];
+		const btScalar nz = relZ[i] - closestZ[i];
+		distance2[i] = nx * nx + ny * ny + nz * nz;
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		btPersistentManifold* manifold = context.getManifold(iBegin + i);
+		if (distance2[i] <= contactDistance[i] * contactDistance[i])
+		{
+			const bool swapped = manifold->getBody0()->getCollisionShape()->getShapeType() == BOX_SHAPE_PROXYTYPE;
+			const btCollisionObject* sphereObject = swapped ? manifold->getBody1() : manifold->getBody0();
+			const btCollisionObject* boxObject = swapped ? manifold->getBody0() : manifold->getBody1();
+			const btScalar boxMargin = static_cast<const btBoxShape*>(boxObject->getCollisionShape())->getMargin();
+			const btScalar radius = static_cast<const btSphereShape*>(sphereObject->getCollisionShape())->getRadius();
+			const btVector3 relPos(relX[i], relY[i], relZ[i]);
+			btVector3 closestPoint(closestX[i], closestY[i], closestZ[i]);
+			btVector3 normal = relPos - closestPoint;
+			btScalar distance;
+			if (distance2[i] <= SIMD_EPSILON)
+			{
+				distance = -btNarrowphaseSphereBoxPenetration(btVector3(halfX[i], halfY[i], halfZ[i]), relPos, closestPoint, normal);
+			}
+			else
+			{
+				distance = btSqrt(distance2[i]);
+				normal /= distance;
+			}
+			const btTransform& boxTransform = boxObject->getWorldTransform();
+			const btVector3 pointOnBox = boxTransform(closestPoint + normal * boxMargin);
+			btNarrowphaseAddContact(manifold, swapped, boxTransform.getBasis() * normal, pointOnBox, distance - (radius + boxMargin));
+		}
+		btNarrowphaseRefreshContacts(manifold);
+	}
+}
+
+// same as the capsule/capsule case of btConvexConvexAlgorithm: closest points of the two segments
+static void btNarrowphaseCapsuleCapsule(const btNarrowphaseContext& context, int iBegin, int iEnd)
+{
+	btScalar dirAX[BT_NARROWPHASE_BLOCK_SIZE], dirAY[BT_NARROWPHASE_BLOCK_SIZE], dirAZ[BT_NARROWPHASE_BLOCK_SIZE];
+	btScalar dirBX[BT_NARROWPHASE_BLOCK_SIZE], dirBY[BT_NARROWPHASE_BLOCK_SIZE], dirBZ[BT_NARROWPHASE_BLOCK_SIZE];
+	btScalar transX[BT_NARROWPHASE_BLOCK_SIZE], transY[BT_NARROWPHASE_BLOCK_SIZE], transZ[BT_NARROWPHASE_BLOCK_SIZE];
+	btScalar halfHeightA[BT_NARROWPHASE_BLOCK_SIZE], halfHeightB[BT_NARROWPHASE_BLOCK_SIZE];
+	btScalar radiusSum[BT_NARROWPHASE_BLOCK_SIZE];
+	btScalar tB[BT_NARROWPHASE_BLOCK_SIZE], ptsX[BT_NARROWPHASE_BLOCK_SIZE], ptsY[BT_NARROWPHASE_BLOCK_SIZE], ptsZ[BT_NARROWPHASE_BLOCK_SIZE];
+	btScalar length2[BT_NARROWPHASE_BLOCK_SIZE];
+	const int count = iEnd - iBegin;
+
+	for (int i = 0; i < count; ++i)
+	{
+		const btPersistentManifold* manifold = context.getManifold(iBegin + i);
+		const btTransform& transformA = manifold->getBody0()->getWorldTransform();
+		const btTransform& transformB = manifold->getBody1()->getWorldTransform();
+		const btCapsuleShape* capsuleA = static_cast<const btCapsuleShape*>(manifold->getBody0()->getCollisionShape());
+		const btCapsuleShape* capsuleB = static_cast<const btCapsuleShape*>(manifold->getBody1()->getCollisionShape());
+		const btVector3 dirA = transformA.getBasis().getColumn(capsuleA->getUpAxis());
+		const btVector3 dirB = transformB.getBasis().getColumn(capsuleB->getUpAxis());
+		const btVector3 translation = transformB.getOrigin() - transformA.getOrigin();
+		dirAX[i] = dirA.x();
+		dirAY[i] = dirA.y();
+		dirAZ[i] = dirA.z();
+		dirBX[i] = dirB.x();
+		dirBY[i] = dirB.y();
+		dirBZ[i] = dirB.z();
+		transX[i] = translation.x();
+		transY[i] = translation.y();
+		transZ[i] = translation.z();
+		halfHeightA[i] = capsuleA->getHalfHeight();
+		halfHeightB[i] = capsuleB->getHalfHeight();
+		radiusSum[i] = capsuleA->getRadius() + capsuleB->getRadius();
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		const btScalar dirADotDirB = dirAX[i] * dirBX[i] + dirAY[i] * dirBY[i] + dirAZ[i] * dirBZ[i];
+		const btScalar dirADotTrans = dirAX[i] * transX[i] + dirAY[i] * transY[i] + dirAZ[i] * transZ[i];
+		const btScalar dirBDotTrans = dirBX[i] * transX[i] + dirBY[i] * transY[i] + dirBZ[i] * transZ[i];
+		const btScalar denom = btScalar(1) - dirADotDirB * dirADotDirB;
+		// parallel segments take the center of A
+		const btScalar safeDenom = denom == btScalar(0) ? btScalar(1) : denom;
+		btScalar a = denom == btScalar(0) ? btScalar(0) : (dirADotTrans - dirBDotTrans * dirADotDirB) / safeDenom;
+		a = btMax(-halfHeightA[i], btMin(halfHeightA[i], a));
+		const btScalar b = a * dirADotDirB - dirBDotTrans;
+		const btScalar clampedB = btMax(-halfHeightB[i], btMin(halfHeightB[i], b));
+		// when the closest point on B was clamped, the closest point on A is found again from it
+		const btScalar aFromB = btMax(-halfHeightA[i], btMin(halfHeightA[i], clampedB * dirADotDirB + dirADotTrans));
+		a = clampedB != b ? aFromB : a;
+		tB[i] = clampedB;
+		ptsX[i] = transX[i] - dirAX[i] * a + dirBX[i] * clampedB;
+		ptsY[i] = transY[i] - dirAY[i] * a + dirBY[i] * clampedB;
+		ptsZ[i] = transZ[i] - dirAZ[i] * a + dirBZ[i] * clampedB;
+		length2[i] = ptsX[i] * ptsX[i] + ptsY[i] * ptsY[i] + ptsZ[i] * ptsZ[i];
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		btPersistentManifold* manifold = context.getManifold(iBegin + i);
+		const btScalar distance = btSqrt(length2[i]) - radiusSum[i];
+		if (distance < manifold->getContactBreakingThreshold())
+		{
+			const btVector3 pts(ptsX[i], ptsY[i], ptsZ[i]);
+			const btVector3 dirB(dirBX[i], dirBY[i], dirBZ[i]);
+			btVector3 normalOnB;
+			if (length2[i] <= (SIMD_EPSILON * SIMD_EPSILON))
+			{
+				// degenerate case where the capsules are likely at the same location: take a vector tangential to A
+				btVector3 q;
+				btPlaneSpace1(btVector3(dirAX[i], dirAY[i], dirAZ[i]), normalOnB, q);
+			}
+			else
+			{
+				normalOnB = pts * -btRecipSqrt(length2[i]);
+			}
+			const btScalar radiusB = static_cast<const btCapsuleShape*>(manifold->getBody1()->getCollisionShape())->getRadius();
+			const btVector3 pointOnB = manifold->getBody1()->getWorldTransform().getOrigin() + dirB * tB[i] + normalOnB * radiusB;
+			btNarrowphaseAddContact(manifold, false, normalOnB, pointOnB, distance);
+		}
+		btNarrowphaseRefreshContacts(manifold);
+	}
+}
+
+// same as btConvexPlaneCollisionAlgorithm for a sphere, which is not polyhedral and gets no perturbed contacts
+static void btNarrowphaseSpherePlane(const btNarrowphaseContext& context, int iBegin, int iEnd)
+{
+	btScalar centerX[BT_NARROWPHASE_BLOCK_SIZE], centerY[BT_NARROWPHASE_BLOCK_SIZE], centerZ[BT_NARROWPHASE_BLOCK_SIZE];
+	btScalar normalX[BT_NARROWPHASE_BLOCK_SIZE], normalY[BT_NARROWPHASE_BLOCK_SIZE], normalZ[BT_NARROWPHASE_BLOCK_SIZE];
+	btScalar offset[BT_NARROWPHASE_BLOCK_SIZE], distance[BT_NARROWPHASE_BLOCK_SIZE];
+	const int count = iEnd - iBegin;
+
+	for (int i = 0; i < count; ++i)
+	{
+		const btPersistentManifold* manifold = context.getManifold(iBegin + i);
+		const bool swapped = manifold->getBody0()->getCollisionShape()->getShapeType() == STATIC_PLANE_PROXYTYPE;
+		const btCollisionObject* sphereObject = swapped ? manifold->getBody1() : manifold->getBody0();
+		const btCollisionObject* planeObject = swapped ? manifold->getBody0() : manifold->getBody1();
+		const btStaticPlaneShape* plane = static_cast<const btStaticPlaneShape*>(planeObject->getCollisionShape());
+		// sphere center in the space of the plane
+		const btVector3 center = planeObject->getWorldTransform().invXform(sphereObject->getWorldTransform().getOrigin());
+		centerX[i] = center.x();
+		centerY[i] = center.y();
+		centerZ[i] = center.z();
+		const btVector3& planeNormal = plane->getPlaneNormal();
+		normalX[i] = planeNormal.x();
+		normalY[i] = planeNormal.y();
+		normalZ[i] = planeNormal.z();
+		offset[i] = plane->getPlaneConstant() + static_cast<const btSphereShape*>(sphereObject->getCollisionShape())->getRadius();
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		distance[i] = normalX[i] * centerX[i] + normalY[i] * centerY[i] + normalZ[i] * centerZ[i] - offset[i];
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		btPersistentManifold* manifold = context.getManifold(iBegin + i);
+		if (distance[i] < manifold->getContactBreakingThreshold())
+		{
+			const bool swapped = manifold->getBody0()->getCollisionShape()->getShapeType() == STATIC_PLANE_PROXYTYPE;
+			const btCollisionObject* sphereObject = swapped ? manifold->getBody1() : manifold->getBody0();
+			const btTransform& planeTransform = (swapped ? manifold->getBody0() : manifold->getBody1())->getWorldTransform();
+			const btScalar radius = static_cast<const btSphereShape*>(sphereObject->getCollisionShape())->getRadius();
+			const btVector3 planeNormal(normalX[i], normalY[i], normalZ[i]);
+			// deepest point of the sphere, projected on the plane
+			const btVector3 pointInPlane = btVector3(centerX[i], centerY[i], centerZ[i]) - planeNormal * (radius + distance[i]);
+			btNarrowphaseAddContact(manifold, swapped, planeTransform.getBasis() * planeNormal, planeTransform(pointInPlane), distance[i]);
+		}
+		btNarrowphaseRefreshContacts(manifold);
+	}
+}
+
+// separation of two boxes on the face axes of both, as the first six axes of btBoxBoxDetector; pairs closer than
+// the contact breaking threshold run their collision algorithm
+static void btNarrowphaseBoxBox(const btNarrowphaseContext& context, int iBegin, int iEnd)
+{
+	btScalar rotation[9][BT_NARROWPHASE_BLOCK_SIZE];  // dot products of the axes of box A and box B
+	btScalar transA[3][BT_NARROWPHASE_BLOCK_SIZE];    // translation from A to B in the space of A
+	btScalar halfA[3][BT_NARROWPHASE_BLOCK_SIZE], halfB[3][BT_NARROWPHASE_BLOCK_SIZE];
+	btScalar separation[BT_NARROWPHASE_BLOCK_SIZE];
+	const int count = iEnd - iBegin;
+
+	for (int i = 0; i < count; ++i)
+	{
+		const btPersistentManifold* manifold = context.getManifold(iBegin + i);
+		const btTransform& transformA = manifold->getBody0()->getWorldTransform();
+		const btTransform& transformB = manifold->getBody1()->getWorldTransform();
+		const btMatrix3x3 basis = transformA.getBasis().transposeTimes(transformB.getBasis());
+		for (int j = 0; j < 3; ++j)
+		{
+			rotation[j * 3 + 0][i] = basis[j].x();
+			rotation[j * 3 + 1][i] = basis[j].y();
+			rotation[j * 3 + 2][i] = basis[j].z();
+		}
+		const btVector3 translation = transformA.invXform(transformB.getOrigin());
+		const btVector3 extentsA = static_cast<const btBoxShape*>(manifold->getBody0()->getCollisionShape())->getHalfExtentsWithMargin();
+		const btVector3 extentsB = static_cast<const btBoxShape*>(manifold->getBody1()->getCollisionShape())->getHalfExtentsWithMargin();
+		for (int j = 0; j < 3; ++j)
+		{
+			transA[j][i] = translation[j];
+			halfA[j][i] = extentsA[j];
+			halfB[j][i] = extentsB[j];
+		}
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		btScalar maxSeparation = -BT_LARGE_FLOAT;
+		for (int j = 0; j < 3; ++j)
+		{
+			// axis j of A
+			const btScalar extentA = halfA[j][i] + halfB[0][i] * btFabs(rotation[j * 3 + 0][i]) + halfB[1][i] * btFabs(rotation[j * 3 + 1][i]) + halfB[2][i] * btFabs(rotation[j * 3 + 2][i]);
+			maxSeparation = btMax(maxSeparation, btFabs(transA[j][i]) - extentA);
+			// axis j of B
+			const btScalar extentB = halfB[j][i] + halfA[0][i] * btFabs(rotation[0 + j][i]) + halfA[1][i] * btFabs(rotation[3 + j][i]) + halfA[2][i] * btFabs(rotation[6 + j][i]);
+			const btScalar transB = transA[0][i] * rotation[0 + j][i] + transA[1][i] * rotation[3 + j][i] + transA[2][i] * rotation[6 + j][i];
+			maxSeparation = btMax(maxSeparation, btFabs(transB) - extentB);
+		}
+		separation[i] = maxSeparation;
+	}
+
+	int numTouching = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		btPersistentManifold* manifold = context.getManifold(iBegin + i);
+		if (separation[i] > manifold->getContactBreakingThreshold())
+		{
+			btNarrowphaseRefreshContacts(manifold);
+		}
+		else
+		{
+			context.processPair(iBegin + i);
+			++numTouching;
+		}
+	}
+	context.m_numTestedPairsTouching->fetch_add(numTouching, std::memory_order_relaxed);
+}
+
+// support distance of a box to a plane; pairs closer than the contact breaking threshold run their collision algorithm.
+// The perturbed contacts of btConvexPlaneCollisionAlgorithm are corners of the unperturbed box, never deeper than this
+static void btNarrowphaseBoxPlane(const btNarrowphaseContext& context, int iBegin, int iEnd)
+{
+	btScalar normalX[BT_NARROWPHASE_BLOCK_SIZE], normalY[BT_NARROWPHASE_BLOCK_SIZE], normalZ[BT_NARROWPHASE_BLOCK_SIZE];  // plane normal in the space of the box
+	btScalar halfX[BT_NARROWPHASE_BLOCK_SIZE], halfY[BT_NARROWPHASE_BLOCK_SIZE], halfZ[BT_NARROWPHASE_BLOCK_SIZE];
+	btScalar centerDistance[BT_NARROWPHASE_BLOCK_SIZE];
+	btScalar distance[BT_NARROWPHASE_BLOCK_SIZE];
+	const int count = iEnd - iBegin;
+
+	for (int i = 0; i < count; ++i)
+	{
+		const btPersistentManifold* manifold = context.getManifold(iBegin + i);
+		const bool swapped = manifold->getBody0()->getCollisionShape()->getShapeType() == STATIC_PLANE_PROXYTYPE;
+		const btCollisionObject* boxObject = swapped ? manifold->getBody1() : manifold->getBody0();
+		const btCollisionObject* planeObject = swapped ? manifold->getBody0() : manifold->getBody1();
+		const btStaticPlaneShape* plane = static_cast<const btStaticPlaneShape*>(planeObject->getCollisionShape());
+		const btTransform& boxTransform = boxObject->getWorldTransform();
+		const btTransform& planeTransform = planeObject->getWorldTransform();
+		const btVector3 planeNormal = planeTransform.getBasis() * plane->getPlaneNormal();
+		const btVector3 normal = boxTransform.getBasis().transpose() * planeNormal;
+		normalX[i] = normal.x();
+		normalY[i] = normal.y();
+		normalZ[i] = normal.z();
+		const btVector3 halfExtents = static_cast<const btBoxShape*>(boxObject->getCollisionShape())->getHalfExtentsWithMargin();
+		halfX[i] = halfExtents.x();
+		halfY[i] = halfExtents.y();
+		halfZ[i] = halfExtents.z();
+		centerDistance[i] = planeNormal.dot(boxTransform.getOrigin() - planeTransform.getOrigin()) - plane->getPlaneConstant();
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		distance[i] = centerDistance[i] - (halfX[i] * btFabs(normalX[i]) + halfY[i] * btFabs(normalY[i]) + halfZ[i] * btFabs(normalZ[i]));
+	}
+
+	int numTouching = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		btPersistentManifold* manifold = context.getManifold(iBegin + i);
+		if (distance[i] > manifold->getContactBreakingThreshold())
+		{
+			btNarrowphaseRefreshContacts(manifold);
+		}
+		else
+		{
+			context.processPair(iBegin + i);
+			++numTouching;
+		}
+	}
+	context.m_numTestedPairsTouching->fetch_add(numTouching, std::memory_order_relaxed);
+}
+
+struct btNarrowphaseClassifyLoop : public btIParallelForBody
+{
+	btBroadphasePair* m_pairs;
+	btCollisionDispatcher* m_dispatcher;
+	unsigned int* m_keys;
+	int* m_values;
+	btPersistentManifold** m_pairManifolds;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		btManifoldArray manifolds;
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			btBroadphasePair& pair = m_pairs[i];
+			btCollisionObject* colObj0 = (btCollisionObject*)pair.m_pProxy0->m_clientObject;
+			btCollisionObject* colObj1 = (btCollisionObject*)pair.m_pProxy1->m_clientObject;
+			unsigned int key = btNarrowphaseSkipKey;
+			btPersistentManifold* manifold = 0;
+
+			// as btCollisionDispatcher::defaultNearCallback
+			if (m_dispatcher->needsCollision(colObj0, colObj1))
+			{
+				if (!pair.m_algorithm)
+				{
+					btCollisionObjectWrapper obj0Wrap(0, colObj0->getCollisionShape(), colObj0, colObj0->getWorldTransform(), -1, -1);
+					btCollisionObjectWrapper obj1Wrap(0, colObj1->getCollisionShape(), colObj1, colObj1->getWorldTransform(), -1, -1);
+					pair.m_algorithm = m_dispatcher->findAlgorithm(&obj0Wrap, &obj1Wrap, 0, BT_CONTACT_POINT_ALGORITHMS);
+				}
+				if (pair.m_algorithm)
+				{
+					const int shapeType0 = colObj0->getCollisionShape()->getShapeType();
+					const int shapeType1 = colObj1->getCollisionShape()->getShapeType();
+					int kernel = btBatchedNarrowphase::getKernel(shapeType0, shapeType1);
+					if (kernel != btBatchedNarrowphase::KERNEL_GENERIC)
+					{
+						// the kernels write to the manifold of the algorithm, which most algorithms create with the algorithm
+						manifolds.resizeNoInitialize(0);
+						pair.m_algorithm->getAllContactManifolds(manifolds);
+						if (manifolds.size() == 1)
+						{
+							manifold = manifolds[0];
+						}
+						else
+						{
+							kernel = btBatchedNarrowphase::KERNEL_GENERIC;
+						}
+					}
+					key = ((unsigned int)kernel << btNarrowphaseKernelShift) | ((unsigned int)shapeType0 << 8) | (unsigned int)shapeType1;
+				}
+			}
+			m_keys[i] = key;
+			m_values[i] = i;
+			m_pairManifolds[i] = manifold;
+		}
+	}
+};
+
+struct btNarrowphaseKernelLoop : public btIParallelForBody
+{
+	const btNarrowphaseContext* m_context;
+	int m_kernel;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int blockBegin = iBegin; blockBegin < iEnd; blockBegin += BT_NARROWPHASE_BLOCK_SIZE)
+		{
+			const int blockEnd = btMin(blockBegin + BT_NARROWPHASE_BLOCK_SIZE, iEnd);
+			switch (m_kernel)
+			{
+				case btBatchedNarrowphase::KERNEL_SPHERE_SPHERE:
+					btNarrowphaseSphereSphere(*m_context, blockBegin, blockEnd);
+					break;
+				case btBatchedNarrowphase::KERNEL_SPHERE_BOX:
+					btNarrowphaseSphereBox(*m_context, blockBegin, blockEnd);
+					break;
+				case btBatchedNarrowphase::KERNEL_CAPSULE_CAPSULE:
+					btNarrowphaseCapsuleCapsule(*m_context, blockBegin, blockEnd);
+					break;
+				case btBatchedNarrowphase::KERNEL_SPHERE_PLANE:
+					btNarrowphaseSpherePlane(*m_context, blockBegin, blockEnd);
+					break;
+				case btBatchedNarrowphase::KERNEL_BOX_BOX:
+					btNarrowphaseBoxBox(*m_context, blockBegin, blockEnd);
+					break;
+				case btBatchedNarrowphase::KERNEL_BOX_PLANE:
+					btNarrowphaseBoxPlane(*m_context, blockBegin, blockEnd);
+					break;
+				default:
+					for (int i = blockBegin; i < blockEnd; ++i)
+					{
+						m_context->processPair(i);
+					}
+					break;
+			}
+		}
+	}
+};
+
+btBatchedNarrowphase::btBatchedNarrowphase()
+	: m_numTestedPairsTouching(0)
+{
+	for (int i = 0; i <= KERNEL_COUNT; ++i)
+	{
+		m_kernelBegin[i] = 0;
+	}
+}
+
+int btBatchedNarrowphase::getKernel(int shapeType0, int shapeType1)
+{
+	const int minType = btMin(shapeType0, shapeType1);
+	const int maxType = btMax(shapeType0, shapeType1);
+	if (minType == SPHERE_SHAPE_PROXYTYPE && maxType == SPHERE_SHAPE_PROXYTYPE)
+	{
+		return KERNEL_SPHERE_SPHERE;
+	}
+	if (minType == BOX_SHAPE_PROXYTYPE && maxType == SPHERE_SHAPE_PROXYTYPE)
+	{
+		return KERNEL_SPHERE_BOX;
+	}
+	if (minType == CAPSULE_SHAPE_PROXYTYPE && maxType == CAPSULE_SHAPE_PROXYTYPE)
+	{
+		return KERNEL_CAPSULE_CAPSULE;
+	}
+	if (minType == SPHERE_SHAPE_PROXYTYPE && maxType == STATIC_PLANE_PROXYTYPE)
+	{
+		return KERNEL_SPHERE_PLANE;
+	}
+	if (minType == BOX_SHAPE_PROXYTYPE && maxType == BOX_SHAPE_PROXYTYPE)
+	{
+		return KERNEL_BOX_BOX;
+	}
+	if (minType == BOX_SHAPE_PROXYTYPE && maxType == STATIC_PLANE_PROXYTYPE)
+	{
+		return KERNEL_BOX_PLANE;
+	}
+	return KERNEL_GENERIC;
+}
+
+void btBatchedNarrowphase::dispatchAllCollisionPairs(btOverlappingPairCache* pairCache, const btDispatcherInfo& info, btCollisionDispatcher* dispatcher, int grainSize)
+{
+	BT_PROFILE("btBatchedNarrowphase::dispatchAllCollisionPairs");
+	const int numPairs = pairCache->getNumOverlappingPairs();
+	m_numTestedPairsTouching = 0;
+	m_sort.resize(numPairs);
+	if (numPairs == 0)
+	{
+		for (int i = 0; i <= KERNEL_COUNT; ++i)
+		{
+			m_kernelBegin[i] = 0;
+		}
+		return;
+	}
+
+	// only needed during this dispatch, so take it from the frame allocator when there is one
+	btPersistentManifold** pairManifolds = (btPersistentManifold**)btFrameAlloc(sizeof(btPersistentManifold*) * numPairs, 16);
+	if (!pairManifolds)
+	{
+		m_pairManifolds.resizeNoInitialize(numPairs);
+		pairManifolds = &m_pairManifolds[0];
+	}
+
+	{
+		BT_PROFILE("classifyPairs");
+		btNarrowphaseClassifyLoop loop;
+		loop.m_pairs = pairCache->getOverlappingPairArrayPtr();
+		loop.m_dispatcher = dispatcher;
+		loop.m_keys = m_sort.getKeys();
+		loop.m_values = m_sort.getValues();
+		loop.m_pairManifolds = pairManifolds;
+		btParallelFor(0, numPairs, grainSize, loop);
+	}
+	m_sort.sort(btNarrowphaseKeyBits);
+
+	// the sorted keys start with the kernel, so each kernel is one range
+	const unsigned int* keys = m_sort.getKeys();
+	for (int kernel = 0; kernel <= KERNEL_COUNT; ++kernel)
+	{
+		const unsigned int kernelKey = (unsigned int)kernel << btNarrowphaseKernelShift;
+		int lo = kernel > 0 ? m_kernelBegin[kernel - 1] : 0;
+		int hi = numPairs;
+		while (lo < hi)
+		{
+			const int mid = (lo + hi) / 2;
+			if (keys[mid] < kernelKey)
+			{
+				lo = mid + 1;
+			}
+			else
+			{
+				hi = mid;
+			}
+		}
+		m_kernelBegin[kernel] = lo;
+	}
+
+	btNarrowphaseContext context;
+	context.m_pairs = pairCache->getOverlappingPairArrayPtr();
+	context.m_pairManifolds = pairManifolds;
+	context.m_sortedPairs = m_sort.getValues();
+	context.m_dispatcher = dispatcher;
+	context.m_info = &info;
+	btAssert(sizeof(std::atomic<int>) == sizeof(int));
+	context.m_numTestedPairsTouching = reinterpret_cast<std::atomic<int>*>(&m_numTestedPairsTouching);
+
+	btNarrowphaseKernelLoop loop;
+	loop.m_context = &context;
+	{
+		BT_PROFILE("batchedKernels");
+		for (int kernel = 0; kernel < KERNEL_GENERIC; ++kernel)
+		{
+			if (m_kernelBegin[kernel] < m_kernelBegin[kernel + 1])
+			{
+				loop.m_kernel = kernel;
+				btParallelFor(m_kernelBegin[kernel], m_kernelBegin[kernel + 1], BT_NARROWPHASE_BLOCK_SIZE, loop);
+			}
+		}
+	}
+	if (m_kernelBegin[KERNEL_GENERIC] < m_kernelBegin[KERNEL_GENERIC + 1])
+	{
+		BT_PROFILE("collisionAlgorithms");
+		loop.m_kernel = KERNEL_GENERIC;
+		btParallelFor(m_kernelBegin[KERNEL_GENERIC], m_kernelBegin[KERNEL_GENERIC + 1], grainSize, loop);
+	}
+}
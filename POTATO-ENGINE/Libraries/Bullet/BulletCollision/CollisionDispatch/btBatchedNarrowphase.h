@@ -0,0 +1,77 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose, 
+including commercial applications, and to alter it and redistribute it freely, 
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_BATCHED_NARROWPHASE_H
+#define BT_BATCHED_NARROWPHASE_H
+
+#include "BulletCollision/BroadphaseCollision/btDispatcher.h"
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btParallelRadixSort.h"
+
+class btCollisionDispatcher;
+class btOverlappingPairCache;
+class btPersistentManifold;
+
+///The btBatchedNarrowphase runs the narrowphase of btCollisionDispatcherMt grouped by shape types instead of in pair array order.
+///A parallel pass creates the missing collision algorithms and buckets the pairs by kernel and (shapeType0, shapeType1) with a
+///radix sort, keeping the pair array order inside a bucket. The hot primitive pairs then run batched kernels, which gather a block
+///of pairs into SoA arrays, compute the closest features in branch-free loops, and add the contacts through btManifoldResult to the
+///manifold owned by the collision algorithm of the pair, so persistence, contact callbacks and material combining are unchanged.
+///Sphere/sphere, sphere/box, capsule/capsule and sphere/plane contacts are computed in full, as the default algorithms do.
+///Box/box and box/plane are only tested for separation in the batch, on the face axes of both boxes and on the support distance to
+///the plane, against the contact breaking threshold; the pairs that may touch run their collision algorithm right after their block. Every other pair runs its collision algorithm through the near
+///callback, in shape type order so the same algorithm runs back to back. So does a pair whose algorithm has no manifold yet.
+class btBatchedNarrowphase
+{
+public:
+	enum Kernel
+	{
+		KERNEL_SPHERE_SPHERE,
+		KERNEL_SPHERE_BOX,
+		KERNEL_CAPSULE_CAPSULE,
+		KERNEL_SPHERE_PLANE,
+		KERNEL_BOX_BOX,    // separation test, then the collision algorithm
+		KERNEL_BOX_PLANE,  // separation test, then the collision algorithm
+		KERNEL_GENERIC,    // the collision algorithm through the near callback
+		KERNEL_COUNT
+	};
+
+	btBatchedNarrowphase();
+
+	///runs the narrowphase of every pair with the near callback of the dispatcher, which must be batch updating the manifolds
+	void dispatchAllCollisionPairs(btOverlappingPairCache* pairCache, const btDispatcherInfo& info, btCollisionDispatcher* dispatcher, int grainSize);
+
+	static int getKernel(int shapeType0, int shapeType1);
+
+	///pairs that ran the kernel at the last dispatch
+	int getNumPairs(int kernel) const
+	{
+		return m_kernelBegin[kernel + 1] - m_kernelBegin[kernel];
+	}
+
+	///box/box and box/plane pairs that passed the separation test and ran their collision algorithm at the last dispatch
+	int getNumTestedPairsTouching() const
+	{
+		return m_numTestedPairsTouching;
+	}
+
+private:
+	btParallelRadixSort m_sort;                                 // kernel and shape types of each pair, with pair indices as values
+	btAlignedObjectArray<btPersistentManifold*> m_pairManifolds;  // manifold of each pair that runs a batched kernel, without a frame allocator
+	int m_kernelBegin[KERNEL_COUNT + 1];                        // first sorted pair of each kernel
+	int m_numTestedPairsTouching;
+};
+
+#endif  //BT_BATCHED_NARROWPHASE_H
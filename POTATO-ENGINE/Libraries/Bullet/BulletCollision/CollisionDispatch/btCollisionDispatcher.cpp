@@ -24,13 +24,15 @@ subject to the following restrictions:
 #include "LinearMath/btPoolAllocator.h"
 #include "BulletCollision/CollisionDispatch/btCollisionConfiguration.h"
 #include "BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h"
+#include "BulletCollision/CollisionDispatch/btPairEventBuffer.h"
 
 #ifdef BT_DEBUG
 #include <stdio.h>
 #endif
 
 btCollisionDispatcher::btCollisionDispatcher(btCollisionConfiguration* collisionConfiguration) : m_dispatcherFlags(btCollisionDispatcher::CD_USE_RELATIVE_CONTACT_BREAKING_THRESHOLD),
-																								 m_collisionConfiguration(collisionConfiguration)
+																								 m_collisionConfiguration(collisionConfiguration),
+																								 m_pairEventBuffer(0)
 {
 	int i;
 
@@ -106,6 +108,10 @@ void btCollisionDispatcher::clearManifold(btPersistentManifold* manifold)
 void btCollisionDispatcher::releaseManifold(btPersistentManifold* manifold)
 {
 	//printf("releaseManifold: gNumManifold %d\n",gNumManifold);
+	if (m_pairEventBuffer)
+	{
+		m_pairEventBuffer->releaseManifold(manifold);
+	}
 	clearManifold(manifold);
 
 	int findIndex = manifold->m_index1a;
@@ -224,6 +230,11 @@ void btCollisionDispatcher::dispatchAllCollisionPairs(btOverlappingPairCache* pa
 		pairCache->processAllOverlappingPairs(&collisionCallback, dispatcher, dispatchInfo);
 	}
 
+	if (m_pairEventBuffer)
+	{
+		m_pairEventBuffer->updateManifolds(getInternalManifoldPointer(), getNumManifolds());
+	}
+
 	//m_blockedForChanges = false;
 }
 
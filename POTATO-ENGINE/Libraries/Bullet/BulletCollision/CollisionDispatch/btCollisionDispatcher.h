@@ -28,6 +28,7 @@ class btIDebugDraw;
 class btOverlappingPairCache;
 class btPoolAllocator;
 class btCollisionConfiguration;
+class btPairEventBuffer;
 
 #include "btCollisionCreateFunc.h"
 
@@ -58,6 +59,8 @@ protected:
 
 	btCollisionConfiguration* m_collisionConfiguration;
 
+	btPairEventBuffer* m_pairEventBuffer;
+
 public:
 	enum DispatcherFlags
 	{
@@ -155,6 +158,17 @@ public:
 		m_collisionConfiguration = config;
 	}
 
+	///records contact begin and end events of the manifolds, see btPairEventBuffer
+	void setPairEventBuffer(btPairEventBuffer* pairEventBuffer)
+	{
+		m_pairEventBuffer = pairEventBuffer;
+	}
+
+	btPairEventBuffer* getPairEventBuffer() const
+	{
+		return m_pairEventBuffer;
+	}
+
 	virtual btPoolAllocator* getInternalManifoldPool()
 	{
 		return m_persistentManifoldPoolAllocator;
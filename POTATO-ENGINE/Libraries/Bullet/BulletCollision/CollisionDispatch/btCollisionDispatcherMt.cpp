@@ -24,15 +24,19 @@ subject to the following restrictions:
 #include "LinearMath/btPoolAllocator.h"
 #include "BulletCollision/CollisionDispatch/btCollisionConfiguration.h"
 #include "BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h"
+#include "BulletCollision/CollisionDispatch/btPairEventBuffer.h"
 
 btCollisionDispatcherMt::btCollisionDispatcherMt(btCollisionConfiguration* config, int grainSize)
-	: btCollisionDispatcher(config)
+	: btCollisionDispatcher(config),
+	  m_manifoldPool(sizeof(btPersistentManifold)),
+	  m_collisionAlgorithmPool(config->getCollisionAlgorithmPool()->getElementSize())
 {
 	m_batchManifoldsPtr.resize(btGetTaskScheduler()->getNumThreads());
 	m_batchReleasePtr.resize(btGetTaskScheduler()->getNumThreads());
 
 	m_batchUpdating = false;
 	m_grainSize = grainSize;  // iterations per task
+	m_useBatchedNarrowphase = false;
 }
 
 btPersistentManifold* btCollisionDispatcherMt::getNewManifold(const btCollisionObject* body0, const btCollisionObject* body1)
@@ -44,20 +48,17 @@ btPersistentManifold* btCollisionDispatcherMt::getNewManifold(const btCollisionO
 
 	btScalar contactProcessingThreshold = btMin(body0->getContactProcessingThreshold(), body1->getContactProcessingThreshold());
 
-	void* mem = m_persistentManifoldPoolAllocator->allocate(sizeof(btPersistentManifold));
+	if (!m_batchUpdating)
+	{
+		updateManifoldPoolLimit();
+	}
+	void* mem = m_manifoldPool.allocate(sizeof(btPersistentManifold));
 	if (NULL == mem)
 	{
-		//we got a pool memory overflow, by default we fallback to dynamically allocate memory. If we require a contiguous contact pool then assert.
-		if ((m_dispatcherFlags & CD_DISABLE_CONTACTPOOL_DYNAMIC_ALLOCATION) == 0)
-		{
-			mem = btAlignedAlloc(sizeof(btPersistentManifold), 16);
-		}
-		else
-		{
-			btAssert(0);
-			//make sure to increase the m_defaultMaxPersistentManifoldPoolSize in the btDefaultCollisionConstructionInfo/btDefaultCollisionConfiguration
-			return 0;
-		}
+		//only with CD_DISABLE_CONTACTPOOL_DYNAMIC_ALLOCATION, the pool is full
+		btAssert(0);
+		//make sure to increase the m_defaultMaxPersistentManifoldPoolSize in the btDefaultCollisionConstructionInfo/btDefaultCollisionConfiguration
+		return 0;
 	}
 	btPersistentManifold* manifold = new (mem) btPersistentManifold(body0, body1, 0, contactBreakingThreshold, contactProcessingThreshold);
 	if (!m_batchUpdating)
@@ -82,6 +83,10 @@ void btCollisionDispatcherMt::releaseManifold(btPersistentManifold* manifold)
 	
 	if (!m_batchUpdating)
 	{
+		if (m_pairEventBuffer)
+		{
+			m_pairEventBuffer->releaseManifold(manifold);
+		}
 		clearManifold(manifold);
 		// batch updater will update manifold pointers array after finishing, so
 		// only need to update array when not batch-updating
@@ -96,16 +101,30 @@ void btCollisionDispatcherMt::releaseManifold(btPersistentManifold* manifold)
 	}
 
 	manifold->~btPersistentManifold();
-	if (m_persistentManifoldPoolAllocator->validPtr(manifold))
-	{
-		m_persistentManifoldPoolAllocator->freeMemory(manifold);
-	}
-	else
+	m_manifoldPool.freeMemory(manifold);
+}
+
+void btCollisionDispatcherMt::updateManifoldPoolLimit()
+{
+	// like the base dispatcher, CD_DISABLE_CONTACTPOOL_DYNAMIC_ALLOCATION bounds the manifolds by the
+	// configuration's manifold pool size instead of letting the pool grow
+	const int maxManifolds = (m_dispatcherFlags & CD_DISABLE_CONTACTPOOL_DYNAMIC_ALLOCATION) ? btMax(m_persistentManifoldPoolAllocator->getMaxCount(), 1) : 0;
+	if (m_manifoldPool.getMaxElements() != maxManifolds)
 	{
-		btAlignedFree(manifold);
+		m_manifoldPool.setMaxElements(maxManifolds);
 	}
 }
 
+void* btCollisionDispatcherMt::allocateCollisionAlgorithm(int size)
+{
+	return m_collisionAlgorithmPool.allocate(size);
+}
+
+void btCollisionDispatcherMt::freeCollisionAlgorithm(void* ptr)
+{
+	m_collisionAlgorithmPool.freeMemory(ptr);
+}
+
 struct CollisionDispatcherUpdater : public btIParallelForBody
 {
 	btBroadphasePair* mPairArray;
@@ -137,14 +156,23 @@ void btCollisionDispatcherMt::dispatchAllCollisionPairs(btOverlappingPairCache*
 	{
 		return;
 	}
-	CollisionDispatcherUpdater updater;
-	updater.mCallback = getNearCallback();
-	updater.mPairArray = pairCache->getOverlappingPairArrayPtr();
-	updater.mDispatcher = this;
-	updater.mInfo = &info;
-
+	// the flags can change between steps, but not while the workers allocate
+	updateManifoldPoolLimit();
 	m_batchUpdating = true;
-	btParallelFor(0, pairCount, m_grainSize, updater);
+	if (m_useBatchedNarrowphase && getNearCallback() == defaultNearCallback && info.m_dispatchFunc == btDispatcherInfo::DISPATCH_DISCRETE)
+	{
+		m_batchedNarrowphase.dispatchAllCollisionPairs(pairCache, info, this, m_grainSize);
+	}
+	else
+	{
+		CollisionDispatcherUpdater updater;
+		updater.mCallback = getNearCallback();
+		updater.mPairArray = pairCache->getOverlappingPairArrayPtr();
+		updater.mDispatcher = this;
+		updater.mInfo = &info;
+
+		btParallelFor(0, pairCount, m_grainSize, updater);
+	}
 	m_batchUpdating = false;
 
 	// merge new manifolds, if any
@@ -176,4 +204,9 @@ void btCollisionDispatcherMt::dispatchAllCollisionPairs(btOverlappingPairCache*
 	{
 		m_manifoldsPtr[i]->m_index1a = i;
 	}
+
+	if (m_pairEventBuffer)
+	{
+		m_pairEventBuffer->updateManifolds(getInternalManifoldPointer(), getNumManifolds());
+	}
 }
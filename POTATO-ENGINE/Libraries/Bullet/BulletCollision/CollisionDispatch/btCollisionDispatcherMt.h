@@ -17,8 +17,16 @@ subject to the following restrictions:
 #define BT_COLLISION_DISPATCHER_MT_H
 
 #include "BulletCollision/CollisionDispatch/btCollisionDispatcher.h"
+#include "BulletCollision/CollisionDispatch/btBatchedNarrowphase.h"
 #include "LinearMath/btThreads.h"
+#include "LinearMath/btPoolAllocatorMt.h"
 
+///btCollisionDispatcherMt dispatches the overlapping pairs over the task scheduler.
+///Manifolds and collision algorithms come from its own growable pools with a free list per thread,
+///rather than from the fixed, lock-protected pools of the collision configuration.
+///With CD_DISABLE_CONTACTPOOL_DYNAMIC_ALLOCATION the manifold pool stops growing at the configuration's
+///manifold pool size and getNewManifold returns 0 past it, as in btCollisionDispatcher.
+///The flag does not bound the collision algorithm pool, btCollisionDispatcher does not bound those either.
 class btCollisionDispatcherMt : public btCollisionDispatcher
 {
 public:
@@ -27,13 +35,50 @@ public:
 	virtual btPersistentManifold* getNewManifold(const btCollisionObject* body0, const btCollisionObject* body1) BT_OVERRIDE;
 	virtual void releaseManifold(btPersistentManifold* manifold) BT_OVERRIDE;
 
+	virtual void* allocateCollisionAlgorithm(int size) BT_OVERRIDE;
+	virtual void freeCollisionAlgorithm(void* ptr) BT_OVERRIDE;
+
 	virtual void dispatchAllCollisionPairs(btOverlappingPairCache* pairCache, const btDispatcherInfo& info, btDispatcher* dispatcher) BT_OVERRIDE;
 
+	///runs the narrowphase grouped by shape types, with batched kernels for the common primitive pairs, see btBatchedNarrowphase.
+	///Only used with the default near callback and discrete dispatch; otherwise the pairs run in pair array order.
+	void setBatchedNarrowphase(bool batched)
+	{
+		m_useBatchedNarrowphase = batched;
+	}
+
+	bool getBatchedNarrowphase() const
+	{
+		return m_useBatchedNarrowphase;
+	}
+
+	const btBatchedNarrowphase& getNarrowphaseBatches() const
+	{
+		return m_batchedNarrowphase;
+	}
+
+	const btPoolAllocatorMt& getManifoldPoolMt() const
+	{
+		return m_manifoldPool;
+	}
+
+	const btPoolAllocatorMt& getCollisionAlgorithmPoolMt() const
+	{
+		return m_collisionAlgorithmPool;
+	}
+
 protected:
+	void updateManifoldPoolLimit();
+
+	btPoolAllocatorMt m_manifoldPool;
+	btPoolAllocatorMt m_collisionAlgorithmPool;
+
 	btAlignedObjectArray<btAlignedObjectArray<btPersistentManifold*> > m_batchManifoldsPtr;
 	btAlignedObjectArray<btAlignedObjectArray<btPersistentManifold*> > m_batchReleasePtr;
 	bool m_batchUpdating;
 	int m_grainSize;
+	btBatchedNarrowphase m_batchedNarrowphase;
+	bool m_useBatchedNarrowphase;
 };
 
 #endif  //BT_COLLISION_DISPATCHER_MT_H
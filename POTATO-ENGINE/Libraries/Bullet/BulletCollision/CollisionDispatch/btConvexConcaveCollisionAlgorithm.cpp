@@ -27,6 +27,35 @@ subject to the following restrictions:
 #include "BulletCollision/NarrowPhaseCollision/btSubSimplexConvexCast.h"
 #include "BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h"
 #include "BulletCollision/CollisionShapes/btSdfCollisionShape.h"
+#include "LinearMath/btThreads.h"
+
+struct ATTRIBUTE_ALIGNED64(btTriangleQueryCacheThreadStats)
+{
+	btTriangleQueryCacheStats m_stats;
+	char m_padding[64 - sizeof(btTriangleQueryCacheStats)];
+};
+
+static btTriangleQueryCacheThreadStats gTriangleQueryCacheStats[BT_MAX_THREAD_COUNT];
+
+void btConvexConcaveCollisionAlgorithm::getTriangleQueryCacheStats(btTriangleQueryCacheStats& stats)
+{
+	stats = btTriangleQueryCacheStats();
+	for (unsigned int i = 0; i < BT_MAX_THREAD_COUNT; i++)
+	{
+		const btTriangleQueryCacheStats& threadStats = gTriangleQueryCacheStats[i].m_stats;
+		stats.m_queries += threadStats.m_queries;
+		stats.m_cacheHits += threadStats.m_cacheHits;
+		stats.m_triangles += threadStats.m_triangles;
+	}
+}
+
+void btConvexConcaveCollisionAlgorithm::resetTriangleQueryCacheStats()
+{
+	for (unsigned int i = 0; i < BT_MAX_THREAD_COUNT; i++)
+	{
+		gTriangleQueryCacheStats[i].m_stats = btTriangleQueryCacheStats();
+	}
+}
 
 btConvexConcaveCollisionAlgorithm::btConvexConcaveCollisionAlgorithm(const btCollisionAlgorithmConstructionInfo& ci, const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap, bool isSwapped)
 	: btActivatingCollisionAlgorithm(ci, body0Wrap, body1Wrap),
@@ -48,7 +77,9 @@ void btConvexConcaveCollisionAlgorithm::getAllContactManifolds(btManifoldArray&
 }
 
 btConvexTriangleCallback::btConvexTriangleCallback(btDispatcher* dispatcher, const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap, bool isSwapped) : m_dispatcher(dispatcher),
-																																													 m_dispatchInfoPtr(0)
+																																													 m_dispatchInfoPtr(0),
+																																													 m_triangleAlgorithm(0),
+																																													 m_cacheShape(0)
 {
 	m_convexBodyWrap = isSwapped ? body1Wrap : body0Wrap;
 	m_triBodyWrap = isSwapped ? body0Wrap : body1Wrap;
@@ -63,6 +94,7 @@ btConvexTriangleCallback::btConvexTriangleCallback(btDispatcher* dispatcher, con
 
 btConvexTriangleCallback::~btConvexTriangleCallback()
 {
+	freeTriangleAlgorithm();
 	clearCache();
 	m_dispatcher->releaseManifold(m_manifoldPtr);
 }
@@ -70,6 +102,82 @@ btConvexTriangleCallback::~btConvexTriangleCallback()
 void btConvexTriangleCallback::clearCache()
 {
 	m_dispatcher->clearManifold(m_manifoldPtr);
+	clearTriangleCache();
+}
+
+void btConvexTriangleCallback::freeTriangleAlgorithm()
+{
+	if (m_triangleAlgorithm)
+	{
+		m_triangleAlgorithm->~btCollisionAlgorithm();
+		m_dispatcher->freeCollisionAlgorithm(m_triangleAlgorithm);
+		m_triangleAlgorithm = 0;
+	}
+}
+
+///collects the triangles that overlap the expanded box of the triangle query cache
+struct btTriangleQueryCacheCallback : public btTriangleCallback
+{
+	btAlignedObjectArray<btCachedTriangle>* m_triangles;
+	btVector3 m_aabbMin;
+	btVector3 m_aabbMax;
+
+	virtual void processTriangle(btVector3* triangle, int partId, int triangleIndex)
+	{
+		if (TestTriangleAgainstAabb2(triangle, m_aabbMin, m_aabbMax))
+		{
+			btCachedTriangle& cached = m_triangles->expandNonInitializing();
+			cached.m_vertices[0] = triangle[0];
+			cached.m_vertices[1] = triangle[1];
+			cached.m_vertices[2] = triangle[2];
+			cached.m_partId = partId;
+			cached.m_triangleIndex = triangleIndex;
+		}
+	}
+};
+
+void btConvexTriangleCallback::processConcaveShape(const btConcaveShape* concaveShape)
+{
+	if (!m_dispatchInfoPtr->m_enableTriangleQueryCache)
+	{
+		clearTriangleCache();
+		concaveShape->processAllTriangles(this, m_aabbMin, m_aabbMax);
+		freeTriangleAlgorithm();
+		return;
+	}
+
+	btTriangleQueryCacheStats& stats = gTriangleQueryCacheStats[btGetCurrentThreadIndex()].m_stats;
+	stats.m_queries++;
+
+	//the expanded box is walked in the same order as the tight one, so the overlapping triangles keep their order
+	if (m_cacheShape == concaveShape && m_cacheAabbMin.x() <= m_aabbMin.x() && m_cacheAabbMin.y() <= m_aabbMin.y() && m_cacheAabbMin.z() <= m_aabbMin.z() &&
+		m_aabbMax.x() <= m_cacheAabbMax.x() && m_aabbMax.y() <= m_cacheAabbMax.y() && m_aabbMax.z() <= m_cacheAabbMax.z())
+	{
+		stats.m_cacheHits++;
+	}
+	else
+	{
+		BT_PROFILE("fillTriangleQueryCache");
+		const btScalar margin = m_dispatchInfoPtr->m_triangleQueryCacheMargin;
+		m_cacheAabbMin = m_aabbMin - btVector3(margin, margin, margin);
+		m_cacheAabbMax = m_aabbMax + btVector3(margin, margin, margin);
+		m_cacheShape = concaveShape;
+		m_cachedTriangles.resize(0);
+
+		btTriangleQueryCacheCallback callback;
+		callback.m_triangles = &m_cachedTriangles;
+		callback.m_aabbMin = m_cacheAabbMin;
+		callback.m_aabbMax = m_cacheAabbMax;
+		concaveShape->processAllTriangles(&callback, m_cacheAabbMin, m_cacheAabbMax);
+	}
+
+	stats.m_triangles += m_cachedTriangles.size();
+	for (int i = 0; i < m_cachedTriangles.size(); i++)
+	{
+		btCachedTriangle& cached = m_cachedTriangles[i];
+		processTriangle(cached.m_vertices, cached.m_partId, cached.m_triangleIndex);
+	}
+	freeTriangleAlgorithm();
 }
 
 void btConvexTriangleCallback::processTriangle(btVector3* triangle, int partId, int triangleIndex)
@@ -150,11 +258,16 @@ void btConvexTriangleCallback::processTriangle(btVector3* triangle, int partId,
 
 		if (m_resultOut->m_closestPointDistanceThreshold > 0)
 		{
+			//closest point algorithms own a manifold for the one triangle, they are not shared
 			colAlgo = ci.m_dispatcher1->findAlgorithm(m_convexBodyWrap, &triObWrap, 0, BT_CLOSEST_POINT_ALGORITHMS);
 		}
 		else
 		{
-			colAlgo = ci.m_dispatcher1->findAlgorithm(m_convexBodyWrap, &triObWrap, m_manifoldPtr, BT_CONTACT_POINT_ALGORITHMS);
+			if (!m_triangleAlgorithm)
+			{
+				m_triangleAlgorithm = ci.m_dispatcher1->findAlgorithm(m_convexBodyWrap, &triObWrap, m_manifoldPtr, BT_CONTACT_POINT_ALGORITHMS);
+			}
+			colAlgo = m_triangleAlgorithm;
 		}
 		const btCollisionObjectWrapper* tmpWrap = 0;
 
@@ -173,7 +286,7 @@ void btConvexTriangleCallback::processTriangle(btVector3* triangle, int partId,
 
 		{
 			BT_PROFILE("processCollision (GJK?)");
-			colAlgo->processCollision(m_convexBodyWrap, &triObWrap, *m_dispatchInfoPtr, m_resultOut);
+			colAlgo->processCollision(m_convexBodyWrap, &triObWrap, m_triangleDispatchInfo, m_resultOut);
 		}
 
 		if (m_resultOut->getBody0Internal() == m_triBodyWrap->getCollisionObject())
@@ -185,8 +298,11 @@ void btConvexTriangleCallback::processTriangle(btVector3* triangle, int partId,
 			m_resultOut->setBody1Wrap(tmpWrap);
 		}
 
-		colAlgo->~btCollisionAlgorithm();
-		ci.m_dispatcher1->freeCollisionAlgorithm(colAlgo);
+		if (colAlgo != m_triangleAlgorithm)
+		{
+			colAlgo->~btCollisionAlgorithm();
+			ci.m_dispatcher1->freeCollisionAlgorithm(colAlgo);
+		}
 	}
 }
 
@@ -196,6 +312,8 @@ void btConvexTriangleCallback::setTimeStepAndCounters(btScalar collisionMarginTr
 	m_triBodyWrap = triBodyWrap;
 
 	m_dispatchInfoPtr = &dispatchInfo;
+	m_triangleDispatchInfo = dispatchInfo;
+	m_triangleDispatchInfo.m_enableConvexCoherence = false;
 	m_collisionMarginTriangle = collisionMarginTriangle;
 	m_resultOut = resultOut;
 
@@ -227,6 +345,13 @@ void btConvexConcaveCollisionAlgorithm::processCollision(const btCollisionObject
 
 	if (triBodyWrap->getCollisionShape()->isConcave())
 	{
+		//a box resting on a mesh touches it at more than 4 corners, a larger manifold keeps them all
+		int contactCapacity = dispatchInfo.m_concaveContactCapacity > 0 ? btMin(dispatchInfo.m_concaveContactCapacity, int(MANIFOLD_CACHE_SIZE)) : MANIFOLD_DEFAULT_CAPACITY;
+		if (m_btConvexTriangleCallback.m_manifoldPtr->getContactCapacity() != contactCapacity)
+		{
+			m_btConvexTriangleCallback.m_manifoldPtr->setContactCapacity(contactCapacity);
+		}
+
 		if (triBodyWrap->getCollisionShape()->getShapeType() == SDF_SHAPE_PROXYTYPE)
 		{
 			btSdfCollisionShape* sdfShape = (btSdfCollisionShape*)triBodyWrap->getCollisionShape();
@@ -301,7 +426,7 @@ void btConvexConcaveCollisionAlgorithm::processCollision(const btCollisionObject
 
 				m_btConvexTriangleCallback.m_manifoldPtr->setBodies(convexBodyWrap->getCollisionObject(), triBodyWrap->getCollisionObject());
 
-				concaveShape->processAllTriangles(&m_btConvexTriangleCallback, m_btConvexTriangleCallback.getAabbMin(), m_btConvexTriangleCallback.getAabbMax());
+				m_btConvexTriangleCallback.processConcaveShape(concaveShape);
 
 				resultOut->refreshContactPoints();
 
@@ -22,8 +22,39 @@ subject to the following restrictions:
 #include "BulletCollision/CollisionShapes/btTriangleCallback.h"
 #include "BulletCollision/NarrowPhaseCollision/btPersistentManifold.h"
 class btDispatcher;
+class btConcaveShape;
+class btCollisionShape;
 #include "BulletCollision/BroadphaseCollision/btBroadphaseProxy.h"
 #include "btCollisionCreateFunc.h"
+#include "LinearMath/btAlignedObjectArray.h"
+
+///counters of the triangle query cache of btConvexConcaveCollisionAlgorithm, summed over all pairs and threads
+struct btTriangleQueryCacheStats
+{
+	unsigned long long m_queries;    // mesh queries of processCollision with the cache enabled
+	unsigned long long m_cacheHits;  // queries answered from the cached triangles without walking the mesh
+	unsigned long long m_triangles;  // cached triangles tested against the convex
+
+	btTriangleQueryCacheStats()
+		: m_queries(0),
+		  m_cacheHits(0),
+		  m_triangles(0)
+	{
+	}
+
+	btScalar getHitRate() const
+	{
+		return m_queries ? btScalar(m_cacheHits) / btScalar(m_queries) : btScalar(0);
+	}
+};
+
+///triangle of the concave shape kept by the triangle query cache, in the local space of the concave shape
+struct btCachedTriangle
+{
+	btVector3 m_vertices[3];
+	int m_partId;
+	int m_triangleIndex;
+};
 
 ///For each triangle in the concave mesh that overlaps with the AABB of a convex (m_convexProxy), processTriangle is called.
 ATTRIBUTE_ALIGNED16(class)
@@ -40,6 +71,18 @@ btConvexTriangleCallback : public btTriangleCallback
 	const btDispatcherInfo* m_dispatchInfoPtr;
 	btScalar m_collisionMarginTriangle;
 
+	///convex against triangle algorithm shared by the triangles of one query, the triangles only differ in their vertices
+	btCollisionAlgorithm* m_triangleAlgorithm;
+	///dispatch info of the triangle algorithm, without the convex coherence cache that cannot tell the triangles apart
+	btDispatcherInfo m_triangleDispatchInfo;
+
+	///the triangle query cache, used with btDispatcherInfo::m_enableTriangleQueryCache: the triangles of the concave shape
+	///that overlap an expanded box around the convex, reused while the convex stays inside the box
+	btAlignedObjectArray<btCachedTriangle> m_cachedTriangles;
+	btVector3 m_cacheAabbMin;
+	btVector3 m_cacheAabbMax;
+	const btCollisionShape* m_cacheShape;  // concave shape the triangles come from, 0 when the cache is empty
+
 public:
 	BT_DECLARE_ALIGNED_ALLOCATOR();
 
@@ -60,8 +103,22 @@ public:
 
 	virtual void processTriangle(btVector3 * triangle, int partId, int triangleIndex);
 
+	///processCollision of the convex against the triangles of concaveShape that overlap the convex, from the triangle query cache
+	///when it is enabled and still covers the convex, otherwise from concaveShape->processAllTriangles
+	void processConcaveShape(const btConcaveShape* concaveShape);
+
+	///frees the collision algorithm shared by the triangles of the last query
+	void freeTriangleAlgorithm();
+
 	void clearCache();
 
+	///empties the triangle query cache, needed after the triangles of the concave shape changed in place
+	void clearTriangleCache()
+	{
+		m_cachedTriangles.resize(0);
+		m_cacheShape = 0;
+	}
+
 	SIMD_FORCE_INLINE const btVector3& getAabbMin() const
 	{
 		return m_aabbMin;
@@ -95,6 +152,16 @@ public:
 
 	void clearCache();
 
+	///empties the triangle query cache, needed after the triangles of the concave shape changed in place
+	void clearTriangleCache()
+	{
+		m_btConvexTriangleCallback.clearTriangleCache();
+	}
+
+	///sums the triangle query cache counters of all threads, they are only consistent when no collision detection runs
+	static void getTriangleQueryCacheStats(btTriangleQueryCacheStats & stats);
+	static void resetTriangleQueryCacheStats();
+
 	struct CreateFunc : public btCollisionAlgorithmCreateFunc
 	{
 		virtual btCollisionAlgorithm* CreateCollisionAlgorithm(btCollisionAlgorithmConstructionInfo& ci, const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap)
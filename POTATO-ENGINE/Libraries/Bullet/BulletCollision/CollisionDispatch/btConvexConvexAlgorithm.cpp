@@ -50,6 +50,7 @@ subject to the following restrictions:
 #include "BulletCollision/NarrowPhaseCollision/btGjkEpaPenetrationDepthSolver.h"
 #include "BulletCollision/NarrowPhaseCollision/btPolyhedralContactClipping.h"
 #include "BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h"
+#include "LinearMath/btThreads.h"
 
 ///////////
 
@@ -192,7 +193,13 @@ btConvexConvexAlgorithm::btConvexConvexAlgorithm(btPersistentManifold* mf, const
 					(static_cast<btConvexShape*>(body1->getCollisionShape()))->getAngularMotionDisc()),
 #endif
 	  m_numPerturbationIterations(numPerturbationIterations),
-	  m_minimumPointsPerturbationThreshold(minimumPointsPerturbationThreshold)
+	  m_minimumPointsPerturbationThreshold(minimumPointsPerturbationThreshold),
+	  m_coherenceShapeA(0),
+	  m_coherenceShapeB(0),
+	  m_coherenceRadiusA(0),
+	  m_coherenceRadiusB(0),
+	  m_coherenceMotion(-1),
+	  m_coherenceTouching(false)
 {
 	(void)body0Wrap;
 	(void)body1Wrap;
@@ -212,6 +219,118 @@ void btConvexConvexAlgorithm ::setLowLevelOfDetail(bool useLowLevel)
 	m_lowLevelOfDetail = useLowLevel;
 }
 
+// coherence counters of each thread, on their own cache lines
+struct ATTRIBUTE_ALIGNED64(btConvexCoherenceThreadStats)
+{
+	btConvexCoherenceStats m_stats;
+	char m_padding[64 - sizeof(btConvexCoherenceStats)];
+};
+
+static btConvexCoherenceThreadStats gConvexCoherenceStats[BT_MAX_THREAD_COUNT];
+
+void btConvexConvexAlgorithm::getCoherenceStats(btConvexCoherenceStats& stats)
+{
+	stats = btConvexCoherenceStats();
+	for (unsigned int i = 0; i < BT_MAX_THREAD_COUNT; i++)
+	{
+		const btConvexCoherenceStats& threadStats = gConvexCoherenceStats[i].m_stats;
+		stats.m_queries += threadStats.m_queries;
+		stats.m_separatedSkips += threadStats.m_separatedSkips;
+		stats.m_contactRefreshes += threadStats.m_contactRefreshes;
+	}
+}
+
+void btConvexConvexAlgorithm::resetCoherenceStats()
+{
+	for (unsigned int i = 0; i < BT_MAX_THREAD_COUNT; i++)
+	{
+		gConvexCoherenceStats[i].m_stats = btConvexCoherenceStats();
+	}
+}
+
+// bounds the distance that any point of a shape within radius of its origin moved between two transforms,
+// the rotation moves a point p by |(R1 - R0) p|, which is at most the Frobenius norm of R1 - R0 times |p|
+static SIMD_FORCE_INLINE btScalar btCoherenceMotionBound(const btTransform& from, const btTransform& to, btScalar radius)
+{
+	const btMatrix3x3& basis0 = from.getBasis();
+	const btMatrix3x3& basis1 = to.getBasis();
+	const btScalar rotation2 = (basis1[0] - basis0[0]).length2() + (basis1[1] - basis0[1]).length2() + (basis1[2] - basis0[2]).length2();
+	return (to.getOrigin() - from.getOrigin()).length() + btSqrt(rotation2) * radius;
+}
+
+bool btConvexConvexAlgorithm::testCoherence(const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap, btManifoldResult* resultOut)
+{
+	btConvexCoherenceStats& stats = gConvexCoherenceStats[btGetCurrentThreadIndex()].m_stats;
+	stats.m_queries++;
+
+	if (m_coherenceMotion < btScalar(0.) || body0Wrap->getCollisionShape() != m_coherenceShapeA || body1Wrap->getCollisionShape() != m_coherenceShapeB)
+		return false;
+
+	const btScalar motion = btCoherenceMotionBound(m_coherenceTransformA, body0Wrap->getWorldTransform(), m_coherenceRadiusA) +
+							btCoherenceMotionBound(m_coherenceTransformB, body1Wrap->getWorldTransform(), m_coherenceRadiusB);
+	if (motion >= m_coherenceMotion)
+		return false;
+
+	if (m_coherenceTouching)
+	{
+		// the contacts are regenerated from their local points on both bodies
+		resultOut->refreshContactPoints();
+		if (!m_manifoldPtr->getNumContacts())
+			m_coherenceMotion = btScalar(-1.);
+		stats.m_contactRefreshes++;
+	}
+	else
+	{
+		if (m_ownManifold)
+			resultOut->refreshContactPoints();
+		stats.m_separatedSkips++;
+	}
+	return true;
+}
+
+void btConvexConvexAlgorithm::updateCoherence(const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap, const btDispatcherInfo& dispatchInfo, const btManifoldResult* resultOut, const btVector3& separatingAxis)
+{
+	m_coherenceMotion = btScalar(-1.);
+	m_coherenceShapeA = body0Wrap->getCollisionShape();
+	m_coherenceShapeB = body1Wrap->getCollisionShape();
+	m_coherenceTransformA = body0Wrap->getWorldTransform();
+	m_coherenceTransformB = body1Wrap->getWorldTransform();
+	m_coherenceTouching = m_manifoldPtr->getNumContacts() > 0;
+
+	if (m_coherenceTouching)
+	{
+		// a shared manifold is refreshed by the algorithm that owns it
+		if (m_ownManifold && dispatchInfo.m_convexCoherenceContactMotion > btScalar(0.))
+			m_coherenceMotion = dispatchInfo.m_convexCoherenceContactMotion;
+	}
+	else
+	{
+		const btScalar length2 = separatingAxis.length2();
+		if (length2 < SIMD_EPSILON)
+			return;
+
+		// the separation along the axis is measured with the support functions including the margins,
+		// so it does not depend on the accuracy of the query that found the axis
+		const btConvexShape* min0 = static_cast<const btConvexShape*>(m_coherenceShapeA);
+		const btConvexShape* min1 = static_cast<const btConvexShape*>(m_coherenceShapeB);
+		const btVector3 axis = separatingAxis / btSqrt(length2);
+		const btScalar maxA = axis.dot(m_coherenceTransformA(min0->localGetSupportingVertex(axis * m_coherenceTransformA.getBasis())));
+		const btScalar minA = axis.dot(m_coherenceTransformA(min0->localGetSupportingVertex(-axis * m_coherenceTransformA.getBasis())));
+		const btScalar maxB = axis.dot(m_coherenceTransformB(min1->localGetSupportingVertex(axis * m_coherenceTransformB.getBasis())));
+		const btScalar minB = axis.dot(m_coherenceTransformB(min1->localGetSupportingVertex(-axis * m_coherenceTransformB.getBasis())));
+		const btScalar separation = btMax(minA - maxB, minB - maxA);
+		const btScalar threshold = m_manifoldPtr->getContactBreakingThreshold() + resultOut->m_closestPointDistanceThreshold;
+		if (separation > threshold)
+			m_coherenceMotion = separation - threshold;
+	}
+
+	if (m_coherenceMotion > btScalar(0.))
+	{
+		m_coherenceRadiusA = m_coherenceShapeA->getAngularMotionDisc();
+		m_coherenceRadiusB = m_coherenceShapeB->getAngularMotionDisc();
+	}
+}
+
 struct btPerturbedContactResult : public btManifoldResult
 {
 	btManifoldResult* m_originalManifoldResult;
@@ -356,6 +475,12 @@ void btConvexConvexAlgorithm ::processCollision(const btCollisionObjectWrapper*
 	}
 #endif  //BT_DISABLE_CAPSULE_CAPSULE_COLLIDER
 
+	if (dispatchInfo.m_enableConvexCoherence && testCoherence(body0Wrap, body1Wrap, resultOut))
+	{
+		return;
+	}
+	btVector3 coherenceAxis(0, 0, 0);
+
 #ifdef USE_SEPDISTANCE_UTIL2
 	if (dispatchInfo.m_useConvexConservativeDistanceUtil)
 	{
@@ -492,7 +617,8 @@ void btConvexConvexAlgorithm ::processCollision(const btCollisionObjectWrapper*
 						*polyhedronA->getConvexPolyhedron(), *polyhedronB->getConvexPolyhedron(),
 						body0Wrap->getWorldTransform(),
 						body1Wrap->getWorldTransform(),
-						sepNormalWorldSpace, *resultOut);
+						sepNormalWorldSpace, *resultOut, &m_manifoldPtr->m_separatingFeature);
+					coherenceAxis = sepNormalWorldSpace;
 				}
 				else
 				{
@@ -504,6 +630,7 @@ void btConvexConvexAlgorithm ::processCollision(const btCollisionObjectWrapper*
 					gjkPairDetector.getClosestPoints(input, withoutMargin, dispatchInfo.m_debugDraw);
 					//gjkPairDetector.getClosestPoints(input,dummy,dispatchInfo.m_debugDraw);
 #endif  //ZERO_MARGIN
+					coherenceAxis = gjkPairDetector.getCachedSeparatingAxis();
 					//btScalar l2 = gjkPairDetector.getCachedSeparatingAxis().length2();
 					//if (l2>SIMD_EPSILON)
 					{
@@ -532,6 +659,10 @@ void btConvexConvexAlgorithm ::processCollision(const btCollisionObjectWrapper*
 				{
 					resultOut->refreshContactPoints();
 				}
+				if (dispatchInfo.m_enableConvexCoherence)
+				{
+					updateCoherence(body0Wrap, body1Wrap, dispatchInfo, resultOut, coherenceAxis);
+				}
 				return;
 			}
 			else
@@ -697,6 +828,7 @@ void btConvexConvexAlgorithm ::processCollision(const btCollisionObjectWrapper*
 		}
 
 		gjkPairDetector.getClosestPoints(input, *resultOut, dispatchInfo.m_debugDraw);
+		coherenceAxis = gjkPairDetector.getCachedSeparatingAxis();
 
 		//now perform 'm_numPerturbationIterations' collision queries with the perturbated collision objects
 
@@ -786,6 +918,10 @@ void btConvexConvexAlgorithm ::processCollision(const btCollisionObjectWrapper*
 	{
 		resultOut->refreshContactPoints();
 	}
+	if (dispatchInfo.m_enableConvexCoherence)
+	{
+		updateCoherence(body0Wrap, body1Wrap, dispatchInfo, resultOut, coherenceAxis);
+	}
 }
 
 bool disableCcd = false;
@@ -28,6 +28,26 @@ subject to the following restrictions:
 
 class btConvexPenetrationDepthSolver;
 
+///counters of the coherence cache of btConvexConvexAlgorithm, summed over all pairs and threads
+struct btConvexCoherenceStats
+{
+	unsigned long long m_queries;           // processCollision calls with the cache enabled, capsule pairs excepted
+	unsigned long long m_separatedSkips;    // calls skipped because the pair could not have come within the contact threshold
+	unsigned long long m_contactRefreshes;  // calls of a touching pair that only refreshed its contacts
+
+	btConvexCoherenceStats()
+		: m_queries(0),
+		  m_separatedSkips(0),
+		  m_contactRefreshes(0)
+	{
+	}
+
+	btScalar getHitRate() const
+	{
+		return m_queries ? btScalar(m_separatedSkips + m_contactRefreshes) / btScalar(m_queries) : btScalar(0);
+	}
+};
+
 ///Enabling USE_SEPDISTANCE_UTIL2 requires 100% reliable distance computation. However, when using large size ratios GJK can be imprecise
 ///so the distance is not conservative. In that case, enabling this USE_SEPDISTANCE_UTIL2 would result in failing/missing collisions.
 ///Either improve GJK for large size ratios (testing a 100 units versus a 0.1 unit object) or only enable the util
@@ -55,6 +75,20 @@ class btConvexConvexAlgorithm : public btActivatingCollisionAlgorithm
 	int m_numPerturbationIterations;
 	int m_minimumPointsPerturbationThreshold;
 
+	///the coherence cache, used with btDispatcherInfo::m_enableConvexCoherence: the world transforms and shapes of the last query,
+	///and the motion of the two bodies since then that can not change its result, negative when the cache is empty
+	btTransform m_coherenceTransformA;
+	btTransform m_coherenceTransformB;
+	const btCollisionShape* m_coherenceShapeA;
+	const btCollisionShape* m_coherenceShapeB;
+	btScalar m_coherenceRadiusA;
+	btScalar m_coherenceRadiusB;
+	btScalar m_coherenceMotion;
+	bool m_coherenceTouching;
+
+	bool testCoherence(const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap, btManifoldResult* resultOut);
+	void updateCoherence(const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap, const btDispatcherInfo& dispatchInfo, const btManifoldResult* resultOut, const btVector3& separatingAxis);
+
 	///cache separating vector to speedup collision detection
 
 public:
@@ -75,6 +109,16 @@ public:
 
 	void setLowLevelOfDetail(bool useLowLevel);
 
+	///empties the coherence cache, so the next processCollision runs a full query. Needed after changing a shape in place, e.g. its scaling
+	void resetCoherence()
+	{
+		m_coherenceMotion = btScalar(-1.);
+	}
+
+	///sums the coherence counters of all threads, they are only consistent when no collision detection runs
+	static void getCoherenceStats(btConvexCoherenceStats& stats);
+	static void resetCoherenceStats();
+
 	const btPersistentManifold* getManifold()
 	{
 		return m_manifoldPtr;
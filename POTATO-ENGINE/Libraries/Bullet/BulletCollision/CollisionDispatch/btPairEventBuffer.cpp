@@ -0,0 +1,134 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose, 
+including commercial applications, and to alter it and redistribute it freely, 
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btPairEventBuffer.h"
+#include "BulletCollision/BroadphaseCollision/btBroadphaseProxy.h"
+#include "BulletCollision/CollisionDispatch/btCollisionObject.h"
+#include "BulletCollision/NarrowPhaseCollision/btPersistentManifold.h"
+#include "LinearMath/btQuickprof.h"
+
+btPairEventBuffer::btPairEventBuffer()
+	: m_filterCallback(0),
+	  m_eventMask(btPairEvent::PAIR_BEGIN | btPairEvent::PAIR_END | btPairEvent::CONTACT_BEGIN | btPairEvent::CONTACT_END)
+{
+}
+
+btPairEventBuffer::~btPairEventBuffer()
+{
+}
+
+bool btPairEventBuffer::needPairEvents(const btCollisionObject* object0, const btCollisionObject* object1) const
+{
+	return m_filterCallback == 0 || m_filterCallback->needPairEvents(object0, object1);
+}
+
+void btPairEventBuffer::addEvent(int type, const btCollisionObject* object0, const btCollisionObject* object1)
+{
+	btPairEvent& event = m_events.expandNonInitializing();
+	event.m_type = type;
+	event.m_userIndex0 = object0->getUserIndex();
+	event.m_userIndex1 = object1->getUserIndex();
+	event.m_object0 = object0;
+	event.m_object1 = object1;
+}
+
+btBroadphasePair* btPairEventBuffer::addOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
+{
+	if (m_eventMask & btPairEvent::PAIR_BEGIN)
+	{
+		const btCollisionObject* object0 = static_cast<const btCollisionObject*>(proxy0->m_clientObject);
+		const btCollisionObject* object1 = static_cast<const btCollisionObject*>(proxy1->m_clientObject);
+		if (needPairEvents(object0, object1))
+		{
+			addEvent(btPairEvent::PAIR_BEGIN, object0, object1);
+		}
+	}
+	return 0;
+}
+
+void* btPairEventBuffer::removeOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1, btDispatcher* /*dispatcher*/)
+{
+	if (m_eventMask & btPairEvent::PAIR_END)
+	{
+		const btCollisionObject* object0 = static_cast<const btCollisionObject*>(proxy0->m_clientObject);
+		const btCollisionObject* object1 = static_cast<const btCollisionObject*>(proxy1->m_clientObject);
+		if (needPairEvents(object0, object1))
+		{
+			addEvent(btPairEvent::PAIR_END, object0, object1);
+		}
+	}
+	return 0;
+}
+
+void btPairEventBuffer::removeOverlappingPairsContainingProxy(btBroadphaseProxy* /*proxy0*/, btDispatcher* /*dispatcher*/)
+{
+	// the pair cache removes the pairs one by one through removeOverlappingPair
+}
+
+void btPairEventBuffer::updateManifolds(btPersistentManifold* const* manifolds, int numManifolds)
+{
+	BT_PROFILE("btPairEventBuffer::updateManifolds");
+	const bool reportPersist = (m_eventMask & btPairEvent::CONTACT_PERSIST) != 0;
+	for (int i = 0; i < numManifolds; ++i)
+	{
+		btPersistentManifold* manifold = manifolds[i];
+		const int state = manifold->m_pairEventState;
+		if (state == MANIFOLD_FILTERED)
+		{
+			continue;
+		}
+		const bool touching = manifold->getNumContacts() > 0;
+		if (state == MANIFOLD_APART)
+		{
+			if (touching)
+			{
+				if (!needPairEvents(manifold->getBody0(), manifold->getBody1()))
+				{
+					manifold->m_pairEventState = MANIFOLD_FILTERED;
+					continue;
+				}
+				manifold->m_pairEventState = MANIFOLD_TOUCHING;
+				if (m_eventMask & btPairEvent::CONTACT_BEGIN)
+				{
+					addEvent(btPairEvent::CONTACT_BEGIN, manifold->getBody0(), manifold->getBody1());
+				}
+			}
+		}
+		else if (!touching)
+		{
+			manifold->m_pairEventState = MANIFOLD_APART;
+			if (m_eventMask & btPairEvent::CONTACT_END)
+			{
+				addEvent(btPairEvent::CONTACT_END, manifold->getBody0(), manifold->getBody1());
+			}
+		}
+		else if (reportPersist)
+		{
+			addEvent(btPairEvent::CONTACT_PERSIST, manifold->getBody0(), manifold->getBody1());
+		}
+	}
+}
+
+void btPairEventBuffer::releaseManifold(btPersistentManifold* manifold)
+{
+	if (manifold->m_pairEventState == MANIFOLD_TOUCHING)
+	{
+		manifold->m_pairEventState = MANIFOLD_APART;
+		if (m_eventMask & btPairEvent::CONTACT_END)
+		{
+			addEvent(btPairEvent::CONTACT_END, manifold->getBody0(), manifold->getBody1());
+		}
+	}
+}
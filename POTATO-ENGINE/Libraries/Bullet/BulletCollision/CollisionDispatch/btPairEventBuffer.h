@@ -0,0 +1,132 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose, 
+including commercial applications, and to alter it and redistribute it freely, 
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_PAIR_EVENT_BUFFER_H
+#define BT_PAIR_EVENT_BUFFER_H
+
+#include "BulletCollision/BroadphaseCollision/btBroadphaseProxy.h"
+#include "BulletCollision/BroadphaseCollision/btOverlappingPairCallback.h"
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btThreads.h"
+
+class btCollisionObject;
+class btPersistentManifold;
+
+///change in the state of a pair of collision objects, recorded by btPairEventBuffer
+struct btPairEvent
+{
+	enum Type
+	{
+		PAIR_BEGIN = 1,       // the broadphase boxes started to overlap
+		PAIR_END = 2,         // the broadphase boxes stopped overlapping, or one of the objects left the world
+		CONTACT_BEGIN = 4,    // a manifold got its first contact point
+		CONTACT_PERSIST = 8,  // a manifold still has contact points, at every collision detection
+		CONTACT_END = 16,     // a manifold lost its last contact point, or was released while touching
+	};
+
+	int m_type;
+	int m_userIndex0;  // user indices of the objects when the event was recorded
+	int m_userIndex1;
+	// for PAIR_END and CONTACT_END the objects may have been removed from the world and deleted since
+	const btCollisionObject* m_object0;
+	const btCollisionObject* m_object1;
+};
+
+///decides which pairs of collision objects get events
+struct btPairEventFilterCallback
+{
+	virtual ~btPairEventFilterCallback()
+	{
+	}
+	// return true when the pair needs events; must give the same answer for the lifetime of the pair
+	virtual bool needPairEvents(const btCollisionObject* object0, const btCollisionObject* object1) const = 0;
+};
+
+///The btPairEventBuffer collects begin and end events of overlapping pairs and of contacts, so that triggers, impact sounds
+///or replication can do work for what changed instead of going through every manifold at every step.
+///The pair cache reports its pairs to it when set with btOverlappingPairCache::setPairEventCallback, and the dispatcher
+///reports its manifolds when set with btCollisionDispatcher::setPairEventBuffer: it keeps the state of each manifold and
+///compares it with the contact count after the narrowphase, in one pass over the manifold pointers.
+///A manifold is only passed through the filter when it first gets contact points.
+///Events accumulate over the steps until clearEvents, and are recorded from the stepping thread only.
+class btPairEventBuffer : public btOverlappingPairCallback
+{
+public:
+	btPairEventBuffer();
+	virtual ~btPairEventBuffer();
+
+	int getNumEvents() const
+	{
+		return m_events.size();
+	}
+	const btPairEvent& getEvent(int index) const
+	{
+		return m_events[index];
+	}
+	const btAlignedObjectArray<btPairEvent>& getEvents() const
+	{
+		return m_events;
+	}
+	void clearEvents()
+	{
+		m_events.resizeNoInitialize(0);
+	}
+
+	///btPairEvent::Type bits of the events to record, by default all but CONTACT_PERSIST
+	void setEventMask(int eventMask)
+	{
+		m_eventMask = eventMask;
+	}
+	int getEventMask() const
+	{
+		return m_eventMask;
+	}
+
+	void setFilterCallback(btPairEventFilterCallback* filterCallback)
+	{
+		m_filterCallback = filterCallback;
+	}
+	btPairEventFilterCallback* getFilterCallback() const
+	{
+		return m_filterCallback;
+	}
+
+	// called by the pair cache
+	virtual btBroadphasePair* addOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) BT_OVERRIDE;
+	virtual void* removeOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1, btDispatcher* dispatcher) BT_OVERRIDE;
+	virtual void removeOverlappingPairsContainingProxy(btBroadphaseProxy* proxy0, btDispatcher* dispatcher) BT_OVERRIDE;
+
+	// called by the dispatcher
+	void updateManifolds(btPersistentManifold* const* manifolds, int numManifolds);
+	void releaseManifold(btPersistentManifold* manifold);
+
+	///manifold state kept in btPersistentManifold::m_pairEventState
+	enum ManifoldState
+	{
+		MANIFOLD_APART = 0,
+		MANIFOLD_TOUCHING,
+		MANIFOLD_FILTERED,
+	};
+
+private:
+	bool needPairEvents(const btCollisionObject* object0, const btCollisionObject* object1) const;
+	void addEvent(int type, const btCollisionObject* object0, const btCollisionObject* object1);
+
+	btAlignedObjectArray<btPairEvent> m_events;
+	btPairEventFilterCallback* m_filterCallback;
+	int m_eventMask;
+};
+
+#endif  //BT_PAIR_EVENT_BUFFER_H
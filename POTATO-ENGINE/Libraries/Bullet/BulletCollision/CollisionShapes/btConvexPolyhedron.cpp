@@ -58,11 +58,13 @@ struct btInternalEdge
 {
 	btInternalEdge()
 		: m_face0(-1),
-		  m_face1(-1)
+		  m_face1(-1),
+		  m_uniqueEdge(-1)
 	{
 	}
 	short int m_face0;
 	short int m_face1;
+	int m_uniqueEdge;
 };
 
 //
@@ -118,20 +120,21 @@ void btConvexPolyhedron::initialize()
 			btVector3 edge = m_vertices[vp.m_v1] - m_vertices[vp.m_v0];
 			edge.normalize();
 
-			bool found = false;
+			int uniqueEdge = -1;
 
 			for (int p = 0; p < m_uniqueEdges.size(); p++)
 			{
 				if (IsAlmostZero1(m_uniqueEdges[p] - edge) ||
 					IsAlmostZero1(m_uniqueEdges[p] + edge))
 				{
-					found = true;
+					uniqueEdge = p;
 					break;
 				}
 			}
 
-			if (!found)
+			if (uniqueEdge < 0)
 			{
+				uniqueEdge = m_uniqueEdges.size();
 				m_uniqueEdges.push_back(edge);
 			}
 
@@ -145,11 +148,39 @@ void btConvexPolyhedron::initialize()
 			{
 				btInternalEdge ed;
 				ed.m_face0 = i;
+				ed.m_uniqueEdge = uniqueEdge;
 				edges.insert(vp, ed);
 			}
 		}
 	}
 
+	// the Gauss map is only valid for a closed polyhedron
+	m_gaussMapEdges.resize(0);
+	bool closed = true;
+	for (int i = 0; i < edges.size(); i++)
+	{
+		if (edges.getAtIndex(i)->m_face1 < 0)
+		{
+			closed = false;
+			break;
+		}
+	}
+	if (closed)
+	{
+		m_gaussMapEdges.resize(edges.size());
+		for (int i = 0; i < edges.size(); i++)
+		{
+			const btInternalVertexPair vp = edges.getKeyAtIndex(i);
+			const btInternalEdge* ed = edges.getAtIndex(i);
+			btGaussMapEdge& gaussMapEdge = m_gaussMapEdges[i];
+			gaussMapEdge.m_vertex0 = vp.m_v0;
+			gaussMapEdge.m_vertex1 = vp.m_v1;
+			gaussMapEdge.m_face0 = ed->m_face0;
+			gaussMapEdge.m_face1 = ed->m_face1;
+			gaussMapEdge.m_uniqueEdge = ed->m_uniqueEdge;
+		}
+	}
+
 #ifdef USE_CONNECTED_FACES
 	for (int i = 0; i < m_faces.size(); i++)
 	{
@@ -276,27 +307,14 @@ void btConvexPolyhedron::initialize2()
 }
 void btConvexPolyhedron::project(const btTransform& trans, const btVector3& dir, btScalar& minProj, btScalar& maxProj, btVector3& witnesPtMin, btVector3& witnesPtMax) const
 {
-	minProj = FLT_MAX;
-	maxProj = -FLT_MAX;
-	int numVerts = m_vertices.size();
-	for (int i = 0; i < numVerts; i++)
-	{
-		btVector3 pt = trans * m_vertices[i];
-		btScalar dp = pt.dot(dir);
-		if (dp < minProj)
-		{
-			minProj = dp;
-			witnesPtMin = pt;
-		}
-		if (dp > maxProj)
-		{
-			maxProj = dp;
-			witnesPtMax = pt;
-		}
-	}
-	if (minProj > maxProj)
-	{
-		btSwap(minProj, maxProj);
-		btSwap(witnesPtMin, witnesPtMax);
-	}
+	// project the local vertices on the direction in the local frame, so the vertices need no transform
+	const btVector3 localDir = dir * trans.getBasis();
+	const btScalar offset = trans.getOrigin().dot(dir);
+	const long numVerts = m_vertices.size();
+	const long iMin = localDir.minDot(&m_vertices[0], numVerts, minProj);
+	const long iMax = localDir.maxDot(&m_vertices[0], numVerts, maxProj);
+	minProj += offset;
+	maxProj += offset;
+	witnesPtMin = trans * m_vertices[iMin];
+	witnesPtMax = trans * m_vertices[iMax];
 }
@@ -30,6 +30,17 @@ struct btFace
 	btScalar m_plane[4];
 };
 
+///btGaussMapEdge is an edge of a closed polyhedron with the two faces that share it.
+///On the Gauss map the edge is the arc between the normals of m_face0 and m_face1.
+struct btGaussMapEdge
+{
+	int m_vertex0;
+	int m_vertex1;
+	int m_face0;
+	int m_face1;
+	int m_uniqueEdge;  // index of the direction of the edge in m_uniqueEdges
+};
+
 ATTRIBUTE_ALIGNED16(class)
 btConvexPolyhedron
 {
@@ -42,6 +53,8 @@ public:
 	btAlignedObjectArray<btVector3> m_vertices;
 	btAlignedObjectArray<btFace> m_faces;
 	btAlignedObjectArray<btVector3> m_uniqueEdges;
+	///edges with their adjacent faces, empty unless every edge is shared by exactly two faces
+	btAlignedObjectArray<btGaussMapEdge> m_gaussMapEdges;
 
 	btVector3 m_localCenter;
 	btVector3 m_extents;
@@ -53,6 +66,7 @@ public:
 	void initialize2();
 	bool testContainment() const;
 
+	///the support queries of project run on the local vertices with btVector3::minDot and maxDot
 	void project(const btTransform& trans, const btVector3& dir, btScalar& minProj, btScalar& maxProj, btVector3& witnesPtMin, btVector3& witnesPtMax) const;
 };
 
@@ -220,3 +220,6 @@ bool btContinuousConvexCollision::calcTimeOfImpact(
 
 	return false;
 }
+
+// btGjkConvexCast.cpp defines its own limit when both are compiled in one unity source
+#undef MAX_ITERATIONS
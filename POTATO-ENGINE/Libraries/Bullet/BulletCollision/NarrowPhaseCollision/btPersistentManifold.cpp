@@ -37,9 +37,12 @@ btPersistentManifold::btPersistentManifold()
 	  m_body0(0),
 	  m_body1(0),
 	  m_cachedPoints(0),
+	  m_contactCapacity(MANIFOLD_DEFAULT_CAPACITY),
 	  m_companionIdA(0),
 	  m_companionIdB(0),
-	  m_index1a(0)
+	  m_index1a(0),
+	  m_pairEventState(0),
+	  m_separatingFeature(-1)
 {
 }
 
@@ -189,6 +192,65 @@ int btPersistentManifold::sortCachedPoints(const btManifoldPoint& pt)
 	return biggestarea;
 }
 
+int btPersistentManifold::reduceCachedPoints(const btManifoldPoint& pt)
+{
+	//keep the deepest point, and give the new point the slot of the closest two points that are left:
+	//either the cached point nearest to the new point, or the shallower of the two closest cached points
+	int maxPenetrationIndex = -1;
+	btScalar maxPenetration = pt.getDistance();
+	for (int i = 0; i < m_cachedPoints; i++)
+	{
+		if (m_pointCache[i].getDistance() < maxPenetration)
+		{
+			maxPenetrationIndex = i;
+			maxPenetration = m_pointCache[i].getDistance();
+		}
+	}
+
+	int replaceIndex = maxPenetrationIndex == 0 ? 1 : 0;
+	btScalar closestDist2 = BT_LARGE_FLOAT;
+	for (int i = 0; i < m_cachedPoints; i++)
+	{
+		if (i == maxPenetrationIndex)
+			continue;
+		btScalar dist2 = (m_pointCache[i].m_localPointA - pt.m_localPointA).length2();
+		if (dist2 < closestDist2)
+		{
+			closestDist2 = dist2;
+			replaceIndex = i;
+		}
+	}
+	for (int i = 0; i < m_cachedPoints; i++)
+	{
+		for (int j = i + 1; j < m_cachedPoints; j++)
+		{
+			btScalar dist2 = (m_pointCache[i].m_localPointA - m_pointCache[j].m_localPointA).length2();
+			if (dist2 < closestDist2)
+			{
+				closestDist2 = dist2;
+				if (i == maxPenetrationIndex)
+					replaceIndex = j;
+				else if (j == maxPenetrationIndex)
+					replaceIndex = i;
+				else
+					replaceIndex = m_pointCache[i].getDistance() > m_pointCache[j].getDistance() ? i : j;
+			}
+		}
+	}
+	//a single point is always replaced
+	return replaceIndex < m_cachedPoints ? replaceIndex : 0;
+}
+
+void btPersistentManifold::setContactCapacity(int contactCapacity)
+{
+	btAssert(contactCapacity >= 1 && contactCapacity <= MANIFOLD_CACHE_SIZE);
+	m_contactCapacity = btMax(1, btMin(contactCapacity, int(MANIFOLD_CACHE_SIZE)));
+	while (m_cachedPoints > m_contactCapacity)
+	{
+		removeContactPoint(m_cachedPoints - 1);
+	}
+}
+
 int btPersistentManifold::getCacheEntry(const btManifoldPoint& newPoint) const
 {
 	btScalar shortestDist = getContactBreakingThreshold() * getContactBreakingThreshold();
@@ -217,14 +279,17 @@ int btPersistentManifold::addManifoldPoint(const btManifoldPoint& newPoint, bool
 	}
 
 	int insertIndex = getNumContacts();
-	if (insertIndex == MANIFOLD_CACHE_SIZE)
+	if (insertIndex >= m_contactCapacity)
 	{
-#if MANIFOLD_CACHE_SIZE >= 4
-		//sort cache so best points come first, based on area
-		insertIndex = sortCachedPoints(newPoint);
-#else
-		insertIndex = 0;
-#endif
+		if (m_contactCapacity == 4)
+		{
+			//sort cache so best points come first, based on area
+			insertIndex = sortCachedPoints(newPoint);
+		}
+		else
+		{
+			insertIndex = reduceCachedPoints(newPoint);
+		}
 		clearUserCache(m_pointCache[insertIndex]);
 	}
 	else
@@ -315,13 +380,15 @@ const char* btPersistentManifold::serialize(const class btPersistentManifold* ma
 	dataOut->m_body1 = (btCollisionObjectData*)serializer->getUniquePointer((void*)manifold->getBody1());
 	dataOut->m_contactBreakingThreshold = manifold->getContactBreakingThreshold();
 	dataOut->m_contactProcessingThreshold = manifold->getContactProcessingThreshold();
-	dataOut->m_numCachedPoints = manifold->getNumContacts();
+	//the file format keeps 4 points, the first ones of a larger manifold
+	int numPoints = btMin(manifold->getNumContacts(), 4);
+	dataOut->m_numCachedPoints = numPoints;
 	dataOut->m_companionIdA = manifold->m_companionIdA;
 	dataOut->m_companionIdB = manifold->m_companionIdB;
 	dataOut->m_index1a = manifold->m_index1a;
 	dataOut->m_objectType = manifold->m_objectType;
 
-	for (int i = 0; i < this->getNumContacts(); i++)
+	for (int i = 0; i < numPoints; i++)
 	{
 		const btManifoldPoint& pt = manifold->getContactPoint(i);
 		dataOut->m_pointCacheAppliedImpulse[i] = pt.m_appliedImpulse;
@@ -361,7 +428,7 @@ void btPersistentManifold::deSerialize(const struct btPersistentManifoldDoubleDa
 {
 	m_contactBreakingThreshold = manifoldDataPtr->m_contactBreakingThreshold;
 	m_contactProcessingThreshold = manifoldDataPtr->m_contactProcessingThreshold;
-	m_cachedPoints = manifoldDataPtr->m_numCachedPoints;
+	m_cachedPoints = btMin(manifoldDataPtr->m_numCachedPoints, int(MANIFOLD_CACHE_SIZE));
 	m_companionIdA = manifoldDataPtr->m_companionIdA;
 	m_companionIdB = manifoldDataPtr->m_companionIdB;
 	//m_index1a = manifoldDataPtr->m_index1a;
@@ -407,7 +474,7 @@ void btPersistentManifold::deSerialize(const struct btPersistentManifoldFloatDat
 {
 	m_contactBreakingThreshold = manifoldDataPtr->m_contactBreakingThreshold;
 	m_contactProcessingThreshold = manifoldDataPtr->m_contactProcessingThreshold;
-	m_cachedPoints = manifoldDataPtr->m_numCachedPoints;
+	m_cachedPoints = btMin(manifoldDataPtr->m_numCachedPoints, int(MANIFOLD_CACHE_SIZE));
 	m_companionIdA = manifoldDataPtr->m_companionIdA;
 	m_companionIdB = manifoldDataPtr->m_companionIdB;
 	//m_index1a = manifoldDataPtr->m_index1a;
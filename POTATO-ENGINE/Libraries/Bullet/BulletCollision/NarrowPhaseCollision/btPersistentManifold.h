@@ -49,14 +49,26 @@ enum btContactManifoldTypes
 	BT_PERSISTENT_MANIFOLD_TYPE
 };
 
+///MANIFOLD_CACHE_SIZE is the most points a manifold can hold, it sets the size of every btPersistentManifold.
+///It can be defined for the whole build, for example to 8 so that box on mesh pairs keep every corner, see setContactCapacity.
+#ifndef MANIFOLD_CACHE_SIZE
 #define MANIFOLD_CACHE_SIZE 4
+#endif
+
+///capacity of a new manifold, the classic 4 points unless the cache is smaller
+#if MANIFOLD_CACHE_SIZE < 4
+#define MANIFOLD_DEFAULT_CAPACITY MANIFOLD_CACHE_SIZE
+#else
+#define MANIFOLD_DEFAULT_CAPACITY 4
+#endif
 
 ///btPersistentManifold is a contact point cache, it stays persistent as long as objects are overlapping in the broadphase.
 ///Those contact points are created by the collision narrow phase.
-///The cache can be empty, or hold 1,2,3 or 4 points. Some collision algorithms (GJK) might only add one point at a time.
+///The cache can be empty, or hold up to its capacity of points, 4 by default. Some collision algorithms (GJK) might only add one point at a time.
 ///updates/refreshes old contact points, and throw them away if necessary (distance becomes too large)
-///reduces the cache to 4 points, when more then 4 points are added, using following rules:
-///the contact point with deepest penetration is always kept, and it tries to maximuze the area covered by the points
+///reduces the cache to its capacity, when more points are added, using following rules:
+///the contact point with deepest penetration is always kept, and with a capacity of 4 it tries to maximuze the area covered by the points,
+///with any other capacity the new point replaces one of the two closest points, which costs distances instead of areas.
 ///note that some pairs of objects might have more then one contact manifold.
 
 //ATTRIBUTE_ALIGNED128( class) btPersistentManifold : public btTypedObject
@@ -70,6 +82,7 @@ btPersistentManifold : public btTypedObject
 	const btCollisionObject* m_body1;
 
 	int m_cachedPoints;
+	int m_contactCapacity;
 
 	btScalar m_contactBreakingThreshold;
 	btScalar m_contactProcessingThreshold;
@@ -77,6 +90,9 @@ btPersistentManifold : public btTypedObject
 	/// sort cached points so most isolated points come first
 	int sortCachedPoints(const btManifoldPoint& pt);
 
+	/// picks the point that the new point replaces for capacities other than 4
+	int reduceCachedPoints(const btManifoldPoint& pt);
+
 	int findContactPoint(const btManifoldPoint* unUsed, int numUnused, const btManifoldPoint& pt);
 
 public:
@@ -87,6 +103,9 @@ public:
 
 	int m_index1a;
 
+	int m_pairEventState;     // whether a btPairEventBuffer saw contact points at its last update
+	int m_separatingFeature;  // face or edge pair of the last polyhedral separating axis test, see btPolyhedralContactClipping::findSeparatingAxis
+
 	btPersistentManifold();
 
 	btPersistentManifold(const btCollisionObject* body0, const btCollisionObject* body1, int, btScalar contactBreakingThreshold, btScalar contactProcessingThreshold)
@@ -94,11 +113,14 @@ public:
 		  m_body0(body0),
 		  m_body1(body1),
 		  m_cachedPoints(0),
+		  m_contactCapacity(MANIFOLD_DEFAULT_CAPACITY),
 		  m_contactBreakingThreshold(contactBreakingThreshold),
 		  m_contactProcessingThreshold(contactProcessingThreshold),
 		  m_companionIdA(0),
 		  m_companionIdB(0),
-		  m_index1a(0)
+		  m_index1a(0),
+		  m_pairEventState(0),
+		  m_separatingFeature(-1)
 	{
 	}
 
@@ -127,6 +149,14 @@ public:
 		m_cachedPoints = cachedPoints;
 	}
 
+	int getContactCapacity() const
+	{
+		return m_contactCapacity;
+	}
+	/// sets how many points the manifold keeps before it reduces them, between 1 and MANIFOLD_CACHE_SIZE.
+	/// Lowering it below the current number of points drops the most recently added ones.
+	void setContactCapacity(int contactCapacity);
+
 	SIMD_FORCE_INLINE const btManifoldPoint& getContactPoint(int index) const
 	{
 		btAssert(index < m_cachedPoints);
@@ -233,7 +233,167 @@ SIMD_FORCE_INLINE void btSegmentsClosestPoints(
 	ptsVector = translation - offsetA + offsetB;
 }
 
-bool btPolyhedralContactClipping::findSeparatingAxis(const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA, const btTransform& transB, btVector3& sep, btDiscreteCollisionDetectorInterface::Result& resultOut)
+// the best axis found so far by findSeparatingAxis, with the edges and witness points when it is an edge-edge axis
+struct btSatBestAxis
+{
+	btScalar m_dmin;
+	btVector3 m_sep;
+	int m_feature;
+	int m_edgeA;
+	int m_edgeB;
+	btVector3 m_worldEdgeA;
+	btVector3 m_worldEdgeB;
+	btVector3 m_witnessPointA;
+	btVector3 m_witnessPointB;
+};
+
+// returns false when the cross product of unique edges e0 and e1 is a separating axis
+static bool btTestSatEdgePair(const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA, const btTransform& transB, const btVector3& DeltaC2, int e0, int e1, btSatBestAxis& best)
+{
+	const btVector3 WorldEdge0 = transA.getBasis() * hullA.m_uniqueEdges[e0];
+	const btVector3 WorldEdge1 = transB.getBasis() * hullB.m_uniqueEdges[e1];
+
+	btVector3 Cross = WorldEdge0.cross(WorldEdge1);
+	if (IsAlmostZero(Cross))
+		return true;
+
+	Cross = Cross.normalize();
+	if (DeltaC2.dot(Cross) < 0)
+		Cross *= -1.f;
+
+#ifdef TEST_INTERNAL_OBJECTS
+	gExpectedNbTests++;
+	if (gUseInternalObject && !TestInternalObjects(transA, transB, DeltaC2, Cross, hullA, hullB, best.m_dmin))
+		return true;
+	gActualNbTests++;
+#endif
+
+	const int feature = hullA.m_faces.size() + hullB.m_faces.size() + e0 * hullB.m_uniqueEdges.size() + e1;
+	btScalar dist;
+	btVector3 wA, wB;
+	if (!TestSepAxis(hullA, hullB, transA, transB, Cross, dist, wA, wB))
+	{
+		best.m_sep = Cross;
+		best.m_feature = feature;
+		return false;
+	}
+
+	if (dist < best.m_dmin)
+	{
+		best.m_dmin = dist;
+		best.m_sep = Cross;
+		best.m_feature = feature;
+		best.m_edgeA = e0;
+		best.m_edgeB = e1;
+		best.m_worldEdgeA = WorldEdge0;
+		best.m_worldEdgeB = WorldEdge1;
+		best.m_witnessPointA = wA;
+		best.m_witnessPointB = wB;
+	}
+	return true;
+}
+
+// an edge of A and an edge of B give a face of the Minkowski difference when their arcs on the Gauss map intersect,
+// a and b are the normals of the faces of the edge of A, c and d the negated normals of the faces of the edge of B
+SIMD_FORCE_INLINE bool btIsMinkowskiFace(const btVector3& a, const btVector3& b, const btVector3& b_x_a, const btVector3& c, const btVector3& d, const btVector3& d_x_c)
+{
+	const btScalar CBA = c.dot(b_x_a);
+	const btScalar DBA = d.dot(b_x_a);
+	const btScalar ADC = a.dot(d_x_c);
+	const btScalar BDC = b.dot(d_x_c);
+	return CBA * DBA < btScalar(0.) && ADC * BDC < btScalar(0.) && CBA * BDC > btScalar(0.);
+}
+
+// returns false when an edge pair that forms a face of the Minkowski difference gives a separating axis,
+// only those pairs can give the smallest overlap or a separating axis among the edge-edge axes
+static bool btTestSatGaussMapEdges(const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA, const btTransform& transB, const btVector3& DeltaC2, btSatBestAxis& best)
+{
+	// the face normals of A are rotated into the frame of B
+	const btMatrix3x3 relBasis = transB.getBasis().transposeTimes(transA.getBasis());
+	const int numUniqueB = hullB.m_uniqueEdges.size();
+
+	// edges of different faces often share their directions, every pair of unique edges is only tested once
+	const int maxTestedPairs = 64;
+	int testedPairs[maxTestedPairs];
+	int numTestedPairs = 0;
+
+	for (int i = 0; i < hullA.m_gaussMapEdges.size(); i++)
+	{
+		const btGaussMapEdge& edgeA = hullA.m_gaussMapEdges[i];
+		const btFace& faceA0 = hullA.m_faces[edgeA.m_face0];
+		const btFace& faceA1 = hullA.m_faces[edgeA.m_face1];
+		const btVector3 a = relBasis * btVector3(faceA0.m_plane[0], faceA0.m_plane[1], faceA0.m_plane[2]);
+		const btVector3 b = relBasis * btVector3(faceA1.m_plane[0], faceA1.m_plane[1], faceA1.m_plane[2]);
+		const btVector3 b_x_a = b.cross(a);
+
+		for (int j = 0; j < hullB.m_gaussMapEdges.size(); j++)
+		{
+			const btGaussMapEdge& edgeB = hullB.m_gaussMapEdges[j];
+			const btFace& faceB0 = hullB.m_faces[edgeB.m_face0];
+			const btFace& faceB1 = hullB.m_faces[edgeB.m_face1];
+			const btVector3 c(-faceB0.m_plane[0], -faceB0.m_plane[1], -faceB0.m_plane[2]);
+			const btVector3 d(-faceB1.m_plane[0], -faceB1.m_plane[1], -faceB1.m_plane[2]);
+			if (!btIsMinkowskiFace(a, b, b_x_a, c, d, d.cross(c)))
+				continue;
+
+			const int pair = edgeA.m_uniqueEdge * numUniqueB + edgeB.m_uniqueEdge;
+			bool tested = false;
+			for (int k = 0; k < numTestedPairs; k++)
+			{
+				if (testedPairs[k] == pair)
+				{
+					tested = true;
+					break;
+				}
+			}
+			if (tested)
+				continue;
+			if (numTestedPairs < maxTestedPairs)
+				testedPairs[numTestedPairs++] = pair;
+
+			if (!btTestSatEdgePair(hullA, hullB, transA, transB, DeltaC2, edgeA.m_uniqueEdge, edgeB.m_uniqueEdge, best))
+				return false;
+		}
+	}
+	return true;
+}
+
+// computes the axis of a feature of findSeparatingAxis, oriented from B to A
+static bool btSatFeatureAxis(const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA, const btTransform& transB, const btVector3& DeltaC2, int feature, btVector3& axis, int& edgeA, int& edgeB)
+{
+	const int numFacesA = hullA.m_faces.size();
+	const int numFacesB = hullB.m_faces.size();
+	edgeA = -1;
+	edgeB = -1;
+	if (feature < numFacesA)
+	{
+		const btFace& face = hullA.m_faces[feature];
+		axis = transA.getBasis() * btVector3(face.m_plane[0], face.m_plane[1], face.m_plane[2]);
+	}
+	else if (feature < numFacesA + numFacesB)
+	{
+		const btFace& face = hullB.m_faces[feature - numFacesA];
+		axis = transB.getBasis() * btVector3(face.m_plane[0], face.m_plane[1], face.m_plane[2]);
+	}
+	else
+	{
+		const int numUniqueB = hullB.m_uniqueEdges.size();
+		const int pair = feature - numFacesA - numFacesB;
+		if (numUniqueB == 0 || pair >= hullA.m_uniqueEdges.size() * numUniqueB)
+			return false;
+		edgeA = pair / numUniqueB;
+		edgeB = pair % numUniqueB;
+		axis = (transA.getBasis() * hullA.m_uniqueEdges[edgeA]).cross(transB.getBasis() * hullB.m_uniqueEdges[edgeB]);
+		if (IsAlmostZero(axis))
+			return false;
+		axis.normalize();
+	}
+	if (DeltaC2.dot(axis) < 0)
+		axis *= -1.f;
+	return true;
+}
+
+bool btPolyhedralContactClipping::findSeparatingAxis(const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA, const btTransform& transB, btVector3& sep, btDiscreteCollisionDetectorInterface::Result& resultOut, int* featureCache)
 {
 	gActualSATPairTests++;
 
@@ -243,10 +403,49 @@ bool btPolyhedralContactClipping::findSeparatingAxis(const btConvexPolyhedron& h
 	const btVector3 DeltaC2 = c0 - c1;
 	//#endif
 
-	btScalar dmin = FLT_MAX;
+	btSatBestAxis best;
+	best.m_dmin = FLT_MAX;
+	best.m_feature = -1;
+	best.m_edgeA = -1;
+	best.m_edgeB = -1;
+	best.m_witnessPointA.setValue(0, 0, 0);
+	best.m_witnessPointB.setValue(0, 0, 0);
 	int curPlaneTests = 0;
 
 	int numFacesA = hullA.m_faces.size();
+	int numFacesB = hullB.m_faces.size();
+
+	// warm start from the axis of the previous query: it usually still separates the hulls,
+	// or its overlap is small enough to let the internal objects cull most of the other axes
+	if (featureCache && *featureCache >= 0)
+	{
+		btVector3 axis;
+		int e0, e1;
+		if (btSatFeatureAxis(hullA, hullB, transA, transB, DeltaC2, *featureCache, axis, e0, e1))
+		{
+			btScalar d;
+			btVector3 wA, wB;
+			if (!TestSepAxis(hullA, hullB, transA, transB, axis, d, wA, wB))
+			{
+				sep = axis;
+				return false;
+			}
+
+			best.m_dmin = d;
+			best.m_sep = axis;
+			best.m_feature = *featureCache;
+			if (e0 >= 0)
+			{
+				best.m_edgeA = e0;
+				best.m_edgeB = e1;
+				best.m_worldEdgeA = transA.getBasis() * hullA.m_uniqueEdges[e0];
+				best.m_worldEdgeB = transB.getBasis() * hullB.m_uniqueEdges[e1];
+				best.m_witnessPointA = wA;
+				best.m_witnessPointB = wB;
+			}
+		}
+	}
+
 	// Test normals from hullA
 	for (int i = 0; i < numFacesA; i++)
 	{
@@ -258,7 +457,7 @@ bool btPolyhedralContactClipping::findSeparatingAxis(const btConvexPolyhedron& h
 		curPlaneTests++;
 #ifdef TEST_INTERNAL_OBJECTS
 		gExpectedNbTests++;
-		if (gUseInternalObject && !TestInternalObjects(transA, transB, DeltaC2, faceANormalWS, hullA, hullB, dmin))
+		if (gUseInternalObject && !TestInternalObjects(transA, transB, DeltaC2, faceANormalWS, hullA, hullB, best.m_dmin))
 			continue;
 		gActualNbTests++;
 #endif
@@ -266,16 +465,23 @@ bool btPolyhedralContactClipping::findSeparatingAxis(const btConvexPolyhedron& h
 		btScalar d;
 		btVector3 wA, wB;
 		if (!TestSepAxis(hullA, hullB, transA, transB, faceANormalWS, d, wA, wB))
+		{
+			if (featureCache)
+				*featureCache = i;
+			sep = faceANormalWS;
 			return false;
+		}
 
-		if (d < dmin)
+		if (d < best.m_dmin)
 		{
-			dmin = d;
-			sep = faceANormalWS;
+			best.m_dmin = d;
+			best.m_sep = faceANormalWS;
+			best.m_feature = i;
+			best.m_edgeA = -1;
+			best.m_edgeB = -1;
 		}
 	}
 
-	int numFacesB = hullB.m_faces.size();
 	// Test normals from hullB
 	for (int i = 0; i < numFacesB; i++)
 	{
@@ -287,7 +493,7 @@ bool btPolyhedralContactClipping::findSeparatingAxis(const btConvexPolyhedron& h
 		curPlaneTests++;
 #ifdef TEST_INTERNAL_OBJECTS
 		gExpectedNbTests++;
-		if (gUseInternalObject && !TestInternalObjects(transA, transB, DeltaC2, WorldNormal, hullA, hullB, dmin))
+		if (gUseInternalObject && !TestInternalObjects(transA, transB, DeltaC2, WorldNormal, hullA, hullB, best.m_dmin))
 			continue;
 		gActualNbTests++;
 #endif
@@ -295,68 +501,68 @@ bool btPolyhedralContactClipping::findSeparatingAxis(const btConvexPolyhedron& h
 		btScalar d;
 		btVector3 wA, wB;
 		if (!TestSepAxis(hullA, hullB, transA, transB, WorldNormal, d, wA, wB))
+		{
+			if (featureCache)
+				*featureCache = numFacesA + i;
+			sep = WorldNormal;
 			return false;
+		}
 
-		if (d < dmin)
+		if (d < best.m_dmin)
 		{
-			dmin = d;
-			sep = WorldNormal;
+			best.m_dmin = d;
+			best.m_sep = WorldNormal;
+			best.m_feature = numFacesA + i;
+			best.m_edgeA = -1;
+			best.m_edgeB = -1;
 		}
 	}
 
-	btVector3 edgeAstart, edgeAend, edgeBstart, edgeBend;
-	int edgeA = -1;
-	int edgeB = -1;
-	btVector3 worldEdgeA;
-	btVector3 worldEdgeB;
-	btVector3 witnessPointA(0, 0, 0), witnessPointB(0, 0, 0);
-
-	int curEdgeEdge = 0;
 	// Test edges
-	for (int e0 = 0; e0 < hullA.m_uniqueEdges.size(); e0++)
+	const int numUniqueA = hullA.m_uniqueEdges.size();
+	const int numUniqueB = hullB.m_uniqueEdges.size();
+	const int numGaussMapEdgeTests = hullA.m_gaussMapEdges.size() * hullB.m_gaussMapEdges.size();
+	const int numUniqueEdgeTests = numUniqueA * numUniqueB;
+	// the Gauss map test is a few dot products per pair of edges, each pair of unique edges projects both hulls,
+	// so the pruning pays off for hulls with many edge directions but not for boxes and other simple hulls
+	if (numGaussMapEdgeTests > 0 && numGaussMapEdgeTests * 8 < numUniqueEdgeTests * (hullA.m_vertices.size() + hullB.m_vertices.size()))
 	{
-		const btVector3 edge0 = hullA.m_uniqueEdges[e0];
-		const btVector3 WorldEdge0 = transA.getBasis() * edge0;
-		for (int e1 = 0; e1 < hullB.m_uniqueEdges.size(); e1++)
+		if (!btTestSatGaussMapEdges(hullA, hullB, transA, transB, DeltaC2, best))
 		{
-			const btVector3 edge1 = hullB.m_uniqueEdges[e1];
-			const btVector3 WorldEdge1 = transB.getBasis() * edge1;
-
-			btVector3 Cross = WorldEdge0.cross(WorldEdge1);
-			curEdgeEdge++;
-			if (!IsAlmostZero(Cross))
+			if (featureCache)
+				*featureCache = best.m_feature;
+			sep = best.m_sep;
+			return false;
+		}
+	}
+	else
+	{
+		for (int e0 = 0; e0 < numUniqueA; e0++)
+		{
+			for (int e1 = 0; e1 < numUniqueB; e1++)
 			{
-				Cross = Cross.normalize();
-				if (DeltaC2.dot(Cross) < 0)
-					Cross *= -1.f;
-
-#ifdef TEST_INTERNAL_OBJECTS
-				gExpectedNbTests++;
-				if (gUseInternalObject && !TestInternalObjects(transA, transB, DeltaC2, Cross, hullA, hullB, dmin))
-					continue;
-				gActualNbTests++;
-#endif
-
-				btScalar dist;
-				btVector3 wA, wB;
-				if (!TestSepAxis(hullA, hullB, transA, transB, Cross, dist, wA, wB))
-					return false;
-
-				if (dist < dmin)
+				if (!btTestSatEdgePair(hullA, hullB, transA, transB, DeltaC2, e0, e1, best))
 				{
-					dmin = dist;
-					sep = Cross;
-					edgeA = e0;
-					edgeB = e1;
-					worldEdgeA = WorldEdge0;
-					worldEdgeB = WorldEdge1;
-					witnessPointA = wA;
-					witnessPointB = wB;
+					if (featureCache)
+						*featureCache = best.m_feature;
+					sep = best.m_sep;
+					return false;
 				}
 			}
 		}
 	}
 
+	if (featureCache)
+		*featureCache = best.m_feature;
+	sep = best.m_sep;
+
+	const int edgeA = best.m_edgeA;
+	const int edgeB = best.m_edgeB;
+	const btVector3& worldEdgeA = best.m_worldEdgeA;
+	const btVector3& worldEdgeB = best.m_worldEdgeB;
+	const btVector3& witnessPointA = best.m_witnessPointA;
+	const btVector3& witnessPointB = best.m_witnessPointB;
+
 	if (edgeA >= 0 && edgeB >= 0)
 	{
 		//		printf("edge-edge\n");
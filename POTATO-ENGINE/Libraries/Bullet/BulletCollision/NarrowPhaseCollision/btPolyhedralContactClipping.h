@@ -33,7 +33,10 @@ struct btPolyhedralContactClipping
 
 	static void clipFaceAgainstHull(const btVector3& separatingNormal, const btConvexPolyhedron& hullA, const btTransform& transA, btVertexArray& worldVertsB1, btVertexArray& worldVertsB2, const btScalar minDist, btScalar maxDist, btDiscreteCollisionDetectorInterface::Result& resultOut);
 
-	static bool findSeparatingAxis(const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA, const btTransform& transB, btVector3& sep, btDiscreteCollisionDetectorInterface::Result& resultOut);
+	///Returns false when the hulls are separated, sep is then the separating axis that was found.
+	///featureCache is an optional face or edge pair index that is tested first and updated with the axis found, see btPersistentManifold::m_separatingFeature.
+	///Edge pairs of hulls with a Gauss map (btConvexPolyhedron::m_gaussMapEdges) are only tested when they form a face of the Minkowski difference.
+	static bool findSeparatingAxis(const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA, const btTransform& transB, btVector3& sep, btDiscreteCollisionDetectorInterface::Result& resultOut, int* featureCache = 0);
 
 	///the clipFace method is used internally
 	static void clipFace(const btVertexArray& pVtxIn, btVertexArray& ppVtxOut, const btVector3& planeNormalWS, btScalar planeEqWS);
@@ -15,6 +15,7 @@ subject to the following restrictions:
 
 #include "btBatchedConstraints.h"
 
+#include "BulletDynamics/Dynamics/btRigidBody.h"
 #include "LinearMath/btIDebugDraw.h"
 #include "LinearMath/btMinMax.h"
 #include "LinearMath/btStackAlloc.h"
@@ -28,6 +29,20 @@ const int kNoMerge = -1;
 
 bool btBatchedConstraints::s_debugDrawBatches = false;
 
+btBatchedConstraints::~btBatchedConstraints()
+{
+	clearCachedIslands();
+}
+
+void btBatchedConstraints::clearCachedIslands()
+{
+	for (int i = 0; i < m_cachedIslands.size(); ++i)
+	{
+		delete m_cachedIslands[i];
+	}
+	m_cachedIslands.clear();
+}
+
 struct btBatchedConstraintInfo
 {
 	int constraintIndex;
@@ -785,6 +800,302 @@ struct AssignConstraintsToGridBatchesLoop : public btIParallelForBody
 	}
 };
 
+static void initBatchedBodyKeys(const void** outBodyKeys, const btAlignedObjectArray<btSolverBody>& bodies)
+{
+	for (int i = 0; i < bodies.size(); ++i)
+	{
+		outBodyKeys[i] = bodies[i].m_originalBody;
+	}
+}
+
+static btBatchedConstraintsBodyPair getConstraintBodyPair(const void* const* bodyKeys, const btBatchedConstraintInfo& con)
+{
+	return btBatchedConstraintsBodyPair(bodyKeys[con.bodyIds[0]], bodyKeys[con.bodyIds[1]]);
+}
+
+static void cacheConstraintBatchIds(btBatchedConstraintsCache* cache,
+									const void* const* bodyKeys,
+									const btBatchedConstraintInfo* conInfos,
+									const int* constraintBatchIds,
+									const int* cachedBatchIds,
+									int numConstraints)
+{
+	BT_PROFILE("cacheConstraintBatchIds");
+	// start over when pairs that are no longer constrained make up most of the hash map
+	if (cachedBatchIds == NULL || cache->m_batchIds.size() > numConstraints * 2)
+	{
+		cache->m_batchIds.clear();
+		cachedBatchIds = NULL;
+	}
+	cache->m_pairs.resizeNoInitialize(0);
+	cache->m_pairs.reserve(numConstraints);
+	cache->m_pairBatchIds.resizeNoInitialize(numConstraints);
+	for (int iCon = 0; iCon < numConstraints; ++iCon)
+	{
+		btBatchedConstraintsBodyPair pair = getConstraintBodyPair(bodyKeys, conInfos[iCon]);
+		cache->m_pairs.push_back(pair);
+		cache->m_pairBatchIds[iCon] = constraintBatchIds[iCon];
+		if (cachedBatchIds == NULL || cachedBatchIds[iCon] != constraintBatchIds[iCon])
+		{
+			cache->m_batchIds.insert(pair, constraintBatchIds[iCon]);
+		}
+	}
+}
+
+// claims the dynamic bodies of a constraint for a batch of the phase, fails if one belongs to another batch
+static bool claimConstraintBodies(int* bodyBatchIds, const bool* bodyDynamicFlags, const btBatchedConstraintInfo& con, int iBatch)
+{
+	for (int i = 0; i < 2; ++i)
+	{
+		int iBody = con.bodyIds[i];
+		if (bodyDynamicFlags[iBody] && bodyBatchIds[iBody] != -1 && bodyBatchIds[iBody] != iBatch)
+		{
+			return false;
+		}
+	}
+	for (int i = 0; i < 2; ++i)
+	{
+		int iBody = con.bodyIds[i];
+		if (bodyDynamicFlags[iBody])
+		{
+			bodyBatchIds[iBody] = iBatch;
+		}
+	}
+	return true;
+}
+
+// picks a batch for a constraint that has none: the one already holding one of its bodies in a phase,
+// else the grid chunk of its first dynamic body in the first phase where its bodies are free
+static int findIncrementalBatch(const btBatchedConstraintsCache* cache,
+								int* bodyBatchIds,
+								const bool* bodyDynamicFlags,
+								const btAlignedObjectArray<btSolverBody>& bodies,
+								const btBatchedConstraintInfo& con,
+								int iCon,
+								int numPhases)
+{
+	int iBody0 = bodyDynamicFlags[con.bodyIds[0]] ? con.bodyIds[0] : con.bodyIds[1];
+	btAssert(bodyDynamicFlags[iBody0]);
+	btVector3 v = (bodies[iBody0].getWorldTransform().getOrigin() - cache->m_gridMin) * cache->m_invGridCellSize;
+	int gridCoord[3] = {int(v.x()), int(v.y()), int(v.z())};
+	int numBodies = bodies.size();
+	for (int i = 0; i < numPhases; ++i)
+	{
+		int iPhase = (iCon + i) % numPhases;  // pseudorandom start to distribute evenly amongst phases
+		if (iPhase != (iPhase & cache->m_phaseMask))
+		{
+			continue;
+		}
+		int* phaseBodyBatchIds = bodyBatchIds + iPhase * numBodies;
+		int iBatch = -1;
+		for (int j = 0; j < 2; ++j)
+		{
+			int iBody = con.bodyIds[j];
+			if (bodyDynamicFlags[iBody] && phaseBodyBatchIds[iBody] != -1)
+			{
+				if (iBatch != -1 && iBatch != phaseBodyBatchIds[iBody])
+				{
+					iBatch = -2;
+					break;
+				}
+				iBatch = phaseBodyBatchIds[iBody];
+			}
+		}
+		if (iBatch == -2)
+		{
+			continue;
+		}
+		if (iBatch == -1)
+		{
+			int chunkCoord[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				int coordOffset = (iPhase >> k) & 1;
+				chunkCoord[k] = (gridCoord[k] - coordOffset) / 2;
+				btClamp(chunkCoord[k], 0, cache->m_gridChunkDim[k] - 1);
+			}
+			iBatch = iPhase * cache->m_maxNumBatchesPerPhase + chunkCoord[0] + chunkCoord[1] * cache->m_gridChunkDim[0] + chunkCoord[2] * cache->m_gridChunkDim[0] * cache->m_gridChunkDim[1];
+		}
+		claimConstraintBodies(phaseBodyBatchIds, bodyDynamicFlags, con, iBatch);
+		return iBatch;
+	}
+	return -1;
+}
+
+// the chunks are only used while batching, so they come from the frame allocator when there is one
+static char* allocateBatchingScratch(btAlignedObjectArray<char>* scratchMemory, size_t scratchSize)
+{
+	if (char* frameMemory = (char*)btFrameAlloc(scratchSize, 16))
+	{
+		return frameMemory;
+	}
+	// if we need to reallocate
+	if (static_cast<size_t>(scratchMemory->capacity()) < scratchSize)
+	{
+		// allocate 6.25% extra to avoid repeated reallocs
+		scratchMemory->reserve(scratchSize + scratchSize / 16);
+	}
+	scratchMemory->resizeNoInitialize(scratchSize);
+	return &scratchMemory->at(0);
+}
+
+//
+// setupIncrementalBatchesMt -- reuse the batches of the previous setup
+//
+/*
+
+Constraints between the same two bodies as in the previous setup of the island keep their batch, as long as their dynamic bodies are
+not claimed by another batch of the same phase. The others are placed with the grid of the last full setup into a batch
+that already holds one of their bodies, or into a new one. The batch numbering of the last full setup is kept, so small
+batches are merged and written out as usual.
+
+Returns false, leaving the batches untouched, when there is nothing to reuse or when less than half of the constraints
+kept their batch, the caller then does a full setup which also refreshes the grid.
+*/
+//
+static bool setupIncrementalBatchesMt(
+	btBatchedConstraints* bc,
+	btBatchedConstraintsCache* cache,
+	btAlignedObjectArray<char>* scratchMemory,
+	btConstraintArray* constraints,
+	const btAlignedObjectArray<btSolverBody>& bodies,
+	btBatchedConstraints::BatchingMethod batchingMethod,
+	int minBatchSize,
+	int maxBatchSize)
+{
+	if (cache->m_batchingMethod != batchingMethod)
+	{
+		return false;
+	}
+	BT_PROFILE("setupIncrementalBatchesMt");
+	const int numPhases = 8;
+	int numConstraints = constraints->size();
+	int numConstraintRows = constraints->size();
+	int numBodies = bodies.size();
+	int maxNumBatchesPerPhase = cache->m_maxNumBatchesPerPhase;
+	int numBatches = maxNumBatchesPerPhase * numPhases;
+
+	bool* bodyDynamicFlags = NULL;
+	const void** bodyKeys = NULL;
+	int* bodyBatchIds = NULL;
+	btBatchInfo* batches = NULL;
+	int* batchWork = NULL;
+	btBatchedConstraintInfo* conInfos = NULL;
+	int* cachedBatchIds = NULL;
+	int* constraintBatchIds = NULL;
+	int* constraintRowBatchIds = NULL;
+	{
+		PreallocatedMemoryHelper<10> memHelper;
+		memHelper.addChunk((void**)&bodyKeys, sizeof(void*) * numBodies);
+		memHelper.addChunk((void**)&bodyBatchIds, sizeof(int) * numBodies * numPhases);
+		memHelper.addChunk((void**)&batches, sizeof(btBatchInfo) * numBatches);
+		memHelper.addChunk((void**)&batchWork, sizeof(int) * numBatches);
+		memHelper.addChunk((void**)&conInfos, sizeof(btBatchedConstraintInfo) * numConstraints);
+		memHelper.addChunk((void**)&cachedBatchIds, sizeof(int) * numConstraints);
+		memHelper.addChunk((void**)&constraintBatchIds, sizeof(int) * numConstraints);
+		memHelper.addChunk((void**)&constraintRowBatchIds, sizeof(int) * numConstraintRows);
+		memHelper.addChunk((void**)&bodyDynamicFlags, sizeof(bool) * numBodies);
+		char* memPtr = allocateBatchingScratch(scratchMemory, memHelper.getSizeToAllocate());
+		memHelper.setChunkPointers(memPtr);
+	}
+
+	numConstraints = initBatchedConstraintInfo(conInfos, constraints);
+	for (int i = 0; i < numBodies; ++i)
+	{
+		bodyDynamicFlags[i] = (bodies[i].internalGetInvMass().x() > btScalar(0));
+	}
+	initBatchedBodyKeys(bodyKeys, bodies);
+	memset(bodyBatchIds, -1, sizeof(int) * numBodies * numPhases);
+
+	// keep the batch of the constraints whose bodies are still free in its phase,
+	// constraints mostly come in the same order as in the last setup so the hash map is only searched on a mismatch
+	int numKept = 0;
+	int iCached = 0;
+	int numCached = cache->m_pairs.size();
+	for (int iCon = 0; iCon < numConstraints; ++iCon)
+	{
+		const btBatchedConstraintInfo& con = conInfos[iCon];
+		btBatchedConstraintsBodyPair pair = getConstraintBodyPair(bodyKeys, con);
+		int iBatch = -1;
+		if (iCached < numCached && cache->m_pairs[iCached].equals(pair))
+		{
+			iBatch = cache->m_pairBatchIds[iCached++];
+		}
+		else if (iCached + 1 < numCached && cache->m_pairs[iCached + 1].equals(pair))
+		{
+			// the constraints of one pair are gone
+			iBatch = cache->m_pairBatchIds[iCached + 1];
+			iCached += 2;
+		}
+		else if (const int* cachedBatchId = cache->m_batchIds.find(pair))
+		{
+			iBatch = *cachedBatchId;
+		}
+		cachedBatchIds[iCon] = iBatch;
+		if (iBatch >= 0 && claimConstraintBodies(bodyBatchIds + (iBatch / maxNumBatchesPerPhase) * numBodies, bodyDynamicFlags, con, iBatch))
+		{
+			numKept++;
+		}
+		else
+		{
+			iBatch = -1;
+		}
+		constraintBatchIds[iCon] = iBatch;
+	}
+	if (numKept * 2 < numConstraints)
+	{
+		return false;
+	}
+
+	int numRebatchedRows = 0;
+	for (int iCon = 0; iCon < numConstraints; ++iCon)
+	{
+		if (constraintBatchIds[iCon] == -1)
+		{
+			int iBatch = findIncrementalBatch(cache, bodyBatchIds, bodyDynamicFlags, bodies, conInfos[iCon], iCon, numPhases);
+			if (iBatch == -1)
+			{
+				return false;
+			}
+			constraintBatchIds[iCon] = iBatch;
+			numRebatchedRows += conInfos[iCon].numConstraintRows;
+		}
+	}
+
+	for (int iBatch = 0; iBatch < numBatches; ++iBatch)
+	{
+		batches[iBatch] = btBatchInfo();
+	}
+	for (int iCon = 0; iCon < numConstraints; ++iCon)
+	{
+		batches[constraintBatchIds[iCon]].numConstraints += conInfos[iCon].numConstraintRows;
+	}
+	for (int iPhase = 0; iPhase < numPhases; ++iPhase)
+	{
+		if (iPhase == (iPhase & cache->m_phaseMask))
+		{
+			int iBeginBatch = iPhase * maxNumBatchesPerPhase;
+			mergeSmallBatches(batches, iBeginBatch, iBeginBatch + maxNumBatchesPerPhase, minBatchSize, maxBatchSize);
+		}
+	}
+	updateConstraintBatchIdsForMergesMt(constraintBatchIds, numConstraints, batches, numBatches);
+	cacheConstraintBatchIds(cache, bodyKeys, conInfos, constraintBatchIds, cachedBatchIds, numConstraints);
+	bc->m_numRebatchedConstraints = numRebatchedRows;
+
+	if (numConstraintRows > numConstraints)
+	{
+		expandConstraintRowsMt(&constraintRowBatchIds[0], &constraintBatchIds[0], &conInfos[0], numConstraints, numConstraintRows);
+	}
+	else
+	{
+		constraintRowBatchIds = constraintBatchIds;
+	}
+
+	writeOutBatches(bc, constraintRowBatchIds, numConstraintRows, batches, batchWork, maxNumBatchesPerPhase, numPhases);
+	btAssert(bc->validate(constraints, bodies));
+	return true;
+}
+
 //
 // setupSpatialGridBatchesMt -- generate batches using a uniform 3D grid
 //
@@ -815,6 +1126,7 @@ to 4. With fewer phases, there are more constraints per phase and this makes it
 //
 static void setupSpatialGridBatchesMt(
 	btBatchedConstraints* batchedConstraints,
+	btBatchedConstraintsCache* cache,
 	btAlignedObjectArray<char>* scratchMemory,
 	btConstraintArray* constraints,
 	const btAlignedObjectArray<btSolverBody>& bodies,
@@ -840,9 +1152,14 @@ static void setupSpatialGridBatchesMt(
 	btBatchedConstraintInfo* conInfos = NULL;
 	int* constraintBatchIds = NULL;
 	int* constraintRowBatchIds = NULL;
+	const void** bodyKeys = NULL;
 	{
 		PreallocatedMemoryHelper<10> memHelper;
 		memHelper.addChunk((void**)&bodyPositions, sizeof(btVector3) * bodies.size());
+		if (cache)
+		{
+			memHelper.addChunk((void**)&bodyKeys, sizeof(void*) * bodies.size());
+		}
 		memHelper.addChunk((void**)&bodyDynamicFlags, sizeof(bool) * bodies.size());
 		memHelper.addChunk((void**)&bodyGridCoords, sizeof(btIntVec3) * bodies.size());
 		memHelper.addChunk((void**)&batches, sizeof(btBatchInfo) * allocNumBatches);
@@ -850,15 +1167,7 @@ static void setupSpatialGridBatchesMt(
 		memHelper.addChunk((void**)&conInfos, sizeof(btBatchedConstraintInfo) * numConstraints);
 		memHelper.addChunk((void**)&constraintBatchIds, sizeof(int) * numConstraints);
 		memHelper.addChunk((void**)&constraintRowBatchIds, sizeof(int) * numConstraintRows);
-		size_t scratchSize = memHelper.getSizeToAllocate();
-		// if we need to reallocate
-		if (static_cast<size_t>(scratchMemory->capacity()) < scratchSize)
-		{
-			// allocate 6.25% extra to avoid repeated reallocs
-			scratchMemory->reserve(scratchSize + scratchSize / 16);
-		}
-		scratchMemory->resizeNoInitialize(scratchSize);
-		char* memPtr = &scratchMemory->at(0);
+		char* memPtr = allocateBatchingScratch(scratchMemory, memHelper.getSizeToAllocate());
 		memHelper.setChunkPointers(memPtr);
 	}
 
@@ -1020,6 +1329,22 @@ static void setupSpatialGridBatchesMt(
 	// all constraints have been assigned a batchId
 	updateConstraintBatchIdsForMergesMt(constraintBatchIds, numConstraints, batches, maxNumBatchesPerPhase * numPhases);
 
+	batchedConstraints->m_numRebatchedConstraints = numConstraintRows;
+	if (cache)
+	{
+		cache->m_batchingMethod = use2DGrid ? btBatchedConstraints::BATCHING_METHOD_SPATIAL_GRID_2D : btBatchedConstraints::BATCHING_METHOD_SPATIAL_GRID_3D;
+		cache->m_gridMin = bboxMin;
+		cache->m_invGridCellSize = invGridCellSize;
+		for (int i = 0; i < 3; ++i)
+		{
+			cache->m_gridChunkDim[i] = gridChunkDim[i];
+		}
+		cache->m_maxNumBatchesPerPhase = maxNumBatchesPerPhase;
+		cache->m_phaseMask = phaseMask;
+		initBatchedBodyKeys(bodyKeys, bodies);
+		cacheConstraintBatchIds(cache, bodyKeys, conInfos, constraintBatchIds, NULL, numConstraints);
+	}
+
 	if (numConstraintRows > numConstraints)
 	{
 		expandConstraintRowsMt(&constraintRowBatchIds[0], &constraintBatchIds[0], &conInfos[0], numConstraints, numConstraintRows);
@@ -1033,6 +1358,53 @@ static void setupSpatialGridBatchesMt(
 	btAssert(batchedConstraints->validate(constraints, bodies));
 }
 
+// the cache of the island is found by the dynamic body with the lowest world array index, which stays the same while
+// the island keeps its bodies, as for the island history of btSimulationIslandManagerMt; an island not seen before
+// takes a new cache, or the one of the least recently set up island once there are m_maxNumCachedIslands of them
+static btBatchedConstraintsCache* findCachedIsland(btBatchedConstraints* bc, const btAlignedObjectArray<btSolverBody>& bodies, bool* outFound)
+{
+	const btCollisionObject* keyBody = NULL;
+	for (int i = 0; i < bodies.size(); ++i)
+	{
+		const btCollisionObject* body = bodies[i].m_originalBody;
+		if (body && (keyBody == NULL || body->getWorldArrayIndex() < keyBody->getWorldArrayIndex()))
+		{
+			keyBody = body;
+		}
+	}
+	btBatchedConstraintsCache* cache = NULL;
+	btBatchedConstraintsCache* leastRecent = NULL;
+	for (int i = 0; i < bc->m_cachedIslands.size(); ++i)
+	{
+		btBatchedConstraintsCache* island = bc->m_cachedIslands[i];
+		if (island->m_keyBody == keyBody)
+		{
+			cache = island;
+			break;
+		}
+		if (leastRecent == NULL || island->m_lastSetup < leastRecent->m_lastSetup)
+		{
+			leastRecent = island;
+		}
+	}
+	*outFound = cache != NULL;
+	if (cache == NULL)
+	{
+		if (bc->m_cachedIslands.size() < btMax(bc->m_maxNumCachedIslands, 1))
+		{
+			cache = new btBatchedConstraintsCache();
+			bc->m_cachedIslands.push_back(cache);
+		}
+		else
+		{
+			cache = leastRecent;
+		}
+		cache->m_keyBody = keyBody;
+	}
+	cache->m_lastSetup = ++bc->m_numSetups;
+	return cache;
+}
+
 static void setupSingleBatch(
 	btBatchedConstraints* bc,
 	int numConstraints)
@@ -1071,7 +1443,20 @@ void btBatchedConstraints::setup(
 	if (constraints->size() >= minBatchSize * 4)
 	{
 		bool use2DGrid = batchingMethod == BATCHING_METHOD_SPATIAL_GRID_2D;
-		setupSpatialGridBatchesMt(this, scratchMemory, constraints, bodies, minBatchSize, maxBatchSize, use2DGrid);
+		btBatchedConstraintsCache* cache = NULL;
+		bool found = false;
+		if (m_useIncrementalBatching)
+		{
+			cache = findCachedIsland(this, bodies, &found);
+		}
+		else
+		{
+			clearCachedIslands();
+		}
+		if (!found || !setupIncrementalBatchesMt(this, cache, scratchMemory, constraints, bodies, batchingMethod, minBatchSize, maxBatchSize))
+		{
+			setupSpatialGridBatchesMt(this, cache, scratchMemory, constraints, bodies, minBatchSize, maxBatchSize, use2DGrid);
+		}
 		if (s_debugDrawBatches)
 		{
 			debugDrawAllBatches(this, constraints, bodies);
@@ -1079,6 +1464,8 @@ void btBatchedConstraints::setup(
 	}
 	else
 	{
+		// small islands are never cached, so they leave the caches of the large ones alone
 		setupSingleBatch(this, constraints->size());
+		m_numRebatchedConstraints = constraints->size();
 	}
 }
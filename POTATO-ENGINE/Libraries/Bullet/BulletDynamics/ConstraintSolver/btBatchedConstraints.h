@@ -18,10 +18,56 @@ subject to the following restrictions:
 
 #include "LinearMath/btThreads.h"
 #include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btHashMap.h"
 #include "BulletDynamics/ConstraintSolver/btSolverBody.h"
 #include "BulletDynamics/ConstraintSolver/btSolverConstraint.h"
 
 class btIDebugDraw;
+class btCollisionObject;
+
+///identifies the constraints between two bodies across setups, solver body indices change from one step to the next
+struct btBatchedConstraintsBodyPair
+{
+	const void* m_bodyA;  // original bodies, NULL for the fixed body
+	const void* m_bodyB;
+
+	btBatchedConstraintsBodyPair(const void* bodyA, const void* bodyB) : m_bodyA(bodyA), m_bodyB(bodyB) {}
+
+	bool equals(const btBatchedConstraintsBodyPair& other) const
+	{
+		return m_bodyA == other.m_bodyA && m_bodyB == other.m_bodyB;
+	}
+	SIMD_FORCE_INLINE unsigned int getHash() const
+	{
+		// bodies are 16 byte aligned, then Thomas Wang's hash as in btHashKey
+		unsigned int key = (unsigned int)((size_t)m_bodyA >> 4) ^ ((unsigned int)((size_t)m_bodyB >> 4) * 31u);
+		key += ~(key << 15);
+		key ^= (key >> 10);
+		key += (key << 3);
+		key ^= (key >> 6);
+		key += ~(key << 11);
+		key ^= (key >> 16);
+		return key;
+	}
+};
+
+///the batches of one island from its last setup
+struct btBatchedConstraintsCache
+{
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	const btCollisionObject* m_keyBody;  // dynamic body of the island with the lowest world array index
+	btHashMap<btBatchedConstraintsBodyPair, int> m_batchIds;  // batch of a body pair, in the grid batch numbering below
+	btAlignedObjectArray<btBatchedConstraintsBodyPair> m_pairs;  // body pairs of the last setup in constraint order, matched before the hash map
+	btAlignedObjectArray<int> m_pairBatchIds;
+	int m_batchingMethod;
+	btVector3 m_gridMin;
+	btVector3 m_invGridCellSize;
+	int m_gridChunkDim[3];
+	int m_maxNumBatchesPerPhase;
+	int m_phaseMask;
+	int m_lastSetup;  // btBatchedConstraints::m_numSetups when the island was last set up
+};
 
 struct btBatchedConstraints
 {
@@ -47,9 +93,25 @@ struct btBatchedConstraints
 	btAlignedObjectArray<int> m_phaseOrder;       // phases can be done in any order, so we can randomize the order here
 	btIDebugDraw* m_debugDrawer;
 
+	// incremental batching: the batches of the previous setup of an island are kept for the body pairs that are still
+	// constrained, only constraints that are new or whose bodies were claimed by another batch of the phase are batched again
+	bool m_useIncrementalBatching;
+	int m_numRebatchedConstraints;  // constraint rows given a new batch by the last setup
+	int m_maxNumCachedIslands;      // the least recently set up island is forgotten beyond this
+	int m_numSetups;
+	btAlignedObjectArray<btBatchedConstraintsCache*> m_cachedIslands;
+
 	static bool s_debugDrawBatches;
 
-	btBatchedConstraints() { m_debugDrawer = NULL; }
+	btBatchedConstraints()
+	{
+		m_debugDrawer = NULL;
+		m_useIncrementalBatching = false;
+		m_numRebatchedConstraints = 0;
+		m_maxNumCachedIslands = 16;
+		m_numSetups = 0;
+	}
+	~btBatchedConstraints();
 	void setup(btConstraintArray* constraints,
 			   const btAlignedObjectArray<btSolverBody>& bodies,
 			   BatchingMethod batchingMethod,
@@ -57,6 +119,7 @@ struct btBatchedConstraints
 			   int maxBatchSize,
 			   btAlignedObjectArray<char>* scratchMemory);
 	bool validate(btConstraintArray* constraints, const btAlignedObjectArray<btSolverBody>& bodies) const;
+	void clearCachedIslands();
 };
 
 #endif  // BT_BATCHED_CONSTRAINTS_H
@@ -72,8 +72,17 @@ struct btContactSolverInfoData
 	int m_numNonContactInnerIterations;
 };
 
+///results of a single solve, see btContactSolverInfo::m_iterationStats
+struct btContactSolverIterationStats
+{
+	int m_numIterationsUsed;
+	btScalar m_remainingLeastSquaresResidual;
+};
+
 struct btContactSolverInfo : public btContactSolverInfoData
 {
+	btContactSolverIterationStats* m_iterationStats;  //if set, the solver reports the iterations it used and the remaining residual here. Not serialized
+
 	inline btContactSolverInfo()
 	{
 		m_tau = btScalar(0.6);
@@ -110,6 +119,7 @@ struct btContactSolverInfo : public btContactSolverInfoData
 		m_jointFeedbackInJointFrame = false;
 		m_reportSolverAnalytics = 0;
 		m_numNonContactInnerIterations = 1;   // the number of inner iterations for solving motor constraint in a single iteration of the constraint solve
+		m_iterationStats = 0;
 	}
 };
 
@@ -0,0 +1,48 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose, 
+including commercial applications, and to alter it and redistribute it freely, 
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_JACOBI_CONSTRAINT_SOLVER_MT_H
+#define BT_JACOBI_CONSTRAINT_SOLVER_MT_H
+
+#include "btSequentialImpulseConstraintSolverMt.h"
+
+///
+/// btJacobiConstraintSolverMt
+///
+///  A block Jacobi contact solver, the CPU counterpart of b3GpuJacobiContactSolver, for use as the solver of the large islands
+///  of btDiscreteDynamicsWorldMt. The contact and friction rows of every manifold are solved with their own copies of the two
+///  bodies, with the mass of a body split evenly between the manifolds it touches (see btMassSplittingPartitions), and the
+///  copies are averaged after each iteration. An iteration is therefore one parallel loop over the manifolds and one over the
+///  bodies, whatever the contact graph looks like, and no batches or phases are built.
+///  This suits crowds of loosely coupled bodies, where batching costs more than it saves, but stacks need more iterations
+///  than with btSequentialImpulseConstraintSolverMt, since an impulse travels only one contact further per iteration.
+///
+///  Joints, rolling friction, interleaved contacts and friction and SOLVER_RANDMIZE_ORDER are handled as by
+///  btSequentialImpulseConstraintSolverMt, as are islands with fewer than s_minimumContactManifoldsForBatching manifolds.
+///
+ATTRIBUTE_ALIGNED16(class)
+btJacobiConstraintSolverMt : public btSequentialImpulseConstraintSolverMt
+{
+protected:
+	virtual bool allowMassSplitting() const BT_OVERRIDE;
+
+public:
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	btJacobiConstraintSolverMt();
+	virtual ~btJacobiConstraintSolverMt();
+};
+
+#endif  //BT_JACOBI_CONSTRAINT_SOLVER_MT_H
@@ -1737,6 +1737,11 @@ btScalar btSequentialImpulseConstraintSolver::solveGroupCacheFriendlyIterations(
 
 		int maxIterations = m_maxOverrideNumSolverIterations > infoGlobal.m_numIterations ? m_maxOverrideNumSolverIterations : infoGlobal.m_numIterations;
 
+		if (infoGlobal.m_iterationStats)
+		{
+			infoGlobal.m_iterationStats->m_numIterationsUsed = 0;
+			infoGlobal.m_iterationStats->m_remainingLeastSquaresResidual = 0.f;
+		}
 		for (int iteration = 0; iteration < maxIterations; iteration++)
 			//for ( int iteration = maxIterations-1  ; iteration >= 0;iteration--)
 		{
@@ -1755,6 +1760,11 @@ btScalar btSequentialImpulseConstraintSolver::solveGroupCacheFriendlyIterations(
 				m_analyticsData.m_numBodies = numBodies;
 				m_analyticsData.m_numContactManifolds = numManifolds;
 				m_analyticsData.m_remainingLeastSquaresResidual = m_leastSquaresResidual;
+				if (infoGlobal.m_iterationStats)
+				{
+					infoGlobal.m_iterationStats->m_numIterationsUsed = iteration + 1;
+					infoGlobal.m_iterationStats->m_remainingLeastSquaresResidual = m_leastSquaresResidual;
+				}
 				break;
 			}
 		}
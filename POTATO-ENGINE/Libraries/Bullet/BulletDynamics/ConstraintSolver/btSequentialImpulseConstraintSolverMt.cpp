@@ -26,6 +26,11 @@ bool btSequentialImpulseConstraintSolverMt::s_allowNestedParallelForLoops = fals
 int btSequentialImpulseConstraintSolverMt::s_minimumContactManifoldsForBatching = 250;
 int btSequentialImpulseConstraintSolverMt::s_minBatchSize = 50;
 int btSequentialImpulseConstraintSolverMt::s_maxBatchSize = 100;
+bool btSequentialImpulseConstraintSolverMt::s_useIncrementalBatching = false;
+bool btSequentialImpulseConstraintSolverMt::s_allowWideSimd = false;
+int btSequentialImpulseConstraintSolverMt::s_maxWideSimdWidth = 16;
+bool btSequentialImpulseConstraintSolverMt::s_useMassSplitting = false;
+int btSequentialImpulseConstraintSolverMt::s_numMassSplittingPartitions = 0;
 btBatchedConstraints::BatchingMethod btSequentialImpulseConstraintSolverMt::s_contactBatchingMethod = btBatchedConstraints::BATCHING_METHOD_SPATIAL_GRID_2D;
 btBatchedConstraints::BatchingMethod btSequentialImpulseConstraintSolverMt::s_jointBatchingMethod = btBatchedConstraints::BATCHING_METHOD_SPATIAL_GRID_2D;
 
@@ -34,6 +39,10 @@ btSequentialImpulseConstraintSolverMt::btSequentialImpulseConstraintSolverMt()
 	m_numFrictionDirections = 1;
 	m_useBatching = false;
 	m_useObsoleteJointConstraints = false;
+	m_wideSimdWidth = 1;
+	m_wideSimdRowSolvers = btGetWideSimdRowSolvers();
+	m_useMassSplitting = false;
+	m_massSplittingMethod = btMassSplittingPartitions::PARTITION_METHOD_SPATIAL_SLABS;
 }
 
 btSequentialImpulseConstraintSolverMt::~btSequentialImpulseConstraintSolverMt()
@@ -43,6 +52,7 @@ btSequentialImpulseConstraintSolverMt::~btSequentialImpulseConstraintSolverMt()
 void btSequentialImpulseConstraintSolverMt::setupBatchedContactConstraints()
 {
 	BT_PROFILE("setupBatchedContactConstraints");
+	m_batchedContactConstraints.m_useIncrementalBatching = s_useIncrementalBatching;
 	m_batchedContactConstraints.setup(&m_tmpSolverContactConstraintPool,
 									  m_tmpSolverBodyPool,
 									  s_contactBatchingMethod,
@@ -51,9 +61,26 @@ void btSequentialImpulseConstraintSolverMt::setupBatchedContactConstraints()
 									  &m_scratchMemory);
 }
 
+void btSequentialImpulseConstraintSolverMt::setupMassSplittingPartitions(const btContactSolverInfo& infoGlobal)
+{
+	BT_PROFILE("setupMassSplittingPartitions");
+	int numPartitions = s_numMassSplittingPartitions > 0 ? s_numMassSplittingPartitions : btGetTaskScheduler()->getNumThreads();
+	btScalar warmstartingFactor = (infoGlobal.m_solverMode & SOLVER_USE_WARMSTARTING) ? infoGlobal.m_warmstartingFactor : btScalar(0);
+	m_massSplittingPartitions.setup(m_tmpSolverContactConstraintPool,
+									m_tmpSolverContactFrictionConstraintPool,
+									m_tmpSolverBodyPool,
+									m_massSplittingMethod,
+									numPartitions,
+									m_numFrictionDirections,
+									warmstartingFactor);
+	// the copies carry the warm starting impulses
+	m_massSplittingPartitions.gatherVelocities(m_tmpSolverBodyPool, false);
+}
+
 void btSequentialImpulseConstraintSolverMt::setupBatchedJointConstraints()
 {
 	BT_PROFILE("setupBatchedJointConstraints");
+	m_batchedJointConstraints.m_useIncrementalBatching = s_useIncrementalBatching;
 	m_batchedJointConstraints.setup(&m_tmpSolverNonContactConstraintPool,
 									m_tmpSolverBodyPool,
 									s_jointBatchingMethod,
@@ -270,10 +297,40 @@ struct SetupContactConstraintsLoop : public btIParallelForBody
 	}
 };
 
+struct SetupUnbatchedContactConstraintsLoop : public btIParallelForBody
+{
+	btSequentialImpulseConstraintSolverMt* m_solver;
+	const btContactSolverInfo* m_infoGlobal;
+
+	SetupUnbatchedContactConstraintsLoop(btSequentialImpulseConstraintSolverMt* solver, const btContactSolverInfo& infoGlobal)
+	{
+		m_solver = solver;
+		m_infoGlobal = &infoGlobal;
+	}
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		BT_PROFILE("SetupUnbatchedContactConstraintsLoop");
+		for (int iContact = iBegin; iContact < iEnd; ++iContact)
+		{
+			m_solver->internalSetupContactConstraints(iContact, *m_infoGlobal);
+		}
+	}
+};
+
 void btSequentialImpulseConstraintSolverMt::setupAllContactConstraints(const btContactSolverInfo& infoGlobal)
 {
 	BT_PROFILE("setupAllContactConstraints");
-	if (m_useBatching)
+	if (m_useMassSplitting)
+	{
+		// without warm starting a row writes to no body, so rows can be set up in any order,
+		// the mass splitting partitions apply the warm starting impulses to their copies of the bodies
+		btContactSolverInfo infoNoWarmstart = infoGlobal;
+		infoNoWarmstart.m_solverMode &= ~SOLVER_USE_WARMSTARTING;
+		SetupUnbatchedContactConstraintsLoop loop(this, infoNoWarmstart);
+		int grainSize = 100;
+		btParallelFor(0, m_tmpSolverContactConstraintPool.size(), grainSize, loop);
+	}
+	else if (m_useBatching)
 	{
 		const btBatchedConstraints& batchedCons = m_batchedContactConstraints;
 		SetupContactConstraintsLoop loop(this, &batchedCons, infoGlobal);
@@ -513,7 +570,8 @@ struct AllocContactConstraintsLoop : public btIParallelForBody
 void btSequentialImpulseConstraintSolverMt::allocAllContactConstraints(btPersistentManifold** manifoldPtr, int numManifolds, const btContactSolverInfo& infoGlobal)
 {
 	BT_PROFILE("allocAllContactConstraints");
-	btAlignedObjectArray<btContactManifoldCachedInfo> cachedInfoArray;  // = m_manifoldCachedInfoArray;
+	// kept as a member so its capacity carries over from one step to the next
+	btAlignedObjectArray<btContactManifoldCachedInfo>& cachedInfoArray = m_manifoldCachedInfoArray;
 	cachedInfoArray.resizeNoInitialize(numManifolds);
 	if (/* DISABLES CODE */ (false))
 	{
@@ -587,11 +645,21 @@ void btSequentialImpulseConstraintSolverMt::convertContacts(btPersistentManifold
 			initSolverBody(&fixedBody, 0, infoGlobal.m_timeStep);
 		}
 		allocAllContactConstraints(manifoldPtr, numManifolds, infoGlobal);
-		if (m_useBatching)
+		if (m_tmpSolverContactRollingFrictionConstraintPool.size())
+		{
+			// rolling friction rows are only solved in batches
+			m_useMassSplitting = false;
+		}
+		if (m_useBatching && !m_useMassSplitting)
 		{
 			setupBatchedContactConstraints();
 		}
 		setupAllContactConstraints(infoGlobal);
+		// the partitions copy the rows, so they are built once the rows are set up
+		if (m_useMassSplitting)
+		{
+			setupMassSplittingPartitions(infoGlobal);
+		}
 	}
 }
 
@@ -705,7 +773,7 @@ void btSequentialImpulseConstraintSolverMt::convertJoints(btTypedConstraint** co
 	}
 
 	int totalNumRows = 0;
-	btAlignedObjectArray<JointParams> jointParamsArray;
+	btAlignedObjectArray<JointParams>& jointParamsArray = m_jointParamsArray;
 	jointParamsArray.resizeNoInitialize(numConstraints);
 
 	//calculate the total number of contraint rows
@@ -837,12 +905,14 @@ btScalar btSequentialImpulseConstraintSolverMt::solveGroupCacheFriendlySetup(
 {
 	m_numFrictionDirections = (infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS) ? 2 : 1;
 	m_useBatching = false;
+	m_useMassSplitting = false;
 	if (numManifolds >= s_minimumContactManifoldsForBatching &&
 		(s_allowNestedParallelForLoops || !btThreadsAreRunning()))
 	{
 		m_useBatching = true;
 		m_batchedContactConstraints.m_debugDrawer = debugDrawer;
 		m_batchedJointConstraints.m_debugDrawer = debugDrawer;
+		m_useMassSplitting = allowMassSplitting() && !(infoGlobal.m_solverMode & (SOLVER_INTERLEAVE_CONTACT_AND_FRICTION_CONSTRAINTS | SOLVER_RANDMIZE_ORDER));
 	}
 	btSequentialImpulseConstraintSolver::solveGroupCacheFriendlySetup(bodies,
 																	  numBodies,
@@ -852,6 +922,22 @@ btScalar btSequentialImpulseConstraintSolverMt::solveGroupCacheFriendlySetup(
 																	  numConstraints,
 																	  infoGlobal,
 																	  debugDrawer);
+	// the SoA rows follow the order of the batches, which SOLVER_RANDMIZE_ORDER shuffles at each iteration
+	m_wideSimdWidth = 1;
+	if (m_useBatching && !m_useMassSplitting && s_allowWideSimd && !(infoGlobal.m_solverMode & (SOLVER_INTERLEAVE_CONTACT_AND_FRICTION_CONSTRAINTS | SOLVER_RANDMIZE_ORDER)))
+	{
+		m_wideSimdRowSolvers = btGetWideSimdRowSolvers(s_maxWideSimdWidth);
+		if (m_wideSimdRowSolvers.m_width > 1)
+		{
+			m_wideSimdWidth = m_wideSimdRowSolvers.m_width;
+			m_wideSimdRows.setup(m_batchedContactConstraints,
+								 m_tmpSolverContactConstraintPool,
+								 m_tmpSolverContactFrictionConstraintPool,
+								 m_tmpSolverBodyPool,
+								 m_wideSimdWidth,
+								 m_numFrictionDirections);
+		}
+	}
 	return 0.0f;
 }
 
@@ -901,7 +987,11 @@ void btSequentialImpulseConstraintSolverMt::solveGroupCacheFriendlySplitImpulseI
 		for (int iteration = 0; iteration < infoGlobal.m_numIterations; iteration++)
 		{
 			btScalar leastSquaresResidual = 0.f;
-			if (m_useBatching)
+			if (m_useMassSplitting)
+			{
+				leastSquaresResidual = resolveAllMassSplittingPartitions(true);
+			}
+			else if (m_useBatching)
 			{
 				const btBatchedConstraints& batchedCons = m_batchedContactConstraints;
 				ContactSplitPenetrationImpulseSolverLoop loop(this, &batchedCons);
@@ -978,14 +1068,22 @@ btScalar btSequentialImpulseConstraintSolverMt::solveSingleIteration(int iterati
 			else  //SOLVER_INTERLEAVE_CONTACT_AND_FRICTION_CONSTRAINTS
 			{
 				// don't interleave them
-				// solve all contact constraints
-				leastSquaresResidual += resolveAllContactConstraints();
+				if (m_useMassSplitting)
+				{
+					// solve all contact and contact friction constraints, partition by partition, there is no rolling friction
+					leastSquaresResidual += resolveAllMassSplittingPartitions(false);
+				}
+				else
+				{
+					// solve all contact constraints
+					leastSquaresResidual += resolveAllContactConstraints();
 
-				// solve all contact friction constraints
-				leastSquaresResidual += resolveAllContactFrictionConstraints();
+					// solve all contact friction constraints
+					leastSquaresResidual += resolveAllContactFrictionConstraints();
 
-				// solve all rolling friction constraints
-				leastSquaresResidual += resolveAllRollingFrictionConstraints();
+					// solve all rolling friction constraints
+					leastSquaresResidual += resolveAllRollingFrictionConstraints();
+				}
 			}
 		}
 	}
@@ -1040,7 +1138,7 @@ btScalar btSequentialImpulseConstraintSolverMt::resolveMultipleContactFrictionCo
 			int iEnd = iBegin + m_numFrictionDirections;
 			for (int iFriction = iBegin; iFriction < iEnd; ++iFriction)
 			{
-				btSolverConstraint& solveManifold = m_tmpSolverContactFrictionConstraintPool[iFriction++];
+				btSolverConstraint& solveManifold = m_tmpSolverContactFrictionConstraintPool[iFriction];
 				btAssert(solveManifold.m_frictionIndex == iContact);
 
 				solveManifold.m_lowerLimit = -(solveManifold.m_friction * totalImpulse);
@@ -1056,6 +1154,75 @@ btScalar btSequentialImpulseConstraintSolverMt::resolveMultipleContactFrictionCo
 	return leastSquaresResidual;
 }
 
+btScalar btSequentialImpulseConstraintSolverMt::resolveMultipleContactGroupsWideSimd(int iBegin, int iEnd)
+{
+	return m_wideSimdRowSolvers.m_contactRows(m_wideSimdRows,
+											  iBegin,
+											  iEnd,
+											  &m_tmpSolverBodyPool[0],
+											  &m_tmpSolverContactConstraintPool[0]);
+}
+
+btScalar btSequentialImpulseConstraintSolverMt::resolveMultipleContactFrictionGroupsWideSimd(int iBegin, int iEnd)
+{
+	return m_wideSimdRowSolvers.m_frictionRows(m_wideSimdRows,
+											   iBegin,
+											   iEnd,
+											   &m_tmpSolverBodyPool[0],
+											   &m_tmpSolverContactConstraintPool[0]);
+}
+
+btScalar btSequentialImpulseConstraintSolverMt::resolveMultipleMassSplittingPartitions(int iBegin, int iEnd)
+{
+	btMassSplittingPartitions& parts = m_massSplittingPartitions;
+	parts.scatterVelocities(m_tmpSolverBodyPool, iBegin, iEnd, false);
+	btScalar leastSquaresResidual = 0.f;
+	for (int iPartition = iBegin; iPartition < iEnd; ++iPartition)
+	{
+		const btBatchedConstraints::Range& rows = parts.m_partitionContacts[iPartition];
+		for (int iRow = rows.begin; iRow < rows.end; ++iRow)
+		{
+			const btSolverConstraint& contact = parts.m_contacts[iRow];
+			btScalar residual = resolveSingleConstraintRowLowerLimit(parts.m_bodies[contact.m_solverBodyIdA], parts.m_bodies[contact.m_solverBodyIdB], contact);
+			leastSquaresResidual += residual * residual;
+		}
+		for (int iRow = rows.begin; iRow < rows.end; ++iRow)
+		{
+			btScalar totalImpulse = parts.m_contacts[iRow].m_appliedImpulse;
+			if (totalImpulse > 0.0f)
+			{
+				for (int iFriction = iRow * m_numFrictionDirections; iFriction < (iRow + 1) * m_numFrictionDirections; ++iFriction)
+				{
+					btSolverConstraint& friction = parts.m_frictions[iFriction];
+					friction.m_lowerLimit = -(friction.m_friction * totalImpulse);
+					friction.m_upperLimit = friction.m_friction * totalImpulse;
+					btScalar residual = resolveSingleConstraintRowGeneric(parts.m_bodies[friction.m_solverBodyIdA], parts.m_bodies[friction.m_solverBodyIdB], friction);
+					leastSquaresResidual += residual * residual;
+				}
+			}
+		}
+	}
+	return leastSquaresResidual;
+}
+
+btScalar btSequentialImpulseConstraintSolverMt::resolveMultipleMassSplittingPenetrations(int iBegin, int iEnd)
+{
+	btMassSplittingPartitions& parts = m_massSplittingPartitions;
+	parts.scatterVelocities(m_tmpSolverBodyPool, iBegin, iEnd, true);
+	btScalar leastSquaresResidual = 0.f;
+	for (int iPartition = iBegin; iPartition < iEnd; ++iPartition)
+	{
+		const btBatchedConstraints::Range& rows = parts.m_partitionContacts[iPartition];
+		for (int iRow = rows.begin; iRow < rows.end; ++iRow)
+		{
+			const btSolverConstraint& contact = parts.m_contacts[iRow];
+			btScalar residual = resolveSplitPenetrationImpulse(parts.m_bodies[contact.m_solverBodyIdA], parts.m_bodies[contact.m_solverBodyIdB], contact);
+			leastSquaresResidual += residual * residual;
+		}
+	}
+	return leastSquaresResidual;
+}
+
 btScalar btSequentialImpulseConstraintSolverMt::resolveMultipleContactRollingFrictionConstraints(const btAlignedObjectArray<int>& consIndices, int batchBegin, int batchEnd)
 {
 	btScalar leastSquaresResidual = 0.f;
@@ -1265,10 +1432,77 @@ struct ContactSolverLoop : public btIParallelSumBody
 	}
 };
 
+// the groups of a phase are solved like its batches, with the batch grain size spread over the lanes
+btScalar btSequentialImpulseConstraintSolverMt::resolveAllWideSimdGroups(const btIParallelSumBody& loop)
+{
+	const btBatchedConstraints& batchedCons = m_batchedContactConstraints;
+	btScalar leastSquaresResidual = 0.f;
+	for (int iiPhase = 0; iiPhase < batchedCons.m_phases.size(); ++iiPhase)
+	{
+		int iPhase = batchedCons.m_phaseOrder[iiPhase];
+		const btBatchedConstraints::Range& phaseGroups = m_wideSimdRows.m_phaseGroups[iPhase];
+		int grainSize = (batchedCons.m_phaseGrainSize[iPhase] + m_wideSimdWidth - 1) / m_wideSimdWidth;
+		leastSquaresResidual += btParallelSum(phaseGroups.begin, phaseGroups.end, grainSize, loop);
+	}
+	return leastSquaresResidual;
+}
+
+struct ContactWideSimdSolverLoop : public btIParallelSumBody
+{
+	btSequentialImpulseConstraintSolverMt* m_solver;
+
+	ContactWideSimdSolverLoop(btSequentialImpulseConstraintSolverMt* solver)
+	{
+		m_solver = solver;
+	}
+	btScalar sumLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		BT_PROFILE("ContactWideSimdSolverLoop");
+		return m_solver->resolveMultipleContactGroupsWideSimd(iBegin, iEnd);
+	}
+};
+
+struct MassSplittingSolverLoop : public btIParallelSumBody
+{
+	btSequentialImpulseConstraintSolverMt* m_solver;
+	bool m_penetration;
+
+	MassSplittingSolverLoop(btSequentialImpulseConstraintSolverMt* solver, bool penetration)
+	{
+		m_solver = solver;
+		m_penetration = penetration;
+	}
+	btScalar sumLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		BT_PROFILE("MassSplittingSolverLoop");
+		if (m_penetration)
+		{
+			return m_solver->resolveMultipleMassSplittingPenetrations(iBegin, iEnd);
+		}
+		return m_solver->resolveMultipleMassSplittingPartitions(iBegin, iEnd);
+	}
+};
+
+btScalar btSequentialImpulseConstraintSolverMt::resolveAllMassSplittingPartitions(bool penetration)
+{
+	BT_PROFILE("resolveAllMassSplittingPartitions");
+	// each partition reads the solver bodies into its copies, then the copies are averaged back
+	MassSplittingSolverLoop loop(this, penetration);
+	int grainSize = m_massSplittingPartitions.m_partitionGrainSize;
+	btScalar leastSquaresResidual = btParallelSum(0, m_massSplittingPartitions.getNumPartitions(), grainSize, loop);
+	m_massSplittingPartitions.gatherVelocities(m_tmpSolverBodyPool, penetration);
+	return leastSquaresResidual;
+}
+
 btScalar btSequentialImpulseConstraintSolverMt::resolveAllContactConstraints()
 {
 	BT_PROFILE("resolveAllContactConstraints");
 	const btBatchedConstraints& batchedCons = m_batchedContactConstraints;
+	if (m_wideSimdWidth > 1)
+	{
+		ContactWideSimdSolverLoop loop(this);
+		return resolveAllWideSimdGroups(loop);
+	}
 	ContactSolverLoop loop(this, &batchedCons);
 	btScalar leastSquaresResidual = 0.f;
 	for (int iiPhase = 0; iiPhase < batchedCons.m_phases.size(); ++iiPhase)
@@ -1304,10 +1538,30 @@ struct ContactFrictionSolverLoop : public btIParallelSumBody
 	}
 };
 
+struct ContactFrictionWideSimdSolverLoop : public btIParallelSumBody
+{
+	btSequentialImpulseConstraintSolverMt* m_solver;
+
+	ContactFrictionWideSimdSolverLoop(btSequentialImpulseConstraintSolverMt* solver)
+	{
+		m_solver = solver;
+	}
+	btScalar sumLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		BT_PROFILE("ContactFrictionWideSimdSolverLoop");
+		return m_solver->resolveMultipleContactFrictionGroupsWideSimd(iBegin, iEnd);
+	}
+};
+
 btScalar btSequentialImpulseConstraintSolverMt::resolveAllContactFrictionConstraints()
 {
 	BT_PROFILE("resolveAllContactFrictionConstraints");
 	const btBatchedConstraints& batchedCons = m_batchedContactConstraints;
+	if (m_wideSimdWidth > 1)
+	{
+		ContactFrictionWideSimdSolverLoop loop(this);
+		return resolveAllWideSimdGroups(loop);
+	}
 	ContactFrictionSolverLoop loop(this, &batchedCons);
 	btScalar leastSquaresResidual = 0.f;
 	for (int iiPhase = 0; iiPhase < batchedCons.m_phases.size(); ++iiPhase)
@@ -1526,6 +1780,14 @@ btScalar btSequentialImpulseConstraintSolverMt::solveGroupCacheFriendlyFinish(bt
 {
 	BT_PROFILE("solveGroupCacheFriendlyFinish");
 
+	if (m_wideSimdWidth > 1)
+	{
+		m_wideSimdRows.storeFrictionImpulses(m_tmpSolverContactFrictionConstraintPool);
+	}
+	if (m_useMassSplitting)
+	{
+		m_massSplittingPartitions.storeImpulses(m_tmpSolverContactConstraintPool, m_tmpSolverContactFrictionConstraintPool);
+	}
 	if (infoGlobal.m_solverMode & SOLVER_USE_WARMSTARTING)
 	{
 		WriteContactPointsLoop loop(this, infoGlobal);
@@ -18,6 +18,8 @@ subject to the following restrictions:
 
 #include "btSequentialImpulseConstraintSolver.h"
 #include "btBatchedConstraints.h"
+#include "btSolverWideSimd.h"
+#include "btSolverMassSplitting.h"
 #include "LinearMath/btThreads.h"
 
 ///
@@ -48,6 +50,23 @@ subject to the following restrictions:
 ///  is randomized, however it does not swap constraints between batches.
 ///  This is to avoid regenerating the batches for each solver iteration which would be quite costly in performance.
 ///
+///  When s_allowWideSimd is set and the CPU supports AVX2 or AVX-512F, the contact and friction rows of the batches are
+///  solved 8 or 16 batches at a time, one batch per SIMD lane, from a SoA copy of the rows built once per solve (see btWideSimdRows).
+///  Each lane still solves the rows of its batch in order, so only the floating point rounding differs from the scalar path.
+///  Interleaved contacts and friction and SOLVER_RANDMIZE_ORDER keep the scalar path.
+///  Building the copy costs a few scalar iterations, so it is off by default and pays off with many solver iterations.
+///
+///  When s_useIncrementalBatching is set, constraints between the same two bodies as in the previous step keep their batch
+///  and only new or conflicting ones are batched again (see btBatchedConstraints). In resting piles most constraints
+///  persist, so the spatial grid is rebuilt only when fewer than half of them keep their batch. Each large island solved by the
+///  solver keeps its own batches, found again by its body pairs, so several islands do not overwrite each other.
+///
+///  When s_useMassSplitting is set, the contact and friction rows of an island are not batched but cut into spatial partitions,
+///  one per worker thread unless s_numMassSplittingPartitions says otherwise, and each partition is solved by one thread with its
+///  own copies of the bodies it shares with other partitions (see btMassSplittingPartitions). The copies are averaged after each
+///  iteration, so an iteration has two synchronization points instead of one per phase, at the cost of slower convergence for the
+///  bodies on the boundaries. Rolling friction, interleaved contacts and friction and SOLVER_RANDMIZE_ORDER keep the batches.
+///
 ///  Note that a non-zero leastSquaresResidualThreshold could possibly affect the determinism of the simulation
 ///  if the task scheduler's parallelSum operation is non-deterministic. The parallelSum operation can be non-deterministic
 ///  because floating point addition is not associative due to rounding errors.
@@ -65,7 +84,7 @@ public:
 	// temp struct used to collect info from persistent manifolds into a cache-friendly struct using multiple threads
 	struct btContactManifoldCachedInfo
 	{
-		static const int MAX_NUM_CONTACT_POINTS = 4;
+		static const int MAX_NUM_CONTACT_POINTS = MANIFOLD_CACHE_SIZE;
 
 		int numTouchingContacts;
 		int solverBodyIds[2];
@@ -91,6 +110,11 @@ public:
 	static btBatchedConstraints::BatchingMethod s_jointBatchingMethod;
 	static int s_minBatchSize;  // desired number of constraints per batch
 	static int s_maxBatchSize;
+	static bool s_useIncrementalBatching;     // keep the batches of constraints that persist from the previous step
+	static bool s_allowWideSimd;              // solve contact batches in SIMD lanes when the CPU supports it, off by default
+	static int s_maxWideSimdWidth;            // 8 keeps AVX-512 capable CPUs on the AVX2 solver
+	static bool s_useMassSplitting;           // solve contacts in spatial partitions with split masses instead of batches, off by default
+	static int s_numMassSplittingPartitions;  // 0 for one partition per worker thread
 
 protected:
 	static const int CACHE_LINE_SIZE = 64;
@@ -99,8 +123,15 @@ protected:
 	btBatchedConstraints m_batchedJointConstraints;
 	int m_numFrictionDirections;
 	bool m_useBatching;
+	int m_wideSimdWidth;  // lanes used by the current solve, 1 for the scalar path
+	btWideSimdRowSolvers m_wideSimdRowSolvers;
+	btWideSimdRows m_wideSimdRows;
+	bool m_useMassSplitting;
+	btMassSplittingPartitions::PartitionMethod m_massSplittingMethod;
+	btMassSplittingPartitions m_massSplittingPartitions;
 	bool m_useObsoleteJointConstraints;
 	btAlignedObjectArray<btContactManifoldCachedInfo> m_manifoldCachedInfoArray;
+	btAlignedObjectArray<JointParams> m_jointParamsArray;
 	btAlignedObjectArray<int> m_rollingFrictionIndexTable;  // lookup table mapping contact index to rolling friction index
 	btSpinMutex m_bodySolverArrayMutex;
 	char m_antiFalseSharingPadding[CACHE_LINE_SIZE];  // padding to keep mutexes in separate cachelines
@@ -113,9 +144,16 @@ protected:
 	virtual btScalar resolveAllContactFrictionConstraints();
 	virtual btScalar resolveAllContactConstraintsInterleaved();
 	virtual btScalar resolveAllRollingFrictionConstraints();
+	btScalar resolveAllWideSimdGroups(const btIParallelSumBody& loop);
+	btScalar resolveAllMassSplittingPartitions(bool penetration);
 
 	virtual void setupBatchedContactConstraints();
 	virtual void setupBatchedJointConstraints();
+	virtual void setupMassSplittingPartitions(const btContactSolverInfo& infoGlobal);
+	virtual bool allowMassSplitting() const
+	{
+		return s_useMassSplitting;
+	}
 	virtual void convertJoints(btTypedConstraint * *constraints, int numConstraints, const btContactSolverInfo& infoGlobal) BT_OVERRIDE;
 	virtual void convertContacts(btPersistentManifold * *manifoldPtr, int numManifolds, const btContactSolverInfo& infoGlobal) BT_OVERRIDE;
 	virtual void convertBodies(btCollisionObject * *bodies, int numBodies, const btContactSolverInfo& infoGlobal) BT_OVERRIDE;
@@ -137,6 +175,31 @@ public:
 	btScalar resolveMultipleContactFrictionConstraints(const btAlignedObjectArray<int>& consIndices, int batchBegin, int batchEnd);
 	btScalar resolveMultipleContactRollingFrictionConstraints(const btAlignedObjectArray<int>& consIndices, int batchBegin, int batchEnd);
 	btScalar resolveMultipleContactConstraintsInterleaved(const btAlignedObjectArray<int>& contactIndices, int batchBegin, int batchEnd);
+	btScalar resolveMultipleContactGroupsWideSimd(int iBegin, int iEnd);
+	btScalar resolveMultipleContactFrictionGroupsWideSimd(int iBegin, int iEnd);
+	btScalar resolveMultipleMassSplittingPartitions(int iBegin, int iEnd);
+	btScalar resolveMultipleMassSplittingPenetrations(int iBegin, int iEnd);
+
+	///contact rows the last setup had to batch again, all of them unless s_useIncrementalBatching is set
+	int getNumRebatchedContactConstraints() const
+	{
+		return m_batchedContactConstraints.m_numRebatchedConstraints;
+	}
+	///number of SIMD lanes the last solve used for contact batches, 1 when it took the scalar path
+	int getWideSimdWidth() const
+	{
+		return m_wideSimdWidth;
+	}
+	///partitions the last solve used, 0 when it did not split masses
+	int getNumMassSplittingPartitions() const
+	{
+		return m_useMassSplitting ? m_massSplittingPartitions.getNumPartitions() : 0;
+	}
+	///bodies that had a copy in more than one partition in the last solve
+	int getNumMassSplittingSharedBodies() const
+	{
+		return m_useMassSplitting ? m_massSplittingPartitions.m_numSharedBodies : 0;
+	}
 
 	void internalCollectContactManifoldCachedInfo(btContactManifoldCachedInfo * cachedInfoArray, btPersistentManifold * *manifoldPtr, int numManifolds, const btContactSolverInfo& infoGlobal);
 	void internalAllocContactConstraints(const btContactManifoldCachedInfo* cachedInfoArray, int numManifolds);
@@ -0,0 +1,457 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btSolverMassSplitting.h"
+
+#include "BulletCollision/NarrowPhaseCollision/btManifoldPoint.h"
+#include "BulletDynamics/Dynamics/btRigidBody.h"
+#include "LinearMath/btQuickprof.h"
+
+btMassSplittingPartitions::btMassSplittingPartitions()
+{
+	m_numFrictionDirections = 1;
+	m_numSharedBodies = 0;
+	m_partitionGrainSize = 1;
+	m_warmstartingFactor = 0;
+}
+
+struct btMassSplittingSortKey
+{
+	btScalar m_key;
+	int m_bodyId;
+};
+
+struct btMassSplittingSortKeyPredicate
+{
+	bool operator()(const btMassSplittingSortKey& lhs, const btMassSplittingSortKey& rhs) const
+	{
+		// ties broken by body id so that the order does not depend on the sort
+		return lhs.m_key < rhs.m_key || (lhs.m_key == rhs.m_key && lhs.m_bodyId < rhs.m_bodyId);
+	}
+};
+
+struct btMassSplittingFillLoop : public btIParallelForBody
+{
+	btMassSplittingPartitions* m_partitions;
+	const btConstraintArray* m_contacts;
+	const btConstraintArray* m_frictions;
+	const btAlignedObjectArray<btSolverBody>* m_bodies;
+
+	btMassSplittingFillLoop(btMassSplittingPartitions* partitions, const btConstraintArray* contacts, const btConstraintArray* frictions, const btAlignedObjectArray<btSolverBody>* bodies)
+	{
+		m_partitions = partitions;
+		m_contacts = contacts;
+		m_frictions = frictions;
+		m_bodies = bodies;
+	}
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		m_partitions->fillPartitions(*m_contacts, *m_frictions, *m_bodies, iBegin, iEnd);
+	}
+};
+
+void btMassSplittingPartitions::assignSpatialSlabPartitions(const btConstraintArray& contacts, const btAlignedObjectArray<btSolverBody>& bodies, int numPartitions)
+{
+	// dynamic bodies are cut into slabs along the longest axis of the island
+	btAlignedObjectArray<btMassSplittingSortKey> sortKeys;
+	sortKeys.reserve(bodies.size());
+	btVector3 aabbMin(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+	btVector3 aabbMax(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+	for (int i = 0; i < bodies.size(); ++i)
+	{
+		const btSolverBody& body = bodies[i];
+		m_bodyPartitions[i] = -1;
+		if (body.m_originalBody && body.m_originalBody->getInvMass() != btScalar(0))
+		{
+			const btVector3& pos = body.getWorldTransform().getOrigin();
+			aabbMin.setMin(pos);
+			aabbMax.setMax(pos);
+			sortKeys.expandNonInitializing().m_bodyId = i;
+		}
+	}
+	int axis = sortKeys.size() ? (aabbMax - aabbMin).maxAxis() : 0;
+	for (int i = 0; i < sortKeys.size(); ++i)
+	{
+		sortKeys[i].m_key = bodies[sortKeys[i].m_bodyId].getWorldTransform().getOrigin()[axis];
+	}
+	sortKeys.quickSort(btMassSplittingSortKeyPredicate());
+	for (int i = 0; i < sortKeys.size(); ++i)
+	{
+		m_bodyPartitions[sortKeys[i].m_bodyId] = int((long long)(i)*numPartitions / sortKeys.size());
+	}
+
+	// rows go to the partition of their first dynamic body
+	for (int iCon = 0; iCon < contacts.size(); ++iCon)
+	{
+		const btSolverConstraint& con = contacts[iCon];
+		int iPartition = m_bodyPartitions[con.m_solverBodyIdA];
+		if (iPartition < 0)
+		{
+			iPartition = btMax(0, m_bodyPartitions[con.m_solverBodyIdB]);
+		}
+		m_rowPartitions[iCon] = iPartition;
+	}
+}
+
+int btMassSplittingPartitions::assignBodyPairPartitions(const btConstraintArray& contacts, const btAlignedObjectArray<btSolverBody>& bodies)
+{
+	for (int i = 0; i < bodies.size(); ++i)
+	{
+		const btSolverBody& body = bodies[i];
+		m_bodyPartitions[i] = (body.m_originalBody && body.m_originalBody->getInvMass() != btScalar(0)) ? 0 : -1;
+	}
+	// the rows of a manifold are contiguous in the contact pool, a run of rows between the same two bodies is one partition
+	int numPartitions = 0;
+	for (int iCon = 0; iCon < contacts.size(); ++iCon)
+	{
+		const btSolverConstraint& con = contacts[iCon];
+		if (iCon == 0 || con.m_solverBodyIdA != contacts[iCon - 1].m_solverBodyIdA || con.m_solverBodyIdB != contacts[iCon - 1].m_solverBodyIdB)
+		{
+			numPartitions++;
+		}
+		m_rowPartitions[iCon] = numPartitions - 1;
+	}
+	return numPartitions;
+}
+
+void btMassSplittingPartitions::setup(const btConstraintArray& contacts,
+									  const btConstraintArray& frictions,
+									  const btAlignedObjectArray<btSolverBody>& bodies,
+									  PartitionMethod method,
+									  int numPartitions,
+									  int numFrictionDirections,
+									  btScalar warmstartingFactor)
+{
+	BT_PROFILE("btMassSplittingPartitions::setup");
+	m_numFrictionDirections = numFrictionDirections;
+	m_warmstartingFactor = warmstartingFactor;
+	numPartitions = btMax(1, numPartitions);
+	const int numBodies = bodies.size();
+	const int numContacts = contacts.size();
+
+	m_bodyPartitions.resizeNoInitialize(numBodies);
+	m_rowPartitions.resizeNoInitialize(numContacts);
+	if (method == PARTITION_METHOD_BODY_PAIRS)
+	{
+		numPartitions = assignBodyPairPartitions(contacts, bodies);
+	}
+	else
+	{
+		assignSpatialSlabPartitions(contacts, bodies, numPartitions);
+	}
+
+	// rows keep their order within a partition
+	m_partitionContacts.resizeNoInitialize(numPartitions);
+	for (int iPartition = 0; iPartition < numPartitions; ++iPartition)
+	{
+		m_partitionContacts[iPartition].begin = 0;
+	}
+	for (int iCon = 0; iCon < numContacts; ++iCon)
+	{
+		m_partitionContacts[m_rowPartitions[iCon]].begin++;
+	}
+	int rowCount = 0;
+	for (int iPartition = 0; iPartition < numPartitions; ++iPartition)
+	{
+		btBatchedConstraints::Range& range = m_partitionContacts[iPartition];
+		int count = range.begin;
+		range.begin = rowCount;
+		range.end = rowCount;
+		rowCount += count;
+	}
+	m_contactIndices.resizeNoInitialize(numContacts);
+	for (int iCon = 0; iCon < numContacts; ++iCon)
+	{
+		m_contactIndices[m_partitionContacts[m_rowPartitions[iCon]].end++] = iCon;
+	}
+
+	// each partition gets one copy of every body its rows touch
+	m_bodyNumCopies.resizeNoInitialize(numBodies);
+	m_bodyCopyIds.resizeNoInitialize(numBodies);
+	for (int i = 0; i < numBodies; ++i)
+	{
+		m_bodyNumCopies[i] = 0;
+		m_bodyCopyIds[i] = -1;
+	}
+	m_bodySolverBodyIds.resizeNoInitialize(0);
+	m_rowBodyCopies.resizeNoInitialize(numContacts * 2);
+	m_partitionBodies.resizeNoInitialize(numPartitions);
+	for (int iPartition = 0; iPartition < numPartitions; ++iPartition)
+	{
+		const btBatchedConstraints::Range& rows = m_partitionContacts[iPartition];
+		int firstCopy = m_bodySolverBodyIds.size();
+		m_partitionBodies[iPartition].begin = firstCopy;
+		for (int iRow = rows.begin; iRow < rows.end; ++iRow)
+		{
+			const btSolverConstraint& con = contacts[m_contactIndices[iRow]];
+			int bodyIds[2] = {con.m_solverBodyIdA, con.m_solverBodyIdB};
+			for (int iBody = 0; iBody < 2; ++iBody)
+			{
+				int bodyId = bodyIds[iBody];
+				// copy ids of earlier partitions are below firstCopy
+				if (m_bodyCopyIds[bodyId] < firstCopy)
+				{
+					m_bodyCopyIds[bodyId] = m_bodySolverBodyIds.size();
+					m_bodySolverBodyIds.push_back(bodyId);
+					m_bodyNumCopies[bodyId]++;
+				}
+				m_rowBodyCopies[iRow * 2 + iBody] = m_bodyCopyIds[bodyId];
+			}
+		}
+		m_partitionBodies[iPartition].end = m_bodySolverBodyIds.size();
+	}
+
+	// copies of each dynamic body, used to average their velocities
+	m_gatherBodyIds.resizeNoInitialize(0);
+	m_gatherOffsets.resizeNoInitialize(0);
+	m_numSharedBodies = 0;
+	int numGatherCopies = 0;
+	for (int i = 0; i < numBodies; ++i)
+	{
+		if (m_bodyPartitions[i] >= 0 && m_bodyNumCopies[i] > 0)
+		{
+			m_gatherBodyIds.push_back(i);
+			m_gatherOffsets.push_back(numGatherCopies);
+			// reused as the fill cursor of the body
+			m_bodyCopyIds[i] = numGatherCopies;
+			numGatherCopies += m_bodyNumCopies[i];
+			if (m_bodyNumCopies[i] > 1)
+			{
+				m_numSharedBodies++;
+			}
+		}
+	}
+	m_gatherOffsets.push_back(numGatherCopies);
+	m_gatherCopies.resizeNoInitialize(numGatherCopies);
+	for (int iCopy = 0; iCopy < m_bodySolverBodyIds.size(); ++iCopy)
+	{
+		int bodyId = m_bodySolverBodyIds[iCopy];
+		if (m_bodyPartitions[bodyId] >= 0)
+		{
+			m_gatherCopies[m_bodyCopyIds[bodyId]++] = iCopy;
+		}
+	}
+
+	m_bodies.resizeNoInitialize(m_bodySolverBodyIds.size());
+	m_contacts.resizeNoInitialize(numContacts);
+	m_frictions.resizeNoInitialize(numContacts * numFrictionDirections);
+	// a partition per body pair is only a few rows, so tasks take many of them
+	m_partitionGrainSize = (method == PARTITION_METHOD_BODY_PAIRS) ? 64 : 1;
+	btMassSplittingFillLoop loop(this, &contacts, &frictions, &bodies);
+	btParallelFor(0, numPartitions, m_partitionGrainSize, loop);
+}
+
+static int btMassSplittingNumCopies(const btAlignedObjectArray<int>& bodyPartitions, const btAlignedObjectArray<int>& bodyNumCopies, int bodyId)
+{
+	// bodies without impulses keep their inverse mass of zero
+	return bodyPartitions[bodyId] >= 0 ? bodyNumCopies[bodyId] : 1;
+}
+
+static void btMassSplittingCopyRow(btSolverConstraint& dest, const btSolverConstraint& src, int copyA, int copyB, const btSolverBody& bodyA, const btSolverBody& bodyB, int numCopiesA, int numCopiesB)
+{
+	dest = src;
+	dest.m_solverBodyIdA = copyA;
+	dest.m_solverBodyIdB = copyB;
+	if (numCopiesA == 1 && numCopiesB == 1)
+	{
+		return;
+	}
+	// the inverse effective mass of a row is a sum of one term per body, each linear in the inverse mass and inertia of its body
+	btScalar invMassA = bodyA.m_originalBody ? bodyA.m_originalBody->getInvMass() : btScalar(0);
+	btScalar invMassB = bodyB.m_originalBody ? bodyB.m_originalBody->getInvMass() : btScalar(0);
+	btScalar denomA = invMassA + src.m_angularComponentA.dot(src.m_relpos1CrossNormal);
+	btScalar denomB = invMassB + src.m_angularComponentB.dot(src.m_relpos2CrossNormal);
+	btScalar splitDenom = btScalar(numCopiesA) * denomA + btScalar(numCopiesB) * denomB;
+	if (splitDenom > SIMD_EPSILON)
+	{
+		// rhs and cfm were scaled by the effective mass, which the copies make smaller
+		btScalar scale = (denomA + denomB) / splitDenom;
+		dest.m_jacDiagABInv *= scale;
+		dest.m_rhs *= scale;
+		dest.m_rhsPenetration *= scale;
+		dest.m_cfm *= scale;
+	}
+	dest.m_angularComponentA *= btScalar(numCopiesA);
+	dest.m_angularComponentB *= btScalar(numCopiesB);
+}
+
+void btMassSplittingPartitions::fillPartitions(const btConstraintArray& contacts,
+											   const btConstraintArray& frictions,
+											   const btAlignedObjectArray<btSolverBody>& bodies,
+											   int iBegin,
+											   int iEnd)
+{
+	for (int iPartition = iBegin; iPartition < iEnd; ++iPartition)
+	{
+		const btBatchedConstraints::Range& copies = m_partitionBodies[iPartition];
+		for (int iCopy = copies.begin; iCopy < copies.end; ++iCopy)
+		{
+			int bodyId = m_bodySolverBodyIds[iCopy];
+			btSolverBody& copy = m_bodies[iCopy];
+			copy = bodies[bodyId];
+			copy.m_invMass *= btScalar(btMassSplittingNumCopies(m_bodyPartitions, m_bodyNumCopies, bodyId));
+		}
+		const btBatchedConstraints::Range& rows = m_partitionContacts[iPartition];
+		for (int iRow = rows.begin; iRow < rows.end; ++iRow)
+		{
+			int iContact = m_contactIndices[iRow];
+			const btSolverConstraint& contact = contacts[iContact];
+			const btSolverBody& bodyA = bodies[contact.m_solverBodyIdA];
+			const btSolverBody& bodyB = bodies[contact.m_solverBodyIdB];
+			int copyA = m_rowBodyCopies[iRow * 2];
+			int copyB = m_rowBodyCopies[iRow * 2 + 1];
+			int numCopiesA = btMassSplittingNumCopies(m_bodyPartitions, m_bodyNumCopies, contact.m_solverBodyIdA);
+			int numCopiesB = btMassSplittingNumCopies(m_bodyPartitions, m_bodyNumCopies, contact.m_solverBodyIdB);
+			btSolverConstraint& row = m_contacts[iRow];
+			btMassSplittingCopyRow(row, contact, copyA, copyB, bodyA, bodyB, numCopiesA, numCopiesB);
+			if (m_warmstartingFactor != btScalar(0))
+			{
+				// as in btSequentialImpulseConstraintSolver::setupContactConstraint, with the split masses of the copies
+				const btManifoldPoint* cp = static_cast<const btManifoldPoint*>(contact.m_originalContactPoint);
+				row.m_appliedImpulse = cp->m_appliedImpulse * m_warmstartingFactor;
+				btSolverBody& copyBodyA = m_bodies[copyA];
+				btSolverBody& copyBodyB = m_bodies[copyB];
+				copyBodyA.internalApplyImpulse(row.m_contactNormal1 * copyBodyA.internalGetInvMass(), row.m_angularComponentA, row.m_appliedImpulse);
+				copyBodyB.internalApplyImpulse(row.m_contactNormal2 * copyBodyB.internalGetInvMass(), row.m_angularComponentB, row.m_appliedImpulse);
+			}
+			for (int iDir = 0; iDir < m_numFrictionDirections; ++iDir)
+			{
+				const btSolverConstraint& friction = frictions[iContact * m_numFrictionDirections + iDir];
+				btAssert(friction.m_frictionIndex == iContact);
+				btSolverConstraint& dest = m_frictions[iRow * m_numFrictionDirections + iDir];
+				btMassSplittingCopyRow(dest, friction, copyA, copyB, bodyA, bodyB, numCopiesA, numCopiesB);
+				dest.m_frictionIndex = iRow;
+			}
+		}
+	}
+}
+
+void btMassSplittingPartitions::scatterVelocities(const btAlignedObjectArray<btSolverBody>& bodies, int iBegin, int iEnd, bool pushVelocities)
+{
+	for (int iPartition = iBegin; iPartition < iEnd; ++iPartition)
+	{
+		const btBatchedConstraints::Range& copies = m_partitionBodies[iPartition];
+		for (int iCopy = copies.begin; iCopy < copies.end; ++iCopy)
+		{
+			const btSolverBody& body = bodies[m_bodySolverBodyIds[iCopy]];
+			btSolverBody& copy = m_bodies[iCopy];
+			if (pushVelocities)
+			{
+				copy.m_pushVelocity = body.m_pushVelocity;
+				copy.m_turnVelocity = body.m_turnVelocity;
+			}
+			else
+			{
+				copy.m_deltaLinearVelocity = body.m_deltaLinearVelocity;
+				copy.m_deltaAngularVelocity = body.m_deltaAngularVelocity;
+			}
+		}
+	}
+}
+
+struct btMassSplittingGatherLoop : public btIParallelForBody
+{
+	const btMassSplittingPartitions* m_partitions;
+	btAlignedObjectArray<btSolverBody>* m_bodies;
+	bool m_pushVelocities;
+
+	btMassSplittingGatherLoop(const btMassSplittingPartitions* partitions, btAlignedObjectArray<btSolverBody>* bodies, bool pushVelocities)
+	{
+		m_partitions = partitions;
+		m_bodies = bodies;
+		m_pushVelocities = pushVelocities;
+	}
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		const btMassSplittingPartitions& parts = *m_partitions;
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			btSolverBody& body = (*m_bodies)[parts.m_gatherBodyIds[i]];
+			int copyBegin = parts.m_gatherOffsets[i];
+			int copyEnd = parts.m_gatherOffsets[i + 1];
+			btVector3 linear(0, 0, 0);
+			btVector3 angular(0, 0, 0);
+			for (int iiCopy = copyBegin; iiCopy < copyEnd; ++iiCopy)
+			{
+				const btSolverBody& copy = parts.m_bodies[parts.m_gatherCopies[iiCopy]];
+				linear += m_pushVelocities ? copy.m_pushVelocity : copy.m_deltaLinearVelocity;
+				angular += m_pushVelocities ? copy.m_turnVelocity : copy.m_deltaAngularVelocity;
+			}
+			// the copies have equal masses, so the mean velocity keeps the momentum of the body
+			if (copyEnd - copyBegin > 1)
+			{
+				btScalar invNumCopies = btScalar(1) / btScalar(copyEnd - copyBegin);
+				linear *= invNumCopies;
+				angular *= invNumCopies;
+			}
+			if (m_pushVelocities)
+			{
+				body.m_pushVelocity = linear;
+				body.m_turnVelocity = angular;
+			}
+			else
+			{
+				body.m_deltaLinearVelocity = linear;
+				body.m_deltaAngularVelocity = angular;
+			}
+		}
+	}
+};
+
+void btMassSplittingPartitions::gatherVelocities(btAlignedObjectArray<btSolverBody>& bodies, bool pushVelocities) const
+{
+	BT_PROFILE("btMassSplittingPartitions::gatherVelocities");
+	btMassSplittingGatherLoop loop(this, &bodies, pushVelocities);
+	int grainSize = 200;
+	btParallelFor(0, m_gatherBodyIds.size(), grainSize, loop);
+}
+
+struct btMassSplittingStoreImpulsesLoop : public btIParallelForBody
+{
+	const btMassSplittingPartitions* m_partitions;
+	btConstraintArray* m_contacts;
+	btConstraintArray* m_frictions;
+
+	btMassSplittingStoreImpulsesLoop(const btMassSplittingPartitions* partitions, btConstraintArray* contacts, btConstraintArray* frictions)
+	{
+		m_partitions = partitions;
+		m_contacts = contacts;
+		m_frictions = frictions;
+	}
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		const btMassSplittingPartitions& parts = *m_partitions;
+		const int numDirections = parts.m_numFrictionDirections;
+		for (int iRow = iBegin; iRow < iEnd; ++iRow)
+		{
+			int iContact = parts.m_contactIndices[iRow];
+			btSolverConstraint& contact = (*m_contacts)[iContact];
+			contact.m_appliedImpulse = parts.m_contacts[iRow].m_appliedImpulse;
+			contact.m_appliedPushImpulse = parts.m_contacts[iRow].m_appliedPushImpulse;
+			for (int iDir = 0; iDir < numDirections; ++iDir)
+			{
+				(*m_frictions)[iContact * numDirections + iDir].m_appliedImpulse = parts.m_frictions[iRow * numDirections + iDir].m_appliedImpulse;
+			}
+		}
+	}
+};
+
+void btMassSplittingPartitions::storeImpulses(btConstraintArray& contacts, btConstraintArray& frictions) const
+{
+	BT_PROFILE("btMassSplittingPartitions::storeImpulses");
+	btMassSplittingStoreImpulsesLoop loop(this, &contacts, &frictions);
+	int grainSize = 500;
+	btParallelFor(0, m_contactIndices.size(), grainSize, loop);
+}
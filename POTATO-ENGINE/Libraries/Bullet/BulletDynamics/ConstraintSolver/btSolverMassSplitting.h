@@ -0,0 +1,93 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_SOLVER_MASS_SPLITTING_H
+#define BT_SOLVER_MASS_SPLITTING_H
+
+#include "btBatchedConstraints.h"
+
+///The btMassSplittingPartitions cuts the contact rows of an island into partitions that are solved in parallel, built once per solve.
+///Dynamic bodies are sorted along the longest axis of the island and cut into slabs of equal body count, and each contact row goes
+///to the partition of its first dynamic body. A partition solves its rows with its own copy of every body they touch, so a body on
+///the boundary between partitions has one copy per partition. The mass of such a body is split evenly between its copies: their
+///inverse masses and inertias are multiplied by the number of copies and the effective masses of the rows are updated to match.
+///After each iteration the velocities of the copies are averaged, which conserves momentum, and the rows converge to the solution
+///of the whole island. Bodies that are not on a boundary have a single copy and are solved exactly as by the sequential solver.
+///The contact rows are expected without warm starting, the copies take the warm starting impulses when the partitions are filled.
+///With PARTITION_METHOD_BODY_PAIRS every manifold is a partition of its own instead, which is the block Jacobi scheme of
+///b3GpuJacobiContactSolver: every dynamic body has one copy per manifold it touches and no partition depends on another.
+struct btMassSplittingPartitions
+{
+	enum PartitionMethod
+	{
+		PARTITION_METHOD_SPATIAL_SLABS,  // numPartitions slabs along the longest axis of the island
+		PARTITION_METHOD_BODY_PAIRS,     // one partition per run of rows between the same two bodies, numPartitions is ignored
+	};
+
+	btAlignedObjectArray<btSolverBody> m_bodies;                            // copies of the bodies, partition by partition
+	btAlignedObjectArray<int> m_bodySolverBodyIds;                          // solver body of each copy
+	btAlignedObjectArray<btSolverConstraint> m_contacts;                    // contact rows partition by partition, body ids index m_bodies
+	btAlignedObjectArray<btSolverConstraint> m_frictions;                   // friction rows of each contact row, m_frictionIndex indexes m_contacts
+	btAlignedObjectArray<int> m_contactIndices;                             // contact pool index of each row
+	btAlignedObjectArray<btBatchedConstraints::Range> m_partitionBodies;    // range of copies for each partition
+	btAlignedObjectArray<btBatchedConstraints::Range> m_partitionContacts;  // range of rows for each partition
+	btAlignedObjectArray<int> m_gatherBodyIds;                              // dynamic solver bodies that have copies
+	btAlignedObjectArray<int> m_gatherOffsets;                              // copies of m_gatherBodyIds[i] are [m_gatherOffsets[i], m_gatherOffsets[i + 1])
+	btAlignedObjectArray<int> m_gatherCopies;
+	int m_numFrictionDirections;
+	int m_numSharedBodies;     // dynamic bodies with more than one copy
+	int m_partitionGrainSize;  // partitions per task of the parallel loops over partitions
+	btScalar m_warmstartingFactor;
+
+	// temporaries of setup, kept to avoid reallocation
+	btAlignedObjectArray<int> m_bodyPartitions;  // slab of each solver body, -1 for bodies that take no impulses
+	btAlignedObjectArray<int> m_bodyNumCopies;
+	btAlignedObjectArray<int> m_bodyCopyIds;
+	btAlignedObjectArray<int> m_rowPartitions;
+	btAlignedObjectArray<int> m_rowBodyCopies;  // copies of body A and B for each row
+
+	void assignSpatialSlabPartitions(const btConstraintArray& contacts, const btAlignedObjectArray<btSolverBody>& bodies, int numPartitions);
+	int assignBodyPairPartitions(const btConstraintArray& contacts, const btAlignedObjectArray<btSolverBody>& bodies);
+
+	btMassSplittingPartitions();
+
+	void setup(const btConstraintArray& contacts,
+			   const btConstraintArray& frictions,
+			   const btAlignedObjectArray<btSolverBody>& bodies,
+			   PartitionMethod method,
+			   int numPartitions,
+			   int numFrictionDirections,
+			   btScalar warmstartingFactor);
+
+	void fillPartitions(const btConstraintArray& contacts,
+						const btConstraintArray& frictions,
+						const btAlignedObjectArray<btSolverBody>& bodies,
+						int iBegin,
+						int iEnd);
+
+	int getNumPartitions() const
+	{
+		return m_partitionContacts.size();
+	}
+
+	///copies the delta velocities, or the push and turn velocities, of the solver bodies into the copies of partitions [iBegin, iEnd)
+	void scatterVelocities(const btAlignedObjectArray<btSolverBody>& bodies, int iBegin, int iEnd, bool pushVelocities);
+	///averages the velocities of the copies into the solver bodies, in parallel
+	void gatherVelocities(btAlignedObjectArray<btSolverBody>& bodies, bool pushVelocities) const;
+	///writes the applied impulses of the rows back to the contact and friction pools, in parallel
+	void storeImpulses(btConstraintArray& contacts, btConstraintArray& frictions) const;
+};
+
+#endif  //BT_SOLVER_MASS_SPLITTING_H
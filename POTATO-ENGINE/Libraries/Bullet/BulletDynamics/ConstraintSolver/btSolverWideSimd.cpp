@@ -0,0 +1,226 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btSolverWideSimd.h"
+
+#include "LinearMath/btQuickprof.h"
+
+btWideSimdRows::btWideSimdRows()
+{
+	m_floats = NULL;
+	m_ints = NULL;
+	m_groups = NULL;
+	m_width = 1;
+	m_numFrictionDirections = 1;
+	m_stepFloatCount = 0;
+}
+
+struct btWideSimdFillGroupsLoop : public btIParallelForBody
+{
+	btWideSimdRows* m_rows;
+	const btBatchedConstraints* m_bc;
+	const btConstraintArray* m_contacts;
+	const btConstraintArray* m_frictions;
+	const btAlignedObjectArray<btSolverBody>* m_bodies;
+
+	btWideSimdFillGroupsLoop(btWideSimdRows* rows, const btBatchedConstraints* bc, const btConstraintArray* contacts, const btConstraintArray* frictions, const btAlignedObjectArray<btSolverBody>* bodies)
+	{
+		m_rows = rows;
+		m_bc = bc;
+		m_contacts = contacts;
+		m_frictions = frictions;
+		m_bodies = bodies;
+	}
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		m_rows->fillGroups(*m_bc, *m_contacts, *m_frictions, *m_bodies, iBegin, iEnd);
+	}
+};
+
+void btWideSimdRows::setup(const btBatchedConstraints& batchedCons,
+						   const btConstraintArray& contacts,
+						   const btConstraintArray& frictions,
+						   const btAlignedObjectArray<btSolverBody>& bodies,
+						   int width,
+						   int numFrictionDirections)
+{
+	BT_PROFILE("btWideSimdRows::setup");
+	m_width = width;
+	m_numFrictionDirections = numFrictionDirections;
+	m_stepFloatCount = BT_WIDE_SIMD_ROW_FIELD_COUNT * (1 + numFrictionDirections) * width;
+
+	// consecutive batches of a phase make a group
+	m_groupArray.resizeNoInitialize(0);
+	m_phaseGroups.resizeNoInitialize(batchedCons.m_phases.size());
+	int numSteps = 0;
+	for (int iPhase = 0; iPhase < batchedCons.m_phases.size(); ++iPhase)
+	{
+		const btBatchedConstraints::Range& phase = batchedCons.m_phases[iPhase];
+		m_phaseGroups[iPhase].begin = m_groupArray.size();
+		for (int iBatch = phase.begin; iBatch < phase.end; iBatch += width)
+		{
+			btWideSimdGroup& group = m_groupArray.expandNonInitializing();
+			group.m_firstStep = numSteps;
+			group.m_numSteps = 0;
+			for (int i = iBatch; i < btMin(iBatch + width, phase.end); ++i)
+			{
+				const btBatchedConstraints::Range& batch = batchedCons.m_batches[i];
+				group.m_numSteps = btMax(group.m_numSteps, batch.end - batch.begin);
+			}
+			group.m_firstBatch = iBatch;
+			group.m_numBatches = btMin(width, phase.end - iBatch);
+			numSteps += group.m_numSteps;
+		}
+		m_phaseGroups[iPhase].end = m_groupArray.size();
+	}
+
+	// room to align the rows to 64 bytes
+	const int alignFloats = 16;
+	m_floatArray.resizeNoInitialize(numSteps * m_stepFloatCount + alignFloats);
+	m_intArray.resizeNoInitialize(numSteps * 3 * width);
+	m_floats = (float*)(((size_t)&m_floatArray[0] + 63) & ~size_t(63));
+	m_ints = m_intArray.size() ? &m_intArray[0] : NULL;
+	m_groups = m_groupArray.size() ? &m_groupArray[0] : NULL;
+
+	btWideSimdFillGroupsLoop loop(this, &batchedCons, &contacts, &frictions, &bodies);
+	int grainSize = 40;
+	btParallelFor(0, m_groupArray.size(), grainSize, loop);
+}
+
+static void btWideSimdStoreVector(float* row, int field, int width, int lane, const btVector3& v)
+{
+	row[field * width + lane] = v.getX();
+	row[(field + 1) * width + lane] = v.getY();
+	row[(field + 2) * width + lane] = v.getZ();
+}
+
+static void btWideSimdStoreRow(float* row, int width, int lane, const btSolverConstraint& c, const btSolverBody& bodyA, const btSolverBody& bodyB, btScalar limit)
+{
+	// the normals of a row are opposite, a body without impulses has a zero one
+	btWideSimdStoreVector(row, BT_WIDE_SIMD_NORMAL, width, lane, bodyA.m_originalBody ? c.m_contactNormal1 : -c.m_contactNormal2);
+	btWideSimdStoreVector(row, BT_WIDE_SIMD_RELPOS1_CROSS_NORMAL, width, lane, c.m_relpos1CrossNormal);
+	btWideSimdStoreVector(row, BT_WIDE_SIMD_RELPOS2_CROSS_NORMAL, width, lane, c.m_relpos2CrossNormal);
+	// the factors are folded in, they are usually one so the products match btSolverBody::internalApplyImpulse
+	btWideSimdStoreVector(row, BT_WIDE_SIMD_LINEAR_COMPONENT_A, width, lane, c.m_contactNormal1 * bodyA.internalGetInvMass() * bodyA.m_linearFactor);
+	btWideSimdStoreVector(row, BT_WIDE_SIMD_LINEAR_COMPONENT_B, width, lane, c.m_contactNormal2 * bodyB.internalGetInvMass() * bodyB.m_linearFactor);
+	btWideSimdStoreVector(row, BT_WIDE_SIMD_ANGULAR_COMPONENT_A, width, lane, c.m_angularComponentA * bodyA.m_angularFactor);
+	btWideSimdStoreVector(row, BT_WIDE_SIMD_ANGULAR_COMPONENT_B, width, lane, c.m_angularComponentB * bodyB.m_angularFactor);
+	row[BT_WIDE_SIMD_RHS * width + lane] = c.m_rhs;
+	row[BT_WIDE_SIMD_CFM * width + lane] = c.m_cfm;
+	row[BT_WIDE_SIMD_JAC_DIAG_INV * width + lane] = c.m_jacDiagABInv;
+	row[BT_WIDE_SIMD_LIMIT * width + lane] = limit;
+	row[BT_WIDE_SIMD_APPLIED_IMPULSE * width + lane] = c.m_appliedImpulse;
+}
+
+void btWideSimdRows::fillGroups(const btBatchedConstraints& batchedCons,
+								const btConstraintArray& contacts,
+								const btConstraintArray& frictions,
+								const btAlignedObjectArray<btSolverBody>& bodies,
+								int iBegin,
+								int iEnd)
+{
+	const int width = m_width;
+	const int rowFloatCount = BT_WIDE_SIMD_ROW_FIELD_COUNT * width;
+	for (int iGroup = iBegin; iGroup < iEnd; ++iGroup)
+	{
+		const btWideSimdGroup& group = m_groups[iGroup];
+		float* floats = m_floats + size_t(group.m_firstStep) * m_stepFloatCount;
+		int* ints = (int*)m_ints + group.m_firstStep * 3 * width;
+		const btBatchedConstraints::Range* batches = &batchedCons.m_batches[group.m_firstBatch];
+		// step by step so that a step is written while it sits in the cache, empty lanes solve zero rows
+		for (int step = 0; step < group.m_numSteps; ++step)
+		{
+			float* row = floats + size_t(step) * m_stepFloatCount;
+			int* laneInts = ints + step * 3 * width;
+			for (int lane = 0; lane < width; ++lane)
+			{
+				if (lane >= group.m_numBatches || step >= batches[lane].end - batches[lane].begin)
+				{
+					for (int iField = 0; iField < m_stepFloatCount; iField += width)
+					{
+						row[iField + lane] = 0.f;
+					}
+					laneInts[lane] = -1;
+					laneInts[width + lane] = -1;
+					laneInts[2 * width + lane] = -1;
+					continue;
+				}
+				const int iContact = batchedCons.m_constraintIndices[batches[lane].begin + step];
+				const btSolverConstraint& contact = contacts[iContact];
+				const btSolverBody& bodyA = bodies[contact.m_solverBodyIdA];
+				const btSolverBody& bodyB = bodies[contact.m_solverBodyIdB];
+				btWideSimdStoreRow(row, width, lane, contact, bodyA, bodyB, contact.m_lowerLimit);
+				for (int iDir = 0; iDir < m_numFrictionDirections; ++iDir)
+				{
+					const btSolverConstraint& friction = frictions[iContact * m_numFrictionDirections + iDir];
+					btAssert(friction.m_frictionIndex == iContact);
+					btAssert(friction.m_solverBodyIdA == contact.m_solverBodyIdA && friction.m_solverBodyIdB == contact.m_solverBodyIdB);
+					btWideSimdStoreRow(row + (1 + iDir) * rowFloatCount, width, lane, friction, bodyA, bodyB, friction.m_friction);
+				}
+				// bodies without an original body never take impulses
+				laneInts[lane] = iContact;
+				laneInts[width + lane] = bodyA.m_originalBody ? contact.m_solverBodyIdA : -1;
+				laneInts[2 * width + lane] = bodyB.m_originalBody ? contact.m_solverBodyIdB : -1;
+			}
+		}
+	}
+}
+
+struct btWideSimdStoreFrictionImpulsesLoop : public btIParallelForBody
+{
+	const btWideSimdRows* m_rows;
+	btConstraintArray* m_frictions;
+
+	btWideSimdStoreFrictionImpulsesLoop(const btWideSimdRows* rows, btConstraintArray* frictions)
+	{
+		m_rows = rows;
+		m_frictions = frictions;
+	}
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		const int width = m_rows->m_width;
+		const int numDirections = m_rows->m_numFrictionDirections;
+		for (int iGroup = iBegin; iGroup < iEnd; ++iGroup)
+		{
+			const btWideSimdGroup& group = m_rows->m_groups[iGroup];
+			for (int step = group.m_firstStep; step < group.m_firstStep + group.m_numSteps; ++step)
+			{
+				const float* stepRows = m_rows->m_floats + size_t(step) * m_rows->m_stepFloatCount;
+				const int* lanes = m_rows->m_ints + step * 3 * width;
+				for (int lane = 0; lane < width; ++lane)
+				{
+					const int iContact = lanes[lane];
+					if (iContact < 0)
+					{
+						continue;
+					}
+					for (int iDir = 0; iDir < numDirections; ++iDir)
+					{
+						const float* row = stepRows + (1 + iDir) * BT_WIDE_SIMD_ROW_FIELD_COUNT * width;
+						(*m_frictions)[iContact * numDirections + iDir].m_appliedImpulse = row[BT_WIDE_SIMD_APPLIED_IMPULSE * width + lane];
+					}
+				}
+			}
+		}
+	}
+};
+
+void btWideSimdRows::storeFrictionImpulses(btConstraintArray& frictions) const
+{
+	BT_PROFILE("btWideSimdRows::storeFrictionImpulses");
+	btWideSimdStoreFrictionImpulsesLoop loop(this, &frictions);
+	int grainSize = 40;
+	btParallelFor(0, m_groupArray.size(), grainSize, loop);
+}
@@ -0,0 +1,135 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_SOLVER_WIDE_SIMD_H
+#define BT_SOLVER_WIDE_SIMD_H
+
+#include "LinearMath/btCpuFeatureUtility.h"
+#include "btBatchedConstraints.h"
+
+///fields of a row in btWideSimdRows, each one a run of width floats, one per lane
+enum btWideSimdRowField
+{
+	BT_WIDE_SIMD_NORMAL = 0,  // contact normal of body A, body B uses its negation
+	BT_WIDE_SIMD_RELPOS1_CROSS_NORMAL = 3,
+	BT_WIDE_SIMD_RELPOS2_CROSS_NORMAL = 6,
+	BT_WIDE_SIMD_LINEAR_COMPONENT_A = 9,  // normal1 * invMass * linearFactor of body A
+	BT_WIDE_SIMD_LINEAR_COMPONENT_B = 12,
+	BT_WIDE_SIMD_ANGULAR_COMPONENT_A = 15,  // angularComponentA * angularFactor of body A
+	BT_WIDE_SIMD_ANGULAR_COMPONENT_B = 18,
+	BT_WIDE_SIMD_RHS = 21,
+	BT_WIDE_SIMD_CFM,
+	BT_WIDE_SIMD_JAC_DIAG_INV,
+	BT_WIDE_SIMD_LIMIT,  // lower limit of a contact, friction coefficient of a friction row
+	BT_WIDE_SIMD_APPLIED_IMPULSE,
+	BT_WIDE_SIMD_ROW_FIELD_COUNT
+};
+
+///a group of up to width batches of one phase, solved together with one batch per lane
+struct btWideSimdGroup
+{
+	int m_firstStep;
+	int m_numSteps;    // rows in the longest batch of the group
+	int m_firstBatch;  // lanes take the batches [m_firstBatch, m_firstBatch + m_numBatches)
+	int m_numBatches;
+};
+
+///The btWideSimdRows is a SoA copy of the contact and friction rows of btBatchedConstraints, built once per solve.
+///Batches of a phase share no dynamic body, so each group of width batches is solved in SIMD lanes: step i of a group
+///holds row i of each of its batches. btBatchedConstraints sorts the batches of a phase largest first, so the lanes
+///of a group run out of rows at about the same step. Rows within a batch stay in order, so solving a group gives the same velocities
+///as solving its batches one after the other, up to the rounding of fused operations.
+///The rows also keep the applied impulses, which are written back to the contact pool at each step and to the friction
+///pool by storeFrictionImpulses; body velocities are gathered from the solver body pool and scattered back at each step.
+struct btWideSimdRows
+{
+	btAlignedObjectArray<float> m_floatArray;
+	btAlignedObjectArray<int> m_intArray;
+	btAlignedObjectArray<btWideSimdGroup> m_groupArray;
+	btAlignedObjectArray<btBatchedConstraints::Range> m_phaseGroups;  // range of groups for each phase of the batched constraints
+
+	// views used by the row solvers
+	float* m_floats;        // per step: the contact row, then a friction row per friction direction, 64-byte aligned
+	const int* m_ints;      // per step and lane: contact index, solver body A and B, -1 for empty lanes and bodies without impulses
+	const btWideSimdGroup* m_groups;
+	int m_width;
+	int m_numFrictionDirections;
+	int m_stepFloatCount;
+
+	btWideSimdRows();
+
+	void setup(const btBatchedConstraints& batchedCons,
+			   const btConstraintArray& contacts,
+			   const btConstraintArray& frictions,
+			   const btAlignedObjectArray<btSolverBody>& bodies,
+			   int width,
+			   int numFrictionDirections);
+
+	void fillGroups(const btBatchedConstraints& batchedCons,
+					const btConstraintArray& contacts,
+					const btConstraintArray& frictions,
+					const btAlignedObjectArray<btSolverBody>& bodies,
+					int iBegin,
+					int iEnd);
+
+	void storeFrictionImpulses(btConstraintArray& frictions) const;
+};
+
+///solves the groups [iBegin, iEnd) of one phase and returns the sum of the squared residuals
+typedef btScalar (*btWideSimdRowSolver)(btWideSimdRows& rows, int iBegin, int iEnd, btSolverBody* bodies, btSolverConstraint* contacts);
+
+struct btWideSimdRowSolvers
+{
+	int m_width;  // lanes per step, 1 when no wide instruction set is available
+	btWideSimdRowSolver m_contactRows;
+	btWideSimdRowSolver m_frictionRows;
+};
+
+#ifdef BT_ALLOW_WIDE_SIMD
+///each solver is compiled for its instruction set only, call them after checking btCpuFeatureUtility::getCpuFeatures
+btScalar btSolveContactRowsAvx2(btWideSimdRows& rows, int iBegin, int iEnd, btSolverBody* bodies, btSolverConstraint* contacts);
+btScalar btSolveFrictionRowsAvx2(btWideSimdRows& rows, int iBegin, int iEnd, btSolverBody* bodies, btSolverConstraint* contacts);
+btScalar btSolveContactRowsAvx512(btWideSimdRows& rows, int iBegin, int iEnd, btSolverBody* bodies, btSolverConstraint* contacts);
+btScalar btSolveFrictionRowsAvx512(btWideSimdRows& rows, int iBegin, int iEnd, btSolverBody* bodies, btSolverConstraint* contacts);
+#endif  //BT_ALLOW_WIDE_SIMD
+
+///returns the widest row solvers the CPU supports, no wider than maxWidth
+inline btWideSimdRowSolvers btGetWideSimdRowSolvers(int maxWidth = 16)
+{
+	btWideSimdRowSolvers solvers;
+	solvers.m_width = 1;
+	solvers.m_contactRows = NULL;
+	solvers.m_frictionRows = NULL;
+#ifdef BT_ALLOW_WIDE_SIMD
+	int cpuFeatures = btCpuFeatureUtility::getCpuFeatures();
+	if ((cpuFeatures & btCpuFeatureUtility::CPU_FEATURE_AVX512F) && maxWidth >= 16)
+	{
+		solvers.m_width = 16;
+		solvers.m_contactRows = btSolveContactRowsAvx512;
+		solvers.m_frictionRows = btSolveFrictionRowsAvx512;
+	}
+	else if ((cpuFeatures & btCpuFeatureUtility::CPU_FEATURE_AVX2) && maxWidth >= 8)
+	{
+		solvers.m_width = 8;
+		solvers.m_contactRows = btSolveContactRowsAvx2;
+		solvers.m_frictionRows = btSolveFrictionRowsAvx2;
+	}
+#else
+	(void)maxWidth;
+#endif  //BT_ALLOW_WIDE_SIMD
+	return solvers;
+}
+
+#endif  //BT_SOLVER_WIDE_SIMD_H
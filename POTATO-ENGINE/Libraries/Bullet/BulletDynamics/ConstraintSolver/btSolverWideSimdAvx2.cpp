@@ -0,0 +1,107 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+///8-lane row solvers. The functions below are compiled for AVX2 whatever the project flags, so this file is kept
+///out of btBulletDynamicsAll.cpp; btGetWideSimdRowSolvers only hands them out when the CPU reports AVX2.
+
+#include "btSolverWideSimd.h"
+
+#ifdef BT_ALLOW_WIDE_SIMD
+
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+struct btSimdLanesAvx2
+{
+	static const int WIDTH = 8;
+	typedef __m256 Float;
+	typedef __m256 Mask;
+
+	static Float load(const float* p) { return _mm256_load_ps(p); }
+	static Float loadu(const float* p) { return _mm256_loadu_ps(p); }
+	static void store(float* p, Float v) { _mm256_store_ps(p, v); }
+	static void storeu(float* p, Float v) { _mm256_storeu_ps(p, v); }
+	static Float zero() { return _mm256_setzero_ps(); }
+	static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+	static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+	static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+	static Mask lessThan(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static Mask greaterThan(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static Float select(Mask m, Float ifTrue, Float ifFalse) { return _mm256_blendv_ps(ifFalse, ifTrue, m); }
+	static int laneBits(Mask m) { return _mm256_movemask_ps(m); }
+
+	// lanes i and i + 4 share a register, then each 128-bit half is transposed as a 4x4 matrix
+	static void loadTransposed(float* const* p, Float& x, Float& y, Float& z, Float& w)
+	{
+		__m256 r0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p[0])), _mm_loadu_ps(p[4]), 1);
+		__m256 r1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p[1])), _mm_loadu_ps(p[5]), 1);
+		__m256 r2 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p[2])), _mm_loadu_ps(p[6]), 1);
+		__m256 r3 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p[3])), _mm_loadu_ps(p[7]), 1);
+		__m256 t0 = _mm256_unpacklo_ps(r0, r1);
+		__m256 t1 = _mm256_unpackhi_ps(r0, r1);
+		__m256 t2 = _mm256_unpacklo_ps(r2, r3);
+		__m256 t3 = _mm256_unpackhi_ps(r2, r3);
+		x = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		y = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		z = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		w = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+
+	static void storeTransposed(float* const* p, Float x, Float y, Float z, Float w)
+	{
+		__m256 t0 = _mm256_unpacklo_ps(x, y);
+		__m256 t1 = _mm256_unpackhi_ps(x, y);
+		__m256 t2 = _mm256_unpacklo_ps(z, w);
+		__m256 t3 = _mm256_unpackhi_ps(z, w);
+		__m256 r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+		_mm_storeu_ps(p[0], _mm256_castps256_ps128(r0));
+		_mm_storeu_ps(p[1], _mm256_castps256_ps128(r1));
+		_mm_storeu_ps(p[2], _mm256_castps256_ps128(r2));
+		_mm_storeu_ps(p[3], _mm256_castps256_ps128(r3));
+		_mm_storeu_ps(p[4], _mm256_extractf128_ps(r0, 1));
+		_mm_storeu_ps(p[5], _mm256_extractf128_ps(r1, 1));
+		_mm_storeu_ps(p[6], _mm256_extractf128_ps(r2, 1));
+		_mm_storeu_ps(p[7], _mm256_extractf128_ps(r3, 1));
+	}
+};
+
+#include "btSolverWideSimdKernel.h"
+
+btScalar btSolveContactRowsAvx2(btWideSimdRows& rows, int iBegin, int iEnd, btSolverBody* bodies, btSolverConstraint* contacts)
+{
+	return btWideSimdRowKernel<btSimdLanesAvx2>::solveContactRows(rows, iBegin, iEnd, bodies, contacts);
+}
+
+btScalar btSolveFrictionRowsAvx2(btWideSimdRows& rows, int iBegin, int iEnd, btSolverBody* bodies, btSolverConstraint* contacts)
+{
+	return btWideSimdRowKernel<btSimdLanesAvx2>::solveFrictionRows(rows, iBegin, iEnd, bodies, contacts);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif  //BT_ALLOW_WIDE_SIMD
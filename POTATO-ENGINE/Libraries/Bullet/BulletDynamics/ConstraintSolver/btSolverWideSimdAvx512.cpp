@@ -0,0 +1,119 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+///16-lane row solvers. The functions below are compiled for AVX-512F whatever the project flags, so this file is kept
+///out of btBulletDynamicsAll.cpp; btGetWideSimdRowSolvers only hands them out when the CPU reports AVX-512F.
+
+#include "btSolverWideSimd.h"
+
+#ifdef BT_ALLOW_WIDE_SIMD
+
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+// GCC 12 reports the undefined source operand of its own _mm512_undefined_* based intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+struct btSimdLanesAvx512
+{
+	static const int WIDTH = 16;
+	typedef __m512 Float;
+	typedef __mmask16 Mask;
+
+	static Float load(const float* p) { return _mm512_load_ps(p); }
+	static Float loadu(const float* p) { return _mm512_loadu_ps(p); }
+	static void store(float* p, Float v) { _mm512_store_ps(p, v); }
+	static void storeu(float* p, Float v) { _mm512_storeu_ps(p, v); }
+	static Float zero() { return _mm512_setzero_ps(); }
+	static Float add(Float a, Float b) { return _mm512_add_ps(a, b); }
+	static Float sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+	static Float mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+	static Mask lessThan(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+	static Mask greaterThan(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+	static Float select(Mask m, Float ifTrue, Float ifFalse) { return _mm512_mask_blend_ps(m, ifFalse, ifTrue); }
+	static int laneBits(Mask m) { return int(m); }
+
+	// lanes i, i + 4, i + 8 and i + 12 share a register, then each 128-bit quarter is transposed as a 4x4 matrix
+	static __m512 loadQuarters(float* const* p, int i)
+	{
+		__m512 r = _mm512_castps128_ps512(_mm_loadu_ps(p[i]));
+		r = _mm512_insertf32x4(r, _mm_loadu_ps(p[i + 4]), 1);
+		r = _mm512_insertf32x4(r, _mm_loadu_ps(p[i + 8]), 2);
+		return _mm512_insertf32x4(r, _mm_loadu_ps(p[i + 12]), 3);
+	}
+
+	static void storeQuarters(float* const* p, int i, __m512 r)
+	{
+		_mm_storeu_ps(p[i], _mm512_castps512_ps128(r));
+		_mm_storeu_ps(p[i + 4], _mm512_extractf32x4_ps(r, 1));
+		_mm_storeu_ps(p[i + 8], _mm512_extractf32x4_ps(r, 2));
+		_mm_storeu_ps(p[i + 12], _mm512_extractf32x4_ps(r, 3));
+	}
+
+	static void loadTransposed(float* const* p, Float& x, Float& y, Float& z, Float& w)
+	{
+		__m512 r0 = loadQuarters(p, 0);
+		__m512 r1 = loadQuarters(p, 1);
+		__m512 r2 = loadQuarters(p, 2);
+		__m512 r3 = loadQuarters(p, 3);
+		__m512 t0 = _mm512_unpacklo_ps(r0, r1);
+		__m512 t1 = _mm512_unpackhi_ps(r0, r1);
+		__m512 t2 = _mm512_unpacklo_ps(r2, r3);
+		__m512 t3 = _mm512_unpackhi_ps(r2, r3);
+		x = _mm512_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		y = _mm512_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		z = _mm512_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		w = _mm512_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+
+	static void storeTransposed(float* const* p, Float x, Float y, Float z, Float w)
+	{
+		__m512 t0 = _mm512_unpacklo_ps(x, y);
+		__m512 t1 = _mm512_unpackhi_ps(x, y);
+		__m512 t2 = _mm512_unpacklo_ps(z, w);
+		__m512 t3 = _mm512_unpackhi_ps(z, w);
+		storeQuarters(p, 0, _mm512_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)));
+		storeQuarters(p, 1, _mm512_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)));
+		storeQuarters(p, 2, _mm512_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)));
+		storeQuarters(p, 3, _mm512_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2)));
+	}
+};
+
+#include "btSolverWideSimdKernel.h"
+
+btScalar btSolveContactRowsAvx512(btWideSimdRows& rows, int iBegin, int iEnd, btSolverBody* bodies, btSolverConstraint* contacts)
+{
+	return btWideSimdRowKernel<btSimdLanesAvx512>::solveContactRows(rows, iBegin, iEnd, bodies, contacts);
+}
+
+btScalar btSolveFrictionRowsAvx512(btWideSimdRows& rows, int iBegin, int iEnd, btSolverBody* bodies, btSolverConstraint* contacts)
+{
+	return btWideSimdRowKernel<btSimdLanesAvx512>::solveFrictionRows(rows, iBegin, iEnd, bodies, contacts);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#pragma GCC pop_options
+#endif
+
+#endif  //BT_ALLOW_WIDE_SIMD
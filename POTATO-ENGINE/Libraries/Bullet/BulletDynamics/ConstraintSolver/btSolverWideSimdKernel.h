@@ -0,0 +1,228 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+///Row solving shared by the wide SIMD solvers, included once per instruction set by btSolverWideSimdAvx2.cpp and
+///btSolverWideSimdAvx512.cpp inside their target region. The lanes type V provides WIDTH, Float, Mask and the
+///load (aligned), loadu, storeu, add, sub, mul, lessThan, greaterThan and select operations, plus loadTransposed and
+///storeTransposed which move one 16-byte aligned btVector3 per lane in and out of x, y, z and w registers.
+///Only plain member access is used on Bullet types here: an inline Bullet function instantiated under the target
+///region could be merged by the linker with the copy used by code running on CPUs without that instruction set.
+
+#ifndef BT_SOLVER_WIDE_SIMD_KERNEL_H
+#define BT_SOLVER_WIDE_SIMD_KERNEL_H
+
+#include "btSolverWideSimd.h"
+
+template <typename V>
+struct btWideSimdRowKernel
+{
+	typedef typename V::Float Float;
+
+	static const int WIDTH = V::WIDTH;
+
+	// velocity deltas of a body per lane; lanes without a body read zeros and write to a scratch vector
+	struct BodyLanes
+	{
+		float* m_linear[WIDTH];
+		float* m_angular[WIDTH];
+		Float m_linearX, m_linearY, m_linearZ, m_linearW;
+		Float m_angularX, m_angularY, m_angularZ, m_angularW;
+
+		void gather(const int* bodyIndices, btSolverBody* bodies, float* zero)
+		{
+			for (int lane = 0; lane < WIDTH; ++lane)
+			{
+				const int iBody = bodyIndices[lane];
+				m_linear[lane] = iBody >= 0 ? bodies[iBody].m_deltaLinearVelocity.m_floats : zero;
+				m_angular[lane] = iBody >= 0 ? bodies[iBody].m_deltaAngularVelocity.m_floats : zero;
+			}
+			V::loadTransposed(m_linear, m_linearX, m_linearY, m_linearZ, m_linearW);
+			V::loadTransposed(m_angular, m_angularX, m_angularY, m_angularZ, m_angularW);
+		}
+
+		void scatter(const int* bodyIndices, float* scratch)
+		{
+			for (int lane = 0; lane < WIDTH; ++lane)
+			{
+				if (bodyIndices[lane] < 0)
+				{
+					m_linear[lane] = scratch;
+					m_angular[lane] = scratch;
+				}
+			}
+			V::storeTransposed(m_linear, m_linearX, m_linearY, m_linearZ, m_linearW);
+			V::storeTransposed(m_angular, m_angularX, m_angularY, m_angularZ, m_angularW);
+		}
+
+		// body B sees the negated normal, subtracting its linear part keeps the scalar rounding
+		Float dot(const float* row, int relposCrossNormal, bool negateNormal) const
+		{
+			Float linear = V::add(V::add(V::mul(V::load(row + BT_WIDE_SIMD_NORMAL * WIDTH), m_linearX),
+										 V::mul(V::load(row + (BT_WIDE_SIMD_NORMAL + 1) * WIDTH), m_linearY)),
+								  V::mul(V::load(row + (BT_WIDE_SIMD_NORMAL + 2) * WIDTH), m_linearZ));
+			Float angular = V::add(V::add(V::mul(V::load(row + relposCrossNormal * WIDTH), m_angularX),
+										  V::mul(V::load(row + (relposCrossNormal + 1) * WIDTH), m_angularY)),
+								   V::mul(V::load(row + (relposCrossNormal + 2) * WIDTH), m_angularZ));
+			return negateNormal ? V::sub(angular, linear) : V::add(linear, angular);
+		}
+
+		// m_deltaLinearVelocity += linearComponent * deltaImpulse
+		// m_deltaAngularVelocity += angularComponent * deltaImpulse
+		void applyImpulse(const float* row, Float deltaImpulse, int linearComponent, int angularComponent)
+		{
+			m_linearX = V::add(m_linearX, V::mul(V::load(row + linearComponent * WIDTH), deltaImpulse));
+			m_linearY = V::add(m_linearY, V::mul(V::load(row + (linearComponent + 1) * WIDTH), deltaImpulse));
+			m_linearZ = V::add(m_linearZ, V::mul(V::load(row + (linearComponent + 2) * WIDTH), deltaImpulse));
+			m_angularX = V::add(m_angularX, V::mul(V::load(row + angularComponent * WIDTH), deltaImpulse));
+			m_angularY = V::add(m_angularY, V::mul(V::load(row + (angularComponent + 1) * WIDTH), deltaImpulse));
+			m_angularZ = V::add(m_angularZ, V::mul(V::load(row + (angularComponent + 2) * WIDTH), deltaImpulse));
+		}
+	};
+
+	BodyLanes m_bodyA;
+	BodyLanes m_bodyB;
+	float m_deltaImpulse[WIDTH];
+	ATTRIBUTE_ALIGNED16(float m_zero[4]);
+	ATTRIBUTE_ALIGNED16(float m_scratch[4]);
+
+	btWideSimdRowKernel()
+	{
+		for (int k = 0; k < 4; ++k)
+		{
+			m_zero[k] = 0.f;
+		}
+	}
+
+	// same arithmetic as the scalar reference row solvers, the upper limit is only clamped for friction rows;
+	// lanes outside of active keep their impulse and velocities, the new applied impulses are stored in the row
+	void solveLanes(float* row, const int* lanes, btSolverBody* bodies, Float lower, Float upper, bool clampUpper, const typename V::Mask* active)
+	{
+		m_bodyA.gather(lanes + WIDTH, bodies, m_zero);
+		m_bodyB.gather(lanes + 2 * WIDTH, bodies, m_zero);
+
+		const Float jacDiagInv = V::load(row + BT_WIDE_SIMD_JAC_DIAG_INV * WIDTH);
+		const Float applied = V::load(row + BT_WIDE_SIMD_APPLIED_IMPULSE * WIDTH);
+		Float deltaImpulse = V::sub(V::load(row + BT_WIDE_SIMD_RHS * WIDTH), V::mul(applied, V::load(row + BT_WIDE_SIMD_CFM * WIDTH)));
+		const Float deltaVel1Dotn = m_bodyA.dot(row, BT_WIDE_SIMD_RELPOS1_CROSS_NORMAL, false);
+		const Float deltaVel2Dotn = m_bodyB.dot(row, BT_WIDE_SIMD_RELPOS2_CROSS_NORMAL, true);
+		deltaImpulse = V::sub(deltaImpulse, V::mul(deltaVel1Dotn, jacDiagInv));
+		deltaImpulse = V::sub(deltaImpulse, V::mul(deltaVel2Dotn, jacDiagInv));
+
+		const Float sum = V::add(applied, deltaImpulse);
+		Float newApplied = sum;
+		if (clampUpper)
+		{
+			const typename V::Mask aboveUpper = V::greaterThan(sum, upper);
+			newApplied = V::select(aboveUpper, upper, newApplied);
+			deltaImpulse = V::select(aboveUpper, V::sub(upper, applied), deltaImpulse);
+		}
+		// selected last, the lower limit wins as in the scalar solver
+		const typename V::Mask belowLower = V::lessThan(sum, lower);
+		newApplied = V::select(belowLower, lower, newApplied);
+		deltaImpulse = V::select(belowLower, V::sub(lower, applied), deltaImpulse);
+		if (active)
+		{
+			newApplied = V::select(*active, newApplied, applied);
+			deltaImpulse = V::select(*active, deltaImpulse, V::zero());
+		}
+		V::store(row + BT_WIDE_SIMD_APPLIED_IMPULSE * WIDTH, newApplied);
+		V::storeu(m_deltaImpulse, deltaImpulse);
+
+		m_bodyA.applyImpulse(row, deltaImpulse, BT_WIDE_SIMD_LINEAR_COMPONENT_A, BT_WIDE_SIMD_ANGULAR_COMPONENT_A);
+		m_bodyB.applyImpulse(row, deltaImpulse, BT_WIDE_SIMD_LINEAR_COMPONENT_B, BT_WIDE_SIMD_ANGULAR_COMPONENT_B);
+		m_bodyA.scatter(lanes + WIDTH, m_scratch);
+		m_bodyB.scatter(lanes + 2 * WIDTH, m_scratch);
+	}
+
+	btScalar residual(const float* row, int lane) const
+	{
+		btScalar r = m_deltaImpulse[lane] * (1. / row[BT_WIDE_SIMD_JAC_DIAG_INV * WIDTH + lane]);
+		return r * r;
+	}
+
+	// the applied impulses of the contacts are also written to the pool, rolling friction and the finish read them there
+	static btScalar solveContactRows(btWideSimdRows& rows, int iBegin, int iEnd, btSolverBody* bodies, btSolverConstraint* contacts)
+	{
+		btAssert(rows.m_width == WIDTH);
+		btWideSimdRowKernel kernel;
+		btScalar leastSquaresResidual = 0.f;
+		for (int iGroup = iBegin; iGroup < iEnd; ++iGroup)
+		{
+			const btWideSimdGroup& group = rows.m_groups[iGroup];
+			for (int step = group.m_firstStep; step < group.m_firstStep + group.m_numSteps; ++step)
+			{
+				float* row = rows.m_floats + size_t(step) * rows.m_stepFloatCount;
+				const int* lanes = rows.m_ints + step * 3 * WIDTH;
+				const Float lower = V::load(row + BT_WIDE_SIMD_LIMIT * WIDTH);
+				kernel.solveLanes(row, lanes, bodies, lower, lower, false, NULL);
+				// residuals are summed in lane order
+				for (int lane = 0; lane < WIDTH; ++lane)
+				{
+					const int iContact = lanes[lane];
+					if (iContact >= 0)
+					{
+						*(float*)&contacts[iContact].m_appliedImpulse = row[BT_WIDE_SIMD_APPLIED_IMPULSE * WIDTH + lane];
+						leastSquaresResidual += kernel.residual(row, lane);
+					}
+				}
+			}
+		}
+		return leastSquaresResidual;
+	}
+
+	// friction rows of a contact are solved only while it pushes, within the friction cone of its applied impulse,
+	// which the contact row of the same step holds; btWideSimdRows::storeFrictionImpulses writes them to the pool
+	static btScalar solveFrictionRows(btWideSimdRows& rows, int iBegin, int iEnd, btSolverBody* bodies, btSolverConstraint* contacts)
+	{
+		btAssert(rows.m_width == WIDTH);
+		(void)contacts;
+		const int numDirections = rows.m_numFrictionDirections;
+		btWideSimdRowKernel kernel;
+		btScalar leastSquaresResidual = 0.f;
+		for (int iGroup = iBegin; iGroup < iEnd; ++iGroup)
+		{
+			const btWideSimdGroup& group = rows.m_groups[iGroup];
+			for (int step = group.m_firstStep; step < group.m_firstStep + group.m_numSteps; ++step)
+			{
+				float* stepRows = rows.m_floats + size_t(step) * rows.m_stepFloatCount;
+				const int* lanes = rows.m_ints + step * 3 * WIDTH;
+				const Float totalImpulse = V::load(stepRows + BT_WIDE_SIMD_APPLIED_IMPULSE * WIDTH);
+				const typename V::Mask active = V::greaterThan(totalImpulse, V::zero());
+				const int activeBits = V::laneBits(active);
+				if (activeBits == 0)
+				{
+					continue;
+				}
+				for (int iDir = 0; iDir < numDirections; ++iDir)
+				{
+					float* row = stepRows + (1 + iDir) * BT_WIDE_SIMD_ROW_FIELD_COUNT * WIDTH;
+					const Float upper = V::mul(V::load(row + BT_WIDE_SIMD_LIMIT * WIDTH), totalImpulse);
+					const Float lower = V::sub(V::zero(), upper);
+					kernel.solveLanes(row, lanes, bodies, lower, upper, true, &active);
+					for (int lane = 0; lane < WIDTH; ++lane)
+					{
+						if (activeBits & (1 << lane))
+						{
+							leastSquaresResidual += kernel.residual(row, lane);
+						}
+					}
+				}
+			}
+		}
+		return leastSquaresResidual;
+	}
+};
+
+#endif  //BT_SOLVER_WIDE_SIMD_KERNEL_H
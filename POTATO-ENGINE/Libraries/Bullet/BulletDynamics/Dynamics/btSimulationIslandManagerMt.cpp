@@ -44,6 +44,12 @@ btSimulationIslandManagerMt::btSimulationIslandManagerMt()
 	m_batchIslandMinBodyCount = 32;
 	m_islandDispatch = parallelIslandDispatch;
 	m_batchIsland = NULL;
+	m_adaptiveIterations = false;
+	m_collectIslandStats = false;
+	m_minimumIslandIterations = 2;
+	m_frameIterationBudget = 0;
+	m_islandResidualThreshold = btScalar(1e-2);
+	m_frameCounter = 0;
 }
 
 btSimulationIslandManagerMt::~btSimulationIslandManagerMt()
@@ -165,6 +171,7 @@ void btSimulationIslandManagerMt::initIslandPools()
 		island->constraintArray.resize(0);
 		island->id = -1;
 		island->isSleeping = true;
+		island->numIterations = 0;
 		m_freeIslands.push_back(island);
 	}
 }
@@ -249,6 +256,7 @@ btSimulationIslandManagerMt::Island* btSimulationIslandManagerMt::allocateIsland
 		// no free island found, allocate
 		island = new Island();  // TODO: change this to use the pool allocator
 		island->id = id;
+		island->numIterations = 0;
 		island->bodyArray.reserve(allocSize);
 		m_allocatedIslands.push_back(island);
 	}
@@ -525,10 +533,165 @@ void btSimulationIslandManagerMt::mergeIslands()
 	}
 }
 
+static btCollisionObject* getIslandKeyBody(const btSimulationIslandManagerMt::Island* island)
+{
+	// the body with the lowest world array index stays the same while the island keeps its bodies
+	btCollisionObject* keyBody = island->bodyArray[0];
+	for (int i = 1; i < island->bodyArray.size(); ++i)
+	{
+		btCollisionObject* body = island->bodyArray[i];
+		if (body->getWorldArrayIndex() < keyBody->getWorldArrayIndex())
+		{
+			keyBody = body;
+		}
+	}
+	return keyBody;
+}
+
+SIMD_FORCE_INLINE int calcIslandIterationWeight(const btSimulationIslandManagerMt::Island* island)
+{
+	return btMax(1, island->manifoldArray.size() + island->constraintArray.size());
+}
+
+void btSimulationIslandManagerMt::assignIslandIterations(const btContactSolverInfo& solverInfo)
+{
+	BT_PROFILE("assignIslandIterations");
+	int maxIterations = btMax(1, solverInfo.m_numIterations);
+	btScalar residualThreshold = solverInfo.m_leastSquaresResidualThreshold;
+	if (!m_adaptiveIterations)
+	{
+		// same iterations as without stats, only the results are collected
+		for (int i = 0; i < m_activeIslands.size(); ++i)
+		{
+			Island* island = m_activeIslands[i];
+			island->numIterations = maxIterations;
+			island->leastSquaresResidualThreshold = residualThreshold;
+		}
+		return;
+	}
+	int minIterations = btMin(btMax(1, m_minimumIslandIterations), maxIterations);
+	residualThreshold = btMax(residualThreshold, m_islandResidualThreshold);
+	int minWork = 0;
+	int wantedWork = 0;
+	for (int i = 0; i < m_activeIslands.size(); ++i)
+	{
+		Island* island = m_activeIslands[i];
+		int numManifolds = island->manifoldArray.size();
+		int wanted = maxIterations;
+		const IslandHistory* history = m_islandHistory.find(btHashPtr(getIslandKeyBody(island)));
+		if (history && history->lastFrame == m_frameCounter - 1)
+		{
+			if (numManifolds > history->numManifolds + history->numManifolds / 4 + 2)
+			{
+				// many new contacts are not warm started, solve them in full
+				wanted = maxIterations;
+			}
+			else if (history->numIterationsUsed < history->numIterations)
+			{
+				// converged early last frame, keep a spare iteration
+				wanted = history->numIterationsUsed + 1;
+			}
+			else
+			{
+				// ran out of iterations, grow the budget quickly
+				wanted = history->numIterations * 2;
+			}
+		}
+		island->numIterations = btMax(minIterations, btMin(wanted, maxIterations));
+		island->leastSquaresResidualThreshold = residualThreshold;
+		int weight = calcIslandIterationWeight(island);
+		minWork += minIterations * weight;
+		wantedWork += island->numIterations * weight;
+	}
+	if (m_frameIterationBudget > 0 && wantedWork > m_frameIterationBudget)
+	{
+		// every island keeps its minimum, the rest of the budget goes to the extra iterations in proportion
+		btScalar extraScale = btScalar(btMax(0, m_frameIterationBudget - minWork)) / btScalar(wantedWork - minWork);
+		for (int i = 0; i < m_activeIslands.size(); ++i)
+		{
+			Island* island = m_activeIslands[i];
+			int extra = int(btScalar(island->numIterations - minIterations) * extraScale);
+			island->numIterations = minIterations + extra;
+		}
+	}
+}
+
+void btSimulationIslandManagerMt::gatherIslandStats()
+{
+	BT_PROFILE("gatherIslandStats");
+	m_islandStats.resizeNoInitialize(m_activeIslands.size());
+	for (int i = 0; i < m_activeIslands.size(); ++i)
+	{
+		const Island* island = m_activeIslands[i];
+		IslandStats& stats = m_islandStats[i];
+		stats.islandId = island->id;
+		stats.numBodies = island->bodyArray.size();
+		stats.numManifolds = island->manifoldArray.size();
+		stats.numConstraints = island->constraintArray.size();
+		stats.numIterations = island->numIterations;
+		stats.numIterationsUsed = island->iterationStats.m_numIterationsUsed;
+		stats.remainingLeastSquaresResidual = island->iterationStats.m_remainingLeastSquaresResidual;
+	}
+	if (!m_adaptiveIterations)
+	{
+		return;
+	}
+	// islands that went to sleep or were merged differently are dropped after a frame
+	if (m_islandHistory.size() > 2 * m_activeIslands.size() + 64)
+	{
+		btAlignedObjectArray<btHashPtr> keys;
+		btAlignedObjectArray<IslandHistory> entries;
+		for (int i = 0; i < m_islandHistory.size(); ++i)
+		{
+			const IslandHistory* entry = m_islandHistory.getAtIndex(i);
+			if (entry->lastFrame == m_frameCounter - 1)
+			{
+				keys.push_back(m_islandHistory.getKeyAtIndex(i));
+				entries.push_back(*entry);
+			}
+		}
+		m_islandHistory.clear();
+		for (int i = 0; i < keys.size(); ++i)
+		{
+			m_islandHistory.insert(keys[i], entries[i]);
+		}
+	}
+	for (int i = 0; i < m_activeIslands.size(); ++i)
+	{
+		const Island* island = m_activeIslands[i];
+		IslandHistory entry;
+		entry.numIterations = island->numIterations;
+		entry.numIterationsUsed = island->iterationStats.m_numIterationsUsed;
+		entry.numManifolds = island->manifoldArray.size();
+		entry.lastFrame = m_frameCounter;
+		m_islandHistory.insert(btHashPtr(getIslandKeyBody(island)), entry);
+	}
+	++m_frameCounter;
+}
+
 void btSimulationIslandManagerMt::solveIsland(btConstraintSolver* solver, Island& island, const SolverParams& solverParams)
 {
 	btPersistentManifold** manifolds = island.manifoldArray.size() ? &island.manifoldArray[0] : NULL;
 	btTypedConstraint** constraintsPtr = island.constraintArray.size() ? &island.constraintArray[0] : NULL;
+	if (island.numIterations > 0)
+	{
+		btContactSolverInfo islandSolverInfo = *solverParams.m_solverInfo;
+		islandSolverInfo.m_numIterations = island.numIterations;
+		islandSolverInfo.m_leastSquaresResidualThreshold = island.leastSquaresResidualThreshold;
+		islandSolverInfo.m_iterationStats = &island.iterationStats;
+		island.iterationStats.m_numIterationsUsed = 0;
+		island.iterationStats.m_remainingLeastSquaresResidual = 0.f;
+		solver->solveGroup(&island.bodyArray[0],
+						   island.bodyArray.size(),
+						   manifolds,
+						   island.manifoldArray.size(),
+						   constraintsPtr,
+						   island.constraintArray.size(),
+						   islandSolverInfo,
+						   solverParams.m_debugDrawer,
+						   solverParams.m_dispatcher);
+		return;
+	}
 	solver->solveGroup(&island.bodyArray[0],
 					   island.bodyArray.size(),
 					   manifolds,
@@ -690,7 +853,20 @@ void btSimulationIslandManagerMt::buildAndProcessIslands(btDispatcher* dispatche
 		{
 			mergeIslands();
 		}
+		bool collectStats = m_adaptiveIterations || m_collectIslandStats;
+		if (collectStats)
+		{
+			assignIslandIterations(*solverParams.m_solverInfo);
+		}
 		// dispatch islands to solver
 		m_islandDispatch(&m_activeIslands, solverParams);
+		if (collectStats)
+		{
+			gatherIslandStats();
+		}
+		else
+		{
+			m_islandStats.resizeNoInitialize(0);
+		}
 	}
 }
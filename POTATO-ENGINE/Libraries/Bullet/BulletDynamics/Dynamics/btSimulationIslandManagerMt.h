@@ -17,10 +17,11 @@ subject to the following restrictions:
 #define BT_SIMULATION_ISLAND_MANAGER_MT_H
 
 #include "BulletCollision/CollisionDispatch/btSimulationIslandManager.h"
+#include "BulletDynamics/ConstraintSolver/btContactSolverInfo.h"
+#include "LinearMath/btHashMap.h"
 
 class btTypedConstraint;
 class btConstraintSolver;
-struct btContactSolverInfo;
 class btIDebugDraw;
 
 ///
@@ -32,6 +33,12 @@ class btIDebugDraw;
 ///                       of islands. If only a single island exists, then no parallelism is
 ///                       possible.
 ///
+///                       With adaptive iterations each island gets its own iteration count, taken
+///                       from how many iterations it needed to reach the residual threshold last
+///                       frame and from how much its contact count changed. The counts are clamped
+///                       to [minimum island iterations, btContactSolverInfo::m_numIterations] and
+///                       scaled down when the islands together exceed the frame iteration budget.
+///
 class btSimulationIslandManagerMt : public btSimulationIslandManager
 {
 public:
@@ -44,6 +51,9 @@ public:
 		btAlignedObjectArray<btTypedConstraint*> constraintArray;
 		int id;  // island id
 		bool isSleeping;
+		int numIterations;                             // solver iterations for this island, 0 to use the solver info as is
+		btScalar leastSquaresResidualThreshold;        // used with numIterations
+		btContactSolverIterationStats iterationStats;  // written by the solver when numIterations is set
 
 		void append(const Island& other);  // add bodies, manifolds, constraints to my own
 	};
@@ -61,7 +71,28 @@ public:
 	static void serialIslandDispatch(btAlignedObjectArray<Island*>* islandsPtr, const SolverParams& solverParams);
 	static void parallelIslandDispatch(btAlignedObjectArray<Island*>* islandsPtr, const SolverParams& solverParams);
 
+	// convergence of an island in the last buildAndProcessIslands
+	struct IslandStats
+	{
+		int islandId;
+		int numBodies;
+		int numManifolds;
+		int numConstraints;
+		int numIterations;      // iterations the island was given
+		int numIterationsUsed;  // iterations solved before the residual threshold was reached
+		btScalar remainingLeastSquaresResidual;
+	};
+
 protected:
+	// what an island needed last time it was solved, keyed by its body with the lowest world array index
+	struct IslandHistory
+	{
+		int numIterations;
+		int numIterationsUsed;
+		int numManifolds;
+		int lastFrame;
+	};
+
 	btAlignedObjectArray<Island*> m_allocatedIslands;    // owner of all Islands
 	btAlignedObjectArray<Island*> m_activeIslands;       // islands actively in use
 	btAlignedObjectArray<Island*> m_freeIslands;         // islands ready to be reused
@@ -70,6 +101,14 @@ protected:
 	int m_minimumSolverBatchSize;
 	int m_batchIslandMinBodyCount;
 	IslandDispatchFunc m_islandDispatch;
+	bool m_adaptiveIterations;
+	bool m_collectIslandStats;
+	int m_minimumIslandIterations;
+	int m_frameIterationBudget;
+	btScalar m_islandResidualThreshold;
+	int m_frameCounter;
+	btHashMap<btHashPtr, IslandHistory> m_islandHistory;
+	btAlignedObjectArray<IslandStats> m_islandStats;
 
 	Island* getIsland(int id);
 	virtual Island* allocateIsland(int id, int numBodies);
@@ -78,6 +117,8 @@ protected:
 	virtual void addManifoldsToIslands(btDispatcher* dispatcher);
 	virtual void addConstraintsToIslands(btAlignedObjectArray<btTypedConstraint*>& constraints);
 	virtual void mergeIslands();
+	virtual void assignIslandIterations(const btContactSolverInfo& solverInfo);
+	virtual void gatherIslandStats();
 
 public:
 	btSimulationIslandManagerMt();
@@ -98,6 +139,11 @@ public:
 	{
 		m_minimumSolverBatchSize = sz;
 	}
+	// islands built by the last buildAndProcessIslands, after small islands were merged into batches
+	int getNumActiveIslands() const
+	{
+		return m_activeIslands.size();
+	}
 	IslandDispatchFunc getIslandDispatchFunction() const
 	{
 		return m_islandDispatch;
@@ -107,6 +153,60 @@ public:
 	{
 		m_islandDispatch = func;
 	}
+	// give each island its own iteration count, only used when islands are split
+	bool getAdaptiveIterations() const
+	{
+		return m_adaptiveIterations;
+	}
+	void setAdaptiveIterations(bool enable)
+	{
+		m_adaptiveIterations = enable;
+	}
+	// fill the island stats without adapting the iteration counts
+	bool getCollectIslandStats() const
+	{
+		return m_collectIslandStats;
+	}
+	void setCollectIslandStats(bool enable)
+	{
+		m_collectIslandStats = enable;
+	}
+	int getMinimumIslandIterations() const
+	{
+		return m_minimumIslandIterations;
+	}
+	void setMinimumIslandIterations(int iterations)
+	{
+		m_minimumIslandIterations = iterations;
+	}
+	// iterations times manifolds and constraints of all islands in a frame, 0 for no limit
+	int getFrameIterationBudget() const
+	{
+		return m_frameIterationBudget;
+	}
+	void setFrameIterationBudget(int budget)
+	{
+		m_frameIterationBudget = budget;
+	}
+	// an island stops iterating below this residual (squared velocity error of the rows), or below
+	// btContactSolverInfo::m_leastSquaresResidualThreshold if larger
+	btScalar getIslandResidualThreshold() const
+	{
+		return m_islandResidualThreshold;
+	}
+	void setIslandResidualThreshold(btScalar threshold)
+	{
+		m_islandResidualThreshold = threshold;
+	}
+	// one entry per active island, filled when adaptive iterations or island stats are enabled
+	int getNumIslandStats() const
+	{
+		return m_islandStats.size();
+	}
+	const IslandStats& getIslandStats(int i) const
+	{
+		return m_islandStats[i];
+	}
 };
 
 #endif  //BT_SIMULATION_ISLAND_MANAGER_H
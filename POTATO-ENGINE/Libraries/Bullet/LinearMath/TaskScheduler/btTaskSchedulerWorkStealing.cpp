@@ -0,0 +1,562 @@
+#include "LinearMath/btMinMax.h"
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+
+#if BT_THREADSAFE && (__cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900))
+
+#include <atomic>
+#include <climits>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if defined(__linux__)
+#define BT_WS_USE_FUTEX 1
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#if _WIN32_WINNT >= 0x0602  // WaitOnAddress needs Windows 8
+#define BT_WS_USE_WAIT_ON_ADDRESS 1
+#pragma comment(lib, "Synchronization.lib")
+#endif
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define btWsCpuRelax() _mm_pause()
+#elif defined(__i386__) || defined(__x86_64__)
+#define btWsCpuRelax() __builtin_ia32_pause()
+#else
+#define btWsCpuRelax() std::this_thread::yield()
+#endif
+
+///
+/// btWorkStealingDeque -- Chase-Lev deque of [begin, end) iteration ranges.
+///
+/// The owning thread pushes and pops at the bottom, any other thread steals from the top.
+/// The buffer is fixed: with binary splitting a thread never holds more than log2(iterations)
+/// ranges, so a full deque only means the owner runs the range itself instead of sharing it.
+/// top only ever grows, so a thief holding a stale index simply loses its CAS.
+///
+class btWorkStealingDeque
+{
+public:
+	enum
+	{
+		kCapacity = 64  // power of 2
+	};
+
+	btWorkStealingDeque()
+	{
+		m_top.store(0, std::memory_order_relaxed);
+		m_bottom.store(0, std::memory_order_relaxed);
+		for (int i = 0; i < kCapacity; ++i)
+		{
+			m_ranges[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	static unsigned long long packRange(int iBegin, int iEnd)
+	{
+		return (unsigned long long)(unsigned int)iBegin | ((unsigned long long)(unsigned int)iEnd << 32);
+	}
+	static void unpackRange(unsigned long long range, int* iBegin, int* iEnd)
+	{
+		*iBegin = (int)(unsigned int)(range & 0xffffffffu);
+		*iEnd = (int)(unsigned int)(range >> 32);
+	}
+
+	bool push(int iBegin, int iEnd)
+	{
+		long long b = m_bottom.load(std::memory_order_relaxed);
+		long long t = m_top.load(std::memory_order_acquire);
+		if (b - t >= kCapacity)
+		{
+			return false;
+		}
+		m_ranges[b & (kCapacity - 1)].store(packRange(iBegin, iEnd), std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_bottom.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool pop(int* iBegin, int* iEnd)
+	{
+		long long b = m_bottom.load(std::memory_order_relaxed) - 1;
+		m_bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long t = m_top.load(std::memory_order_relaxed);
+		if (t > b)
+		{
+			// empty
+			m_bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+		unsigned long long range = m_ranges[b & (kCapacity - 1)].load(std::memory_order_relaxed);
+		if (t == b)
+		{
+			// last item, race the thieves for it
+			bool won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			m_bottom.store(b + 1, std::memory_order_relaxed);
+			if (!won)
+			{
+				return false;
+			}
+		}
+		unpackRange(range, iBegin, iEnd);
+		return true;
+	}
+
+	bool steal(int* iBegin, int* iEnd)
+	{
+		long long t = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long b = m_bottom.load(std::memory_order_acquire);
+		if (t >= b)
+		{
+			return false;
+		}
+		unsigned long long range = m_ranges[t & (kCapacity - 1)].load(std::memory_order_relaxed);
+		if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			return false;
+		}
+		unpackRange(range, iBegin, iEnd);
+		return true;
+	}
+
+	bool isEmpty() const
+	{
+		return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+	}
+
+private:
+	// top and bottom on separate cache lines, thieves hammer top while the owner works on bottom
+	char m_pad0[64];
+	std::atomic<long long> m_top;
+	char m_pad1[64 - sizeof(std::atomic<long long>)];
+	std::atomic<long long> m_bottom;
+	char m_pad2[64 - sizeof(std::atomic<long long>)];
+	std::atomic<unsigned long long> m_ranges[kCapacity];
+};
+
+///
+/// btWorkStealingParker -- futex style sleep on a generation counter.
+///
+/// wait(gen) returns as soon as the generation differs from gen; wakeAll() bumps the generation.
+/// Uses futex on Linux and WaitOnAddress on Windows 8+, a mutex and condition variable elsewhere.
+///
+class btWorkStealingParker
+{
+public:
+	btWorkStealingParker()
+	{
+		m_generation.store(0, std::memory_order_relaxed);
+		m_numWaiting.store(0, std::memory_order_relaxed);
+	}
+
+	int getGeneration() const
+	{
+		return m_generation.load(std::memory_order_acquire);
+	}
+
+	void wait(int generation)
+	{
+		m_numWaiting.fetch_add(1, std::memory_order_seq_cst);
+#if BT_WS_USE_FUTEX
+		while (m_generation.load(std::memory_order_acquire) == generation)
+		{
+			syscall(SYS_futex, reinterpret_cast<int*>(&m_generation), FUTEX_WAIT_PRIVATE, generation, NULL, NULL, 0);
+		}
+#elif BT_WS_USE_WAIT_ON_ADDRESS
+		while (m_generation.load(std::memory_order_acquire) == generation)
+		{
+			WaitOnAddress(&m_generation, &generation, sizeof(generation), INFINITE);
+		}
+#else
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (m_generation.load(std::memory_order_acquire) == generation)
+			{
+				m_condition.wait(lock);
+			}
+		}
+#endif
+		m_numWaiting.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	void wakeAll()
+	{
+#if !BT_WS_USE_FUTEX && !BT_WS_USE_WAIT_ON_ADDRESS
+		std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+		m_generation.fetch_add(1, std::memory_order_seq_cst);
+		// skip the syscall when nobody sleeps, the common case while workers are still spinning
+		if (m_numWaiting.load(std::memory_order_seq_cst) == 0)
+		{
+			return;
+		}
+#if BT_WS_USE_FUTEX
+		syscall(SYS_futex, reinterpret_cast<int*>(&m_generation), FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#elif BT_WS_USE_WAIT_ON_ADDRESS
+		WakeByAddressAll(&m_generation);
+#else
+		m_condition.notify_all();
+#endif
+	}
+
+private:
+	std::atomic<int> m_generation;
+	std::atomic<int> m_numWaiting;
+#if !BT_WS_USE_FUTEX && !BT_WS_USE_WAIT_ON_ADDRESS
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+#endif
+};
+
+///
+/// btTaskSchedulerWorkStealing -- task scheduler with one deque per thread
+///
+/// A parallelFor starts as a single range on the calling thread's deque. Whoever runs a range
+/// works through it grain by grain, and whenever its own deque runs dry it splits the remaining
+/// iterations in half and pushes the upper half for others to steal (lazy binary splitting).
+/// Idle threads pick random victims and steal from the top of their deque, so the split
+/// granularity follows the actual load instead of a fixed job size. Workers spin for a short
+/// while after running out of work, then sleep until the next parallelFor.
+///
+/// The calling thread is slot 0 and the workers are started one by one so that worker slot i gets
+/// Bullet thread index i. Only workers below getNumThreads() take part; the others stay asleep.
+///
+class btTaskSchedulerWorkStealing : public btITaskScheduler
+{
+	struct ThreadSlot
+	{
+		btWorkStealingDeque m_deque;
+		unsigned int m_randomState;
+		btScalar m_sumResult;
+		char m_pad[64];
+	};
+
+	const btIParallelForBody* m_forBody;
+	const btIParallelSumBody* m_sumBody;
+	int m_grainSize;
+	std::atomic<int> m_iterationsRemaining;
+
+	ThreadSlot* m_slots;
+	btAlignedObjectArray<std::thread*> m_workerThreads;
+	btWorkStealingParker m_parker;
+	std::atomic<bool> m_exit;
+	std::atomic<int> m_numActiveThreads;
+	std::atomic<int> m_numWorkersStarted;
+	int m_maxNumThreads;
+	int m_numThreads;
+	int m_spinMicroseconds;
+	btSpinMutex m_antiNestingLock;  // prevent nested parallel-for
+
+	void runRange(int slotIndex, int iBegin, int iEnd)
+	{
+		ThreadSlot& slot = m_slots[slotIndex];
+		int grainSize = m_grainSize;
+		int done = 0;
+		while (iBegin < iEnd)
+		{
+			// share the upper half whenever our own deque is empty, thieves take it from there
+			if (iEnd - iBegin > grainSize * 2 && slot.m_deque.isEmpty())
+			{
+				int iMid = iBegin + (iEnd - iBegin) / 2;
+				if (slot.m_deque.push(iMid, iEnd))
+				{
+					iEnd = iMid;
+				}
+			}
+			int iChunkEnd = btMin(iEnd, iBegin + grainSize);
+			if (m_sumBody)
+			{
+				slot.m_sumResult += m_sumBody->sumLoop(iBegin, iChunkEnd);
+			}
+			else
+			{
+				m_forBody->forLoop(iBegin, iChunkEnd);
+			}
+			done += iChunkEnd - iBegin;
+			iBegin = iChunkEnd;
+		}
+		m_iterationsRemaining.fetch_sub(done, std::memory_order_acq_rel);
+	}
+
+	bool stealRange(int slotIndex, int* iBegin, int* iEnd)
+	{
+		int numThreads = m_numActiveThreads.load(std::memory_order_relaxed);
+		if (numThreads < 2)
+		{
+			return false;
+		}
+		// xorshift, then visit every other slot starting at a random victim
+		unsigned int x = m_slots[slotIndex].m_randomState;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		m_slots[slotIndex].m_randomState = x;
+		int start = int(x % unsigned(numThreads));
+		for (int i = 0; i < numThreads; ++i)
+		{
+			int victim = start + i;
+			if (victim >= numThreads)
+			{
+				victim -= numThreads;
+			}
+			if (victim != slotIndex && m_slots[victim].m_deque.steal(iBegin, iEnd))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool runOneTask(int slotIndex)
+	{
+		int iBegin;
+		int iEnd;
+		if (m_slots[slotIndex].m_deque.pop(&iBegin, &iEnd) || stealRange(slotIndex, &iBegin, &iEnd))
+		{
+			runRange(slotIndex, iBegin, iEnd);
+			return true;
+		}
+		return false;
+	}
+
+	void workerThreadFunc(int slotIndex)
+	{
+		// claim a Bullet thread index before init() starts the next worker
+		int threadIndex = btGetCurrentThreadIndex();
+		btAssert(threadIndex == slotIndex);
+		m_numWorkersStarted.fetch_add(1, std::memory_order_release);
+		while (!m_exit.load(std::memory_order_acquire))
+		{
+			int generation = m_parker.getGeneration();
+			// per-thread storage in the Mt dispatcher and solver is sized by getNumThreads(), so a
+			// worker whose Bullet thread index is out of range must not run tasks
+			int numActiveThreads = m_numActiveThreads.load(std::memory_order_acquire);
+			if (slotIndex < numActiveThreads && threadIndex < numActiveThreads)
+			{
+				std::chrono::steady_clock::time_point spinEnd = std::chrono::steady_clock::now() + std::chrono::microseconds(m_spinMicroseconds);
+				int idleSpins = 0;
+				for (;;)
+				{
+					if (runOneTask(slotIndex))
+					{
+						idleSpins = 0;
+						spinEnd = std::chrono::steady_clock::now() + std::chrono::microseconds(m_spinMicroseconds);
+						continue;
+					}
+					btWsCpuRelax();
+					// check the clock only every so often, it is not free
+					if (++idleSpins >= 64)
+					{
+						idleSpins = 0;
+						if (std::chrono::steady_clock::now() >= spinEnd || m_exit.load(std::memory_order_relaxed))
+						{
+							break;
+						}
+					}
+				}
+				// work may have been published between the last steal attempt and reading the generation
+				if (m_parker.getGeneration() != generation)
+				{
+					continue;
+				}
+			}
+			m_parker.wait(generation);
+		}
+	}
+
+public:
+	btTaskSchedulerWorkStealing() : btITaskScheduler("WorkStealing")
+	{
+		m_forBody = NULL;
+		m_sumBody = NULL;
+		m_grainSize = 1;
+		m_iterationsRemaining.store(0, std::memory_order_relaxed);
+		m_exit.store(false, std::memory_order_relaxed);
+		m_numActiveThreads.store(1, std::memory_order_relaxed);
+		m_numWorkersStarted.store(0, std::memory_order_relaxed);
+		m_maxNumThreads = btMax(1, btMin(int(BT_MAX_THREAD_COUNT), int(std::thread::hardware_concurrency())));
+		m_numThreads = 1;
+		m_spinMicroseconds = 100;
+		void* mem = btAlignedAlloc(sizeof(ThreadSlot) * m_maxNumThreads, 64);
+		m_slots = static_cast<ThreadSlot*>(mem);
+		for (int i = 0; i < m_maxNumThreads; ++i)
+		{
+			new (&m_slots[i]) ThreadSlot();
+			m_slots[i].m_randomState = 0x9e3779b9u * unsigned(i + 1);
+			m_slots[i].m_sumResult = btScalar(0);
+		}
+	}
+
+	virtual ~btTaskSchedulerWorkStealing()
+	{
+		m_exit.store(true, std::memory_order_release);
+		m_parker.wakeAll();
+		for (int i = 0; i < m_workerThreads.size(); ++i)
+		{
+			m_workerThreads[i]->join();
+			delete m_workerThreads[i];
+		}
+		m_workerThreads.clear();
+		// the worker indexes are free again, a scheduler created later numbers its workers from 1
+		m_savedThreadCounter = 0;
+		if (m_isActive)
+		{
+			btResetThreadIndexCounter();
+		}
+		for (int i = 0; i < m_maxNumThreads; ++i)
+		{
+			m_slots[i].~ThreadSlot();
+		}
+		btAlignedFree(m_slots);
+	}
+
+	void init()
+	{
+		// the calling thread must own Bullet thread index 0, claim it before any worker can
+		unsigned int mainThreadIndex = btGetCurrentThreadIndex();
+		btAssert(mainThreadIndex == 0);
+		(void)mainThreadIndex;
+		// start the workers one at a time so that slot i ends up with Bullet thread index i, numbering
+		// from 1 again even if an earlier scheduler left the counter further up
+		btResetThreadIndexCounter();
+		for (int i = 1; i < m_maxNumThreads; ++i)
+		{
+			m_workerThreads.push_back(new std::thread(&btTaskSchedulerWorkStealing::workerThreadFunc, this, i));
+			while (m_numWorkersStarted.load(std::memory_order_acquire) < i)
+			{
+				std::this_thread::yield();
+			}
+		}
+		// activate() restores this, so threads that show up later are numbered after our workers
+		m_savedThreadCounter = m_maxNumThreads - 1;
+		setNumThreads(m_maxNumThreads);
+	}
+
+	virtual int getMaxNumThreads() const BT_OVERRIDE
+	{
+		return m_maxNumThreads;
+	}
+
+	virtual int getNumThreads() const BT_OVERRIDE
+	{
+		return m_numThreads;
+	}
+
+	virtual void setNumThreads(int numThreads) BT_OVERRIDE
+	{
+		m_numThreads = btMax(btMin(numThreads, m_maxNumThreads), 1);
+		m_numActiveThreads.store(m_numThreads, std::memory_order_release);
+		// let surplus workers go back to sleep
+		m_parker.wakeAll();
+	}
+
+	/// how long a worker keeps looking for work before it goes to sleep
+	void setSpinMicroseconds(int us)
+	{
+		m_spinMicroseconds = btMax(0, us);
+	}
+
+	void runParallel(int iBegin, int iEnd, int grainSize)
+	{
+		m_grainSize = btMax(1, grainSize);
+		m_iterationsRemaining.store(iEnd - iBegin, std::memory_order_relaxed);
+		m_slots[0].m_deque.push(iBegin, iEnd);
+		m_parker.wakeAll();
+
+		// the calling thread works too, and waits for the stragglers once nothing is left to steal
+		while (m_iterationsRemaining.load(std::memory_order_acquire) > 0)
+		{
+			if (!runOneTask(0))
+			{
+				btWsCpuRelax();
+			}
+		}
+	}
+
+	virtual void parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body) BT_OVERRIDE
+	{
+		BT_PROFILE("parallelFor_WorkStealing");
+		btAssert(iEnd >= iBegin);
+		btAssert(grainSize >= 1);
+		int iterationCount = iEnd - iBegin;
+		if (iterationCount > grainSize && m_numThreads > 1 && m_antiNestingLock.tryLock())
+		{
+			btPushThreadsAreRunning();
+			m_forBody = &body;
+			m_sumBody = NULL;
+			runParallel(iBegin, iEnd, grainSize);
+			m_forBody = NULL;
+			btPopThreadsAreRunning();
+			m_antiNestingLock.unlock();
+		}
+		else
+		{
+			BT_PROFILE("parallelFor_mainThread");
+			// just run on main thread
+			body.forLoop(iBegin, iEnd);
+		}
+	}
+
+	virtual btScalar parallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody& body) BT_OVERRIDE
+	{
+		BT_PROFILE("parallelSum_WorkStealing");
+		btAssert(iEnd >= iBegin);
+		btAssert(grainSize >= 1);
+		int iterationCount = iEnd - iBegin;
+		if (iterationCount > grainSize && m_numThreads > 1 && m_antiNestingLock.tryLock())
+		{
+			btPushThreadsAreRunning();
+			for (int i = 0; i < m_numThreads; ++i)
+			{
+				m_slots[i].m_sumResult = btScalar(0);
+			}
+			m_forBody = NULL;
+			m_sumBody = &body;
+			runParallel(iBegin, iEnd, grainSize);
+			m_sumBody = NULL;
+			btScalar sum = btScalar(0);
+			for (int i = 0; i < m_numThreads; ++i)
+			{
+				sum += m_slots[i].m_sumResult;
+			}
+			btPopThreadsAreRunning();
+			m_antiNestingLock.unlock();
+			return sum;
+		}
+		else
+		{
+			BT_PROFILE("parallelSum_mainThread");
+			// just run on main thread
+			return body.sumLoop(iBegin, iEnd);
+		}
+	}
+};
+
+btITaskScheduler* btCreateWorkStealingTaskScheduler()
+{
+	btTaskSchedulerWorkStealing* ts = new btTaskSchedulerWorkStealing();
+	ts->init();
+	return ts;
+}
+
+#else  // #if BT_THREADSAFE && C++11
+
+btITaskScheduler* btCreateWorkStealingTaskScheduler()
+{
+	return NULL;
+}
+
+#endif  // #else // #if BT_THREADSAFE && C++11
@@ -108,6 +108,18 @@ void btAlignedAllocSetCustom(btAllocFunc *allocFunc, btFreeFunc *freeFunc)
 	sFreeFunc = freeFunc ? freeFunc : btFreeDefault;
 }
 
+static btFrameAllocFunc *sFrameAllocFunc = 0;
+
+void btFrameAllocSetCustom(btFrameAllocFunc *allocFunc)
+{
+	sFrameAllocFunc = allocFunc;
+}
+
+void *btFrameAlloc(size_t size, int alignment)
+{
+	return sFrameAllocFunc ? sFrameAllocFunc(size, alignment) : 0;
+}
+
 #ifdef BT_DEBUG_MEMORY_ALLOCATIONS
 
 static int allocations_id[10241024];
@@ -59,6 +59,14 @@ void btAlignedAllocSetCustom(btAllocFunc* allocFunc, btFreeFunc* freeFunc);
 ///If the developer has already an custom aligned allocator, then btAlignedAllocSetCustomAligned can be used. The default aligned allocator pre-allocates extra memory using the non-aligned allocator, and instruments it.
 void btAlignedAllocSetCustomAligned(btAlignedAllocFunc* allocFunc, btAlignedFreeFunc* freeFunc);
 
+typedef void*(btFrameAllocFunc)(size_t size, int alignment);
+
+///The developer can give Bullet a frame allocator for scratch memory that only lives during the current simulation step, using btFrameAllocSetCustom.
+///Bullet never frees that memory; the developer rewinds the allocator after each step, while no Bullet thread runs. NULL removes it.
+void btFrameAllocSetCustom(btFrameAllocFunc* allocFunc);
+///Returns NULL when no frame allocator is set or it is out of memory, the caller then falls back to its own storage.
+void* btFrameAlloc(size_t size, int alignment);
+
 ///The btAlignedAllocator is a portable class for aligned memory allocations.
 ///Default implementations for unaligned and aligned allocations can be overridden by a custom allocator using btAlignedAllocSetCustom and btAlignedAllocSetCustomAligned.
 template <typename T, unsigned Alignment>
@@ -12,6 +12,16 @@
 #endif  //BT_ALLOW_SSE4
 #endif  //USE_SIMD
 
+//x86-64 single precision builds carry AVX2 and AVX-512 code paths, used once getCpuFeatures reports them
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(BT_USE_DOUBLE_PRECISION)
+#define BT_ALLOW_WIDE_SIMD
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif  //x86-64
+
 #if defined BT_USE_NEON
 #define ARM_NEON_GCC_COMPATIBILITY 1
 #include <arm_neon.h>
@@ -19,7 +29,7 @@
 #include <sys/sysctl.h>  //for sysctlbyname
 #endif                   //BT_USE_NEON
 
-///Rudimentary btCpuFeatureUtility for CPU features: only report the features that Bullet actually uses (SSE4/FMA3, NEON_HPFP)
+///Rudimentary btCpuFeatureUtility for CPU features: only report the features that Bullet actually uses (SSE4/FMA3, AVX2, AVX-512F, NEON_HPFP)
 ///We assume SSE2 in case BT_USE_SSE2 is defined in LinearMath/btScalar.h
 class btCpuFeatureUtility
 {
@@ -28,7 +38,9 @@ public:
 	{
 		CPU_FEATURE_FMA3 = 1,
 		CPU_FEATURE_SSE4_1 = 2,
-		CPU_FEATURE_NEON_HPFP = 4
+		CPU_FEATURE_NEON_HPFP = 4,
+		CPU_FEATURE_AVX2 = 8,     // AVX2 and FMA3, with the OS saving the YMM registers
+		CPU_FEATURE_AVX512F = 16  // with the OS saving the ZMM and opmask registers as well
 	};
 
 	static int getCpuFeatures()
@@ -80,6 +92,46 @@ public:
 		}
 #endif  //BT_ALLOW_SSE4
 
+#ifdef BT_ALLOW_WIDE_SIMD
+		{
+			unsigned int leaf1[4] = {0, 0, 0, 0};
+			unsigned int leaf7[4] = {0, 0, 0, 0};
+			unsigned long long xcr0 = 0;
+#if defined(_MSC_VER)
+			__cpuid((int*)leaf1, 1);
+			__cpuidex((int*)leaf7, 7, 0);
+#else
+			__get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]);
+			__get_cpuid_count(7, 0, &leaf7[0], &leaf7[1], &leaf7[2], &leaf7[3]);
+#endif
+			const unsigned int OSXSAVEFlag = (1U << 27);
+			const unsigned int AVXFlag = (1U << 28);
+			if ((leaf1[2] & (OSXSAVEFlag | AVXFlag)) == (OSXSAVEFlag | AVXFlag))
+			{
+#if defined(_MSC_VER)
+				xcr0 = _xgetbv(0);
+#else
+				unsigned int xcr0Low, xcr0High;
+				__asm__ __volatile__("xgetbv"
+									 : "=a"(xcr0Low), "=d"(xcr0High)
+									 : "c"(0));
+				xcr0 = ((unsigned long long)xcr0High << 32) | xcr0Low;
+#endif
+			}
+			const unsigned int FMAFlag = (1U << 12);
+			const unsigned int AVX2Flag = (1U << 5);
+			const unsigned int AVX512FFlag = (1U << 16);
+			if ((xcr0 & 0x6) == 0x6 && (leaf1[2] & FMAFlag) && (leaf7[1] & AVX2Flag))
+			{
+				capabilities |= btCpuFeatureUtility::CPU_FEATURE_AVX2;
+				if ((xcr0 & 0xe0) == 0xe0 && (leaf7[1] & AVX512FFlag))
+				{
+					capabilities |= btCpuFeatureUtility::CPU_FEATURE_AVX512F;
+				}
+			}
+		}
+#endif  //BT_ALLOW_WIDE_SIMD
+
 		testedCapabilities = true;
 		return capabilities;
 	}
@@ -0,0 +1,146 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btParallelRadixSort.h"
+#include "btMinMax.h"
+#include "btQuickprof.h"
+
+static const int BT_RADIX_BITS = 8;
+static const int BT_RADIX_SIZE = 1 << BT_RADIX_BITS;
+static const int BT_RADIX_MIN_CHUNK_SIZE = 256;
+
+struct btRadixSortPassLoop : public btIParallelForBody
+{
+	btParallelRadixSort* m_sort;
+	int m_shift;
+	bool m_scatter;
+
+	btRadixSortPassLoop(btParallelRadixSort* sort, int shift, bool scatter)
+		: m_sort(sort),
+		  m_shift(shift),
+		  m_scatter(scatter)
+	{
+	}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			if (m_scatter)
+			{
+				m_sort->scatterDigits(i, m_shift);
+			}
+			else
+			{
+				m_sort->countDigits(i, m_shift);
+			}
+		}
+	}
+};
+
+btParallelRadixSort::btParallelRadixSort()
+	: m_buffer(0),
+	  m_chunkCount(128),
+	  m_chunkSize(BT_RADIX_MIN_CHUNK_SIZE)
+{
+}
+
+void btParallelRadixSort::resize(int size)
+{
+	m_buffer = 0;
+	for (int i = 0; i < 2; ++i)
+	{
+		m_keys[i].resizeNoInitialize(size);
+		m_values[i].resizeNoInitialize(size);
+	}
+}
+
+void btParallelRadixSort::countDigits(int chunkIndex, int shift)
+{
+	const unsigned int* keys = &m_keys[m_buffer][0];
+	int* counts = &m_digitOffsets[chunkIndex * BT_RADIX_SIZE];
+	for (int d = 0; d < BT_RADIX_SIZE; ++d)
+	{
+		counts[d] = 0;
+	}
+	const int iBegin = chunkIndex * m_chunkSize;
+	const int iEnd = btMin(iBegin + m_chunkSize, size());
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		counts[(keys[i] >> shift) & (BT_RADIX_SIZE - 1)]++;
+	}
+}
+
+void btParallelRadixSort::scatterDigits(int chunkIndex, int shift)
+{
+	const unsigned int* keys = &m_keys[m_buffer][0];
+	const int* values = &m_values[m_buffer][0];
+	unsigned int* destKeys = &m_keys[1 - m_buffer][0];
+	int* destValues = &m_values[1 - m_buffer][0];
+	int* offsets = &m_digitOffsets[chunkIndex * BT_RADIX_SIZE];
+	const int iBegin = chunkIndex * m_chunkSize;
+	const int iEnd = btMin(iBegin + m_chunkSize, size());
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		int dest = offsets[(keys[i] >> shift) & (BT_RADIX_SIZE - 1)]++;
+		destKeys[dest] = keys[i];
+		destValues[dest] = values[i];
+	}
+}
+
+void btParallelRadixSort::sort(int numKeyBits)
+{
+	BT_PROFILE("btParallelRadixSort::sort");
+	const int numKeys = size();
+	if (numKeys <= 1)
+	{
+		return;
+	}
+	m_chunkSize = btMax(BT_RADIX_MIN_CHUNK_SIZE, (numKeys + m_chunkCount - 1) / m_chunkCount);
+	const int numChunks = (numKeys + m_chunkSize - 1) / m_chunkSize;
+	m_digitOffsets.resizeNoInitialize(numChunks * BT_RADIX_SIZE);
+	for (int shift = 0; shift < numKeyBits; shift += BT_RADIX_BITS)
+	{
+		{
+			btRadixSortPassLoop loop(this, shift, false);
+			btParallelFor(0, numChunks, 1, loop);
+		}
+		// offsets run over the digits, and over the chunks within a digit
+		int offset = 0;
+		bool singleDigit = false;
+		for (int d = 0; d < BT_RADIX_SIZE && !singleDigit; ++d)
+		{
+			int digitBegin = offset;
+			for (int c = 0; c < numChunks; ++c)
+			{
+				int& count = m_digitOffsets[c * BT_RADIX_SIZE + d];
+				int chunkCount = count;
+				count = offset;
+				offset += chunkCount;
+			}
+			singleDigit = (offset - digitBegin == numKeys);
+		}
+		if (singleDigit)
+		{
+			// every key has the same digit, the pass would not move anything
+			continue;
+		}
+		{
+			btRadixSortPassLoop loop(this, shift, true);
+			btParallelFor(0, numChunks, 1, loop);
+		}
+		m_buffer = 1 - m_buffer;
+	}
+}
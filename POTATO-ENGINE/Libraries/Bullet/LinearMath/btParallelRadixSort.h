@@ -0,0 +1,76 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_PARALLEL_RADIX_SORT_H
+#define BT_PARALLEL_RADIX_SORT_H
+
+#include "btAlignedObjectArray.h"
+#include "btMinMax.h"
+#include "btThreads.h"
+
+///The btParallelRadixSort sorts unsigned keys with int values on the task scheduler, least significant 8 bits first.
+///The array is cut into a fixed number of chunks; each pass counts the digits of every chunk in parallel, turns the counts
+///into offsets on the calling thread and scatters the chunks in parallel. Passes are stable and the chunks do not depend
+///on the thread count, so equal keys keep their order and the result is the same for any number of threads.
+///Passes where all keys have the same digit are skipped. Fill getKeys and getValues after resize, then call sort.
+class btParallelRadixSort
+{
+public:
+	btParallelRadixSort();
+
+	void resize(int size);
+	int size() const
+	{
+		return m_keys[m_buffer].size();
+	}
+	unsigned int* getKeys()
+	{
+		return size() ? &m_keys[m_buffer][0] : 0;
+	}
+	int* getValues()
+	{
+		return size() ? &m_values[m_buffer][0] : 0;
+	}
+	const unsigned int* getKeys() const
+	{
+		return size() ? &m_keys[m_buffer][0] : 0;
+	}
+	const int* getValues() const
+	{
+		return size() ? &m_values[m_buffer][0] : 0;
+	}
+
+	///sorts by the numKeyBits low bits of the keys
+	void sort(int numKeyBits = 32);
+
+	///number of chunks the passes are cut into, independently of the thread count
+	void setChunkCount(int chunkCount)
+	{
+		m_chunkCount = btMax(chunkCount, 1);
+	}
+
+	void countDigits(int chunkIndex, int shift);
+	void scatterDigits(int chunkIndex, int shift);
+
+private:
+	btAlignedObjectArray<unsigned int> m_keys[2];  // the passes go back and forth between the two arrays
+	btAlignedObjectArray<int> m_values[2];
+	btAlignedObjectArray<int> m_digitOffsets;  // counts, then offsets, of each digit per chunk
+	int m_buffer;                              // array holding the keys before the current pass
+	int m_chunkCount;
+	int m_chunkSize;
+};
+
+#endif  //BT_PARALLEL_RADIX_SORT_H
@@ -0,0 +1,219 @@
+/*
+Copyright (c) 2003-2006 Gino van den Bergen / Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btPoolAllocatorMt.h"
+#include "btMinMax.h"
+
+btPoolAllocatorMt::btPoolAllocatorMt(int elemSize, int firstChunkSize, int maxChunkSize)
+	: m_elemSize(btMax(elemSize, int(sizeof(FreeElement)))),
+	  m_nextChunkSize(btMax(firstChunkSize, 1)),
+	  m_maxChunkSize(btMax(maxChunkSize, firstChunkSize)),
+	  m_capacity(0),
+	  m_maxElements(0),
+	  m_batches(NULL)
+{
+	// every element is preceded by a header naming its owner, so freeMemory can tell pool elements from fallbacks
+	m_elemStride = HEADER_SIZE + ((m_elemSize + 15) & ~15);
+
+	for (int i = 0; i < int(BT_MAX_THREAD_COUNT); ++i)
+	{
+		ThreadCache& cache = m_threadCaches[i];
+		cache.m_firstFree = NULL;
+		cache.m_freeCount = 0;
+		cache.m_allocations = 0;
+		cache.m_frees = 0;
+		cache.m_localHits = 0;
+		cache.m_globalRefills = 0;
+		cache.m_fallbacks = 0;
+	}
+}
+
+btPoolAllocatorMt::~btPoolAllocatorMt()
+{
+	for (int i = 0; i < m_chunks.size(); ++i)
+	{
+		btAlignedFree(m_chunks[i]);
+	}
+}
+
+void* btPoolAllocatorMt::allocate(int size)
+{
+	const unsigned int threadIndex = btGetCurrentThreadIndex();
+	btAssert(threadIndex < BT_MAX_THREAD_COUNT);
+	ThreadCache& cache = m_threadCaches[threadIndex];
+	++cache.m_allocations;
+
+	if (size > m_elemSize)
+	{
+		++cache.m_fallbacks;
+		char* block = (char*)btAlignedAlloc(static_cast<size_t>(HEADER_SIZE + size), 16);
+		*(btPoolAllocatorMt**)block = NULL;
+		return block + HEADER_SIZE;
+	}
+
+	FreeElement* element = cache.m_firstFree;
+	if (element)
+	{
+		++cache.m_localHits;
+	}
+	else
+	{
+		++cache.m_globalRefills;
+		element = takeBatch();
+		if (!element)
+		{
+			// the pool is at its element limit
+			--cache.m_allocations;
+			--cache.m_globalRefills;
+			return NULL;
+		}
+		int count = 0;
+		for (FreeElement* counted = element; counted; counted = counted->m_next)
+		{
+			++count;
+		}
+		cache.m_freeCount = count;
+	}
+
+	cache.m_firstFree = element->m_next;
+	--cache.m_freeCount;
+	return element;
+}
+
+void btPoolAllocatorMt::freeMemory(void* ptr)
+{
+	if (!ptr)
+	{
+		return;
+	}
+
+	const unsigned int threadIndex = btGetCurrentThreadIndex();
+	btAssert(threadIndex < BT_MAX_THREAD_COUNT);
+	ThreadCache& cache = m_threadCaches[threadIndex];
+	++cache.m_frees;
+
+	char* block = (char*)ptr - HEADER_SIZE;
+	if (*(btPoolAllocatorMt**)block != this)
+	{
+		btAlignedFree(block);
+		return;
+	}
+
+	FreeElement* element = (FreeElement*)ptr;
+	element->m_next = cache.m_firstFree;
+	cache.m_firstFree = element;
+	if (++cache.m_freeCount >= 2 * BATCH_SIZE)
+	{
+		giveBatch(cache, BATCH_SIZE);
+	}
+}
+
+btPoolAllocatorMt::FreeElement* btPoolAllocatorMt::takeBatch()
+{
+	btMutexLock(&m_mutex);
+
+	FreeElement* batch = m_batches;
+	if (batch)
+	{
+		m_batches = batch->m_nextBatch;
+		btMutexUnlock(&m_mutex);
+		return batch;
+	}
+
+	// shared pool is empty: add a chunk, twice as large as the previous one up to m_maxChunkSize
+	int chunkSize = m_nextChunkSize;
+	if (m_maxElements > 0)
+	{
+		chunkSize = btMin(chunkSize, m_maxElements - m_capacity);
+		if (chunkSize <= 0)
+		{
+			btMutexUnlock(&m_mutex);
+			return NULL;
+		}
+	}
+	m_nextChunkSize = btMin(m_nextChunkSize * 2, m_maxChunkSize);
+
+	char* chunk = (char*)btAlignedAlloc(static_cast<size_t>(chunkSize) * m_elemStride, 16);
+	m_chunks.push_back(chunk);
+	m_capacity += chunkSize;
+
+	// cut the chunk into batches, keep the first one and share the rest
+	for (int first = 0; first < chunkSize; first += BATCH_SIZE)
+	{
+		const int last = btMin(first + int(BATCH_SIZE), chunkSize);
+		FreeElement* head = NULL;
+		for (int i = last - 1; i >= first; --i)
+		{
+			char* block = chunk + static_cast<size_t>(i) * m_elemStride;
+			*(btPoolAllocatorMt**)block = this;
+			FreeElement* element = (FreeElement*)(block + HEADER_SIZE);
+			element->m_next = head;
+			head = element;
+		}
+
+		if (first == 0)
+		{
+			batch = head;
+		}
+		else
+		{
+			head->m_nextBatch = m_batches;
+			m_batches = head;
+		}
+	}
+
+	btMutexUnlock(&m_mutex);
+	return batch;
+}
+
+void btPoolAllocatorMt::giveBatch(ThreadCache& cache, int count)
+{
+	FreeElement* head = cache.m_firstFree;
+	FreeElement* tail = head;
+	for (int i = 1; i < count; ++i)
+	{
+		tail = tail->m_next;
+	}
+	cache.m_firstFree = tail->m_next;
+	cache.m_freeCount -= count;
+	tail->m_next = NULL;
+
+	btMutexLock(&m_mutex);
+	head->m_nextBatch = m_batches;
+	m_batches = head;
+	btMutexUnlock(&m_mutex);
+}
+
+void btPoolAllocatorMt::setMaxElements(int maxElements)
+{
+	btMutexLock(&m_mutex);
+	m_maxElements = btMax(maxElements, 0);
+	btMutexUnlock(&m_mutex);
+}
+
+void btPoolAllocatorMt::getStats(btPoolAllocatorMtStats& stats) const
+{
+	stats = btPoolAllocatorMtStats();
+	for (int i = 0; i < int(BT_MAX_THREAD_COUNT); ++i)
+	{
+		const ThreadCache& cache = m_threadCaches[i];
+		stats.m_allocations += cache.m_allocations;
+		stats.m_frees += cache.m_frees;
+		stats.m_localHits += cache.m_localHits;
+		stats.m_globalRefills += cache.m_globalRefills;
+		stats.m_fallbacks += cache.m_fallbacks;
+	}
+	stats.m_chunkCount = m_chunks.size();
+	stats.m_capacity = m_capacity;
+}
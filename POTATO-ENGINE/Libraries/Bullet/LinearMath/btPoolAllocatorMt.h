@@ -0,0 +1,128 @@
+/*
+Copyright (c) 2003-2006 Gino van den Bergen / Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef _BT_POOL_ALLOCATOR_MT_H
+#define _BT_POOL_ALLOCATOR_MT_H
+
+#include "btScalar.h"
+#include "btAlignedAllocator.h"
+#include "btAlignedObjectArray.h"
+#include "btThreads.h"
+
+///counters of a btPoolAllocatorMt, summed over all threads since construction
+struct btPoolAllocatorMtStats
+{
+	unsigned long long m_allocations;
+	unsigned long long m_frees;
+	unsigned long long m_localHits;      // allocations served from the calling thread's own free list
+	unsigned long long m_globalRefills;  // allocations that took a batch from the shared pool
+	unsigned long long m_fallbacks;      // requests larger than the element size, sent to btAlignedAlloc
+	int m_chunkCount;
+	int m_capacity;  // elements in all chunks
+
+	btPoolAllocatorMtStats()
+		: m_allocations(0),
+		  m_frees(0),
+		  m_localHits(0),
+		  m_globalRefills(0),
+		  m_fallbacks(0),
+		  m_chunkCount(0),
+		  m_capacity(0)
+	{
+	}
+
+	btScalar getHitRate() const
+	{
+		return m_allocations ? btScalar(m_localHits) / btScalar(m_allocations) : btScalar(1);
+	}
+};
+
+///The btPoolAllocatorMt class is a growable pool of fixed-size elements with a free list per thread.
+///Allocating and freeing only touch the calling thread's list; a thread that runs dry takes a whole batch
+///from the shared pool, and one that collects too many frees hands a batch back, so the shared lock is
+///taken once per batch. The pool grows by chunks when the shared pool is empty and never shrinks.
+///Elements may be freed by another thread than the one that allocated them.
+class btPoolAllocatorMt
+{
+public:
+	btPoolAllocatorMt(int elemSize, int firstChunkSize = 256, int maxChunkSize = 8192);
+
+	~btPoolAllocatorMt();
+
+	///returns 16-byte aligned memory; requests larger than the element size fall back to btAlignedAlloc
+	void* allocate(int size);
+
+	void freeMemory(void* ptr);
+
+	int getElementSize() const
+	{
+		return m_elemSize;
+	}
+
+	///stops the pool from growing past maxElements elements, allocate then returns NULL once none is free;
+	///elements sitting in another thread's free list are not reachable. 0 removes the limit
+	void setMaxElements(int maxElements);
+
+	int getMaxElements() const
+	{
+		return m_maxElements;
+	}
+
+	///only meaningful while no other thread uses the pool
+	void getStats(btPoolAllocatorMtStats& stats) const;
+
+private:
+	enum
+	{
+		BATCH_SIZE = 32,
+		HEADER_SIZE = 16  // keeps elements 16-byte aligned
+	};
+
+	struct FreeElement
+	{
+		FreeElement* m_next;
+		FreeElement* m_nextBatch;
+	};
+
+	struct ThreadCache
+	{
+		FreeElement* m_firstFree;
+		int m_freeCount;
+		unsigned long long m_allocations;
+		unsigned long long m_frees;
+		unsigned long long m_localHits;
+		unsigned long long m_globalRefills;
+		unsigned long long m_fallbacks;
+		char m_antiFalseSharingPadding[64];  // neighbouring caches never share a cache line
+	};
+
+	FreeElement* takeBatch();
+
+	void giveBatch(ThreadCache& cache, int count);
+
+	int m_elemSize;    // usable bytes per element
+	int m_elemStride;  // header plus element, a multiple of 16
+	int m_nextChunkSize;
+	int m_maxChunkSize;
+	int m_capacity;
+	int m_maxElements;  // 0 when the pool may grow without limit
+
+	btSpinMutex m_mutex;  // guards the members below
+	FreeElement* m_batches;
+	btAlignedObjectArray<void*> m_chunks;
+
+	ThreadCache m_threadCaches[BT_MAX_THREAD_COUNT];
+};
+
+#endif  //_BT_POOL_ALLOCATOR_MT_H
@@ -547,6 +547,14 @@ CProfileIterator* CProfileManager::Get_Iterator(void)
 	return new CProfileIterator(&gRoots[threadIndex]);
 }
 
+CProfileIterator* CProfileManager::Get_Iterator(int threadIndex)
+{
+	if ((threadIndex < 0) || threadIndex >= int(BT_QUICKPROF_MAX_THREAD_COUNT))
+		return 0;
+
+	return new CProfileIterator(&gRoots[threadIndex]);
+}
+
 void CProfileManager::CleanupMemory(void)
 {
 	for (int i = 0; i < BT_QUICKPROF_MAX_THREAD_COUNT; i++)
@@ -616,6 +624,18 @@ void CProfileManager::Reset(void)
 	Profile_Get_Ticks(&ResetTime);
 }
 
+/***********************************************************************************************
+ * CProfileManager::Reset_Thread -- Reset the timing data of one thread                        *
+ *                                                                                             *
+ *    Unlike Reset, the clock is left alone, so the other threads' open zones stay valid.      *
+ *=============================================================================================*/
+void CProfileManager::Reset_Thread(int threadIndex)
+{
+	if ((threadIndex < 0) || threadIndex >= int(BT_QUICKPROF_MAX_THREAD_COUNT))
+		return;
+	gRoots[threadIndex].Reset();
+}
+
 /***********************************************************************************************
  * CProfileManager::Increment_Frame_Counter -- Increment the frame counter                    *
  *=============================================================================================*/
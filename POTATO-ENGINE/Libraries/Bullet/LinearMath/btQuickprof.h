@@ -163,6 +163,7 @@ public:
 	//	}
 
 	static void Reset(void);
+	static void Reset_Thread(int threadIndex);  // clear the totals of one thread's tree, the clock keeps running
 	static void Increment_Frame_Counter(void);
 	static int Get_Frame_Count_Since_Reset(void) { return FrameCounter; }
 	static float Get_Time_Since_Reset(void);
@@ -172,6 +173,7 @@ public:
 	//
 	//		return new CProfileIterator( &Root );
 	//	}
+	static CProfileIterator* Get_Iterator(int threadIndex);  // tree of any thread, only walk it while that thread is idle
 	static void Release_Iterator(CProfileIterator* iterator) { delete (iterator); }
 
 	static void dumpRecursive(CProfileIterator* profileIterator, int spacing);
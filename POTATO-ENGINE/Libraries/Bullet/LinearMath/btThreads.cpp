@@ -333,6 +333,16 @@ void btResetThreadIndexCounter()
 	gThreadCounter.mCounter = 0;
 }
 
+void btReleaseMainThreadIndex()
+{
+	// for when the main thread is about to exit after all worker threads were destroyed,
+	// it must not call into Bullet again since it keeps thread-index 0
+	btAssert(btIsMainThread());
+	btAssert(gBtTaskScheduler == NULL);
+	gThreadCounter.mCounter = 0;
+	--gThreadCounter.mCounter;  // next count should come back 0
+}
+
 btITaskScheduler::btITaskScheduler(const char* name)
 {
 	m_name = name;
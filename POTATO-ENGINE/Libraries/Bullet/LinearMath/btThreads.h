@@ -33,8 +33,11 @@ const unsigned int BT_MAX_THREAD_COUNT = 64;  // only if BT_THREADSAFE is 1
 // for internal use only
 bool btIsMainThread();
 bool btThreadsAreRunning();
+void btPushThreadsAreRunning();
+void btPopThreadsAreRunning();
 unsigned int btGetCurrentThreadIndex();
 void btResetThreadIndexCounter();  // notify that all worker threads have been destroyed
+void btReleaseMainThreadIndex();  // notify that the main thread is exiting, the next thread to use Bullet becomes thread 0
 
 ///
 /// btSpinMutex -- lightweight spin-mutex implemented with atomic ops, never puts
@@ -157,6 +160,9 @@ btITaskScheduler* btGetSequentialTaskScheduler();
 // create a default task scheduler (Win32 or pthreads based)
 btITaskScheduler* btCreateDefaultTaskScheduler();
 
+// create a work-stealing task scheduler (per-thread deques, needs C++11; otherwise returns null)
+btITaskScheduler* btCreateWorkStealingTaskScheduler();
+
 // get OpenMP task scheduler (if available, otherwise returns null)
 btITaskScheduler* btGetOpenMPTaskScheduler();
 
@@ -0,0 +1,241 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btBulletCollisionCommon.h"
+#include "BulletCollision/CollisionDispatch/btBatchedNarrowphase.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "btUnitTest.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+typedef std::pair<int, int> btTestIndexPair;
+
+///contacts of a manifold, seen from the object with the smaller user index
+struct btTestManifold
+{
+	int m_numContacts;
+	btScalar m_distances[MANIFOLD_CACHE_SIZE];
+	btVector3 m_normals[MANIFOLD_CACHE_SIZE];
+	btVector3 m_points[MANIFOLD_CACHE_SIZE];
+};
+
+typedef std::map<btTestIndexPair, btTestManifold> btTestManifolds;
+
+static btTestManifolds collectManifolds(btCollisionDispatcher& dispatcher)
+{
+	btTestManifolds manifolds;
+	for (int k = 0; k < dispatcher.getNumManifolds(); ++k)
+	{
+		const btPersistentManifold* manifold = dispatcher.getManifoldByIndexInternal(k);
+		const int index0 = manifold->getBody0()->getUserIndex();
+		const int index1 = manifold->getBody1()->getUserIndex();
+		const bool swapped = index1 < index0;
+		btTestManifold& result = manifolds[swapped ? btTestIndexPair(index1, index0) : btTestIndexPair(index0, index1)];
+		result.m_numContacts = manifold->getNumContacts();
+		for (int i = 0; i < result.m_numContacts; ++i)
+		{
+			const btManifoldPoint& point = manifold->getContactPoint(i);
+			result.m_distances[i] = point.getDistance();
+			result.m_normals[i] = swapped ? -point.m_normalWorldOnB : point.m_normalWorldOnB;
+			result.m_points[i] = swapped ? point.getPositionWorldOnB() : point.getPositionWorldOnA();
+		}
+	}
+	return manifolds;
+}
+
+///the same objects in two collision worlds, one with the default dispatch and one with the batched narrowphase
+struct btNarrowphaseScene
+{
+	btDefaultCollisionConfiguration m_configuration;
+	btCollisionDispatcherMt m_defaultDispatcher;
+	btCollisionDispatcherMt m_batchedDispatcher;
+	btDbvtBroadphase m_broadphases[2];
+	btCollisionWorld* m_worlds[2];
+	btSphereShape m_sphere;
+	btBoxShape m_box;
+	btCapsuleShape m_capsule;
+	btConvexHullShape m_hull;
+	btStaticPlaneShape m_plane;
+	std::vector<btCollisionObject*> m_objects[2];
+	std::vector<btTransform> m_transforms;
+	btTestRandom m_random;
+
+	btNarrowphaseScene()
+		: m_defaultDispatcher(&m_configuration),
+		  m_batchedDispatcher(&m_configuration),
+		  m_sphere(btScalar(0.5)),
+		  m_box(btVector3(btScalar(0.4), btScalar(0.5), btScalar(0.45))),
+		  m_capsule(btScalar(0.3), btScalar(0.8)),
+		  m_plane(btVector3(0, 1, btScalar(0.1)).normalized(), btScalar(-0.5)),
+		  m_random(3)
+	{
+		m_batchedDispatcher.setBatchedNarrowphase(true);
+		btCollisionDispatcher* dispatchers[2] = {&m_defaultDispatcher, &m_batchedDispatcher};
+		for (int w = 0; w < 2; ++w)
+		{
+			m_worlds[w] = new btCollisionWorld(dispatchers[w], &m_broadphases[w], &m_configuration);
+		}
+		for (int i = 0; i < 8; ++i)
+		{
+			m_hull.addPoint(btVector3(i & 1 ? btScalar(0.45) : btScalar(-0.45), i & 2 ? btScalar(0.4) : btScalar(-0.4), i & 4 ? btScalar(0.35) : btScalar(-0.35)));
+		}
+
+		// shallow contacts only: deep inside a box, the face a sphere is pushed out of is a tie broken differently by the kernel
+		btCollisionShape* shapes[] = {&m_sphere, &m_box, &m_capsule, &m_hull, &m_sphere, &m_box};
+		for (int x = 0; x < 10; ++x)
+		{
+			for (int y = 0; y < 3; ++y)
+			{
+				for (int z = 0; z < 10; ++z)
+				{
+					btTransform transform;
+					transform.setIdentity();
+					transform.setOrigin(btVector3(btScalar(x), btScalar(y), btScalar(z)) * btScalar(0.92) + jitter(btScalar(0.05)));
+					transform.setRotation(btQuaternion(btVector3(0, 1, 0), m_random.nextFloat() * btScalar(0.3)));
+					addObject(shapes[(x + y * 3 + z * 7) % 6], transform);
+				}
+			}
+		}
+		btTransform ground;
+		ground.setIdentity();
+		addObject(&m_plane, ground);
+	}
+
+	~btNarrowphaseScene()
+	{
+		for (int w = 0; w < 2; ++w)
+		{
+			for (size_t i = 0; i < m_objects[w].size(); ++i)
+			{
+				m_worlds[w]->removeCollisionObject(m_objects[w][i]);
+				delete m_objects[w][i];
+			}
+			delete m_worlds[w];
+		}
+	}
+
+	btVector3 jitter(btScalar size)
+	{
+		return btVector3(m_random.nextFloat() - btScalar(0.5), m_random.nextFloat() - btScalar(0.5), m_random.nextFloat() - btScalar(0.5)) * (2 * size);
+	}
+
+	void addObject(btCollisionShape* shape, const btTransform& transform)
+	{
+		for (int w = 0; w < 2; ++w)
+		{
+			btCollisionObject* object = new btCollisionObject();
+			object->setCollisionShape(shape);
+			object->setWorldTransform(transform);
+			object->setUserIndex(int(m_transforms.size()));
+			m_worlds[w]->addCollisionObject(object);
+			m_objects[w].push_back(object);
+		}
+		m_transforms.push_back(transform);
+	}
+
+	///every object but the plane takes a small step, the same in both worlds
+	void moveObjects()
+	{
+		for (size_t i = 0; i + 1 < m_transforms.size(); ++i)
+		{
+			m_transforms[i].setOrigin(m_transforms[i].getOrigin() + jitter(btScalar(0.01)));
+			m_transforms[i].setRotation(m_transforms[i].getRotation() * btQuaternion(btVector3(0, 1, 0), btScalar(0.02)));
+			m_objects[0][i]->setWorldTransform(m_transforms[i]);
+			m_objects[1][i]->setWorldTransform(m_transforms[i]);
+		}
+	}
+
+	int getKernel(const btTestIndexPair& pair) const
+	{
+		return btBatchedNarrowphase::getKernel(m_objects[0][pair.first]->getCollisionShape()->getShapeType(), m_objects[0][pair.second]->getCollisionShape()->getShapeType());
+	}
+};
+
+///the batched narrowphase gives every pair the manifold the default dispatch gives it
+static void testAgainstDefaultDispatch()
+{
+	// the kernels round differently, most visibly in the normal of a sphere near a box edge
+	const btScalar tolerance = btScalar(1e-3);
+	btNarrowphaseScene scene;
+	int kernelPairs[btBatchedNarrowphase::KERNEL_COUNT] = {0};
+	int mismatches[btBatchedNarrowphase::KERNEL_COUNT] = {0};
+	int touching = 0;
+	for (int frame = 0; frame < 30; ++frame)
+	{
+		scene.moveObjects();
+		scene.m_worlds[0]->performDiscreteCollisionDetection();
+		scene.m_worlds[1]->performDiscreteCollisionDetection();
+		const btTestManifolds expected = collectManifolds(scene.m_defaultDispatcher);
+		const btTestManifolds batched = collectManifolds(scene.m_batchedDispatcher);
+		BT_CHECK(expected.size() == batched.size());
+
+		for (btTestManifolds::const_iterator it = expected.begin(); it != expected.end(); ++it)
+		{
+			const int kernel = scene.getKernel(it->first);
+			btTestManifolds::const_iterator found = batched.find(it->first);
+			if (found == batched.end() || found->second.m_numContacts != it->second.m_numContacts)
+			{
+				mismatches[kernel]++;
+				continue;
+			}
+			for (int i = 0; i < it->second.m_numContacts; ++i)
+			{
+				const bool same = btFabs(it->second.m_distances[i] - found->second.m_distances[i]) < tolerance &&
+								  (it->second.m_normals[i] - found->second.m_normals[i]).length() < tolerance &&
+								  (it->second.m_points[i] - found->second.m_points[i]).length() < tolerance;
+				mismatches[kernel] += same ? 0 : 1;
+			}
+		}
+
+		const btBatchedNarrowphase& narrowphase = scene.m_batchedDispatcher.getNarrowphaseBatches();
+		for (int k = 0; k < btBatchedNarrowphase::KERNEL_COUNT; ++k)
+		{
+			kernelPairs[k] += narrowphase.getNumPairs(k);
+		}
+		touching += narrowphase.getNumTestedPairsTouching();
+	}
+
+	for (int k = 0; k < btBatchedNarrowphase::KERNEL_COUNT; ++k)
+	{
+		BT_CHECK(kernelPairs[k] > 0);
+		BT_CHECK(mismatches[k] == 0);
+		if (mismatches[k])
+		{
+			printf("kernel %d: %d pairs, %d mismatches\n", k, kernelPairs[k], mismatches[k]);
+		}
+	}
+	// the separation test lets some box pairs through, and rejects others
+	BT_CHECK(touching > 0);
+	BT_CHECK(touching < kernelPairs[btBatchedNarrowphase::KERNEL_BOX_BOX] + kernelPairs[btBatchedNarrowphase::KERNEL_BOX_PLANE]);
+}
+
+int main()
+{
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	testAgainstDefaultDispatch();
+
+	btITaskScheduler* scheduler = btCreateDefaultTaskScheduler();
+	if (scheduler)
+	{
+		scheduler->setNumThreads(scheduler->getMaxNumThreads());
+		btSetTaskScheduler(scheduler);
+		testAgainstDefaultDispatch();
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
+		delete scheduler;
+	}
+	return btReportTest("btBatchedNarrowphaseTest");
+}
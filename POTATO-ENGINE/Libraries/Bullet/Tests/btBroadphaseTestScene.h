@@ -0,0 +1,195 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_BROADPHASE_TEST_SCENE_H
+#define BT_BROADPHASE_TEST_SCENE_H
+
+#include "BulletCollision/BroadphaseCollision/btBroadphaseInterface.h"
+#include "BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcher.h"
+#include "BulletCollision/CollisionDispatch/btDefaultCollisionConfiguration.h"
+#include "LinearMath/btAabbUtil2.h"
+#include "btUnitTest.h"
+
+#include <set>
+#include <utility>
+#include <vector>
+
+///pairs of box indices, smaller index first
+typedef std::set<std::pair<int, int> > btTestPairSet;
+
+///Random boxes in a broadphase under test, checked against a brute force test of every pair of boxes.
+///Every tenth box is in group 2 and does not collide with the rest of group 2, and every 200th box is
+///20 times larger, so the broadphases also see filtered pairs and boxes spanning much of the world.
+struct btBroadphaseTestScene
+{
+	btDefaultCollisionConfiguration m_configuration;
+	btCollisionDispatcher m_dispatcher;
+	btBroadphaseInterface* m_broadphase;
+	btTestRandom m_random;
+	btVector3 m_worldSize;
+	std::vector<btVector3> m_mins;
+	std::vector<btVector3> m_maxs;
+	///null once destroyed
+	std::vector<btBroadphaseProxy*> m_proxies;
+
+	btBroadphaseTestScene(btBroadphaseInterface* broadphase, unsigned int seed, const btVector3& worldSize)
+		: m_dispatcher(&m_configuration), m_broadphase(broadphase), m_random(seed), m_worldSize(worldSize)
+	{
+	}
+
+	~btBroadphaseTestScene()
+	{
+		destroyAll();
+	}
+
+	btVector3 randomPoint()
+	{
+		return btVector3(m_random.nextFloat() * m_worldSize.x(), m_random.nextFloat() * m_worldSize.y(), m_random.nextFloat() * m_worldSize.z());
+	}
+
+	void createBoxes(int count)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			const int index = int(m_proxies.size());
+			const btVector3 center = randomPoint();
+			btVector3 extent(m_random.nextFloat() * 2 + btScalar(0.1), m_random.nextFloat() * 2 + btScalar(0.1), m_random.nextFloat() * 2 + btScalar(0.1));
+			if (index % 200 == 0)
+			{
+				extent *= 20;
+			}
+			const int group = index % 10 == 0 ? 2 : 1;
+			const int mask = index % 10 == 0 ? ~2 : -1;
+			m_mins.push_back(center - extent);
+			m_maxs.push_back(center + extent);
+			m_proxies.push_back(m_broadphase->createProxy(m_mins[index], m_maxs[index], BOX_SHAPE_PROXYTYPE, (void*)(size_t)(index + 1), group, mask, &m_dispatcher));
+		}
+	}
+
+	///moves every box by up to distance along each axis, and every teleportStride-th box anywhere in the world
+	void moveBoxes(btScalar distance, int teleportStride)
+	{
+		for (size_t i = 0; i < m_proxies.size(); ++i)
+		{
+			if (!m_proxies[i])
+			{
+				continue;
+			}
+			btVector3 delta((m_random.nextFloat() - btScalar(0.5)) * 2 * distance, (m_random.nextFloat() - btScalar(0.5)) * 2 * distance, (m_random.nextFloat() - btScalar(0.5)) * 2 * distance);
+			if (teleportStride > 0 && m_random.next() % teleportStride == 0)
+			{
+				delta = randomPoint() - (m_mins[i] + m_maxs[i]) * btScalar(0.5);
+			}
+			m_mins[i] += delta;
+			m_maxs[i] += delta;
+			m_broadphase->setAabb(m_proxies[i], m_mins[i], m_maxs[i], &m_dispatcher);
+		}
+	}
+
+	void destroyBoxes(int stride)
+	{
+		for (size_t i = 0; i < m_proxies.size(); i += stride)
+		{
+			if (m_proxies[i])
+			{
+				m_broadphase->destroyProxy(m_proxies[i], &m_dispatcher);
+				m_proxies[i] = 0;
+			}
+		}
+	}
+
+	void destroyAll()
+	{
+		destroyBoxes(1);
+	}
+
+	void calculateOverlappingPairs()
+	{
+		m_broadphase->calculateOverlappingPairs(&m_dispatcher);
+	}
+
+	static int boxIndex(const btBroadphaseProxy* proxy)
+	{
+		return int((size_t)proxy->m_clientObject) - 1;
+	}
+
+	///pairs of live boxes that pass the filters and whose bounds overlap, testing every pair
+	btTestPairSet overlappingBoxPairs(const std::vector<btVector3>& mins, const std::vector<btVector3>& maxs) const
+	{
+		btTestPairSet pairs;
+		for (size_t i = 0; i < m_proxies.size(); ++i)
+		{
+			const btBroadphaseProxy* a = m_proxies[i];
+			if (!a)
+			{
+				continue;
+			}
+			for (size_t j = i + 1; j < m_proxies.size(); ++j)
+			{
+				const btBroadphaseProxy* b = m_proxies[j];
+				if (!b || !(a->m_collisionFilterGroup & b->m_collisionFilterMask) || !(b->m_collisionFilterGroup & a->m_collisionFilterMask))
+				{
+					continue;
+				}
+				if (TestAabbAgainstAabb2(mins[i], maxs[i], mins[j], maxs[j]))
+				{
+					pairs.insert(std::make_pair(int(i), int(j)));
+				}
+			}
+		}
+		return pairs;
+	}
+
+	btTestPairSet overlappingBoxPairs() const
+	{
+		return overlappingBoxPairs(m_mins, m_maxs);
+	}
+
+	///the pairs in the broadphase's pair cache; counts duplicates and pairs findPair does not return
+	btTestPairSet cachedPairs(int& badEntries)
+	{
+		btOverlappingPairCache* cache = m_broadphase->getOverlappingPairCache();
+		btBroadphasePairArray& array = cache->getOverlappingPairArray();
+		btTestPairSet pairs;
+		for (int k = 0; k < array.size(); ++k)
+		{
+			const int a = boxIndex(array[k].m_pProxy0);
+			const int b = boxIndex(array[k].m_pProxy1);
+			if (!pairs.insert(std::make_pair(btMin(a, b), btMax(a, b))).second)
+			{
+				badEntries++;
+			}
+			if (cache->findPair(array[k].m_pProxy1, array[k].m_pProxy0) != &array[k])
+			{
+				badEntries++;
+			}
+		}
+		return pairs;
+	}
+};
+
+///number of pairs of subset missing from superset
+static inline int btCountMissingPairs(const btTestPairSet& subset, const btTestPairSet& superset)
+{
+	int missing = 0;
+	for (btTestPairSet::const_iterator it = subset.begin(); it != subset.end(); ++it)
+	{
+		missing += superset.count(*it) == 0;
+	}
+	return missing;
+}
+
+#endif  //BT_BROADPHASE_TEST_SCENE_H
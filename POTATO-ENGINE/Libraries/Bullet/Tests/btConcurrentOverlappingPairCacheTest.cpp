@@ -0,0 +1,266 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "BulletCollision/BroadphaseCollision/btConcurrentOverlappingPairCache.h"
+#include "BulletCollision/BroadphaseCollision/btGridBroadphaseMt.h"
+#include "BulletCollision/BroadphaseCollision/btSapBroadphaseMt.h"
+#include "btBroadphaseTestScene.h"
+#include "btUnitTest.h"
+
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+static const int gNumProxies = 5000;
+static const int gNumAdds = 200000;
+
+typedef std::pair<int, int> btTestUidPair;
+
+struct btTestGhostPairCounter : public btOverlappingPairCallback
+{
+	int m_numPairs;
+
+	btTestGhostPairCounter() : m_numPairs(0) {}
+
+	virtual btBroadphasePair* addOverlappingPair(btBroadphaseProxy*, btBroadphaseProxy*) BT_OVERRIDE
+	{
+		m_numPairs++;
+		return 0;
+	}
+	virtual void* removeOverlappingPair(btBroadphaseProxy*, btBroadphaseProxy*, btDispatcher*) BT_OVERRIDE
+	{
+		m_numPairs--;
+		return 0;
+	}
+	virtual void removeOverlappingPairsContainingProxy(btBroadphaseProxy*, btDispatcher*) BT_OVERRIDE {}
+};
+
+///proxies of the i-th add; many adds repeat a pair, in either order
+static void getAddProxies(int i, int& a, int& b)
+{
+	const unsigned int hash = unsigned(i) * 2654435761u;
+	a = (hash >> 8) % gNumProxies;
+	b = (hash >> 3) % gNumProxies;
+}
+
+///adds the pairs from numThreads threads at once, each also looking up the pairs it added;
+///pairs that did not fit in the reserved room cannot be found before endConcurrentInsertion
+static void addConcurrently(btConcurrentOverlappingPairCache& cache, std::vector<btBroadphaseProxy>& proxies, int numThreads, int reserve, bool hasRoom)
+{
+	cache.beginConcurrentInsertion(reserve);
+	BT_CHECK(cache.isInConcurrentInsertion());
+
+	std::vector<int> missing(numThreads, 0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < numThreads; ++t)
+	{
+		threads.emplace_back([&, t]() {
+			for (int i = t; i < gNumAdds; i += numThreads)
+			{
+				int a, b;
+				getAddProxies(i, a, b);
+				if (a == b)
+				{
+					continue;
+				}
+				cache.addOverlappingPair(&proxies[a], &proxies[b]);
+				if (!cache.findPair(&proxies[b], &proxies[a]))
+				{
+					missing[t]++;
+				}
+			}
+		});
+	}
+	for (int t = 0; t < numThreads; ++t)
+	{
+		threads[t].join();
+		BT_CHECK(!hasRoom || missing[t] == 0);
+	}
+
+	cache.endConcurrentInsertion();
+	BT_CHECK(!cache.isInConcurrentInsertion());
+}
+
+///checks the cache holds exactly the expected pairs, sorted by uids, and finds each of them
+static void checkPairs(btConcurrentOverlappingPairCache& cache, const std::set<btTestUidPair>& expected)
+{
+	btBroadphasePairArray& pairs = cache.getOverlappingPairArray();
+	BT_CHECK(cache.getNumOverlappingPairs() == int(expected.size()));
+	BT_CHECK(pairs.size() == int(expected.size()));
+
+	std::set<btTestUidPair> found;
+	int notFound = 0;
+	for (int i = 0; i < pairs.size(); ++i)
+	{
+		found.insert(btTestUidPair(pairs[i].m_pProxy0->getUid(), pairs[i].m_pProxy1->getUid()));
+		notFound += cache.findPair(pairs[i].m_pProxy1, pairs[i].m_pProxy0) != &pairs[i] ? 1 : 0;
+	}
+	BT_CHECK(found == expected);
+	BT_CHECK(notFound == 0);
+}
+
+static void getPairUids(btConcurrentOverlappingPairCache& cache, std::vector<btTestUidPair>& uids)
+{
+	btBroadphasePairArray& pairs = cache.getOverlappingPairArray();
+	uids.clear();
+	for (int i = 0; i < pairs.size(); ++i)
+	{
+		uids.push_back(btTestUidPair(pairs[i].m_pProxy0->getUid(), pairs[i].m_pProxy1->getUid()));
+	}
+}
+
+static void testConcurrentInsertion(int numThreads, std::vector<btTestUidPair>& order)
+{
+	std::vector<btBroadphaseProxy> proxies(gNumProxies);
+	for (int i = 0; i < gNumProxies; ++i)
+	{
+		proxies[i].m_uniqueId = i + 2;
+		proxies[i].m_collisionFilterGroup = 1;
+		proxies[i].m_collisionFilterMask = -1;
+	}
+
+	std::set<btTestUidPair> expected;
+	for (int i = 0; i < gNumAdds; ++i)
+	{
+		int a, b;
+		getAddProxies(i, a, b);
+		if (a != b)
+		{
+			expected.insert(btTestUidPair(btMin(a, b) + 2, btMax(a, b) + 2));
+		}
+	}
+
+	btConcurrentOverlappingPairCache cache;
+	cache.setDeterministicOrder(true);
+	btTestGhostPairCounter ghost;
+	cache.setInternalGhostPairCallback(&ghost);
+
+	// far too little room: most pairs are kept aside and inserted at the end
+	addConcurrently(cache, proxies, numThreads, 100, false);
+	checkPairs(cache, expected);
+	BT_CHECK(cache.getNumNewPairs() == int(expected.size()));
+	BT_CHECK(ghost.m_numPairs == int(expected.size()));
+	getPairUids(cache, order);
+
+	btBroadphasePairArray& pairs = cache.getOverlappingPairArray();
+	int unsorted = 0;
+	for (int i = 1; i < pairs.size(); ++i)
+	{
+		const btTestUidPair previous(pairs[i - 1].m_pProxy0->getUid(), pairs[i - 1].m_pProxy1->getUid());
+		const btTestUidPair current(pairs[i].m_pProxy0->getUid(), pairs[i].m_pProxy1->getUid());
+		unsorted += previous < current ? 0 : 1;
+	}
+	BT_CHECK(unsorted == 0);
+
+	// adding the same pairs again creates none
+	addConcurrently(cache, proxies, numThreads, cache.getNumNewPairs() * 2, true);
+	BT_CHECK(cache.getNumNewPairs() == 0);
+	checkPairs(cache, expected);
+
+	// remove every other pair outside of the concurrent phase, then add them back with room to spare
+	for (int i = pairs.size() - 1; i >= 0; i -= 2)
+	{
+		const btTestUidPair uids(pairs[i].m_pProxy0->getUid(), pairs[i].m_pProxy1->getUid());
+		cache.removeOverlappingPair(pairs[i].m_pProxy0, pairs[i].m_pProxy1, 0);
+		expected.erase(uids);
+	}
+	checkPairs(cache, expected);
+	BT_CHECK(ghost.m_numPairs == int(expected.size()));
+
+	const int numKept = int(expected.size());
+	addConcurrently(cache, proxies, numThreads, gNumAdds, true);
+	BT_CHECK(cache.getNumNewPairs() == int(order.size()) - numKept);
+	BT_CHECK(cache.getNumOverlappingPairs() == int(order.size()));
+	BT_CHECK(ghost.m_numPairs == int(order.size()));
+
+	for (int i = 0; i < gNumProxies; ++i)
+	{
+		cache.removeOverlappingPairsContainingProxy(&proxies[i], 0);
+	}
+	BT_CHECK(cache.getNumOverlappingPairs() == 0);
+	BT_CHECK(ghost.m_numPairs == 0);
+}
+
+///the broadphase tasks add their pairs to the cache in parallel: the pairs are still the overlapping pairs of boxes,
+///and with a deterministic order the pair array does not depend on the task scheduler
+static void checkBroadphase(bool grid, std::vector<std::vector<btTestUidPair> >& order)
+{
+	btConcurrentOverlappingPairCache cache;
+	cache.setDeterministicOrder(true);
+	btSapBroadphaseMt sap(&cache);
+	btGridBroadphaseMt gridBroadphase(&cache);
+	btBroadphaseInterface* broadphase = grid ? static_cast<btBroadphaseInterface*>(&gridBroadphase) : &sap;
+	sap.setTaskCount(16);
+	gridBroadphase.setTaskCount(16);
+
+	btBroadphaseTestScene scene(broadphase, 29, btVector3(80, 80, 30));
+	scene.createBoxes(1500);
+	order.clear();
+	for (int frame = 0; frame < 8; ++frame)
+	{
+		if (frame == 4)
+		{
+			scene.destroyBoxes(5);
+			scene.createBoxes(200);
+		}
+		scene.moveBoxes(btScalar(0.3), frame % 3 == 0 ? 50 : 0);
+		scene.calculateOverlappingPairs();
+
+		int badEntries = 0;
+		const btTestPairSet cached = scene.cachedPairs(badEntries);
+		BT_CHECK(badEntries == 0);
+		BT_CHECK(cached == scene.overlappingBoxPairs());
+		order.push_back(std::vector<btTestUidPair>());
+		getPairUids(cache, order.back());
+	}
+	scene.destroyAll();
+	BT_CHECK(cache.getNumOverlappingPairs() == 0);
+}
+
+static void testBroadphases()
+{
+	for (int grid = 0; grid < 2; ++grid)
+	{
+		std::vector<std::vector<btTestUidPair> > sequentialOrder;
+		checkBroadphase(grid != 0, sequentialOrder);
+
+		btITaskScheduler* scheduler = btCreateDefaultTaskScheduler();
+		if (scheduler)
+		{
+			scheduler->setNumThreads(scheduler->getMaxNumThreads());
+			btSetTaskScheduler(scheduler);
+			std::vector<std::vector<btTestUidPair> > parallelOrder;
+			checkBroadphase(grid != 0, parallelOrder);
+			BT_CHECK(parallelOrder == sequentialOrder);
+			btSetTaskScheduler(btGetSequentialTaskScheduler());
+			delete scheduler;
+		}
+	}
+}
+
+int main()
+{
+	// endConcurrentInsertion runs on the task scheduler; the insertion itself is driven by std::thread below
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+
+	std::vector<btTestUidPair> order1, order4;
+	testConcurrentInsertion(1, order1);
+	testConcurrentInsertion(4, order4);
+	// with a deterministic order the pairs do not depend on the threads that added them
+	BT_CHECK(order1 == order4);
+	testBroadphases();
+	return btReportTest("btConcurrentOverlappingPairCacheTest");
+}
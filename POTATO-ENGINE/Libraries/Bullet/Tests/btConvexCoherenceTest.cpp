@@ -0,0 +1,108 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/CollisionDispatch/btConvexConvexAlgorithm.h"
+#include "btUnitTest.h"
+
+#include <vector>
+
+///steps a pile of boxes, hulls and spheres and returns their transforms
+static void simulate(bool enableCoherence, bool enableSat, std::vector<btTransform>& transforms, btConvexCoherenceStats& stats)
+{
+	btDefaultCollisionConfiguration configuration;
+	btCollisionDispatcher dispatcher(&configuration);
+	btDbvtBroadphase broadphase;
+	btSequentialImpulseConstraintSolver solver;
+	btDiscreteDynamicsWorld world(&dispatcher, &broadphase, &solver, &configuration);
+	world.setGravity(btVector3(0, -10, 0));
+	world.getDispatchInfo().m_enableConvexCoherence = enableCoherence;
+	world.getDispatchInfo().m_convexCoherenceContactMotion = 0;  // exact: cached results are only reused when nothing moved
+	world.getDispatchInfo().m_enableSatConvex = enableSat;
+
+	btBoxShape groundShape(btVector3(40, 1, 40));
+	btRigidBody::btRigidBodyConstructionInfo groundInfo(0, 0, &groundShape);
+	groundInfo.m_startWorldTransform.setOrigin(btVector3(0, -1, 0));
+	btRigidBody ground(groundInfo);
+	world.addRigidBody(&ground);
+
+	btTestRandom random(7);
+	btBoxShape boxShape(btVector3(.5, .5, .5));
+	btConvexHullShape hullShape;
+	for (int i = 0; i < 24; ++i)
+	{
+		btVector3 point(random.nextFloat() * 2 - 1, random.nextFloat() * 2 - 1, random.nextFloat() * 2 - 1);
+		hullShape.addPoint(point.normalized() * btScalar(0.6), false);
+	}
+	hullShape.recalcLocalAabb();
+	hullShape.initializePolyhedralFeatures();
+	if (enableSat)
+	{
+		boxShape.initializePolyhedralFeatures();
+	}
+	btSphereShape sphereShape(btScalar(0.4));
+	btCollisionShape* shapes[3] = {&boxShape, &hullShape, &sphereShape};
+
+	std::vector<btRigidBody*> bodies;
+	for (int i = 0; i < 200; ++i)
+	{
+		btCollisionShape* shape = shapes[i % 3];
+		btVector3 inertia;
+		shape->calculateLocalInertia(1, inertia);
+		btRigidBody::btRigidBodyConstructionInfo info(1, 0, shape, inertia);
+		info.m_startWorldTransform.setOrigin(btVector3((i % 10) * 2.2f - 11, 0.7f + (i / 100) * 1.6f, ((i / 10) % 10) * 2.2f - 11));
+		btRigidBody* body = new btRigidBody(info);
+		body->setLinearVelocity(btVector3(random.nextFloat() - 0.5f, 0, random.nextFloat() - 0.5f));
+		world.addRigidBody(body);
+		bodies.push_back(body);
+	}
+
+	btConvexConvexAlgorithm::resetCoherenceStats();
+	for (int step = 0; step < 240; ++step)
+	{
+		world.stepSimulation(btScalar(1. / 60.), 1, btScalar(1. / 60.));
+	}
+	btConvexConvexAlgorithm::getCoherenceStats(stats);
+
+	transforms.clear();
+	for (size_t i = 0; i < bodies.size(); ++i)
+	{
+		transforms.push_back(bodies[i]->getWorldTransform());
+		world.removeRigidBody(bodies[i]);
+		delete bodies[i];
+	}
+	world.removeRigidBody(&ground);
+}
+
+int main()
+{
+	for (int sat = 0; sat < 2; ++sat)
+	{
+		std::vector<btTransform> reference, coherent;
+		btConvexCoherenceStats referenceStats, coherentStats;
+		simulate(false, sat != 0, reference, referenceStats);
+		simulate(true, sat != 0, coherent, coherentStats);
+
+		// without contact motion tolerance the cache must not change a single bit of the simulation
+		BT_CHECK(!reference.empty());
+		BT_CHECK(btCountDifferentTransforms(reference, coherent) == 0);
+
+		BT_CHECK(referenceStats.m_queries == 0);
+		BT_CHECK(coherentStats.m_queries > 0);
+		BT_CHECK(coherentStats.m_separatedSkips + coherentStats.m_contactRefreshes > 0);
+		BT_CHECK(coherentStats.getHitRate() > 0);
+	}
+	return btReportTest("btConvexCoherenceTest");
+}
@@ -0,0 +1,246 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "BulletCollision/BroadphaseCollision/btDbvtBroadphaseMt.h"
+#include "LinearMath/btThreads.h"
+#include "btBroadphaseTestScene.h"
+
+static const btVector3 gWorldSize(80, 80, 30);
+
+///the tree leaves are padded, so the broadphase may report boxes that are close without touching:
+///the pairs must contain every overlapping pair of boxes, and only pairs whose leaf volumes overlap
+static void checkPairs(btBroadphaseTestScene& scene, int frame)
+{
+	std::vector<btVector3> leafMins(scene.m_proxies.size());
+	std::vector<btVector3> leafMaxs(scene.m_proxies.size());
+	for (size_t i = 0; i < scene.m_proxies.size(); ++i)
+	{
+		if (scene.m_proxies[i])
+		{
+			const btDbvtVolume& volume = static_cast<btDbvtProxy*>(scene.m_proxies[i])->leaf->volume;
+			leafMins[i] = volume.Mins();
+			leafMaxs[i] = volume.Maxs();
+		}
+	}
+
+	int badEntries = 0;
+	const btTestPairSet cached = scene.cachedPairs(badEntries);
+	const int missing = btCountMissingPairs(scene.overlappingBoxPairs(), cached);
+	const int extra = btCountMissingPairs(cached, scene.overlappingBoxPairs(leafMins, leafMaxs));
+	BT_CHECK(badEntries == 0);
+	BT_CHECK(missing == 0);
+	BT_CHECK(extra == 0);
+	if (badEntries || missing || extra)
+	{
+		printf("frame %d: %d pairs, %d missing, %d extra, %d bad entries\n", frame, int(cached.size()), missing, extra, badEntries);
+	}
+}
+
+struct btTreeStats
+{
+	int m_numLeaves;
+	int m_badLinks;    // children whose parent is not the node above them
+	int m_badVolumes;  // volumes that do not hold a child, or that are not the merge of their children when tight
+	std::set<btDbvtNode*> m_nodes;
+	std::vector<int> m_leafOrder;  // box indices of the leaves from left to right
+};
+
+static void collectTree(btDbvtNode* node, bool tight, btTreeStats& stats)
+{
+	stats.m_nodes.insert(node);
+	if (node->isleaf())
+	{
+		stats.m_numLeaves++;
+		stats.m_leafOrder.push_back(btBroadphaseTestScene::boxIndex(static_cast<btDbvtProxy*>(node->data)));
+		return;
+	}
+	for (int i = 0; i < 2; ++i)
+	{
+		stats.m_badLinks += node->childs[i]->parent != node;
+		stats.m_badVolumes += !node->volume.Contain(node->childs[i]->volume);
+		collectTree(node->childs[i], tight, stats);
+	}
+	if (tight)
+	{
+		const btDbvtVolume& a = node->childs[0]->volume;
+		const btDbvtVolume& b = node->childs[1]->volume;
+		for (int k = 0; k < 3; ++k)
+		{
+			stats.m_badVolumes += node->volume.Mins()[k] != btMin(a.Mins()[k], b.Mins()[k]) || node->volume.Maxs()[k] != btMax(a.Maxs()[k], b.Maxs()[k]);
+		}
+	}
+}
+
+///a rebuilt tree holds the same leaves in the same nodes, and every volume is the merge of its children
+static btTreeStats checkTree(btDbvt& tree, bool tight)
+{
+	btTreeStats stats;
+	stats.m_numLeaves = 0;
+	stats.m_badLinks = 0;
+	stats.m_badVolumes = 0;
+	if (tree.m_root)
+	{
+		BT_CHECK(tree.m_root->parent == 0);
+		collectTree(tree.m_root, tight, stats);
+	}
+	BT_CHECK(stats.m_numLeaves == tree.m_leaves);
+	BT_CHECK(stats.m_badLinks == 0);
+	BT_CHECK(stats.m_badVolumes == 0);
+	return stats;
+}
+
+struct btCollectProxies : public btBroadphaseAabbCallback
+{
+	std::set<int> m_boxes;
+
+	virtual bool process(const btBroadphaseProxy* proxy) BT_OVERRIDE
+	{
+		m_boxes.insert(btBroadphaseTestScene::boxIndex(proxy));
+		return true;
+	}
+};
+
+///aabbTest between a setAabb and the next collide sees the moved boxes
+static void checkAabbTest(btBroadphaseTestScene& scene)
+{
+	const btVector3 center = gWorldSize * btScalar(0.5);
+	const btVector3 queryMin = center - btVector3(10, 10, 10);
+	const btVector3 queryMax = center + btVector3(10, 10, 10);
+
+	btCollectProxies callback;
+	scene.m_broadphase->aabbTest(queryMin, queryMax, callback);
+
+	int missing = 0;
+	for (size_t i = 0; i < scene.m_proxies.size(); ++i)
+	{
+		if (scene.m_proxies[i] && TestAabbAgainstAabb2(queryMin, queryMax, scene.m_mins[i], scene.m_maxs[i]))
+		{
+			missing += callback.m_boxes.count(int(i)) == 0;
+		}
+	}
+	BT_CHECK(missing == 0);
+	BT_CHECK(callback.m_boxes.size() > 0);
+}
+
+///rebuildThreshold 0 rebuilds the dynamic tree at every parallel collide
+static void testAgainstBruteForce(bool parallel, int taskCount, int rebuildThreshold)
+{
+	btDbvtBroadphaseMt broadphase;
+	broadphase.setParallelCollide(parallel);
+	broadphase.setTaskCount(taskCount);
+	broadphase.setRebuildThreshold(rebuildThreshold);
+	// check every pair at each collide, so pairs that stopped overlapping never linger
+	broadphase.m_cupdates = 100;
+
+	btBroadphaseTestScene scene(&broadphase, 7 + taskCount, gWorldSize);
+	scene.createBoxes(1500);
+	scene.calculateOverlappingPairs();
+	checkPairs(scene, -1);
+
+	for (int frame = 0; frame < 12; ++frame)
+	{
+		if (frame == 4)
+		{
+			scene.destroyBoxes(7);
+		}
+		if (frame == 6)
+		{
+			scene.createBoxes(300);
+		}
+		if (frame == 8)
+		{
+			// right after a collide every volume holds its children; the rebuild reuses the nodes and leaves the pairs alone
+			std::set<btDbvtNode*> nodes[2];
+			for (int i = 0; i < 2; ++i)
+			{
+				nodes[i] = checkTree(broadphase.m_sets[i], false).m_nodes;
+			}
+			broadphase.rebuildTrees();
+			for (int i = 0; i < 2; ++i)
+			{
+				BT_CHECK(checkTree(broadphase.m_sets[i], true).m_nodes == nodes[i]);
+			}
+		}
+		// every third frame teleports a few boxes, which reinserts their leaves
+		scene.moveBoxes(btScalar(0.3), frame % 3 == 0 ? 50 : 0);
+		if (frame == 10)
+		{
+			checkAabbTest(scene);
+		}
+		scene.calculateOverlappingPairs();
+		checkPairs(scene, frame);
+		checkTree(broadphase.m_sets[0], false);
+		checkTree(broadphase.m_sets[1], false);
+	}
+
+	// switching back to the serial collide keeps the pairs
+	broadphase.setParallelCollide(!parallel);
+	scene.moveBoxes(btScalar(0.3), 0);
+	scene.calculateOverlappingPairs();
+	checkPairs(scene, 12);
+
+	scene.destroyAll();
+	BT_CHECK(broadphase.getOverlappingPairCache()->getNumOverlappingPairs() == 0);
+}
+
+///leaf order of the rebuilt dynamic tree of the same scene, for a task count
+static std::vector<int> rebuiltLeafOrder(int taskCount)
+{
+	btDbvtBroadphaseMt broadphase;
+	broadphase.setTaskCount(taskCount);
+	btBroadphaseTestScene scene(&broadphase, 23, gWorldSize);
+	scene.createBoxes(2000);
+	scene.calculateOverlappingPairs();
+	scene.moveBoxes(btScalar(0.3), 10);
+	broadphase.rebuildTrees();
+	return checkTree(broadphase.m_sets[0], true).m_leafOrder;
+}
+
+///the rebuilt tree does not depend on the task count or the thread count
+static void testRebuildDeterminism(const std::vector<int>& reference)
+{
+	BT_CHECK(reference.size() > 1000);
+	BT_CHECK(rebuiltLeafOrder(1) == reference);
+	BT_CHECK(rebuiltLeafOrder(16) == reference);
+	BT_CHECK(rebuiltLeafOrder(64) == reference);
+}
+
+static void runAll(const std::vector<int>& leafOrder)
+{
+	testAgainstBruteForce(false, 1, 10);
+	testAgainstBruteForce(true, 1, 10);
+	testAgainstBruteForce(true, 16, 10);
+	testAgainstBruteForce(true, 64, 10);
+	testAgainstBruteForce(true, 16, 0);
+	testRebuildDeterminism(leafOrder);
+}
+
+int main()
+{
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	const std::vector<int> leafOrder = rebuiltLeafOrder(16);
+	runAll(leafOrder);
+
+	btITaskScheduler* scheduler = btCreateDefaultTaskScheduler();
+	if (scheduler)
+	{
+		scheduler->setNumThreads(scheduler->getMaxNumThreads());
+		btSetTaskScheduler(scheduler);
+		runAll(leafOrder);
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
+		delete scheduler;
+	}
+	return btReportTest("btDbvtBroadphaseMtTest");
+}
@@ -0,0 +1,199 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletDynamics/ConstraintSolver/btJacobiConstraintSolverMt.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "btUnitTest.h"
+
+///a block of boxes packed side by side on the ground, solved by the Jacobi solver
+struct btJacobiScene
+{
+	btDefaultCollisionConfiguration m_configuration;
+	btCollisionDispatcherMt m_dispatcher;
+	btDbvtBroadphase m_broadphase;
+	btConstraintSolverPoolMt m_solverPool;
+	btJacobiConstraintSolverMt m_solver;
+	btDiscreteDynamicsWorldMt m_world;
+	btBoxShape m_groundShape;
+	btBoxShape m_boxShape;
+	btAlignedObjectArray<btRigidBody*> m_bodies;
+	btAlignedObjectArray<btVector3> m_starts;
+	btAlignedObjectArray<btTypedConstraint*> m_joints;
+
+	btJacobiScene(int sizeX, int sizeZ, int height, int numIterations)
+		: m_dispatcher(&m_configuration),
+		  m_solverPool(1),
+		  m_world(&m_dispatcher, &m_broadphase, &m_solverPool, &m_solver, &m_configuration),
+		  m_groundShape(btVector3(100, 1, 100)),
+		  m_boxShape(btVector3(btScalar(0.5), btScalar(0.5), btScalar(0.5)))
+	{
+		m_world.setGravity(btVector3(0, -10, 0));
+		m_world.getSolverInfo().m_numIterations = numIterations;
+		addBody(&m_groundShape, 0, btVector3(0, -1, 0));
+		for (int x = 0; x < sizeX; ++x)
+		{
+			for (int z = 0; z < sizeZ; ++z)
+			{
+				for (int y = 0; y < height; ++y)
+				{
+					addBody(&m_boxShape, 1, btVector3(btScalar(x), btScalar(y) + btScalar(0.5), btScalar(z)));
+				}
+			}
+		}
+	}
+
+	~btJacobiScene()
+	{
+		for (int i = 0; i < m_joints.size(); ++i)
+		{
+			m_world.removeConstraint(m_joints[i]);
+			delete m_joints[i];
+		}
+		for (int i = 0; i < m_bodies.size(); ++i)
+		{
+			m_world.removeRigidBody(m_bodies[i]);
+			delete m_bodies[i];
+		}
+	}
+
+	void addBody(btCollisionShape* shape, btScalar mass, const btVector3& origin)
+	{
+		btVector3 inertia(0, 0, 0);
+		if (mass > 0)
+		{
+			shape->calculateLocalInertia(mass, inertia);
+		}
+		btRigidBody::btRigidBodyConstructionInfo info(mass, 0, shape, inertia);
+		info.m_startWorldTransform.setIdentity();
+		info.m_startWorldTransform.setOrigin(origin);
+		info.m_friction = btScalar(0.7);
+		btRigidBody* body = new btRigidBody(info);
+		body->setActivationState(DISABLE_DEACTIVATION);
+		m_world.addRigidBody(body);
+		m_bodies.push_back(body);
+		m_starts.push_back(origin);
+	}
+
+	///joins two boxes at the middle of the face between them
+	void addJoint(int bodyA, int bodyB)
+	{
+		const btVector3 pivot = (m_starts[bodyA] + m_starts[bodyB]) * btScalar(0.5);
+		btPoint2PointConstraint* joint = new btPoint2PointConstraint(*m_bodies[bodyA], *m_bodies[bodyB], pivot - m_starts[bodyA], pivot - m_starts[bodyB]);
+		m_world.addConstraint(joint, true);
+		m_joints.push_back(joint);
+	}
+
+	void step(int steps)
+	{
+		for (int i = 0; i < steps; ++i)
+		{
+			m_world.stepSimulation(btScalar(1) / 60, 1, btScalar(1) / 60);
+		}
+	}
+
+	btScalar maxDrift() const
+	{
+		btScalar drift = 0;
+		for (int i = 1; i < m_bodies.size(); ++i)
+		{
+			drift = btMax(drift, (m_bodies[i]->getWorldTransform().getOrigin() - m_starts[i]).length());
+		}
+		return drift;
+	}
+
+	btScalar maxSpeed() const
+	{
+		btScalar speed = 0;
+		for (int i = 1; i < m_bodies.size(); ++i)
+		{
+			speed = btMax(speed, m_bodies[i]->getLinearVelocity().length());
+		}
+		return speed;
+	}
+
+	///largest distance between the two ends of a point to point joint
+	btScalar maxJointError() const
+	{
+		btScalar error = 0;
+		for (int i = 0; i < m_joints.size(); ++i)
+		{
+			const btPoint2PointConstraint* joint = static_cast<const btPoint2PointConstraint*>(m_joints[i]);
+			const btVector3 pivotA = joint->getRigidBodyA().getWorldTransform() * joint->getPivotInA();
+			const btVector3 pivotB = joint->getRigidBodyB().getWorldTransform() * joint->getPivotInB();
+			error = btMax(error, (pivotA - pivotB).length());
+		}
+		return error;
+	}
+};
+
+///a crowd of boxes on the ground: every manifold is a partition of its own, and the crowd rests as built
+static void testCrowd()
+{
+	btJacobiScene crowd(20, 20, 1, 10);
+	crowd.step(120);
+	const int numManifolds = crowd.m_dispatcher.getNumManifolds();
+	BT_CHECK(numManifolds > btSequentialImpulseConstraintSolverMt::s_minimumContactManifoldsForBatching);
+	BT_CHECK(crowd.m_solver.getNumMassSplittingPartitions() > 400 && crowd.m_solver.getNumMassSplittingPartitions() <= numManifolds);
+	BT_CHECK(crowd.m_solver.getNumMassSplittingSharedBodies() == 400);
+	BT_CHECK(crowd.maxDrift() < btScalar(0.01));
+	BT_CHECK(crowd.maxSpeed() < btScalar(0.05));
+}
+
+///a stack needs more iterations than with the sequential solver, as an impulse moves one contact further per iteration
+static void testStack()
+{
+	btJacobiScene stack(6, 6, 3, 40);
+	stack.step(120);
+	BT_CHECK(stack.m_solver.getNumMassSplittingPartitions() > 0);
+	BT_CHECK(stack.maxDrift() < btScalar(0.1));
+	BT_CHECK(stack.maxSpeed() < btScalar(0.05));
+}
+
+///joints are solved as by the sequential impulse solver, alongside the Jacobi contacts
+static void testJoints()
+{
+	btJacobiScene crowd(20, 20, 1, 10);
+	for (int x = 0; x + 1 < 20; ++x)
+	{
+		// bodies of row z = 0, the ground is body 0
+		crowd.addJoint(1 + x * 20, 1 + (x + 1) * 20);
+	}
+	// lift one end of the chain, the joints drag the rest of the row along
+	crowd.m_bodies[1]->setLinearVelocity(btVector3(0, 3, 0));
+	crowd.step(60);
+	BT_CHECK(crowd.m_solver.getNumMassSplittingPartitions() > 0);
+	BT_CHECK(crowd.maxJointError() < btScalar(0.05));
+}
+
+///an island with few manifolds is solved by the sequential impulse solver without partitions
+static void testSmallIsland()
+{
+	btJacobiScene pair(2, 1, 1, 10);
+	pair.step(30);
+	BT_CHECK(pair.m_solver.getNumMassSplittingPartitions() == 0);
+	BT_CHECK(pair.maxDrift() < btScalar(0.01));
+}
+
+int main()
+{
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	testCrowd();
+	testStack();
+	testJoints();
+	testSmallIsland();
+	return btReportTest("btJacobiConstraintSolverMtTest");
+}
@@ -0,0 +1,219 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/BroadphaseCollision/btConcurrentOverlappingPairCache.h"
+#include "BulletCollision/BroadphaseCollision/btSapBroadphaseMt.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletCollision/CollisionDispatch/btPairEventBuffer.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "btUnitTest.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+typedef std::pair<int, int> btTestIndexPair;
+typedef std::map<btTestIndexPair, int> btTestPairCounts;
+
+static btTestIndexPair makeIndexPair(int index0, int index1)
+{
+	return index0 < index1 ? btTestIndexPair(index0, index1) : btTestIndexPair(index1, index0);
+}
+
+static void removeZeroCounts(btTestPairCounts& counts)
+{
+	for (btTestPairCounts::iterator it = counts.begin(); it != counts.end();)
+	{
+		if (it->second == 0)
+		{
+			counts.erase(it++);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+enum btTestPipeline
+{
+	TEST_SEQUENTIAL,    // btCollisionDispatcher and btDbvtBroadphase
+	TEST_DISPATCHER_MT, // btCollisionDispatcherMt and btDbvtBroadphase
+	TEST_BROADPHASE_MT, // btCollisionDispatcherMt and btSapBroadphaseMt on a btConcurrentOverlappingPairCache
+};
+
+///replays the events of every step and compares the pairs and touching manifolds they describe with the world's
+static void testEvents(btTestPipeline pipeline)
+{
+	btDefaultCollisionConfiguration configuration;
+	btCollisionDispatcher* dispatcher = pipeline == TEST_SEQUENTIAL ? new btCollisionDispatcher(&configuration) : new btCollisionDispatcherMt(&configuration);
+	btConcurrentOverlappingPairCache concurrentPairCache;
+	concurrentPairCache.setDeterministicOrder(true);
+	btBroadphaseInterface* broadphase = pipeline == TEST_BROADPHASE_MT ? (btBroadphaseInterface*)new btSapBroadphaseMt(&concurrentPairCache) : (btBroadphaseInterface*)new btDbvtBroadphase();
+	btConstraintSolverPoolMt solverPool(1);
+	btSequentialImpulseConstraintSolverMt solver;
+	btDiscreteDynamicsWorldMt world(dispatcher, broadphase, &solverPool, &solver, &configuration);
+	world.setGravity(btVector3(0, -10, 0));
+
+	btPairEventBuffer events;
+	events.setEventMask(events.getEventMask() | btPairEvent::CONTACT_PERSIST);
+	dispatcher->setPairEventBuffer(&events);
+	broadphase->getOverlappingPairCache()->setPairEventCallback(&events);
+
+	btBoxShape groundShape(btVector3(50, 1, 50));
+	btRigidBody::btRigidBodyConstructionInfo groundInfo(0, 0, &groundShape);
+	groundInfo.m_startWorldTransform.setOrigin(btVector3(0, -1, 0));
+	btRigidBody ground(groundInfo);
+	ground.setUserIndex(0);
+	world.addRigidBody(&ground);
+
+	btBoxShape boxShape(btVector3(.5, .5, .5));
+	btVector3 inertia;
+	boxShape.calculateLocalInertia(1, inertia);
+	std::vector<btRigidBody*> bodies;
+	for (int i = 0; i < 150; ++i)
+	{
+		btRigidBody::btRigidBodyConstructionInfo info(1, 0, &boxShape, inertia);
+		info.m_startWorldTransform.setOrigin(btVector3((i % 10) * 1.3f - 6, 1 + (i / 100) * 1.2f, ((i / 10) % 10) * 1.3f - 6));
+		btRigidBody* body = new btRigidBody(info);
+		body->setUserIndex(i + 1);
+		body->setLinearVelocity(btVector3(btScalar(i % 3 - 1), 0, btScalar(i % 5 - 2)));
+		world.addRigidBody(body);
+		bodies.push_back(body);
+	}
+
+	btTestPairCounts pairs, contacts;
+	int numErrors = 0, numContactBegins = 0, numPersists = 0;
+	for (int step = 0; step < 100; ++step)
+	{
+		if (step == 60)
+		{
+			// removed objects end their pairs and contacts
+			for (int i = 0; i < int(bodies.size()); i += 5)
+			{
+				world.removeRigidBody(bodies[i]);
+				delete bodies[i];
+				bodies[i] = 0;
+			}
+		}
+		world.stepSimulation(btScalar(1. / 60.), 1, btScalar(1. / 60.));
+
+		btTestPairCounts persists;
+		for (int i = 0; i < events.getNumEvents(); ++i)
+		{
+			const btPairEvent& event = events.getEvent(i);
+			const btTestIndexPair indices = makeIndexPair(event.m_userIndex0, event.m_userIndex1);
+			switch (event.m_type)
+			{
+				case btPairEvent::PAIR_BEGIN:
+					numErrors += pairs[indices]++ != 0 ? 1 : 0;
+					break;
+				case btPairEvent::PAIR_END:
+					numErrors += --pairs[indices] != 0 ? 1 : 0;
+					break;
+				case btPairEvent::CONTACT_BEGIN:
+					contacts[indices]++;
+					numContactBegins++;
+					break;
+				case btPairEvent::CONTACT_END:
+					numErrors += --contacts[indices] < 0 ? 1 : 0;
+					break;
+				case btPairEvent::CONTACT_PERSIST:
+					persists[indices]++;
+					numPersists++;
+					break;
+			}
+		}
+		events.clearEvents();
+		removeZeroCounts(pairs);
+		removeZeroCounts(contacts);
+
+		btTestPairCounts worldPairs, worldContacts;
+		btOverlappingPairCache* pairCache = broadphase->getOverlappingPairCache();
+		const btBroadphasePair* pairArray = pairCache->getOverlappingPairArrayPtr();
+		for (int i = 0; i < pairCache->getNumOverlappingPairs(); ++i)
+		{
+			const btCollisionObject* object0 = (const btCollisionObject*)pairArray[i].m_pProxy0->m_clientObject;
+			const btCollisionObject* object1 = (const btCollisionObject*)pairArray[i].m_pProxy1->m_clientObject;
+			worldPairs[makeIndexPair(object0->getUserIndex(), object1->getUserIndex())]++;
+		}
+		for (int i = 0; i < dispatcher->getNumManifolds(); ++i)
+		{
+			const btPersistentManifold* manifold = dispatcher->getManifoldByIndexInternal(i);
+			if (manifold->getNumContacts())
+			{
+				worldContacts[makeIndexPair(manifold->getBody0()->getUserIndex(), manifold->getBody1()->getUserIndex())]++;
+			}
+		}
+
+		numErrors += pairs != worldPairs ? 1 : 0;
+		numErrors += contacts != worldContacts ? 1 : 0;
+		// only manifolds that are still touching persist
+		for (btTestPairCounts::const_iterator it = persists.begin(); it != persists.end(); ++it)
+		{
+			btTestPairCounts::const_iterator touching = worldContacts.find(it->first);
+			numErrors += touching == worldContacts.end() || touching->second < it->second ? 1 : 0;
+		}
+	}
+
+	BT_CHECK(numErrors == 0);
+	BT_CHECK(numContactBegins > 0);
+	BT_CHECK(numPersists > 0);
+
+	for (int i = 0; i < int(bodies.size()); ++i)
+	{
+		if (bodies[i])
+		{
+			world.removeRigidBody(bodies[i]);
+			delete bodies[i];
+		}
+	}
+	world.removeRigidBody(&ground);
+
+	// everything left ends
+	int numPairsLeft = int(pairs.size()), numContactsLeft = int(contacts.size());
+	for (int i = 0; i < events.getNumEvents(); ++i)
+	{
+		numPairsLeft -= events.getEvent(i).m_type == btPairEvent::PAIR_END ? 1 : 0;
+		numContactsLeft -= events.getEvent(i).m_type == btPairEvent::CONTACT_END ? 1 : 0;
+	}
+	BT_CHECK(numPairsLeft == 0);
+	BT_CHECK(numContactsLeft == 0);
+
+	delete broadphase;
+	delete dispatcher;
+}
+
+int main()
+{
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	testEvents(TEST_SEQUENTIAL);
+	testEvents(TEST_DISPATCHER_MT);
+	testEvents(TEST_BROADPHASE_MT);
+
+	btITaskScheduler* scheduler = btCreateDefaultTaskScheduler();
+	if (scheduler)
+	{
+		scheduler->setNumThreads(scheduler->getMaxNumThreads());
+		btSetTaskScheduler(scheduler);
+		testEvents(TEST_DISPATCHER_MT);
+		testEvents(TEST_BROADPHASE_MT);
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
+		delete scheduler;
+	}
+	return btReportTest("btPairEventBufferTest");
+}
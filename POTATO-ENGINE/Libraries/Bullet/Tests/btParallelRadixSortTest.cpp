@@ -0,0 +1,143 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "LinearMath/btParallelRadixSort.h"
+#include "btUnitTest.h"
+
+#include <algorithm>
+#include <vector>
+
+struct btTestKeyValue
+{
+	unsigned int m_key;
+	int m_value;
+};
+
+///sorts size keys drawn with keyMask, with the original index as value, and compares with std::stable_sort
+static void checkSort(int size, unsigned int keyMask, int numKeyBits, int chunkCount)
+{
+	btTestRandom random(size * 31 + numKeyBits);
+	std::vector<btTestKeyValue> expected(size);
+	for (int i = 0; i < size; ++i)
+	{
+		expected[i].m_key = random.next() & keyMask;
+		if (numKeyBits < 32)
+		{
+			// the bits above numKeyBits must not take part in the order
+			expected[i].m_key |= random.next() << numKeyBits;
+		}
+		expected[i].m_value = i;
+	}
+
+	btParallelRadixSort sorter;
+	sorter.setChunkCount(chunkCount);
+	sorter.resize(size);
+	for (int i = 0; i < size; ++i)
+	{
+		sorter.getKeys()[i] = expected[i].m_key;
+		sorter.getValues()[i] = expected[i].m_value;
+	}
+	sorter.sort(numKeyBits);
+
+	const unsigned int sortMask = numKeyBits >= 32 ? ~0u : (1u << numKeyBits) - 1;
+	std::stable_sort(expected.begin(), expected.end(), [sortMask](const btTestKeyValue& a, const btTestKeyValue& b) {
+		return (a.m_key & sortMask) < (b.m_key & sortMask);
+	});
+
+	BT_CHECK(sorter.size() == size);
+	int mismatches = 0;
+	for (int i = 0; i < size; ++i)
+	{
+		mismatches += (sorter.getKeys()[i] != expected[i].m_key || sorter.getValues()[i] != expected[i].m_value) ? 1 : 0;
+	}
+	if (mismatches)
+	{
+		printf("size %d mask %x bits %d chunks %d: %d mismatches\n", size, keyMask, numKeyBits, chunkCount, mismatches);
+	}
+	BT_CHECK(mismatches == 0);
+}
+
+static void testSort()
+{
+	const int sizes[] = {0, 1, 2, 255, 1000, 100003};
+	const int chunkCounts[] = {1, 7, 64};
+	for (int s = 0; s < 6; ++s)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			checkSort(sizes[s], ~0u, 32, chunkCounts[c]);
+			// few distinct keys, so stability matters
+			checkSort(sizes[s], 0x0f0f, 32, chunkCounts[c]);
+			checkSort(sizes[s], ~0u, 16, chunkCounts[c]);
+			checkSort(sizes[s], ~0u, 8, chunkCounts[c]);
+		}
+	}
+}
+
+static void sortWithScheduler(btITaskScheduler* scheduler, std::vector<unsigned int>& result)
+{
+	btSetTaskScheduler(scheduler);
+
+	btParallelRadixSort sorter;
+	btTestRandom random(5);
+	sorter.resize(50000);
+	for (int i = 0; i < sorter.size(); ++i)
+	{
+		sorter.getKeys()[i] = random.next() & 0xffff;
+		sorter.getValues()[i] = i;
+	}
+	sorter.sort(16);
+
+	result.clear();
+	for (int i = 0; i < sorter.size(); ++i)
+	{
+		result.push_back(sorter.getKeys()[i]);
+		result.push_back(unsigned(sorter.getValues()[i]));
+	}
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+}
+
+///the result must not depend on the scheduler or its thread count
+static void testThreadCounts()
+{
+	std::vector<unsigned int> reference;
+	sortWithScheduler(btGetSequentialTaskScheduler(), reference);
+
+	btITaskScheduler* schedulers[2] = {btCreateDefaultTaskScheduler(), btCreateWorkStealingTaskScheduler()};
+	for (int s = 0; s < 2; ++s)
+	{
+		btITaskScheduler* scheduler = schedulers[s];
+		if (!scheduler)
+		{
+			continue;
+		}
+		for (int numThreads = 1; numThreads <= scheduler->getMaxNumThreads(); ++numThreads)
+		{
+			scheduler->setNumThreads(numThreads);
+			std::vector<unsigned int> result;
+			sortWithScheduler(scheduler, result);
+			BT_CHECK(result == reference);
+		}
+		delete scheduler;
+	}
+}
+
+int main()
+{
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	testSort();
+	testThreadCounts();
+	return btReportTest("btParallelRadixSortTest");
+}
@@ -0,0 +1,211 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btBulletDynamicsCommon.h"
+#include "btUnitTest.h"
+
+#include <vector>
+
+///adds a point at local position x, z of body A with the given distance
+static void addPoint(btPersistentManifold& manifold, btScalar x, btScalar z, btScalar distance)
+{
+	const btVector3 point(x, 0, z);
+	btManifoldPoint contact(point, point, btVector3(0, 1, 0), distance);
+	contact.m_positionWorldOnA = point;
+	contact.m_positionWorldOnB = point;
+	manifold.addManifoldPoint(contact);
+}
+
+static btScalar deepestDistance(const btPersistentManifold& manifold)
+{
+	btScalar deepest = BT_LARGE_FLOAT;
+	for (int i = 0; i < manifold.getNumContacts(); ++i)
+	{
+		deepest = btMin(deepest, manifold.getContactPoint(i).getDistance());
+	}
+	return deepest;
+}
+
+///every capacity keeps the deepest point and no more points than it has room for
+static void testCapacity()
+{
+	btCollisionObject body0, body1;
+	for (int capacity = 1; capacity <= MANIFOLD_CACHE_SIZE; ++capacity)
+	{
+		btPersistentManifold manifold(&body0, &body1, 0, btScalar(0.1), btScalar(0.1));
+		BT_CHECK(manifold.getContactCapacity() == MANIFOLD_DEFAULT_CAPACITY);
+		manifold.setContactCapacity(capacity);
+		BT_CHECK(manifold.getContactCapacity() == capacity);
+
+		btTestRandom random(capacity);
+		btScalar deepest = 0;
+		for (int i = 0; i < 20; ++i)
+		{
+			const btScalar distance = -random.nextFloat() * btScalar(0.05);
+			addPoint(manifold, random.nextFloat() * 2 - 1, random.nextFloat() * 2 - 1, distance);
+			deepest = btMin(deepest, distance);
+			BT_CHECK(manifold.getNumContacts() == btMin(i + 1, capacity));
+			// a single point is always replaced by the newest
+			BT_CHECK(capacity == 1 || deepestDistance(manifold) == deepest);
+		}
+	}
+}
+
+///the new point takes the slot of the closest pair of points, so the points stay spread out
+static void testReduction()
+{
+	if (MANIFOLD_CACHE_SIZE < 3)
+	{
+		return;
+	}
+	btCollisionObject body0, body1;
+	btPersistentManifold manifold(&body0, &body1, 0, btScalar(0.1), btScalar(0.1));
+	manifold.setContactCapacity(3);
+	addPoint(manifold, -1, 0, btScalar(-0.01));
+	addPoint(manifold, 1, 0, btScalar(-0.02));
+	addPoint(manifold, 0, 1, btScalar(-0.03));
+	// next to the first point, which is shallower: it takes its slot
+	addPoint(manifold, btScalar(-0.9), 0, btScalar(-0.005));
+	BT_CHECK(manifold.getNumContacts() == 3);
+	BT_CHECK(manifold.getContactPoint(0).m_localPointA.x() == btScalar(-0.9));
+	BT_CHECK(manifold.getContactPoint(1).getDistance() == btScalar(-0.02));
+	BT_CHECK(manifold.getContactPoint(2).getDistance() == btScalar(-0.03));
+
+	// lowering the capacity drops the most recently added points
+	manifold.setContactCapacity(2);
+	BT_CHECK(manifold.getNumContacts() == 2);
+	BT_CHECK(manifold.getContactPoint(0).m_localPointA.x() == btScalar(-0.9));
+	BT_CHECK(manifold.getContactPoint(1).getDistance() == btScalar(-0.02));
+}
+
+struct btMeshStackResult
+{
+	std::vector<btTransform> m_transforms;
+	int m_numMeshManifolds;
+	int m_numMeshPoints;
+	int m_wrongCapacities;  // manifolds whose capacity is not the one set for their kind of pair
+	btScalar m_lowestBox;
+};
+
+///boxes resting on a triangle mesh, the mesh manifolds with meshContactCapacity points
+static btMeshStackResult simulateMeshStack(int meshContactCapacity)
+{
+	btDefaultCollisionConfiguration configuration;
+	btCollisionDispatcher dispatcher(&configuration);
+	btDbvtBroadphase broadphase;
+	btSequentialImpulseConstraintSolver solver;
+	btDiscreteDynamicsWorld world(&dispatcher, &broadphase, &solver, &configuration);
+	world.setGravity(btVector3(0, -10, 0));
+	world.getDispatchInfo().m_concaveContactCapacity = meshContactCapacity;
+
+	btTriangleMesh mesh;
+	for (int i = 0; i < 20; ++i)
+	{
+		for (int j = 0; j < 20; ++j)
+		{
+			const btVector3 a(btScalar(i - 10), 0, btScalar(j - 10));
+			mesh.addTriangle(a, a + btVector3(1, 0, 0), a + btVector3(1, 0, 1));
+			mesh.addTriangle(a, a + btVector3(1, 0, 1), a + btVector3(0, 0, 1));
+		}
+	}
+	btBvhTriangleMeshShape groundShape(&mesh, true);
+	btRigidBody ground(0, 0, &groundShape);
+	world.addRigidBody(&ground);
+
+	btBoxShape boxShape(btVector3(btScalar(0.5), btScalar(0.5), btScalar(0.5)));
+	btVector3 inertia;
+	boxShape.calculateLocalInertia(1, inertia);
+	std::vector<btRigidBody*> bodies;
+	for (int i = 0; i < 100; ++i)
+	{
+		btRigidBody::btRigidBodyConstructionInfo info(1, 0, &boxShape, inertia);
+		info.m_startWorldTransform.setIdentity();
+		info.m_startWorldTransform.setOrigin(btVector3((i % 10) * btScalar(1.1) - 5, btScalar(0.6) + (i / 50) * btScalar(1.2), ((i / 10) % 5) * btScalar(1.1) - 3));
+		info.m_startWorldTransform.setRotation(btQuaternion(btVector3(0, 1, 0), i * btScalar(0.37)));
+		btRigidBody* body = new btRigidBody(info);
+		body->setActivationState(DISABLE_DEACTIVATION);
+		world.addRigidBody(body);
+		bodies.push_back(body);
+	}
+
+	for (int step = 0; step < 120; ++step)
+	{
+		world.stepSimulation(btScalar(1. / 60.), 1, btScalar(1. / 60.));
+	}
+
+	btMeshStackResult result;
+	result.m_numMeshManifolds = 0;
+	result.m_numMeshPoints = 0;
+	result.m_wrongCapacities = 0;
+	result.m_lowestBox = BT_LARGE_FLOAT;
+	const int meshCapacity = meshContactCapacity ? meshContactCapacity : MANIFOLD_DEFAULT_CAPACITY;
+	for (int i = 0; i < dispatcher.getNumManifolds(); ++i)
+	{
+		const btPersistentManifold* manifold = dispatcher.getManifoldByIndexInternal(i);
+		const bool onMesh = manifold->getBody0() == &ground || manifold->getBody1() == &ground;
+		result.m_wrongCapacities += manifold->getContactCapacity() != (onMesh ? meshCapacity : MANIFOLD_DEFAULT_CAPACITY);
+		if (onMesh && manifold->getNumContacts())
+		{
+			result.m_numMeshManifolds++;
+			result.m_numMeshPoints += manifold->getNumContacts();
+		}
+	}
+	for (size_t i = 0; i < bodies.size(); ++i)
+	{
+		result.m_transforms.push_back(bodies[i]->getWorldTransform());
+		result.m_lowestBox = btMin(result.m_lowestBox, bodies[i]->getWorldTransform().getOrigin().y());
+		world.removeRigidBody(bodies[i]);
+		delete bodies[i];
+	}
+	world.removeRigidBody(&ground);
+	return result;
+}
+
+///the mesh manifolds get the capacity of the dispatch info, and the default capacity changes nothing
+static void testMeshContactCapacity()
+{
+	const btMeshStackResult reference = simulateMeshStack(0);
+	BT_CHECK(reference.m_wrongCapacities == 0);
+	BT_CHECK(reference.m_numMeshManifolds > 0);
+	BT_CHECK(reference.m_lowestBox > btScalar(0.45));
+
+	const btMeshStackResult classic = simulateMeshStack(MANIFOLD_DEFAULT_CAPACITY);
+	BT_CHECK(classic.m_wrongCapacities == 0);
+	BT_CHECK(btCountDifferentTransforms(reference.m_transforms, classic.m_transforms) == 0);
+
+	if (MANIFOLD_CACHE_SIZE >= 2)
+	{
+		const btMeshStackResult fewer = simulateMeshStack(2);
+		BT_CHECK(fewer.m_wrongCapacities == 0);
+		BT_CHECK(fewer.m_numMeshPoints <= fewer.m_numMeshManifolds * 2);
+		BT_CHECK(fewer.m_lowestBox > btScalar(0.4));
+	}
+	if (MANIFOLD_CACHE_SIZE >= 8)
+	{
+		// every corner of a box on the mesh is kept
+		const btMeshStackResult more = simulateMeshStack(8);
+		BT_CHECK(more.m_wrongCapacities == 0);
+		BT_CHECK(more.m_numMeshPoints > reference.m_numMeshPoints);
+		BT_CHECK(more.m_lowestBox > btScalar(0.45));
+	}
+}
+
+int main()
+{
+	testCapacity();
+	testReduction();
+	testMeshContactCapacity();
+	return btReportTest("btPersistentManifoldTest");
+}
@@ -0,0 +1,205 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/CollisionShapes/btConvexPolyhedron.h"
+#include "BulletCollision/NarrowPhaseCollision/btPolyhedralContactClipping.h"
+#include "btUnitTest.h"
+
+#include <vector>
+
+static const int gNumPairs = 4000;
+static const int gNumWarmFrames = 5;
+static const btScalar gTolerance = btScalar(1e-3);
+
+///keeps the deepest contact reported by findSeparatingAxis
+struct btTestContactResult : public btDiscreteCollisionDetectorInterface::Result
+{
+	int m_numContacts;
+	btVector3 m_point;
+	btScalar m_depth;
+
+	btTestContactResult() : m_numContacts(0), m_point(0, 0, 0), m_depth(0) {}
+
+	virtual void setShapeIdentifiersA(int, int) BT_OVERRIDE {}
+	virtual void setShapeIdentifiersB(int, int) BT_OVERRIDE {}
+	virtual void addContactPoint(const btVector3&, const btVector3& pointInWorld, btScalar depth) BT_OVERRIDE
+	{
+		m_numContacts++;
+		m_point = pointInWorld;
+		m_depth = depth;
+	}
+};
+
+///a hull of points on a sphere, with its Gauss map and a copy without it
+struct btTestHull
+{
+	btConvexHullShape m_shape;
+	btConvexPolyhedron* m_unpruned;
+
+	btTestHull() : m_unpruned(0) {}
+	~btTestHull()
+	{
+		delete m_unpruned;
+	}
+
+	void init()
+	{
+		m_shape.initializePolyhedralFeatures();
+		// without a Gauss map findSeparatingAxis tests every pair of unique edges
+		m_unpruned = new btConvexPolyhedron(*m_shape.getConvexPolyhedron());
+		m_unpruned->m_gaussMapEdges.clear();
+	}
+};
+
+static btTransform randomTransform(btTestRandom& random, btScalar range)
+{
+	btQuaternion rotation(random.nextFloat() * 2 - 1, random.nextFloat() * 2 - 1, random.nextFloat() * 2 - 1, random.nextFloat() * 2 - 1);
+	rotation.normalize();
+	const btVector3 origin(random.nextFloat() * 2 - 1, random.nextFloat() * 2 - 1, random.nextFloat() * 2 - 1);
+	return btTransform(rotation, origin * range);
+}
+
+///same condition as findSeparatingAxis for taking the Gauss map path
+static bool usesGaussMap(const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB)
+{
+	const int numGaussMapEdgeTests = hullA.m_gaussMapEdges.size() * hullB.m_gaussMapEdges.size();
+	const int numUniqueEdgeTests = hullA.m_uniqueEdges.size() * hullB.m_uniqueEdges.size();
+	return numGaussMapEdgeTests > 0 && numGaussMapEdgeTests * 8 < numUniqueEdgeTests * (hullA.m_vertices.size() + hullB.m_vertices.size());
+}
+
+struct btTestMismatches
+{
+	int m_numComparisons;
+	int m_verdicts;
+	int m_axes;
+	int m_contacts;
+	int m_witnesses;  // same contact plane and depth, another witness edge
+
+	btTestMismatches() : m_numComparisons(0), m_verdicts(0), m_axes(0), m_contacts(0), m_witnesses(0) {}
+};
+
+///the Gauss map result must match the one of the test of every pair of unique edges
+static void compare(bool overlap, const btVector3& axis, const btTestContactResult& result,
+					bool referenceOverlap, const btVector3& referenceAxis, const btTestContactResult& reference, btTestMismatches& mismatches)
+{
+	mismatches.m_numComparisons++;
+	if (overlap != referenceOverlap)
+	{
+		mismatches.m_verdicts++;
+		return;
+	}
+	if (!overlap)
+	{
+		return;
+	}
+	if ((axis - referenceAxis).length() > gTolerance)
+	{
+		mismatches.m_axes++;
+	}
+	// parallel edge pairs can give the same axis and depth; the two orders may then keep a different witness
+	// edge, so the witness point only has to lie on the same contact plane
+	if (result.m_numContacts != reference.m_numContacts ||
+		(result.m_numContacts && (btFabs((result.m_point - reference.m_point).dot(referenceAxis)) > gTolerance || btFabs(result.m_depth - reference.m_depth) > gTolerance)))
+	{
+		mismatches.m_contacts++;
+	}
+	else if (result.m_numContacts && (result.m_point - reference.m_point).length() > gTolerance)
+	{
+		mismatches.m_witnesses++;
+	}
+}
+
+int main()
+{
+	btTestRandom random(1);
+
+	const int hullSizes[6] = {8, 12, 20, 32, 48, 64};
+	btTestHull hulls[12];
+	for (int i = 0; i < 12; ++i)
+	{
+		for (int k = 0; k < hullSizes[i % 6]; ++k)
+		{
+			btVector3 point(random.nextFloat() * 2 - 1, random.nextFloat() * 2 - 1, random.nextFloat() * 2 - 1);
+			if (point.length2() < btScalar(1e-3))
+			{
+				point.setValue(1, 0, 0);
+			}
+			hulls[i].m_shape.addPoint(point.normalized() * (0.8f + 0.2f * random.nextFloat()), false);
+		}
+		hulls[i].m_shape.recalcLocalAabb();
+		hulls[i].init();
+		BT_CHECK(hulls[i].m_shape.getConvexPolyhedron()->m_gaussMapEdges.size() > 0);
+	}
+
+	// boxes have few edge directions and keep the full edge test, they cover the mixed pairs
+	btBoxShape box(btVector3(1, .5, .7));
+	box.initializePolyhedralFeatures();
+	btConvexPolyhedron boxUnpruned(*box.getConvexPolyhedron());
+	boxUnpruned.m_gaussMapEdges.clear();
+
+	btTestMismatches cold, warm;
+	int numGaussMapPairs = 0, numOverlaps = 0;
+	for (int i = 0; i < gNumPairs; ++i)
+	{
+		const bool isBox = i % 7 == 0;
+		const btConvexPolyhedron& hullA = isBox ? *box.getConvexPolyhedron() : *hulls[i % 12].m_shape.getConvexPolyhedron();
+		const btConvexPolyhedron& unprunedA = isBox ? boxUnpruned : *hulls[i % 12].m_unpruned;
+		const btConvexPolyhedron& hullB = *hulls[(i / 12) % 12].m_shape.getConvexPolyhedron();
+		const btConvexPolyhedron& unprunedB = *hulls[(i / 12) % 12].m_unpruned;
+		btTransform transA = randomTransform(random, 1.2f);
+		const btTransform transB = randomTransform(random, 1.2f);
+		numGaussMapPairs += usesGaussMap(hullA, hullB) ? 1 : 0;
+
+		{
+			btTestContactResult result, reference;
+			btVector3 axis(0, 0, 0), referenceAxis(0, 0, 0);
+			const bool overlap = btPolyhedralContactClipping::findSeparatingAxis(hullA, hullB, transA, transB, axis, result);
+			const bool referenceOverlap = btPolyhedralContactClipping::findSeparatingAxis(unprunedA, unprunedB, transA, transB, referenceAxis, reference);
+			compare(overlap, axis, result, referenceOverlap, referenceAxis, reference, cold);
+			numOverlaps += referenceOverlap ? 1 : 0;
+		}
+
+		// a few frames of motion, warm started from the feature that separated the previous frame
+		int featureCache = -1;
+		for (int frame = 0; frame < gNumWarmFrames; ++frame)
+		{
+			transA.setOrigin(transA.getOrigin() + btVector3(0.01f, -0.01f, 0.005f));
+			transA.setRotation(btQuaternion(btVector3(0, 1, 0), 0.01f) * transA.getRotation());
+
+			btTestContactResult result, reference;
+			btVector3 axis(0, 0, 0), referenceAxis(0, 0, 0);
+			const bool overlap = btPolyhedralContactClipping::findSeparatingAxis(hullA, hullB, transA, transB, axis, result, &featureCache);
+			const bool referenceOverlap = btPolyhedralContactClipping::findSeparatingAxis(unprunedA, unprunedB, transA, transB, referenceAxis, reference);
+			compare(overlap, axis, result, referenceOverlap, referenceAxis, reference, warm);
+		}
+	}
+
+	BT_CHECK(cold.m_numComparisons + warm.m_numComparisons == gNumPairs * (1 + gNumWarmFrames));
+	// the comparisons must cover both paths, and both verdicts
+	BT_CHECK(numGaussMapPairs > gNumPairs / 2);
+	BT_CHECK(numGaussMapPairs < gNumPairs);
+	BT_CHECK(numOverlaps > gNumPairs / 10);
+	BT_CHECK(numOverlaps < gNumPairs - gNumPairs / 10);
+
+	BT_CHECK(cold.m_verdicts == 0);
+	BT_CHECK(cold.m_axes == 0);
+	BT_CHECK(cold.m_contacts == 0);
+	BT_CHECK(warm.m_verdicts == 0);
+	BT_CHECK(warm.m_axes == 0);
+	BT_CHECK(warm.m_contacts == 0);
+	BT_CHECK(cold.m_witnesses + warm.m_witnesses < gNumPairs / 1000);
+	return btReportTest("btPolyhedralContactClippingTest");
+}
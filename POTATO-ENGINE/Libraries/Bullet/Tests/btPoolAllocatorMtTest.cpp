@@ -0,0 +1,180 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "LinearMath/btPoolAllocatorMt.h"
+#include "btUnitTest.h"
+
+#include <algorithm>
+#include <barrier>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+static const int gThreadCount = 4;
+static const int gElementsPerThread = 20000;
+static const int gElementSize = 40;
+
+///every thread fills its elements, then checks and frees those of the next thread and allocates them again
+static void testCrossThreadFree()
+{
+	btPoolAllocatorMt pool(gElementSize, 16, 1024);
+	std::vector<std::vector<char*> > elements(gThreadCount);
+	std::vector<int> errors(gThreadCount, 0);
+	std::barrier<> allocated(gThreadCount);
+
+	// std::thread gives every thread its own index, so the threads really use separate free lists
+	std::vector<std::thread> threads;
+	for (int t = 0; t < gThreadCount; ++t)
+	{
+		threads.emplace_back([&, t]() {
+			for (int i = 0; i < gElementsPerThread; ++i)
+			{
+				char* element = (char*)pool.allocate(gElementSize);
+				if (!element || (size_t(element) & 15))
+				{
+					errors[t]++;
+					continue;
+				}
+				memset(element, t * 31 + i, gElementSize);
+				elements[t].push_back(element);
+			}
+			allocated.arrive_and_wait();
+
+			const int owner = (t + 1) % gThreadCount;
+			for (size_t i = 0; i < elements[owner].size(); ++i)
+			{
+				const char* element = elements[owner][i];
+				for (int k = 0; k < gElementSize; ++k)
+				{
+					if (element[k] != char(owner * 31 + int(i)))
+					{
+						errors[t]++;
+						break;
+					}
+				}
+				pool.freeMemory(elements[owner][i]);
+			}
+			allocated.arrive_and_wait();
+
+			// the elements freed above now sit in this thread's list
+			elements[owner].clear();
+			for (int i = 0; i < gElementsPerThread; ++i)
+			{
+				elements[owner].push_back((char*)pool.allocate(gElementSize));
+			}
+		});
+	}
+	for (int t = 0; t < gThreadCount; ++t)
+	{
+		threads[t].join();
+	}
+
+	std::vector<char*> all;
+	for (int t = 0; t < gThreadCount; ++t)
+	{
+		BT_CHECK(errors[t] == 0);
+		all.insert(all.end(), elements[t].begin(), elements[t].end());
+	}
+	std::sort(all.begin(), all.end());
+	BT_CHECK(all.size() == size_t(gThreadCount * gElementsPerThread));
+	BT_CHECK(all[0] != NULL);
+	BT_CHECK(std::adjacent_find(all.begin(), all.end()) == all.end());
+	int overlapping = 0;
+	for (size_t i = 1; i < all.size(); ++i)
+	{
+		overlapping += all[i - 1] + gElementSize > all[i] ? 1 : 0;
+	}
+	BT_CHECK(overlapping == 0);
+
+	btPoolAllocatorMtStats stats;
+	pool.getStats(stats);
+	BT_CHECK(stats.m_allocations == 2ull * gThreadCount * gElementsPerThread);
+	BT_CHECK(stats.m_frees == 1ull * gThreadCount * gElementsPerThread);
+	BT_CHECK(stats.m_localHits + stats.m_globalRefills == stats.m_allocations);
+	BT_CHECK(stats.m_localHits > stats.m_globalRefills);
+	BT_CHECK(stats.m_fallbacks == 0);
+	// the second round is served from the freed elements, the pool only grew for the first one
+	BT_CHECK(stats.m_capacity >= gThreadCount * gElementsPerThread);
+	BT_CHECK(stats.m_capacity < 2 * gThreadCount * gElementsPerThread);
+
+	for (size_t i = 0; i < all.size(); ++i)
+	{
+		pool.freeMemory(all[i]);
+	}
+}
+
+static void testElementLimit()
+{
+	btPoolAllocatorMt pool(gElementSize, 16, 64);
+	pool.setMaxElements(100);
+	BT_CHECK(pool.getMaxElements() == 100);
+
+	std::vector<void*> elements;
+	for (int i = 0; i < 200; ++i)
+	{
+		void* element = pool.allocate(gElementSize);
+		if (!element)
+		{
+			break;
+		}
+		elements.push_back(element);
+	}
+	BT_CHECK(elements.size() == 100);
+	BT_CHECK(pool.allocate(gElementSize) == NULL);
+
+	btPoolAllocatorMtStats stats;
+	pool.getStats(stats);
+	BT_CHECK(stats.m_capacity == 100);
+	BT_CHECK(stats.m_allocations == 100);
+
+	// a freed element can be taken again without growing
+	pool.freeMemory(elements.back());
+	elements.back() = pool.allocate(gElementSize);
+	BT_CHECK(elements.back() != NULL);
+
+	pool.setMaxElements(0);
+	void* unlimited = pool.allocate(gElementSize);
+	BT_CHECK(unlimited != NULL);
+	elements.push_back(unlimited);
+
+	for (size_t i = 0; i < elements.size(); ++i)
+	{
+		pool.freeMemory(elements[i]);
+	}
+}
+
+static void testFallback()
+{
+	btPoolAllocatorMt pool(gElementSize);
+
+	char* large = (char*)pool.allocate(gElementSize * 10);
+	BT_CHECK(large != NULL && (size_t(large) & 15) == 0);
+	memset(large, 7, gElementSize * 10);
+	pool.freeMemory(large);
+	pool.freeMemory(NULL);
+
+	btPoolAllocatorMtStats stats;
+	pool.getStats(stats);
+	BT_CHECK(stats.m_fallbacks == 1);
+	BT_CHECK(stats.m_chunkCount == 0);
+}
+
+int main()
+{
+	testCrossThreadFree();
+	testElementLimit();
+	testFallback();
+	return btReportTest("btPoolAllocatorMtTest");
+}
@@ -0,0 +1,210 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "BulletCollision/BroadphaseCollision/btSapBroadphaseMt.h"
+#include "LinearMath/btThreads.h"
+#include "btBroadphaseTestScene.h"
+
+static const btVector3 gWorldSize(80, 80, 30);
+
+///there is nothing to pad, so the pairs are exactly the overlapping pairs of boxes
+static void checkPairs(btBroadphaseTestScene& scene, int frame)
+{
+	int badEntries = 0;
+	const btTestPairSet cached = scene.cachedPairs(badEntries);
+	const btTestPairSet expected = scene.overlappingBoxPairs();
+	const int missing = btCountMissingPairs(expected, cached);
+	const int extra = btCountMissingPairs(cached, expected);
+	BT_CHECK(badEntries == 0);
+	BT_CHECK(missing == 0);
+	BT_CHECK(extra == 0);
+	if (badEntries || missing || extra)
+	{
+		printf("frame %d: %d pairs, %d missing, %d extra, %d bad entries\n", frame, int(cached.size()), missing, extra, badEntries);
+	}
+}
+
+static void testAgainstBruteForce(int taskCount)
+{
+	btSapBroadphaseMt broadphase;
+	broadphase.setTaskCount(taskCount);
+
+	btBroadphaseTestScene scene(&broadphase, 11 + taskCount, gWorldSize);
+	scene.createBoxes(1500);
+	scene.calculateOverlappingPairs();
+	checkPairs(scene, -1);
+
+	for (int frame = 0; frame < 12; ++frame)
+	{
+		if (frame == 4)
+		{
+			scene.destroyBoxes(7);
+		}
+		if (frame == 6)
+		{
+			scene.createBoxes(300);
+		}
+		scene.moveBoxes(btScalar(0.3), frame % 3 == 0 ? 50 : 0);
+		scene.calculateOverlappingPairs();
+		checkPairs(scene, frame);
+	}
+
+	scene.destroyAll();
+	BT_CHECK(broadphase.getOverlappingPairCache()->getNumOverlappingPairs() == 0);
+	scene.calculateOverlappingPairs();
+	BT_CHECK(broadphase.getOverlappingPairCache()->getNumOverlappingPairs() == 0);
+}
+
+///the sweep runs along the axis the boxes are spread the most
+static void testSweepAxis()
+{
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		btVector3 worldSize(20, 20, 20);
+		worldSize[axis] = 200;
+		btSapBroadphaseMt broadphase;
+		btBroadphaseTestScene scene(&broadphase, 3, worldSize);
+		scene.createBoxes(500);
+		scene.calculateOverlappingPairs();
+		BT_CHECK(broadphase.getSweepAxis() == axis);
+		checkPairs(scene, axis);
+	}
+}
+
+struct btCollectProxies : public btBroadphaseAabbCallback
+{
+	std::set<int> m_boxes;
+
+	virtual bool process(const btBroadphaseProxy* proxy) BT_OVERRIDE
+	{
+		m_boxes.insert(btBroadphaseTestScene::boxIndex(proxy));
+		return true;
+	}
+};
+
+struct btCollectRayProxies : public btBroadphaseRayCallback
+{
+	std::set<int> m_boxes;
+
+	virtual bool process(const btBroadphaseProxy* proxy) BT_OVERRIDE
+	{
+		m_boxes.insert(btBroadphaseTestScene::boxIndex(proxy));
+		return true;
+	}
+};
+
+///box and ray queries report the boxes that a test of every box finds
+static void testQueries()
+{
+	btSapBroadphaseMt broadphase;
+	btBroadphaseTestScene scene(&broadphase, 5, gWorldSize);
+	scene.createBoxes(1000);
+	scene.destroyBoxes(9);
+
+	const btVector3 queryMin(30, 30, 10);
+	const btVector3 queryMax(50, 45, 20);
+	btCollectProxies callback;
+	broadphase.aabbTest(queryMin, queryMax, callback);
+	std::set<int> expected;
+	for (size_t i = 0; i < scene.m_proxies.size(); ++i)
+	{
+		if (scene.m_proxies[i] && TestAabbAgainstAabb2(queryMin, queryMax, scene.m_mins[i], scene.m_maxs[i]))
+		{
+			expected.insert(int(i));
+		}
+	}
+	BT_CHECK(!expected.empty());
+	BT_CHECK(callback.m_boxes == expected);
+
+	const btVector3 rayFrom(0, 0, 0);
+	const btVector3 rayTo = gWorldSize;
+	btCollectRayProxies rayCallback;
+	btVector3 direction = rayTo - rayFrom;
+	direction.normalize();
+	rayCallback.m_rayDirectionInverse[0] = direction[0] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / direction[0];
+	rayCallback.m_rayDirectionInverse[1] = direction[1] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / direction[1];
+	rayCallback.m_rayDirectionInverse[2] = direction[2] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / direction[2];
+	rayCallback.m_signs[0] = rayCallback.m_rayDirectionInverse[0] < 0.0;
+	rayCallback.m_signs[1] = rayCallback.m_rayDirectionInverse[1] < 0.0;
+	rayCallback.m_signs[2] = rayCallback.m_rayDirectionInverse[2] < 0.0;
+	rayCallback.m_lambda_max = direction.dot(rayTo - rayFrom);
+	broadphase.rayTest(rayFrom, rayTo, rayCallback);
+
+	std::set<int> expectedRay;
+	for (size_t i = 0; i < scene.m_proxies.size(); ++i)
+	{
+		btScalar param = 1;
+		btVector3 normal;
+		if (scene.m_proxies[i] && btRayAabb(rayFrom, rayTo, scene.m_mins[i], scene.m_maxs[i], param, normal))
+		{
+			expectedRay.insert(int(i));
+		}
+	}
+	BT_CHECK(!expectedRay.empty());
+	BT_CHECK(rayCallback.m_boxes == expectedRay);
+}
+
+///box indices of the pair array in its order
+static std::vector<std::pair<int, int> > pairArrayOrder(btBroadphaseInterface& broadphase)
+{
+	std::vector<std::pair<int, int> > order;
+	const btBroadphasePairArray& array = broadphase.getOverlappingPairCache()->getOverlappingPairArray();
+	for (int k = 0; k < array.size(); ++k)
+	{
+		order.push_back(std::make_pair(btBroadphaseTestScene::boxIndex(array[k].m_pProxy0), btBroadphaseTestScene::boxIndex(array[k].m_pProxy1)));
+	}
+	return order;
+}
+
+///the same scene run through the current task scheduler, the pair array in the order it comes out after each frame
+static std::vector<std::vector<std::pair<int, int> > > recordPairOrder()
+{
+	btSapBroadphaseMt broadphase;
+	broadphase.setTaskCount(16);
+	btBroadphaseTestScene scene(&broadphase, 17, gWorldSize);
+	scene.createBoxes(1500);
+	std::vector<std::vector<std::pair<int, int> > > frames;
+	for (int frame = 0; frame < 6; ++frame)
+	{
+		scene.moveBoxes(btScalar(0.5), 30);
+		scene.calculateOverlappingPairs();
+		frames.push_back(pairArrayOrder(broadphase));
+	}
+	return frames;
+}
+
+int main()
+{
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	testAgainstBruteForce(1);
+	testAgainstBruteForce(16);
+	testSweepAxis();
+	testQueries();
+	const std::vector<std::vector<std::pair<int, int> > > sequentialOrder = recordPairOrder();
+
+	btITaskScheduler* scheduler = btCreateDefaultTaskScheduler();
+	if (scheduler)
+	{
+		scheduler->setNumThreads(scheduler->getMaxNumThreads());
+		btSetTaskScheduler(scheduler);
+		testAgainstBruteForce(1);
+		testAgainstBruteForce(64);
+		// the pair cache comes out the same for any number of threads
+		BT_CHECK(recordPairOrder() == sequentialOrder);
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
+		delete scheduler;
+	}
+	return btReportTest("btSapBroadphaseMtTest");
+}
@@ -0,0 +1,373 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "btUnitTest.h"
+
+///looks at the contact batches and the friction rows of each solve before they are released
+struct btInspectingSolverMt : public btSequentialImpulseConstraintSolverMt
+{
+	int m_batchedSolves;
+	int m_frictionRows;
+	///friction rows of contacts that pushed, yet applied no impulse
+	int m_idleFrictionRows;
+	int m_contactSetups;
+	int m_contactRows;
+	int m_rebatchedContactRows;
+	int m_invalidSetups;
+
+	btInspectingSolverMt()
+		: m_batchedSolves(0), m_frictionRows(0), m_idleFrictionRows(0), m_contactSetups(0), m_contactRows(0), m_rebatchedContactRows(0), m_invalidSetups(0)
+	{
+	}
+
+	void resetCounts()
+	{
+		m_contactSetups = 0;
+		m_contactRows = 0;
+		m_rebatchedContactRows = 0;
+	}
+
+	int getNumCachedIslands() const
+	{
+		return m_batchedContactConstraints.m_cachedIslands.size();
+	}
+
+	void setMaxNumCachedIslands(int maxNumCachedIslands)
+	{
+		m_batchedContactConstraints.m_maxNumCachedIslands = maxNumCachedIslands;
+	}
+
+	void setMassSplittingMethod(btMassSplittingPartitions::PartitionMethod method)
+	{
+		m_massSplittingMethod = method;
+	}
+
+	virtual void setupBatchedContactConstraints() BT_OVERRIDE
+	{
+		btSequentialImpulseConstraintSolverMt::setupBatchedContactConstraints();
+		m_contactSetups++;
+		m_contactRows += m_tmpSolverContactConstraintPool.size();
+		m_rebatchedContactRows += getNumRebatchedContactConstraints();
+		m_invalidSetups += !m_batchedContactConstraints.validate(&m_tmpSolverContactConstraintPool, m_tmpSolverBodyPool);
+	}
+
+	virtual btScalar solveGroupCacheFriendlyFinish(btCollisionObject** bodies, int numBodies, const btContactSolverInfo& infoGlobal) BT_OVERRIDE
+	{
+		m_batchedSolves += m_useBatching;
+		for (int i = 0; i < m_tmpSolverContactFrictionConstraintPool.size(); ++i)
+		{
+			const btSolverConstraint& friction = m_tmpSolverContactFrictionConstraintPool[i];
+			if (m_tmpSolverContactConstraintPool[friction.m_frictionIndex].m_appliedImpulse > 0)
+			{
+				m_frictionRows++;
+				m_idleFrictionRows += friction.m_appliedImpulse == 0;
+			}
+		}
+		return btSequentialImpulseConstraintSolverMt::solveGroupCacheFriendlyFinish(bodies, numBodies, infoGlobal);
+	}
+};
+
+///boxes sliding sideways across a slope, so both friction directions of every contact push
+struct btSlopeScene
+{
+	static const int NUM_BOXES = 40;
+
+	btDefaultCollisionConfiguration m_configuration;
+	btCollisionDispatcherMt m_dispatcher;
+	btDbvtBroadphase m_broadphase;
+	btConstraintSolverPoolMt m_solverPool;
+	btInspectingSolverMt m_solver;
+	btDiscreteDynamicsWorldMt m_world;
+	btBoxShape m_groundShape;
+	btBoxShape m_boxShape;
+	btRigidBody* m_ground;
+	btRigidBody* m_boxes[NUM_BOXES];
+	btVector3 m_start;
+
+	btSlopeScene()
+		: m_dispatcher(&m_configuration),
+		  m_solverPool(1),
+		  m_world(&m_dispatcher, &m_broadphase, &m_solverPool, &m_solver, &m_configuration),
+		  m_groundShape(btVector3(50, 1, 50)),
+		  m_boxShape(btVector3(btScalar(0.5), btScalar(0.5), btScalar(0.5)))
+	{
+		m_world.setGravity(btVector3(0, -10, 0));
+		m_world.getSolverInfo().m_solverMode |= SOLVER_USE_2_FRICTION_DIRECTIONS;
+
+		btTransform slope;
+		slope.setIdentity();
+		slope.setRotation(btQuaternion(btVector3(0, 0, 1), btScalar(0.3)));
+
+		btRigidBody::btRigidBodyConstructionInfo groundInfo(0, 0, &m_groundShape);
+		groundInfo.m_startWorldTransform = slope;
+		groundInfo.m_friction = 1;
+		m_ground = new btRigidBody(groundInfo);
+		m_world.addRigidBody(m_ground);
+
+		btVector3 inertia;
+		m_boxShape.calculateLocalInertia(1, inertia);
+		for (int i = 0; i < NUM_BOXES; ++i)
+		{
+			btRigidBody::btRigidBodyConstructionInfo info(1, 0, &m_boxShape, inertia);
+			info.m_friction = 1;
+			info.m_startWorldTransform = slope;
+			info.m_startWorldTransform.setOrigin(slope * btVector3(0, btScalar(1.5), btScalar(i * 2 - NUM_BOXES)));
+			m_boxes[i] = new btRigidBody(info);
+			m_boxes[i]->setLinearVelocity(btVector3(0, 0, 3));
+			m_boxes[i]->setActivationState(DISABLE_DEACTIVATION);
+			m_world.addRigidBody(m_boxes[i]);
+		}
+		m_start = m_boxes[0]->getWorldTransform().getOrigin();
+	}
+
+	~btSlopeScene()
+	{
+		for (int i = 0; i < NUM_BOXES; ++i)
+		{
+			m_world.removeRigidBody(m_boxes[i]);
+			delete m_boxes[i];
+		}
+		m_world.removeRigidBody(m_ground);
+		delete m_ground;
+	}
+
+	void step(int steps)
+	{
+		for (int i = 0; i < steps; ++i)
+		{
+			m_world.stepSimulation(btScalar(1) / 60, 1, btScalar(1) / 60);
+		}
+	}
+
+	///how far the first box slid down the slope
+	btScalar slide() const
+	{
+		return (m_boxes[0]->getWorldTransform().getOrigin() - m_start).x();
+	}
+};
+
+///the batched friction solve visits both directions of every contact and slows the boxes like the unbatched solve
+static void testBatchedFrictionRows()
+{
+	const int minimumManifolds = btSequentialImpulseConstraintSolverMt::s_minimumContactManifoldsForBatching;
+
+	btSequentialImpulseConstraintSolverMt::s_minimumContactManifoldsForBatching = 100000;
+	btSlopeScene unbatched;
+	unbatched.step(30);
+	BT_CHECK(unbatched.m_solver.m_batchedSolves == 0);
+
+	btSequentialImpulseConstraintSolverMt::s_minimumContactManifoldsForBatching = 1;
+	btSlopeScene batched;
+	batched.step(30);
+	BT_CHECK(batched.m_solver.m_batchedSolves > 0);
+	BT_CHECK(batched.m_solver.m_frictionRows > 0);
+	BT_CHECK(batched.m_solver.m_idleFrictionRows == 0);
+	BT_CHECK(unbatched.m_solver.m_idleFrictionRows == 0);
+
+	// batching reorders the rows, so the boxes do not end up bit for bit where the unbatched solve puts them
+	BT_CHECK(unbatched.slide() < 0);
+	BT_CHECK(btFabs(batched.slide() - unbatched.slide()) < btFabs(unbatched.slide()) * btScalar(0.05));
+	BT_CHECK(btFabs(batched.m_boxes[0]->getLinearVelocity().z() - unbatched.m_boxes[0]->getLinearVelocity().z()) < btScalar(0.05));
+
+	btSequentialImpulseConstraintSolverMt::s_minimumContactManifoldsForBatching = minimumManifolds;
+}
+
+///piles of boxes packed side by side, each pile far enough from the others to be an island of its own
+struct btPilesScene
+{
+	static const int PILE_SIZE = 6;
+	static const int PILE_HEIGHT = 3;
+
+	btDefaultCollisionConfiguration m_configuration;
+	btCollisionDispatcherMt m_dispatcher;
+	btDbvtBroadphase m_broadphase;
+	btConstraintSolverPoolMt m_solverPool;
+	btInspectingSolverMt m_solver;
+	btDiscreteDynamicsWorldMt m_world;
+	btBoxShape m_groundShape;
+	btBoxShape m_boxShape;
+	btAlignedObjectArray<btRigidBody*> m_bodies;
+	btAlignedObjectArray<btVector3> m_starts;
+
+	btPilesScene(int numPiles)
+		: m_dispatcher(&m_configuration),
+		  m_solverPool(1),
+		  m_world(&m_dispatcher, &m_broadphase, &m_solverPool, &m_solver, &m_configuration),
+		  m_groundShape(btVector3(100, 1, 100)),
+		  m_boxShape(btVector3(btScalar(0.5), btScalar(0.5), btScalar(0.5)))
+	{
+		m_world.setGravity(btVector3(0, -10, 0));
+		addBody(&m_groundShape, 0, btVector3(0, -1, 0));
+		for (int pile = 0; pile < numPiles; ++pile)
+		{
+			for (int x = 0; x < PILE_SIZE; ++x)
+			{
+				for (int z = 0; z < PILE_SIZE; ++z)
+				{
+					for (int y = 0; y < PILE_HEIGHT; ++y)
+					{
+						addBody(&m_boxShape, 1, btVector3(btScalar(pile * 20 + x), btScalar(y) + btScalar(0.5), btScalar(z)));
+					}
+				}
+			}
+		}
+	}
+
+	~btPilesScene()
+	{
+		for (int i = 0; i < m_bodies.size(); ++i)
+		{
+			m_world.removeRigidBody(m_bodies[i]);
+			delete m_bodies[i];
+		}
+	}
+
+	void addBody(btCollisionShape* shape, btScalar mass, const btVector3& origin)
+	{
+		btVector3 inertia(0, 0, 0);
+		if (mass > 0)
+		{
+			shape->calculateLocalInertia(mass, inertia);
+		}
+		btRigidBody::btRigidBodyConstructionInfo info(mass, 0, shape, inertia);
+		info.m_startWorldTransform.setIdentity();
+		info.m_startWorldTransform.setOrigin(origin);
+		btRigidBody* body = new btRigidBody(info);
+		body->setActivationState(DISABLE_DEACTIVATION);
+		m_world.addRigidBody(body);
+		m_bodies.push_back(body);
+		m_starts.push_back(origin);
+	}
+
+	void step(int steps)
+	{
+		for (int i = 0; i < steps; ++i)
+		{
+			m_world.stepSimulation(btScalar(1) / 60, 1, btScalar(1) / 60);
+		}
+	}
+
+	///how far the box that moved most is from where it started
+	btScalar maxDrift() const
+	{
+		btScalar drift = 0;
+		for (int i = 1; i < m_bodies.size(); ++i)
+		{
+			drift = btMax(drift, (m_bodies[i]->getWorldTransform().getOrigin() - m_starts[i]).length());
+		}
+		return drift;
+	}
+
+	btScalar maxSpeed() const
+	{
+		btScalar speed = 0;
+		for (int i = 1; i < m_bodies.size(); ++i)
+		{
+			speed = btMax(speed, m_bodies[i]->getLinearVelocity().length());
+		}
+		return speed;
+	}
+};
+
+///with incremental batching, each resting pile keeps its batches even though the same solver sets up every pile
+static void testIncrementalBatchingIslands()
+{
+	const int minimumManifolds = btSequentialImpulseConstraintSolverMt::s_minimumContactManifoldsForBatching;
+	btSequentialImpulseConstraintSolverMt::s_minimumContactManifoldsForBatching = 1;
+	btSequentialImpulseConstraintSolverMt::s_useIncrementalBatching = true;
+
+	btPilesScene piles(3);
+	piles.step(60);
+	piles.m_solver.resetCounts();
+	piles.step(30);
+	BT_CHECK(piles.m_solver.m_contactSetups == 3 * 30);
+	BT_CHECK(piles.m_solver.getNumCachedIslands() == 3);
+	BT_CHECK(piles.m_solver.m_rebatchedContactRows * 10 < piles.m_solver.m_contactRows);
+	BT_CHECK(piles.m_solver.m_invalidSetups == 0);
+
+	// a single cache is overwritten by each pile in turn, so every setup starts over
+	btPilesScene sharedCache(3);
+	sharedCache.m_solver.setMaxNumCachedIslands(1);
+	sharedCache.step(60);
+	sharedCache.m_solver.resetCounts();
+	sharedCache.step(30);
+	BT_CHECK(sharedCache.m_solver.getNumCachedIslands() == 1);
+	BT_CHECK(sharedCache.m_solver.m_rebatchedContactRows == sharedCache.m_solver.m_contactRows);
+	BT_CHECK(sharedCache.m_solver.m_invalidSetups == 0);
+
+	// without incremental batching every row is batched at each setup and no island is kept
+	btSequentialImpulseConstraintSolverMt::s_useIncrementalBatching = false;
+	piles.m_solver.resetCounts();
+	piles.step(5);
+	BT_CHECK(piles.m_solver.m_rebatchedContactRows == piles.m_solver.m_contactRows);
+	BT_CHECK(piles.m_solver.getNumCachedIslands() == 0);
+
+	btSequentialImpulseConstraintSolverMt::s_minimumContactManifoldsForBatching = minimumManifolds;
+}
+
+///partitions and shared bodies of the last solve of a resting pile, which has to stay where it was built
+static void checkMassSplitting(int numPartitions, btMassSplittingPartitions::PartitionMethod method, btScalar maxDrift, int expectedPartitions, int minShared, int maxShared)
+{
+	btSequentialImpulseConstraintSolverMt::s_numMassSplittingPartitions = numPartitions;
+	btPilesScene pile(1);
+	pile.m_solver.setMassSplittingMethod(method);
+	pile.step(120);
+	const int partitions = pile.m_solver.getNumMassSplittingPartitions();
+	const int shared = pile.m_solver.getNumMassSplittingSharedBodies();
+	BT_CHECK(expectedPartitions > 0 ? partitions == expectedPartitions : partitions > pile.m_bodies.size());
+	BT_CHECK(shared >= minShared && shared <= maxShared);
+	BT_CHECK(pile.maxDrift() < maxDrift);
+	BT_CHECK(pile.maxSpeed() < btScalar(0.05));
+	if (pile.maxDrift() >= maxDrift)
+	{
+		printf("%d partitions, method %d: drift %f\n", numPartitions, int(method), pile.maxDrift());
+	}
+}
+
+///a pile solved in partitions with split masses stays where it was built, as with the batched solve
+static void testMassSplitting()
+{
+	const int minimumManifolds = btSequentialImpulseConstraintSolverMt::s_minimumContactManifoldsForBatching;
+	btSequentialImpulseConstraintSolverMt::s_minimumContactManifoldsForBatching = 1;
+	btSequentialImpulseConstraintSolverMt::s_useMassSplitting = true;
+
+	const int numBoxes = btPilesScene::PILE_SIZE * btPilesScene::PILE_SIZE * btPilesScene::PILE_HEIGHT;
+	const btScalar slabsDrift = btScalar(0.02);
+	// a single partition has no copies and solves like the sequential solver
+	checkMassSplitting(1, btMassSplittingPartitions::PARTITION_METHOD_SPATIAL_SLABS, slabsDrift, 1, 0, 0);
+	// one partition per thread of the sequential scheduler
+	checkMassSplitting(0, btMassSplittingPartitions::PARTITION_METHOD_SPATIAL_SLABS, slabsDrift, 1, 0, 0);
+	checkMassSplitting(4, btMassSplittingPartitions::PARTITION_METHOD_SPATIAL_SLABS, slabsDrift, 4, 1, numBoxes - 1);
+	checkMassSplitting(7, btMassSplittingPartitions::PARTITION_METHOD_SPATIAL_SLABS, slabsDrift, 7, 1, numBoxes - 1);
+	// one partition per touching pair, so every box is shared; block Jacobi converges more slowly
+	checkMassSplitting(4, btMassSplittingPartitions::PARTITION_METHOD_BODY_PAIRS, btScalar(0.1), 0, numBoxes, numBoxes);
+
+	btSequentialImpulseConstraintSolverMt::s_useMassSplitting = false;
+	btSequentialImpulseConstraintSolverMt::s_numMassSplittingPartitions = 0;
+	btSequentialImpulseConstraintSolverMt::s_minimumContactManifoldsForBatching = minimumManifolds;
+}
+
+int main()
+{
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	testBatchedFrictionRows();
+	testIncrementalBatchingIslands();
+	testMassSplitting();
+	return btReportTest("btSequentialImpulseConstraintSolverMtTest");
+}
@@ -0,0 +1,306 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "BulletDynamics/Dynamics/btSimulationIslandManagerMt.h"
+#include "btUnitTest.h"
+
+#include <map>
+
+static const int NUM_ITERATIONS = 20;
+
+///piles of boxes with different body counts, so the island stats of one frame are matched to the next by their size.
+///Islands under 32 bodies are solved together in a batch island, so every pile has at least 32. A layer of 3x3 boxes
+///falls onto the 3x3x4 pile and lands after about half a second.
+struct btIslandsScene
+{
+	btDefaultCollisionConfiguration m_configuration;
+	btCollisionDispatcherMt m_dispatcher;
+	btDbvtBroadphase m_broadphase;
+	btConstraintSolverPoolMt m_solverPool;
+	btSequentialImpulseConstraintSolverMt m_solver;
+	btDiscreteDynamicsWorldMt m_world;
+	btBoxShape m_groundShape;
+	btBoxShape m_boxShape;
+	btAlignedObjectArray<btRigidBody*> m_bodies;
+	btSimulationIslandManagerMt* m_islandManager;
+
+	btIslandsScene()
+		: m_dispatcher(&m_configuration),
+		  m_solverPool(1),
+		  m_world(&m_dispatcher, &m_broadphase, &m_solverPool, &m_solver, &m_configuration),
+		  m_groundShape(btVector3(100, 1, 100)),
+		  m_boxShape(btVector3(btScalar(0.5), btScalar(0.5), btScalar(0.5)))
+	{
+		m_world.setGravity(btVector3(0, -10, 0));
+		m_world.getSolverInfo().m_numIterations = NUM_ITERATIONS;
+		m_islandManager = static_cast<btSimulationIslandManagerMt*>(m_world.getSimulationIslandManager());
+		// keep every island on its own
+		m_islandManager->setMinimumSolverBatchSize(1);
+
+		addBody(&m_groundShape, 0, btVector3(0, -1, 0));
+		addPile(0, 3, 3, 4, 0);
+		addPile(10, 4, 4, 2, 0);
+		addPile(20, 5, 4, 2, 0);
+		addPile(0, 3, 3, 1, 5);
+	}
+
+	~btIslandsScene()
+	{
+		for (int i = 0; i < m_bodies.size(); ++i)
+		{
+			m_world.removeRigidBody(m_bodies[i]);
+			delete m_bodies[i];
+		}
+	}
+
+	void addPile(int x0, int sizeX, int sizeZ, int height, int y0)
+	{
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < sizeX; ++x)
+			{
+				for (int z = 0; z < sizeZ; ++z)
+				{
+					addBody(&m_boxShape, 1, btVector3(btScalar(x0 + x), btScalar(y0 + y) + btScalar(0.5), btScalar(z)));
+				}
+			}
+		}
+	}
+
+	void addBody(btCollisionShape* shape, btScalar mass, const btVector3& origin)
+	{
+		btVector3 inertia(0, 0, 0);
+		if (mass > 0)
+		{
+			shape->calculateLocalInertia(mass, inertia);
+		}
+		btRigidBody::btRigidBodyConstructionInfo info(mass, 0, shape, inertia);
+		info.m_startWorldTransform.setIdentity();
+		info.m_startWorldTransform.setOrigin(origin);
+		btRigidBody* body = new btRigidBody(info);
+		body->setActivationState(DISABLE_DEACTIVATION);
+		m_world.addRigidBody(body);
+		m_bodies.push_back(body);
+	}
+
+	void step()
+	{
+		m_world.stepSimulation(btScalar(1) / 60, 1, btScalar(1) / 60);
+	}
+
+	///island iterations given and used in the last step, summed over the islands
+	int sumIterations(bool used) const
+	{
+		int sum = 0;
+		for (int i = 0; i < m_islandManager->getNumIslandStats(); ++i)
+		{
+			const btSimulationIslandManagerMt::IslandStats& stats = m_islandManager->getIslandStats(i);
+			sum += used ? stats.numIterationsUsed : stats.numIterations;
+		}
+		return sum;
+	}
+
+	btScalar highestBox() const
+	{
+		btScalar y = 0;
+		for (int i = 1; i < m_bodies.size(); ++i)
+		{
+			y = btMax(y, m_bodies[i]->getWorldTransform().getOrigin().y());
+		}
+		return y;
+	}
+};
+
+///collecting the stats alone gives every island the full count and reports what it used
+static void testCollectIslandStats()
+{
+	btIslandsScene scene;
+	scene.m_islandManager->setCollectIslandStats(true);
+	int badCounts = 0;
+	for (int frame = 0; frame < 60; ++frame)
+	{
+		scene.step();
+		BT_CHECK(scene.m_islandManager->getNumIslandStats() == scene.m_islandManager->getNumActiveIslands());
+		for (int i = 0; i < scene.m_islandManager->getNumIslandStats(); ++i)
+		{
+			const btSimulationIslandManagerMt::IslandStats& stats = scene.m_islandManager->getIslandStats(i);
+			// an island can reach a zero residual before the last iteration
+			badCounts += stats.numIterations != NUM_ITERATIONS;
+			badCounts += stats.numIterationsUsed < 1 || stats.numIterationsUsed > NUM_ITERATIONS;
+		}
+	}
+	BT_CHECK(badCounts == 0);
+	BT_CHECK(scene.m_islandManager->getNumIslandStats() == 3);
+
+	scene.m_islandManager->setCollectIslandStats(false);
+	scene.step();
+	BT_CHECK(scene.m_islandManager->getNumIslandStats() == 0);
+}
+
+struct btIslandFrame
+{
+	int numIterations;
+	int numIterationsUsed;
+	int numManifolds;
+};
+
+///each island's count follows from what it did the frame before, and the piles rest as they do with the full count
+static void testAdaptiveIterations()
+{
+	const btScalar residualThreshold = btScalar(1e-2);
+	const int minIterations = 3;
+
+	btIslandsScene reference;
+	reference.m_world.getSolverInfo().m_leastSquaresResidualThreshold = 0;
+
+	btIslandsScene scene;
+	scene.m_islandManager->setAdaptiveIterations(true);
+	scene.m_islandManager->setMinimumIslandIterations(minIterations);
+	scene.m_islandManager->setIslandResidualThreshold(residualThreshold);
+
+	std::map<int, btIslandFrame> previous;
+	int wrongCounts = 0;
+	int earlyFrames = 0;
+	int fullCountLandings = 0;
+	int adaptiveIterations = 0;
+	int fullIterations = 0;
+	for (int frame = 0; frame < 120; ++frame)
+	{
+		reference.step();
+		scene.step();
+		std::map<int, btIslandFrame> current;
+		for (int i = 0; i < scene.m_islandManager->getNumIslandStats(); ++i)
+		{
+			const btSimulationIslandManagerMt::IslandStats& stats = scene.m_islandManager->getIslandStats(i);
+			BT_CHECK(stats.numIterations >= minIterations && stats.numIterations <= NUM_ITERATIONS);
+			BT_CHECK(stats.numIterationsUsed >= 1 && stats.numIterationsUsed <= stats.numIterations);
+			btIslandFrame& island = current[stats.numBodies];
+			island.numIterations = stats.numIterations;
+			island.numIterationsUsed = stats.numIterationsUsed;
+			island.numManifolds = stats.numManifolds;
+
+			std::map<int, btIslandFrame>::const_iterator last = previous.find(stats.numBodies);
+			if (last != previous.end())
+			{
+				const btIslandFrame& before = last->second;
+				int expected;
+				if (stats.numManifolds > before.numManifolds + before.numManifolds / 4 + 2)
+				{
+					expected = NUM_ITERATIONS;
+				}
+				else if (before.numIterationsUsed < before.numIterations)
+				{
+					expected = before.numIterationsUsed + 1;
+					earlyFrames++;
+				}
+				else
+				{
+					expected = before.numIterations * 2;
+				}
+				expected = btMax(minIterations, btMin(expected, NUM_ITERATIONS));
+				wrongCounts += stats.numIterations != expected;
+			}
+			else if (stats.numBodies == 45 && previous.count(36))
+			{
+				// the falling layer joined the 3x3x4 pile, whose key body is unchanged: its contact count jumped
+				fullCountLandings += stats.numIterations == NUM_ITERATIONS;
+			}
+		}
+		previous.swap(current);
+		adaptiveIterations += scene.sumIterations(true);
+		fullIterations += NUM_ITERATIONS * scene.m_islandManager->getNumIslandStats();
+	}
+	BT_CHECK(wrongCounts == 0);
+	BT_CHECK(earlyFrames > 0);
+	BT_CHECK(fullCountLandings == 1);
+	BT_CHECK(previous.size() == 3);
+	BT_CHECK(adaptiveIterations < fullIterations * 3 / 4);
+
+	// the piles stay up as with the full count, within a tenth of a box; the landing layer drifts the most
+	int movedBoxes = 0;
+	for (int i = 1; i < scene.m_bodies.size(); ++i)
+	{
+		const btVector3 delta = scene.m_bodies[i]->getWorldTransform().getOrigin() - reference.m_bodies[i]->getWorldTransform().getOrigin();
+		movedBoxes += delta.length() > btScalar(0.1);
+	}
+	BT_CHECK(movedBoxes == 0);
+	BT_CHECK(btFabs(scene.highestBox() - btScalar(4.5)) < btScalar(0.05));
+}
+
+///a frame budget scales the extra iterations down, the islands keep their minimum
+static void testFrameIterationBudget()
+{
+	const int minIterations = 4;
+	btIslandsScene scene;
+	scene.m_islandManager->setAdaptiveIterations(true);
+	scene.m_islandManager->setMinimumIslandIterations(minIterations);
+	// no residual threshold: without the budget every island would take the full count
+	scene.m_islandManager->setIslandResidualThreshold(0);
+	for (int frame = 0; frame < 40; ++frame)
+	{
+		scene.step();
+	}
+
+	int minWork = 0;
+	int fullWork = 0;
+	for (int i = 0; i < scene.m_islandManager->getNumIslandStats(); ++i)
+	{
+		const btSimulationIslandManagerMt::IslandStats& stats = scene.m_islandManager->getIslandStats(i);
+		BT_CHECK(stats.numIterations == NUM_ITERATIONS);
+		const int weight = btMax(1, stats.numManifolds + stats.numConstraints);
+		minWork += minIterations * weight;
+		fullWork += NUM_ITERATIONS * weight;
+	}
+	const int budget = (minWork + fullWork) / 2;
+	scene.m_islandManager->setFrameIterationBudget(budget);
+	for (int frame = 0; frame < 10; ++frame)
+	{
+		scene.step();
+		int work = 0;
+		int belowMinimum = 0;
+		int full = 0;
+		for (int i = 0; i < scene.m_islandManager->getNumIslandStats(); ++i)
+		{
+			const btSimulationIslandManagerMt::IslandStats& stats = scene.m_islandManager->getIslandStats(i);
+			work += stats.numIterations * btMax(1, stats.numManifolds + stats.numConstraints);
+			belowMinimum += stats.numIterations < minIterations;
+			full += stats.numIterations == NUM_ITERATIONS;
+		}
+		BT_CHECK(work <= budget);
+		BT_CHECK(belowMinimum == 0);
+		BT_CHECK(full == 0);
+	}
+
+	// a budget below the minimums still leaves every island its minimum
+	scene.m_islandManager->setFrameIterationBudget(1);
+	scene.step();
+	for (int i = 0; i < scene.m_islandManager->getNumIslandStats(); ++i)
+	{
+		BT_CHECK(scene.m_islandManager->getIslandStats(i).numIterations == minIterations);
+	}
+}
+
+int main()
+{
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	testCollectIslandStats();
+	testAdaptiveIterations();
+	testFrameIterationBudget();
+	return btReportTest("btSimulationIslandManagerMtTest");
+}
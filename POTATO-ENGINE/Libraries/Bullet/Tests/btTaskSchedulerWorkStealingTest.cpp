@@ -0,0 +1,182 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "LinearMath/btThreads.h"
+#include "btUnitTest.h"
+
+#include <atomic>
+#include <vector>
+
+///counts the visits of every iteration and checks that each range lies inside the loop
+struct btCountingForBody : public btIParallelForBody
+{
+	int m_begin;
+	int m_end;
+	std::vector<std::atomic<int> >* m_visits;
+	mutable std::atomic<int> m_badRanges;
+	mutable std::atomic<int> m_badThreads;
+	int m_maxThreads;
+
+	btCountingForBody(int begin, int end, std::vector<std::atomic<int> >* visits, int maxThreads)
+		: m_begin(begin), m_end(end), m_visits(visits), m_badRanges(0), m_badThreads(0), m_maxThreads(maxThreads)
+	{
+	}
+
+	virtual void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		if (iBegin < m_begin || iEnd > m_end || iBegin > iEnd)
+		{
+			m_badRanges++;
+			return;
+		}
+		const int thread = btGetCurrentThreadIndex();
+		if (thread < 0 || thread >= m_maxThreads)
+		{
+			m_badThreads++;
+		}
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			(*m_visits)[i - m_begin]++;
+		}
+	}
+};
+
+///small terms, so the partial sums stay exact in single precision whatever the split
+struct btIndexSumBody : public btIParallelSumBody
+{
+	virtual btScalar sumLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		btScalar sum = 0;
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			sum += btScalar(i % 7);
+		}
+		return sum;
+	}
+};
+
+///a parallelFor issued from inside a task runs on the calling thread and still covers its range
+struct btNestedForBody : public btIParallelForBody
+{
+	mutable std::atomic<int> m_innerIterations;
+
+	btNestedForBody() : m_innerIterations(0) {}
+
+	virtual void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			std::vector<std::atomic<int> > visits(10);
+			btCountingForBody inner(0, 10, &visits, BT_MAX_THREAD_COUNT);
+			btParallelFor(0, 10, 1, inner);
+			for (int k = 0; k < 10; ++k)
+			{
+				m_innerIterations += visits[k].load();
+			}
+		}
+	}
+};
+
+static void testParallelFor(btITaskScheduler* scheduler)
+{
+	const int begins[] = {0, 7, -50};
+	const int counts[] = {1, 2, 63, 1000, 100000};
+	const int grains[] = {1, 3, 64, 100000};
+
+	for (int b = 0; b < 3; ++b)
+	{
+		for (int c = 0; c < 5; ++c)
+		{
+			for (int g = 0; g < 4; ++g)
+			{
+				std::vector<std::atomic<int> > visits(counts[c]);
+				btCountingForBody body(begins[b], begins[b] + counts[c], &visits, scheduler->getMaxNumThreads());
+				btParallelFor(body.m_begin, body.m_end, grains[g], body);
+
+				int wrongVisits = 0;
+				for (int i = 0; i < counts[c]; ++i)
+				{
+					wrongVisits += visits[i].load() != 1;
+				}
+				BT_CHECK(wrongVisits == 0);
+				BT_CHECK(body.m_badRanges.load() == 0);
+				BT_CHECK(body.m_badThreads.load() == 0);
+			}
+		}
+	}
+}
+
+static void testParallelSum()
+{
+	btIndexSumBody body;
+	for (int round = 0; round < 20; ++round)
+	{
+		const int end = 1000 + round * 997;
+		int expected = 0;
+		for (int i = 0; i < end; ++i)
+		{
+			expected += i % 7;
+		}
+		BT_CHECK(btParallelSum(0, end, 1 + round * 7, body) == btScalar(expected));
+	}
+}
+
+static void testNestedParallelFor()
+{
+	btNestedForBody body;
+	btParallelFor(0, 64, 1, body);
+	BT_CHECK(body.m_innerIterations.load() == 64 * 10);
+}
+
+static void testThreadCount(btITaskScheduler* scheduler)
+{
+	const int maxThreads = scheduler->getMaxNumThreads();
+	BT_CHECK(maxThreads >= 1 && maxThreads <= int(BT_MAX_THREAD_COUNT));
+
+	scheduler->setNumThreads(0);
+	BT_CHECK(scheduler->getNumThreads() == 1);
+	scheduler->setNumThreads(maxThreads + 100);
+	BT_CHECK(scheduler->getNumThreads() == maxThreads);
+}
+
+int main()
+{
+	// the workers only run on a machine with several hardware threads, where every loop below goes
+	// through the deques; with a single one the scheduler runs everything on the calling thread
+	for (int round = 0; round < 3; ++round)
+	{
+		btITaskScheduler* scheduler = btCreateWorkStealingTaskScheduler();
+		BT_CHECK(scheduler != NULL);
+		if (scheduler == NULL)
+		{
+			break;
+		}
+		btSetTaskScheduler(scheduler);
+
+		testThreadCount(scheduler);
+		testParallelFor(scheduler);
+		testParallelSum();
+		testNestedParallelFor();
+
+		// fewer threads than the scheduler started
+		scheduler->setNumThreads(2);
+		testParallelFor(scheduler);
+
+		// a scheduler created after this one numbers its workers from 1 again
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
+		delete scheduler;
+	}
+	return btReportTest("btTaskSchedulerWorkStealingTest");
+}
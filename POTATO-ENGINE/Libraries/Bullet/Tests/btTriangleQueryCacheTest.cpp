@@ -0,0 +1,135 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/CollisionDispatch/btConvexConcaveCollisionAlgorithm.h"
+#include "BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h"
+#include "btUnitTest.h"
+
+#include <math.h>
+#include <vector>
+
+static const int gTerrainSize = 41;
+
+///drops mixed convex shapes on a triangle mesh or a heightfield of the same terrain and returns their transforms
+static void simulate(bool enableCache, bool heightfield, std::vector<btTransform>& transforms, btTriangleQueryCacheStats& stats)
+{
+	btDefaultCollisionConfiguration configuration;
+	btCollisionDispatcher dispatcher(&configuration);
+	btDbvtBroadphase broadphase;
+	btSequentialImpulseConstraintSolver solver;
+	btDiscreteDynamicsWorld world(&dispatcher, &broadphase, &solver, &configuration);
+	world.setGravity(btVector3(0, -10, 0));
+	world.getDispatchInfo().m_enableTriangleQueryCache = enableCache;
+
+	std::vector<float> heights(gTerrainSize * gTerrainSize);
+	for (int i = 0; i < gTerrainSize; ++i)
+	{
+		for (int j = 0; j < gTerrainSize; ++j)
+		{
+			heights[i * gTerrainSize + j] = 0.3f * sinf(i * 0.4f) * cosf(j * 0.3f);
+		}
+	}
+
+	btTriangleMesh mesh;
+	const int half = gTerrainSize / 2;
+	for (int i = 0; i + 1 < gTerrainSize; ++i)
+	{
+		for (int j = 0; j + 1 < gTerrainSize; ++j)
+		{
+			// heightfield rows are along x, the grid is centred like the heightfield's
+			const btVector3 a(btScalar(j - half), heights[i * gTerrainSize + j], btScalar(i - half));
+			const btVector3 b(btScalar(j + 1 - half), heights[i * gTerrainSize + j + 1], btScalar(i - half));
+			const btVector3 c(btScalar(j + 1 - half), heights[(i + 1) * gTerrainSize + j + 1], btScalar(i + 1 - half));
+			const btVector3 d(btScalar(j - half), heights[(i + 1) * gTerrainSize + j], btScalar(i + 1 - half));
+			mesh.addTriangle(a, b, c);
+			mesh.addTriangle(a, c, d);
+		}
+	}
+	btCollisionShape* terrainShape;
+	if (heightfield)
+	{
+		terrainShape = new btHeightfieldTerrainShape(gTerrainSize, gTerrainSize, &heights[0], 1, -1, 1, 1, PHY_FLOAT, false);
+	}
+	else
+	{
+		terrainShape = new btBvhTriangleMeshShape(&mesh, true);
+	}
+	btRigidBody terrain(0, 0, terrainShape);
+	world.addRigidBody(&terrain);
+
+	btBoxShape boxShape(btVector3(.4, .4, .4));
+	btSphereShape sphereShape(.4);
+	btCapsuleShape capsuleShape(.3, .6);
+	btConvexHullShape hullShape;
+	for (int i = 0; i < 12; ++i)
+	{
+		hullShape.addPoint(btVector3(.4f * cosf(float(i)), .3f * sinf(i * 1.7f), .4f * sinf(float(i))));
+	}
+	btCollisionShape* shapes[4] = {&boxShape, &sphereShape, &capsuleShape, &hullShape};
+
+	std::vector<btRigidBody*> bodies;
+	for (int i = 0; i < 160; ++i)
+	{
+		btCollisionShape* shape = shapes[i % 4];
+		btVector3 inertia;
+		shape->calculateLocalInertia(1, inertia);
+		btRigidBody::btRigidBodyConstructionInfo info(1, 0, shape, inertia);
+		info.m_startWorldTransform.setOrigin(btVector3((i % 16) * 1.3f - 10, 1.5f + (i / 80) * 1.2f, ((i / 16) % 5) * 1.3f - 3));
+		info.m_startWorldTransform.setRotation(btQuaternion(btVector3(0.3, 1, 0.1).normalized(), i * 0.37f));
+		btRigidBody* body = new btRigidBody(info);
+		body->setLinearVelocity(btVector3(btScalar(i % 3 - 1), 0, btScalar(i % 5 - 2)));
+		world.addRigidBody(body);
+		bodies.push_back(body);
+	}
+
+	btConvexConcaveCollisionAlgorithm::resetTriangleQueryCacheStats();
+	for (int step = 0; step < 240; ++step)
+	{
+		world.stepSimulation(btScalar(1. / 60.), 1, btScalar(1. / 60.));
+	}
+	btConvexConcaveCollisionAlgorithm::getTriangleQueryCacheStats(stats);
+
+	transforms.clear();
+	for (size_t i = 0; i < bodies.size(); ++i)
+	{
+		transforms.push_back(bodies[i]->getWorldTransform());
+		world.removeRigidBody(bodies[i]);
+		delete bodies[i];
+	}
+	world.removeRigidBody(&terrain);
+	delete terrainShape;
+}
+
+int main()
+{
+	for (int heightfield = 0; heightfield < 2; ++heightfield)
+	{
+		std::vector<btTransform> reference, cached;
+		btTriangleQueryCacheStats referenceStats, cachedStats;
+		simulate(false, heightfield != 0, reference, referenceStats);
+		simulate(true, heightfield != 0, cached, cachedStats);
+
+		// the cache returns the triangles the query would have found, so the simulation does not change
+		BT_CHECK(!reference.empty());
+		BT_CHECK(btCountDifferentTransforms(reference, cached) == 0);
+
+		BT_CHECK(referenceStats.m_queries == 0);
+		BT_CHECK(cachedStats.m_queries > 0);
+		BT_CHECK(cachedStats.m_cacheHits > 0);
+		BT_CHECK(cachedStats.m_triangles > 0);
+	}
+	return btReportTest("btTriangleQueryCacheTest");
+}
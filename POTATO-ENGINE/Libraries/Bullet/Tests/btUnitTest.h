@@ -0,0 +1,88 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_UNIT_TEST_H
+#define BT_UNIT_TEST_H
+
+#include <stdio.h>
+#include <vector>
+
+#include "LinearMath/btTransform.h"
+
+///Checks shared by the Bullet and engine tests. Each test is an executable run by ctest. BT_CHECK prints a condition
+///that does not hold with its location and counts it; main returns btReportTest, so a single failed check fails the test.
+static int gNumFailedChecks = 0;
+
+#define BT_CHECK(condition)                                                        \
+	do                                                                             \
+	{                                                                              \
+		if (!(condition))                                                          \
+		{                                                                          \
+			printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); \
+			gNumFailedChecks++;                                                    \
+		}                                                                          \
+	} while (0)
+
+static inline int btReportTest(const char* testName)
+{
+	printf("%s: %d failed checks\n", testName, gNumFailedChecks);
+	return gNumFailedChecks;
+}
+
+///deterministic random numbers, the same on every platform
+struct btTestRandom
+{
+	unsigned int m_state;
+
+	btTestRandom(unsigned int seed) : m_state(seed) {}
+
+	unsigned int next()
+	{
+		m_state = m_state * 1664525u + 1013904223u;
+		return m_state >> 8;
+	}
+
+	///uniform in [0, 1)
+	float nextFloat()
+	{
+		return float(next()) / 16777216.f;
+	}
+};
+
+///number of transforms that differ in any bit of their basis or origin, the unused fourth components excepted
+static inline int btCountDifferentTransforms(const std::vector<btTransform>& a, const std::vector<btTransform>& b)
+{
+	if (a.size() != b.size())
+	{
+		return int(btMax(a.size(), b.size()));
+	}
+	int numDifferent = 0;
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		bool equal = true;
+		for (int k = 0; k < 3; ++k)
+		{
+			equal = equal && a[i].getOrigin()[k] == b[i].getOrigin()[k];
+			for (int row = 0; row < 3; ++row)
+			{
+				equal = equal && a[i].getBasis()[row][k] == b[i].getBasis()[row][k];
+			}
+		}
+		numDifferent += equal ? 0 : 1;
+	}
+	return numDifferent;
+}
+
+#endif  //BT_UNIT_TEST_H